@@ -2400,6 +2400,9 @@ class USERPREF_PT_experimental_prototypes(ExperimentalPanel, Panel):
                 ({"property": "enable_workbench_next"}, ("blender/blender/issues/101619", "#101619")),
                 ({"property": "use_grease_pencil_version3"}, ("blender/blender/projects/40", "Grease Pencil 3.0")),
                 ({"property": "enable_overlay_next"}, ("blender/blender/issues/102179", "#102179")),
+                ({"property": "use_threaded_blend_write"}, None),
+                ({"property": "use_threaded_blend_read"}, None),
+                ({"property": "use_lazy_blend_data"}, None),
             ),
         )
 
@@ -54,6 +54,8 @@ typedef struct BVHTreeFromMesh {
   /** Default callbacks to BVH nearest and ray-cast. */
   BVHTree_NearestPointCallback nearest_callback;
   BVHTree_RayCastCallback raycast_callback;
+  /** Optional callback to #BLI_bvhtree_ray_cast_batch, testing a packet of rays at once. */
+  BVHTree_RayCastPacketCallback raycast_packet_callback;
 
   /* Vertex array, so that callbacks have instant access to data. */
   const float (*vert_positions)[3];
@@ -262,6 +264,11 @@ void free_bvhtree_from_pointcloud(struct BVHTreeFromPointCloud *data);
 
 bool bvhcache_has_tree(const struct BVHCache *bvh_cache, const BVHTree *tree);
 struct BVHCache *bvhcache_init(void);
+/**
+ * Tag the cached trees to be refitted to the new positions the next time they are used, instead
+ * of building them again. Only valid when the topology of the mesh didn't change.
+ */
+void bvhcache_tag_positions_changed(struct BVHCache *bvh_cache);
 /**
  * Frees a BVH-cache.
  */
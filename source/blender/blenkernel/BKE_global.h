@@ -207,6 +207,10 @@ enum {
 
   G_DEBUG_GHOST = (1 << 23),  /* Debug GHOST module. */
   G_DEBUG_WINTAB = (1 << 24), /* Debug Wintab. */
+
+  G_DEBUG_DEPSGRAPH_CRITICAL_PATH = (1 << 25), /* Prioritize operations on the longest path. */
+  G_DEBUG_DEPSGRAPH_VALIDATE_INCREMENTAL = (1 << 26), /* Compare incremental relations updates
+                                                       * against a full rebuild. */
 };
 
 #define G_DEBUG_ALL \
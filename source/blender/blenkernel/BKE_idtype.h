@@ -48,6 +48,18 @@ enum {
    * data-blocks.
    */
   IDTYPE_FLAGS_NO_MEMFILE_UNDO = 1 << 5,
+  /**
+   * Indicates that the `blend_write` callback of the given IDType only modifies the temporary
+   * copy of the ID it writes, so that several IDs of that type can be serialized in parallel when
+   * saving a file.
+   */
+  IDTYPE_FLAGS_THREADSAFE_BLEND_WRITE = 1 << 6,
+  /**
+   * Indicates that the `blend_read_data` callback of the given IDType only accesses the ID it
+   * reads and its own data, so that several IDs of that type can be read in parallel when loading
+   * a file.
+   */
+  IDTYPE_FLAGS_THREADSAFE_BLEND_READ_DATA = 1 << 7,
 };
 
 typedef struct IDCacheKey {
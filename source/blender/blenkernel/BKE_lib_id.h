@@ -377,6 +377,11 @@ enum {
   /** Clear asset data (in case the ID can actually be made local, in copy case asset data is never
    * copied over). */
   LIB_ID_MAKELOCAL_ASSET_DATA_CLEAR = 1 << 3,
+
+  /** Do not ensure unique names for the IDs made local directly (and their shape keys). The caller
+   * does it for all of them at once with #BKE_main_namemap_get_names, and sorts them again in
+   * their lists. The name map of local IDs must exist already, see #BKE_main_namemap_ensure. */
+  LIB_ID_MAKELOCAL_DEFER_UNIQUE_NAME = 1 << 4,
 };
 
 /**
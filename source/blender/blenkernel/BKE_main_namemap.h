@@ -38,6 +38,14 @@ void BKE_main_namemap_destroy(struct UniqueName_Map **r_name_map) ATTR_NONNULL()
  */
 void BKE_main_namemap_clear(struct Main *bmain) ATTR_NONNULL();
 
+/**
+ * Create the name map of the local IDs in given bmain, if it does not exist yet.
+ *
+ * Needed before making IDs local without ensuring their names are unique (see
+ * #LIB_ID_MAKELOCAL_DEFER_UNIQUE_NAME), so that the map is not created from their names.
+ */
+void BKE_main_namemap_ensure(struct Main *bmain) ATTR_NONNULL();
+
 /**
  * Ensures the given name is unique within the given ID type.
  *
@@ -47,6 +55,21 @@ void BKE_main_namemap_clear(struct Main *bmain) ATTR_NONNULL();
  */
 bool BKE_main_namemap_get_name(struct Main *bmain, struct ID *id, char *name) ATTR_NONNULL();
 
+/**
+ * Ensures unique names for many IDs at once, with the same result as calling
+ * #BKE_main_namemap_get_name for each of them in order. The adjusted names are written to the
+ * IDs directly. The IDs may be of different types and libraries, and their names must not be in
+ * use by the name maps yet.
+ *
+ * Each name map is only grown once for all new names, which makes this faster than adding names
+ * one by one when registering thousands of IDs.
+ *
+ * \note The lists of IDs in `bmain` are not re-sorted.
+ *
+ * \return true if any name had to be adjusted for uniqueness.
+ */
+bool BKE_main_namemap_get_names(struct Main *bmain, struct ID **ids, int ids_num) ATTR_NONNULL();
+
 /**
  * Remove a given name from usage.
  *
@@ -161,6 +161,11 @@ class ModifierSimulationCache {
  public:
   CacheState cache_state_ = CacheState::Valid;
   bool failed_finding_bake_ = false;
+  /**
+   * Memory-map baked binary data instead of reading it into new arrays. Only the parts of the
+   * baked data that are accessed are read from disk then.
+   */
+  bool use_mmap_for_bake_ = true;
 
   float last_fps_ = 0.0f;
 
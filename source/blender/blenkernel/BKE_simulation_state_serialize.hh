@@ -4,8 +4,11 @@
 
 #include "BKE_simulation_state.hh"
 
+#include "BLI_array.hh"
+#include "BLI_implicit_sharing_ptr.hh"
 #include "BLI_serialize.hh"
 
+struct BLI_mmap_file;
 struct Main;
 struct ModifierData;
 
@@ -39,18 +42,53 @@ class BDataReader {
    * \return True on success, otherwise false.
    */
   [[nodiscard]] virtual bool read(const BDataSlice &slice, void *r_data) const = 0;
+
+  /**
+   * Get shared read-only access to the data in the given slice without copying it. Not all
+   * readers support this, in which case #read has to be used instead.
+   * \param alignment: Required alignment of the returned data.
+   * \return Shared ownership of the referenced data, or none if the data can't be referenced.
+   */
+  [[nodiscard]] virtual std::optional<ImplicitSharingInfoAndData> read_mapped(
+      const BDataSlice &slice, int64_t alignment) const;
+};
+
+/**
+ * Settings for how arrays are encoded before they are written.
+ */
+struct BDataEncoding {
+  /**
+   * Compress arrays with zstd. Arrays are split into blocks that are compressed independently,
+   * so that they can be decompressed in parallel.
+   */
+  bool use_compression = false;
+  /**
+   * When greater than one, arrays are stored as bitwise difference to the array that has been
+   * written with the same key at the last key frame. Every n-th array is a key frame that is
+   * stored in full, so that any array can be decoded by reading at most one other array. This
+   * is only useful in combination with compression.
+   */
+  int delta_key_interval = 0;
 };
 
 /**
  * Abstract base class for writing binary data.
  */
 class BDataWriter {
+ protected:
+  BDataEncoding encoding_;
+
  public:
   /**
    * Write the provided binary data.
    * \return Slice where the data has been written to.
    */
   virtual BDataSlice write(const void *data, int64_t size) = 0;
+
+  const BDataEncoding &encoding() const
+  {
+    return encoding_;
+  }
 };
 
 /**
@@ -89,6 +127,32 @@ class BDataSharing {
    */
   mutable Map<std::string, ImplicitSharingInfoAndData> runtime_by_stored_;
 
+  struct DeltaBase {
+    /** Identifier of the stored data that later data can be stored relative to. */
+    DictionaryValuePtr io_data;
+    /**
+     * Shared ownership of the stored data, which keeps it alive and unchanged without copying it.
+     * Null when the data isn't shared, in which case #data_copy is used.
+     */
+    ImplicitSharingPtr<const ImplicitSharingInfo> sharing_info;
+    Span<char> shared_data;
+    /** Copy of the stored data when it can't be referenced. */
+    Array<char> data_copy;
+
+    Span<char> data() const
+    {
+      return sharing_info ? shared_data : data_copy.as_span();
+    }
+    /** Number of arrays that have been stored relative to this base. */
+    int deltas_num = 0;
+  };
+
+  /**
+   * Data that has been written in full before, used for delta encoding data that is written for
+   * the same key again, typically on the next frame. Only the last key frame of every key is kept.
+   */
+  Map<std::string, DeltaBase> delta_bases_;
+
  public:
   ~BDataSharing();
 
@@ -108,6 +172,24 @@ class BDataSharing {
   [[nodiscard]] std::optional<ImplicitSharingInfoAndData> read_shared(
       const DictionaryValue &io_data,
       FunctionRef<std::optional<ImplicitSharingInfoAndData>()> read_fn) const;
+
+  /**
+   * Write data as bitwise difference (XOR) to the data that has been written with the same key
+   * before, if possible. Otherwise the data is written in full and becomes the new base for
+   * following writes with the same key.
+   * \param sharing_info: Optional owner of the data, the data is only copied for later writes
+   * when it is null.
+   * \param key_interval: Number of writes after which the data is written in full again.
+   * \param write_fn: Writes the given bytes. The second parameter references the base data the
+   * bytes are relative to, or is null if the bytes are the full data.
+   */
+  [[nodiscard]] DictionaryValuePtr write_delta(
+      StringRef key,
+      Span<char> data,
+      const ImplicitSharingInfo *sharing_info,
+      int key_interval,
+      FunctionRef<DictionaryValuePtr(Span<char> data, const DictionaryValuePtr &io_base)>
+          write_fn);
 };
 
 /**
@@ -116,16 +198,29 @@ class BDataSharing {
 class DiskBDataReader : public BDataReader {
  private:
   const std::string bdata_dir_;
+  /**
+   * When true, bdata files are memory-mapped and arrays reference the mapped memory directly.
+   * Only the pages of arrays that are actually accessed are then read from disk.
+   */
+  const bool use_mmap_;
   mutable std::mutex mutex_;
   mutable Map<std::string, std::unique_ptr<fstream>> open_input_streams_;
+  /**
+   * Mapped files by path. Arrays referencing the mapped memory keep the mapping alive after the
+   * reader has been destructed. Null when mapping the file failed.
+   */
+  mutable Map<std::string, std::shared_ptr<BLI_mmap_file>> mapped_files_;
 
  public:
-  DiskBDataReader(std::string bdata_dir);
+  DiskBDataReader(std::string bdata_dir, bool use_mmap = false);
   [[nodiscard]] bool read(const BDataSlice &slice, void *r_data) const override;
+  [[nodiscard]] std::optional<ImplicitSharingInfoAndData> read_mapped(
+      const BDataSlice &slice, int64_t alignment) const override;
 };
 
 /**
- * A specific #BDataWriter that writes to a file on disk.
+ * A specific #BDataWriter that writes to a file on disk. Every slice starts at an offset that is
+ * a multiple of #DiskBDataWriter::slice_alignment, so that mapped files can be used directly.
  */
 class DiskBDataWriter : public BDataWriter {
  private:
@@ -137,7 +232,12 @@ class DiskBDataWriter : public BDataWriter {
   int64_t current_offset_;
 
  public:
-  DiskBDataWriter(std::string bdata_name, std::ostream &bdata_file, int64_t current_offset);
+  static constexpr int64_t slice_alignment = 16;
+
+  DiskBDataWriter(std::string bdata_name,
+                  std::ostream &bdata_file,
+                  int64_t current_offset,
+                  const BDataEncoding &encoding = {});
 
   BDataSlice write(const void *data, int64_t size) override;
 };
@@ -1110,6 +1110,13 @@ void BKE_blendfile_append(BlendfileLinkAppendContext *lapp_context, ReportList *
     }
   }
 
+  /* IDs made local directly get unique names all at once after the loop below, which is much
+   * faster than one by one when appending many of them. */
+  BKE_main_namemap_ensure(bmain);
+  ID **renamed_ids = MEM_mallocN(sizeof(*renamed_ids) * (size_t)lapp_context->num_items * 2,
+                                 __func__);
+  int renamed_ids_num = 0;
+
   /* Effectively perform required operation on every linked ID. */
   for (itemlink = lapp_context->items.list; itemlink; itemlink = itemlink->next) {
     BlendfileLinkAppendContextItem *item = itemlink->link;
@@ -1119,6 +1126,7 @@ void BKE_blendfile_append(BlendfileLinkAppendContext *lapp_context, ReportList *
     }
 
     ID *local_appended_new_id = NULL;
+    Key *key = NULL;
     char lib_filepath[FILE_MAX];
     STRNCPY(lib_filepath, id->lib->filepath);
     char lib_id_name[MAX_ID_NAME];
@@ -1130,8 +1138,21 @@ void BKE_blendfile_append(BlendfileLinkAppendContext *lapp_context, ReportList *
         local_appended_new_id = id->newid;
         break;
       case LINK_APPEND_ACT_MAKE_LOCAL:
-        BKE_lib_id_make_local(bmain, id, make_local_common_flags | LIB_ID_MAKELOCAL_FORCE_LOCAL);
+        /* The ID may already have been made local together with another one. Shape keys are made
+         * local together with their owner. */
+        if (ID_IS_LINKED(id)) {
+          renamed_ids[renamed_ids_num++] = id;
+          key = BKE_key_from_id(id);
+          if (key != NULL && ID_IS_LINKED(key)) {
+            renamed_ids[renamed_ids_num++] = &key->id;
+          }
+        }
+        BKE_lib_id_make_local(bmain,
+                              id,
+                              make_local_common_flags | LIB_ID_MAKELOCAL_FORCE_LOCAL |
+                                  LIB_ID_MAKELOCAL_DEFER_UNIQUE_NAME);
         BLI_assert(id->newid == NULL);
+        BLI_assert(!ID_IS_LINKED(id) && (key == NULL || !ID_IS_LINKED(key)));
         local_appended_new_id = id;
         break;
       case LINK_APPEND_ACT_KEEP_LINKED:
@@ -1170,6 +1191,21 @@ void BKE_blendfile_append(BlendfileLinkAppendContext *lapp_context, ReportList *
   BKE_main_library_weak_reference_destroy(lapp_context->library_weak_reference_mapping);
   lapp_context->library_weak_reference_mapping = NULL;
 
+  if (BKE_main_namemap_get_names(bmain, renamed_ids, renamed_ids_num)) {
+    bmain->is_memfile_undo_written = false;
+  }
+  /* Sort the IDs again with their final names. Take them all out of their lists first, so that
+   * each one is inserted into a sorted list. */
+  for (int i = 0; i < renamed_ids_num; i++) {
+    BLI_remlink(which_libbase(bmain, GS(renamed_ids[i]->name)), renamed_ids[i]);
+  }
+  for (int i = 0; i < renamed_ids_num; i++) {
+    ListBase *lb = which_libbase(bmain, GS(renamed_ids[i]->name));
+    BLI_addhead(lb, renamed_ids[i]);
+    id_sort_by_name(lb, renamed_ids[i], NULL);
+  }
+  MEM_freeN(renamed_ids);
+
   /* Remap IDs as needed. */
   for (itemlink = lapp_context->items.list; itemlink; itemlink = itemlink->next) {
     BlendfileLinkAppendContextItem *item = itemlink->link;
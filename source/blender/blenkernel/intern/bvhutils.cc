@@ -43,7 +43,11 @@ using blender::VArray;
 
 struct BVHCacheItem {
   bool is_filled;
+  /** The positions changed since the tree was built, see #bvhcache_tag_positions_changed. */
+  bool needs_refit;
   BVHTree *tree;
+  /** Cost of the tree right after building it, see #BLI_bvhtree_sah_cost. */
+  float build_cost;
 };
 
 struct BVHCache {
@@ -82,7 +86,7 @@ static bool bvhcache_find(BVHCache **bvh_cache_p,
   }
   BVHCache *bvh_cache = *bvh_cache_p;
 
-  if (bvh_cache->items[type].is_filled) {
+  if (bvh_cache->items[type].is_filled && !bvh_cache->items[type].needs_refit) {
     *r_tree = bvh_cache->items[type].tree;
     return true;
   }
@@ -133,14 +137,38 @@ BVHCache *bvhcache_init()
  * A call to this assumes that there was no previous cached tree of the given type
  * \warning The #BVHTree can be nullptr.
  */
-static void bvhcache_insert(BVHCache *bvh_cache, BVHTree *tree, BVHCacheType type)
+static void bvhcache_insert(BVHCache *bvh_cache,
+                            BVHTree *tree,
+                            const float build_cost,
+                            BVHCacheType type)
 {
   BVHCacheItem *item = &bvh_cache->items[type];
   BLI_assert(!item->is_filled);
   item->tree = tree;
+  item->build_cost = build_cost;
+  item->needs_refit = false;
   item->is_filled = true;
 }
 
+void bvhcache_tag_positions_changed(BVHCache *bvh_cache)
+{
+  for (int index = 0; index < BVHTREE_MAX_ITEM; index++) {
+    BVHCacheItem *item = &bvh_cache->items[index];
+    if (!item->is_filled) {
+      continue;
+    }
+    if (ELEM(index, BVHTREE_FROM_EM_VERTS, BVHTREE_FROM_EM_EDGES, BVHTREE_FROM_EM_LOOPTRI)) {
+      /* Edit-mesh trees are not refitted, build them again. */
+      BLI_bvhtree_free(item->tree);
+      item->tree = nullptr;
+      item->is_filled = false;
+    }
+    else if (item->tree) {
+      item->needs_refit = true;
+    }
+  }
+}
+
 void bvhcache_free(BVHCache *bvh_cache)
 {
   for (int index = 0; index < BVHTREE_MAX_ITEM; index++) {
@@ -152,26 +180,193 @@ void bvhcache_free(BVHCache *bvh_cache)
   MEM_freeN(bvh_cache);
 }
 
+/**
+ * Trees with more elements than this are built with #BVH_BUILD_QUALITY_FAST. For meshes of that
+ * size the (partly single threaded) build takes longer than the queries of most evaluations.
+ */
+#define BVHTREE_FAST_BUILD_THRESHOLD (1 << 22)
+
+static void bvhtree_balance_for_size(BVHTree *tree)
+{
+  const eBVHBuildQuality quality = (BLI_bvhtree_get_len(tree) > BVHTREE_FAST_BUILD_THRESHOLD) ?
+                                       BVH_BUILD_QUALITY_FAST :
+                                       BVH_BUILD_QUALITY_HIGH;
+  BLI_bvhtree_balance_ex(tree, quality);
+}
+
+struct BVHTreeBalanceData {
+  BVHTree *tree;
+  /** Compute the cost of the balanced tree, see #BLI_bvhtree_sah_cost. */
+  bool calc_cost;
+  float cost;
+};
+
 /**
  * BVH-tree balancing inside a mutex lock must be run in isolation. Balancing
  * is multithreaded, and we do not want the current thread to start another task
  * that may involve acquiring the same mutex lock that it is waiting for.
+ * The same goes for computing the cost of big trees.
  */
 static void bvhtree_balance_isolated(void *userdata)
 {
-  BLI_bvhtree_balance((BVHTree *)userdata);
+  BVHTreeBalanceData *balance_data = (BVHTreeBalanceData *)userdata;
+  bvhtree_balance_for_size(balance_data->tree);
+  if (balance_data->calc_cost) {
+    balance_data->cost = BLI_bvhtree_sah_cost(balance_data->tree);
+  }
 }
 
-static void bvhtree_balance(BVHTree *tree, const bool isolate)
+/** Balance the tree, when \a r_cost is given its cost is computed as well. */
+static void bvhtree_balance(BVHTree *tree, const bool isolate, float *r_cost = nullptr)
 {
+  BVHTreeBalanceData balance_data = {tree, r_cost != nullptr, 0.0f};
   if (tree) {
     if (isolate) {
-      BLI_task_isolate(bvhtree_balance_isolated, tree);
+      BLI_task_isolate(bvhtree_balance_isolated, &balance_data);
     }
     else {
-      BLI_bvhtree_balance(tree);
+      bvhtree_balance_isolated(&balance_data);
     }
   }
+  if (r_cost) {
+    *r_cost = balance_data.cost;
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Refit Cached Trees
+ *
+ * When only the positions of a mesh changed, the cached trees keep their structure and only the
+ * bounding volumes are updated. This is much faster than building the tree again, but the tree
+ * degrades when the mesh deforms a lot, in which case it is built again.
+ * \{ */
+
+/**
+ * Build refitted trees again when their cost grew by more than this factor. Queries on the
+ * degraded tree would take longer than building a new one.
+ */
+#define BVHTREE_REFIT_COST_FACTOR 2.0f
+
+static int mesh_verts_refit_leaf(void *userdata, int index, float (*r_co)[3])
+{
+  const BVHTreeFromMesh *data = (BVHTreeFromMesh *)userdata;
+  copy_v3_v3(r_co[0], data->vert_positions[index]);
+  return 1;
+}
+
+static int mesh_edges_refit_leaf(void *userdata, int index, float (*r_co)[3])
+{
+  const BVHTreeFromMesh *data = (BVHTreeFromMesh *)userdata;
+  const blender::int2 &edge = reinterpret_cast<const blender::int2 *>(data->edge)[index];
+  copy_v3_v3(r_co[0], data->vert_positions[edge[0]]);
+  copy_v3_v3(r_co[1], data->vert_positions[edge[1]]);
+  return 2;
+}
+
+static int mesh_faces_refit_leaf(void *userdata, int index, float (*r_co)[3])
+{
+  const BVHTreeFromMesh *data = (BVHTreeFromMesh *)userdata;
+  const MFace *face = &data->face[index];
+  copy_v3_v3(r_co[0], data->vert_positions[face->v1]);
+  copy_v3_v3(r_co[1], data->vert_positions[face->v2]);
+  copy_v3_v3(r_co[2], data->vert_positions[face->v3]);
+  if (face->v4) {
+    copy_v3_v3(r_co[3], data->vert_positions[face->v4]);
+    return 4;
+  }
+  return 3;
+}
+
+static int mesh_looptri_refit_leaf(void *userdata, int index, float (*r_co)[3])
+{
+  const BVHTreeFromMesh *data = (BVHTreeFromMesh *)userdata;
+  const MLoopTri *lt = &data->looptri[index];
+  for (int i = 0; i < 3; i++) {
+    copy_v3_v3(r_co[i], data->vert_positions[data->corner_verts[lt->tri[i]]]);
+  }
+  return 3;
+}
+
+struct BVHCacheRefitData {
+  BVHTree *tree;
+  BVHTree_RefitLeafCallback leaf_cb;
+  const BVHTreeFromMesh *data;
+  /** Cost of the refitted tree. */
+  float cost;
+};
+
+static void bvhtree_refit_isolated(void *userdata)
+{
+  BVHCacheRefitData *refit_data = (BVHCacheRefitData *)userdata;
+  BLI_bvhtree_refit(refit_data->tree, refit_data->leaf_cb, (void *)refit_data->data);
+  refit_data->cost = BLI_bvhtree_sah_cost(refit_data->tree);
+}
+
+/**
+ * Refit the cached tree of the given type if the positions changed since it was built.
+ * Returns false when there is no such tree, or when refitting degraded it too much, in which
+ * case it is removed from the cache to be built again.
+ *
+ * Like balancing, refitting inside the mutex lock must be run in isolation.
+ */
+static bool bvhcache_refit(BVHCache *bvh_cache,
+                           const BVHCacheType type,
+                           const BVHTreeFromMesh *data,
+                           const bool isolate,
+                           BVHTree **r_tree)
+{
+  BVHCacheItem *item = &bvh_cache->items[type];
+  if (!item->is_filled || !item->needs_refit) {
+    return false;
+  }
+
+  BVHCacheRefitData refit_data = {item->tree, nullptr, data, 0.0f};
+  switch (type) {
+    case BVHTREE_FROM_VERTS:
+    case BVHTREE_FROM_LOOSEVERTS:
+      refit_data.leaf_cb = mesh_verts_refit_leaf;
+      break;
+    case BVHTREE_FROM_EDGES:
+    case BVHTREE_FROM_LOOSEEDGES:
+      refit_data.leaf_cb = mesh_edges_refit_leaf;
+      break;
+    case BVHTREE_FROM_FACES:
+      refit_data.leaf_cb = mesh_faces_refit_leaf;
+      break;
+    case BVHTREE_FROM_LOOPTRI:
+    case BVHTREE_FROM_LOOPTRI_NO_HIDDEN:
+      refit_data.leaf_cb = mesh_looptri_refit_leaf;
+      break;
+    case BVHTREE_FROM_EM_VERTS:
+    case BVHTREE_FROM_EM_EDGES:
+    case BVHTREE_FROM_EM_LOOPTRI:
+    case BVHTREE_MAX_ITEM:
+      BLI_assert_unreachable();
+      return false;
+  }
+
+  if (isolate) {
+    BLI_task_isolate(bvhtree_refit_isolated, &refit_data);
+  }
+  else {
+    bvhtree_refit_isolated(&refit_data);
+  }
+
+  if (refit_data.cost > item->build_cost * BVHTREE_REFIT_COST_FACTOR) {
+    /* Lookups without the lock skip the item while it still needs refitting, so the tree can be
+     * freed before the item is emptied. */
+    BLI_bvhtree_free(item->tree);
+    item->tree = nullptr;
+    item->is_filled = false;
+    return false;
+  }
+
+  /* Only publish the tree once it is valid for the current positions. */
+  *r_tree = item->tree;
+  item->needs_refit = false;
+  return true;
 }
 
 /** \} */
@@ -432,6 +627,60 @@ static void editmesh_looptri_spherecast(void *userdata,
   }
 }
 
+/**
+ * Packet version of #mesh_looptri_spherecast. Only the triangle's vertices and normal are
+ * shared by the packet: the intersection tests are still scalar and done one ray at a time, with
+ * the same functions as #mesh_looptri_spherecast so that both find the same hits.
+ */
+static void mesh_looptri_spherecast_packet(void *userdata,
+                                           int index,
+                                           const BVHTreeRay *rays,
+                                           BVHTreeRayHit *hits,
+                                           const uint ray_mask)
+{
+  const BVHTreeFromMesh *data = (BVHTreeFromMesh *)userdata;
+  const float(*positions)[3] = data->vert_positions;
+  const MLoopTri *lt = &data->looptri[index];
+  const float *vtri_co[3] = {
+      positions[data->corner_verts[lt->tri[0]]],
+      positions[data->corner_verts[lt->tri[1]]],
+      positions[data->corner_verts[lt->tri[2]]],
+  };
+  float dists[BVH_RAYCAST_PACKET_SIZE];
+  uint hit_mask = 0;
+
+  for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+    if ((ray_mask & (1u << i)) == 0) {
+      continue;
+    }
+    const BVHTreeRay *ray = &rays[i];
+    if (ray->radius == 0.0f) {
+      dists[i] = bvhtree_ray_tri_intersection(ray, hits[i].dist, UNPACK3(vtri_co));
+    }
+    else {
+      dists[i] = bvhtree_sphereray_tri_intersection(
+          ray, ray->radius, hits[i].dist, UNPACK3(vtri_co));
+    }
+    if (dists[i] >= 0 && dists[i] < hits[i].dist) {
+      hit_mask |= 1u << i;
+    }
+  }
+  if (hit_mask == 0) {
+    return;
+  }
+
+  float no[3];
+  normal_tri_v3(no, UNPACK3(vtri_co));
+  for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+    if (hit_mask & (1u << i)) {
+      hits[i].index = index;
+      hits[i].dist = dists[i];
+      madd_v3_v3v3fl(hits[i].co, rays[i].origin, rays[i].direction, dists[i]);
+      copy_v3_v3(hits[i].no, no);
+    }
+  }
+}
+
 /**
  * Callback to BVH-tree nearest point.
  * The tree must have been built using #bvhtree_from_mesh_edges.
@@ -616,6 +865,7 @@ static void bvhtree_from_mesh_setup_data(BVHTree *tree,
     case BVHTREE_FROM_LOOPTRI_NO_HIDDEN:
       r_data->nearest_callback = mesh_looptri_nearest_point;
       r_data->raycast_callback = mesh_looptri_spherecast;
+      r_data->raycast_packet_callback = mesh_looptri_spherecast_packet;
       break;
     case BVHTREE_FROM_EM_VERTS:
     case BVHTREE_FROM_EM_EDGES:
@@ -1209,6 +1459,12 @@ BVHTree *BKE_bvhtree_from_mesh_get(struct BVHTreeFromMesh *data,
     return data->tree;
   }
 
+  if (bvhcache_refit(*bvh_cache_p, bvh_cache_type, data, lock_started, &data->tree)) {
+    data->cached = true;
+    bvhcache_unlock(*bvh_cache_p, lock_started);
+    return data->tree;
+  }
+
   /* Create BVHTree. */
 
   switch (bvh_cache_type) {
@@ -1277,13 +1533,14 @@ BVHTree *BKE_bvhtree_from_mesh_get(struct BVHTreeFromMesh *data,
       break;
   }
 
-  bvhtree_balance(data->tree, lock_started);
+  float build_cost;
+  bvhtree_balance(data->tree, lock_started, &build_cost);
 
   /* Save on cache for later use */
   // printf("BVHTree built and saved on cache\n");
   BLI_assert(data->cached == false);
   data->cached = true;
-  bvhcache_insert(*bvh_cache_p, data->tree, bvh_cache_type);
+  bvhcache_insert(*bvh_cache_p, data->tree, build_cost, bvh_cache_type);
   bvhcache_unlock(*bvh_cache_p, lock_started);
 
 #ifdef DEBUG
@@ -1349,7 +1606,8 @@ BVHTree *BKE_bvhtree_from_editmesh_get(BVHTreeFromEditMesh *data,
     // printf("BVHTree built and saved on cache\n");
     BLI_assert(data->cached == false);
     data->cached = true;
-    bvhcache_insert(*bvh_cache_p, data->tree, bvh_cache_type);
+    /* Edit-mesh trees are built again instead of refitted, their cost is not needed. */
+    bvhcache_insert(*bvh_cache_p, data->tree, 0.0f, bvh_cache_type);
     bvhcache_unlock(*bvh_cache_p, lock_started);
   }
 
@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_kdopbvh.h"
+#include "BLI_math_vector.h"
+#include "BLI_math_vector_types.hh"
+#include "BLI_rand.hh"
+
+#include "DNA_mesh_types.h"
+
+#include "BKE_bvhutils.h"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh.hh"
+
+namespace blender::bke::tests {
+
+/** Grid of quads in the XY plane with a wave along Z, so that rays can hit it at any angle. */
+static Mesh *create_wavy_grid_mesh(const int size)
+{
+  const int verts_num = (size + 1) * (size + 1);
+  const int polys_num = size * size;
+  Mesh *mesh = BKE_mesh_new_nomain(verts_num, 0, polys_num, polys_num * 4);
+
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  for (const int y : IndexRange(size + 1)) {
+    for (const int x : IndexRange(size + 1)) {
+      const float fx = float(x) / float(size) * 2.0f - 1.0f;
+      const float fy = float(y) / float(size) * 2.0f - 1.0f;
+      positions[y * (size + 1) + x] = float3(fx, fy, 0.2f * sinf(fx * 5.0f) * cosf(fy * 5.0f));
+    }
+  }
+
+  MutableSpan<int> poly_offsets = mesh->poly_offsets_for_write();
+  MutableSpan<int> corner_verts = mesh->corner_verts_for_write();
+  for (const int y : IndexRange(size)) {
+    for (const int x : IndexRange(size)) {
+      const int poly = y * size + x;
+      const int vert = y * (size + 1) + x;
+      poly_offsets[poly] = poly * 4;
+      corner_verts[poly * 4 + 0] = vert;
+      corner_verts[poly * 4 + 1] = vert + 1;
+      corner_verts[poly * 4 + 2] = vert + size + 2;
+      corner_verts[poly * 4 + 3] = vert + size + 1;
+    }
+  }
+  BKE_mesh_calc_edges(mesh, false, false);
+  return mesh;
+}
+
+/**
+ * Cast rays at a mesh one by one with the ray-cast callback and as a batch with the packet
+ * callback of the looptri BVH tree, both have to find the same hits.
+ */
+static void mesh_ray_cast_batch_test(const float radius)
+{
+  BKE_idtype_init();
+  Mesh *mesh = create_wavy_grid_mesh(32);
+  BVHTreeFromMesh tree_data;
+  BKE_bvhtree_from_mesh_get(&tree_data, mesh, BVHTREE_FROM_LOOPTRI, 2);
+  ASSERT_NE(tree_data.tree, nullptr);
+  ASSERT_NE(tree_data.raycast_packet_callback, nullptr);
+
+  const int rays_num = 1000;
+  RandomNumberGenerator rng(42);
+  Array<float3> origins(rays_num);
+  Array<float3> directions(rays_num);
+  Array<BVHTreeRayHit> hits(rays_num);
+  for (const int i : IndexRange(rays_num)) {
+    origins[i] = float3(rng.get_float() * 4.0f - 2.0f, rng.get_float() * 4.0f - 2.0f, 1.0f);
+    const float3 target(rng.get_float() * 2.0f - 1.0f, rng.get_float() * 2.0f - 1.0f, 0.0f);
+    directions[i] = math::normalize(target - origins[i]);
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+
+  BLI_bvhtree_ray_cast_batch(tree_data.tree,
+                             reinterpret_cast<const float(*)[3]>(origins.data()),
+                             reinterpret_cast<const float(*)[3]>(directions.data()),
+                             rays_num,
+                             radius,
+                             hits.data(),
+                             tree_data.raycast_callback,
+                             tree_data.raycast_packet_callback,
+                             &tree_data);
+
+  int hits_num = 0;
+  for (const int i : IndexRange(rays_num)) {
+    BVHTreeRayHit hit;
+    hit.index = -1;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree_data.tree,
+                         origins[i],
+                         directions[i],
+                         radius,
+                         &hit,
+                         tree_data.raycast_callback,
+                         &tree_data);
+    /* A sphere touching an edge first hits both triangles of the edge at the same distance. */
+    if (radius == 0.0f) {
+      EXPECT_EQ(hits[i].index, hit.index);
+    }
+    else {
+      EXPECT_EQ(hits[i].index == -1, hit.index == -1);
+    }
+    if (hit.index != -1) {
+      EXPECT_NEAR(hits[i].dist, hit.dist, 1e-4f);
+      EXPECT_V3_NEAR(hits[i].co, hit.co, 1e-4f);
+      hits_num++;
+    }
+  }
+  /* All rays are aimed at the mesh, some may still miss it because of the waves. */
+  EXPECT_GT(hits_num, rays_num / 2);
+
+  free_bvhtree_from_mesh(&tree_data);
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST(bvhutils, MeshRayCastBatch)
+{
+  mesh_ray_cast_batch_test(0.0f);
+}
+
+TEST(bvhutils, MeshRayCastBatchRadius)
+{
+  mesh_ray_cast_batch_test(0.05f);
+}
+
+/** Ray casts straight down onto the mesh have to hit the same triangles with both trees. */
+static void expect_same_ray_cast_hits(BVHTreeFromMesh &tree_data_a, BVHTreeFromMesh &tree_data_b)
+{
+  RandomNumberGenerator rng(7);
+  for ([[maybe_unused]] const int i : IndexRange(100)) {
+    const float3 origin(rng.get_float() * 1.8f - 0.9f, rng.get_float() * 1.8f - 0.9f, 10.0f);
+    const float3 direction(0.0f, 0.0f, -1.0f);
+    BVHTreeRayHit hit_a, hit_b;
+    hit_a.index = hit_b.index = -1;
+    hit_a.dist = hit_b.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree_data_a.tree,
+                         origin,
+                         direction,
+                         0.0f,
+                         &hit_a,
+                         tree_data_a.raycast_callback,
+                         &tree_data_a);
+    BLI_bvhtree_ray_cast(tree_data_b.tree,
+                         origin,
+                         direction,
+                         0.0f,
+                         &hit_b,
+                         tree_data_b.raycast_callback,
+                         &tree_data_b);
+    EXPECT_NE(hit_a.index, -1);
+    EXPECT_EQ(hit_a.index, hit_b.index);
+    EXPECT_FLOAT_EQ(hit_a.dist, hit_b.dist);
+  }
+}
+
+/**
+ * Compare the cached tree of the mesh with a tree built from scratch for a copy of the mesh,
+ * which has no cache.
+ */
+static float cached_tree_cost_compared_to_new_tree(Mesh *mesh, BVHTree *expected_cached_tree)
+{
+  BVHTreeFromMesh tree_data;
+  BKE_bvhtree_from_mesh_get(&tree_data, mesh, BVHTREE_FROM_LOOPTRI, 2);
+  EXPECT_TRUE(tree_data.cached);
+  if (expected_cached_tree != nullptr) {
+    EXPECT_EQ(tree_data.tree, expected_cached_tree);
+  }
+
+  Mesh *mesh_copy = BKE_mesh_copy_for_eval(mesh);
+  BVHTreeFromMesh new_tree_data;
+  BKE_bvhtree_from_mesh_get(&new_tree_data, mesh_copy, BVHTREE_FROM_LOOPTRI, 2);
+  EXPECT_NE(new_tree_data.tree, tree_data.tree);
+
+  expect_same_ray_cast_hits(tree_data, new_tree_data);
+  const float cost_ratio = BLI_bvhtree_sah_cost(tree_data.tree) /
+                           BLI_bvhtree_sah_cost(new_tree_data.tree);
+
+  free_bvhtree_from_mesh(&new_tree_data);
+  BKE_id_free(nullptr, mesh_copy);
+  free_bvhtree_from_mesh(&tree_data);
+  return cost_ratio;
+}
+
+TEST(bvhutils, CachedTreeRefit)
+{
+  BKE_idtype_init();
+  Mesh *mesh = create_wavy_grid_mesh(32);
+  BVHTreeFromMesh tree_data;
+  BKE_bvhtree_from_mesh_get(&tree_data, mesh, BVHTREE_FROM_LOOPTRI, 2);
+  BVHTree *tree = tree_data.tree;
+  free_bvhtree_from_mesh(&tree_data);
+  ASSERT_NE(tree, nullptr);
+
+  /* Tilting the mesh keeps the structure of the tree good, so the cached tree is refitted. */
+  for (float3 &position : mesh->vert_positions_for_write()) {
+    position.z += 0.05f * position.x;
+  }
+  BKE_mesh_tag_positions_changed(mesh);
+  EXPECT_LT(cached_tree_cost_compared_to_new_tree(mesh, tree), 2.0f);
+
+  /* Moving every other row of vertices far away makes the refitted tree a lot worse than it was
+   * after building, so it is built again, the same as for a mesh without cache. */
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  for (const int row : IndexRange(33)) {
+    if (row % 2 == 1) {
+      for (float3 &position : positions.slice(row * 33, 33)) {
+        position.z += 2.0f;
+      }
+    }
+  }
+  BKE_mesh_tag_positions_changed(mesh);
+  EXPECT_FLOAT_EQ(cached_tree_cost_compared_to_new_tree(mesh, nullptr), 1.0f);
+
+  BKE_id_free(nullptr, mesh);
+}
+
+}  // namespace blender::bke::tests
@@ -182,7 +182,13 @@ static DerivedMesh *cdDM_from_mesh_ex(Mesh *mesh, const CustomData_MeshMasks *ma
       &dm->loopData, CD_PROP_INT32, ".corner_vert", mesh->totloop));
   cddm->corner_edges = static_cast<int *>(CustomData_get_layer_named_for_write(
       &dm->loopData, CD_PROP_INT32, ".corner_edge", mesh->totloop));
-  dm->poly_offsets = static_cast<int *>(MEM_dupallocN(mesh->poly_offset_indices));
+  if (mesh->poly_offset_indices) {
+    /* The offsets may reference a memory-mapped file, so they can't be duplicated with
+     * #MEM_dupallocN. */
+    dm->poly_offsets = static_cast<int *>(
+        MEM_malloc_arrayN(size_t(mesh->totpoly) + 1, sizeof(int), __func__));
+    memcpy(dm->poly_offsets, mesh->poly_offset_indices, sizeof(int) * (mesh->totpoly + 1));
+  }
 #if 0
   cddm->mface = CustomData_get_layer(&dm->faceData, CD_MFACE);
 #else
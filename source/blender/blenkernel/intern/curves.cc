@@ -159,7 +159,8 @@ IDTypeInfo IDType_ID_CV = {
     /*name*/ "Curves",
     /*name_plural*/ "hair_curves",
     /*translation_context*/ BLT_I18NCONTEXT_ID_CURVES,
-    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE,
+    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE | IDTYPE_FLAGS_THREADSAFE_BLEND_WRITE |
+        IDTYPE_FLAGS_THREADSAFE_BLEND_READ_DATA,
     /*asset_type_info*/ nullptr,
 
     /*init_data*/ curves_init_data,
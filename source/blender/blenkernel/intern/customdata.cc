@@ -2176,12 +2176,16 @@ static bool customdata_typemap_is_valid(const CustomData *data)
 static void *copy_layer_data(const eCustomDataType type, const void *data, const int totelem)
 {
   const LayerTypeInfo &type_info = *layerType_getInfo(type);
+  void *new_data = MEM_malloc_arrayN(size_t(totelem), type_info.size, __func__);
   if (type_info.copy) {
-    void *new_data = MEM_malloc_arrayN(size_t(totelem), type_info.size, __func__);
     type_info.copy(data, new_data, totelem);
-    return new_data;
   }
-  return MEM_dupallocN(data);
+  else if (totelem > 0) {
+    /* Don't use #MEM_dupallocN, the data may not be allocated with the guarded allocator when it
+     * references a memory-mapped file. */
+    memcpy(new_data, data, size_t(totelem) * type_info.size);
+  }
+  return new_data;
 }
 
 static void free_layer_data(const eCustomDataType type, const void *data, const int totelem)
@@ -4512,6 +4516,18 @@ static bool CustomData_layer_ensure_data_exists(CustomDataLayer *layer, size_t c
   return false;
 }
 
+#ifndef NDEBUG
+/**
+ * Layer data that is shared with other owners, e.g. because it references a memory-mapped file,
+ * is not necessarily allocated with the guarded allocator.
+ */
+static bool layer_data_is_mem_allocated(const CustomDataLayer &layer)
+{
+  return layer.sharing_info == nullptr ||
+         dynamic_cast<const CustomDataLayerImplicitSharing *>(layer.sharing_info) != nullptr;
+}
+#endif
+
 bool CustomData_layer_validate(CustomDataLayer *layer, const uint totitems, const bool do_fixes)
 {
   BLI_assert(layer);
@@ -4523,7 +4539,8 @@ bool CustomData_layer_validate(CustomDataLayer *layer, const uint totitems, cons
   }
 
   BLI_assert((totitems == 0) || layer->data);
-  BLI_assert(MEM_allocN_len(layer->data) >= totitems * typeInfo->size);
+  BLI_assert(!layer_data_is_mem_allocated(*layer) ||
+             MEM_allocN_len(layer->data) >= totitems * typeInfo->size);
 
   if (typeInfo->validate != nullptr) {
     return typeInfo->validate(layer->data, totitems, do_fixes);
@@ -5268,8 +5285,17 @@ void CustomData_blend_read(BlendDataReader *reader, CustomData *data, const int
     layer->sharing_info = nullptr;
 
     if (CustomData_verify_versions(data, i)) {
-      BLO_read_data_address(reader, &layer->data);
-      if (layer->data != nullptr) {
+      if (const blender::CPPType *cpp_type = blender::bke::custom_data_type_to_cpp_type(
+              eCustomDataType(layer->type)))
+      {
+        /* Generic attribute arrays don't contain pointers, so they can reference the file. */
+        layer->sharing_info = BLO_read_mapped_data_address(
+            reader, &layer->data, cpp_type->alignment());
+      }
+      else {
+        BLO_read_data_address(reader, &layer->data);
+      }
+      if (layer->data != nullptr && layer->sharing_info == nullptr) {
         /* Make layer data shareable. */
         layer->sharing_info = make_implicit_sharing_info_for_layer(
             eCustomDataType(layer->type), layer->data, count);
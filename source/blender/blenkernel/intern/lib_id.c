@@ -198,7 +198,13 @@ void BKE_lib_id_clear_library_data(Main *bmain, ID *id, const int flags)
   id->tag &= ~(LIB_TAG_INDIRECT | LIB_TAG_EXTERN);
   id->flag &= ~LIB_INDIRECT_WEAK_LINK;
   if (id_in_mainlist) {
-    if (BKE_id_new_name_validate(bmain, which_libbase(bmain, GS(id->name)), id, NULL, false)) {
+    if ((flags & LIB_ID_MAKELOCAL_DEFER_UNIQUE_NAME) != 0) {
+      /* Keep the list sorted by library, the name may still change. */
+      id_sort_by_name(which_libbase(bmain, GS(id->name)), id, NULL);
+    }
+    else if (BKE_id_new_name_validate(
+                 bmain, which_libbase(bmain, GS(id->name)), id, NULL, false))
+    {
       bmain->is_memfile_undo_written = false;
     }
   }
@@ -6,6 +6,8 @@
 
 #include "BLI_listbase.h"
 #include "BLI_string.h"
+#include "BLI_timeit.hh"
+#include "BLI_vector.hh"
 
 #include "BKE_idtype.h"
 #include "BKE_lib_id.h"
@@ -455,4 +457,100 @@ TEST(lib_id_main_unique_name, name_huge_number_suffix)
   EXPECT_TRUE(BKE_main_namemap_validate(ctx.bmain));
 }
 
+TEST(lib_id_main_unique_name, get_names_bulk)
+{
+  LibIDMainSortTestContext ctx;
+
+  ID *id_a = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "Foo"));
+  ID *id_b = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "B"));
+  ID *id_c = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "C"));
+  ID *id_d = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "D"));
+  ID *id_e = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_CA, "E"));
+
+  /* Simulate IDs which were added to Main without going through the name map. */
+  BKE_main_namemap_clear(ctx.bmain);
+  BLI_strncpy(id_b->name + 2, "Foo", sizeof(id_b->name) - 2);
+  BLI_strncpy(id_c->name + 2, "Foo", sizeof(id_c->name) - 2);
+  BLI_strncpy(id_d->name + 2, "Foo.001", sizeof(id_d->name) - 2);
+  BLI_strncpy(id_e->name + 2, "Foo", sizeof(id_e->name) - 2);
+
+  ID *ids[] = {id_b, id_c, id_d, id_e};
+  EXPECT_TRUE(BKE_main_namemap_get_names(ctx.bmain, ids, ARRAY_SIZE(ids)));
+
+  EXPECT_STREQ(id_a->name + 2, "Foo");
+  EXPECT_STREQ(id_b->name + 2, "Foo.001");
+  EXPECT_STREQ(id_c->name + 2, "Foo.002");
+  EXPECT_STREQ(id_d->name + 2, "Foo.003");
+  EXPECT_STREQ(id_e->name + 2, "Foo");
+
+  EXPECT_TRUE(BKE_main_namemap_validate(ctx.bmain));
+}
+
+TEST(lib_id_main_unique_name, rebuild_many_names)
+{
+  LibIDMainSortTestContext ctx;
+
+  Vector<ID *> ids;
+  for ([[maybe_unused]] const int i : IndexRange(2000)) {
+    ids.append(static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "Foo")));
+  }
+  EXPECT_STREQ(ids.last()->name + 2, "Foo.1999");
+
+  /* Rebuild the map from the IDs in Main, with one suffix below 1024 free. Lists with that many
+   * IDs are added to the map from multiple threads. */
+  BKE_main_namemap_clear(ctx.bmain);
+  BLI_strncpy(ids[500]->name + 2, "Bar", sizeof(ids[500]->name) - 2);
+
+  ID *id_a = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "Foo"));
+  EXPECT_STREQ(id_a->name + 2, "Foo.500");
+  ID *id_b = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "Foo.1500"));
+  EXPECT_STREQ(id_b->name + 2, "Foo.2000");
+  ID *id_c = static_cast<ID *>(BKE_id_new(ctx.bmain, ID_OB, "Bar"));
+  EXPECT_STREQ(id_c->name + 2, "Bar.001");
+
+  EXPECT_TRUE(BKE_main_namemap_validate(ctx.bmain));
+}
+
+TEST(lib_id_main_unique_name, Benchmark)
+{
+  LibIDMainSortTestContext ctx;
+
+  const int ids_num = 100000;
+  Vector<ID *> ids;
+  for (const int i : IndexRange(ids_num)) {
+    char name[MAX_NAME];
+    SNPRINTF(name, "Object%d", i);
+    ids.append(static_cast<ID *>(BKE_id_new(ctx.bmain, i % 2 ? ID_OB : ID_CA, name)));
+  }
+
+  for (int i = 0; i < 3; i++) {
+    BKE_main_namemap_clear(ctx.bmain);
+    {
+      SCOPED_TIMER("Rebuild");
+      char name[MAX_NAME];
+      STRNCPY(name, ids[0]->name + 2);
+      BKE_main_namemap_get_name(ctx.bmain, ids[0], name);
+    }
+    for (ID *id : ids) {
+      BKE_main_namemap_remove_name(ctx.bmain, id, id->name + 2);
+    }
+    {
+      SCOPED_TIMER("Add one by one");
+      for (ID *id : ids) {
+        char name[MAX_NAME];
+        STRNCPY(name, id->name + 2);
+        BKE_main_namemap_get_name(ctx.bmain, id, name);
+      }
+    }
+    for (ID *id : ids) {
+      BKE_main_namemap_remove_name(ctx.bmain, id, id->name + 2);
+    }
+    {
+      SCOPED_TIMER("Add bulk");
+      BKE_main_namemap_get_names(ctx.bmain, ids.data(), int(ids.size()));
+    }
+    EXPECT_TRUE(BKE_main_namemap_validate(ctx.bmain));
+  }
+}
+
 }  // namespace blender::bke::tests
@@ -9,8 +9,10 @@
 #include "BKE_main.h"
 #include "BKE_main_namemap.h"
 
+#include "BLI_array.hh"
 #include "BLI_assert.h"
 #include "BLI_bitmap.h"
+#include "BLI_function_ref.hh"
 #include "BLI_ghash.h"
 #include "BLI_listbase.h"
 #include "BLI_map.hh"
@@ -18,6 +20,8 @@
 #include "BLI_set.hh"
 #include "BLI_string_utf8.h"
 #include "BLI_string_utils.h"
+#include "BLI_task.hh"
+#include "BLI_vector.hh"
 
 #include "DNA_ID.h"
 
@@ -154,14 +158,38 @@ struct UniqueName_Value {
   }
 };
 
-/* Tracking of names for a single ID type. */
+/* No inline buffers, there are many of these per name map and most of them stay empty. */
+using UniqueName_Set = Set<UniqueName_Key, 0>;
+using UniqueName_SuffixMap = Map<UniqueName_Key, UniqueName_Value, 0>;
+
+/* Tracking of names for a single ID type.
+ *
+ * Names are spread over shards by their hash. Each shard is only ever accessed by one thread when
+ * filling the map, so the shards can be filled in parallel without any locking. */
 struct UniqueName_TypeMap {
+  static constexpr int shards_num = 16;
   /* Set of full names that are in use. */
-  Set<UniqueName_Key> full_names;
+  UniqueName_Set full_names[shards_num];
   /* For each base name (i.e. without numeric suffix), track the
    * numeric suffixes that are in use. */
-  Map<UniqueName_Key, UniqueName_Value> base_name_to_num_suffix;
+  UniqueName_SuffixMap base_name_to_num_suffix[shards_num];
+
+  static int shard_index(const UniqueName_Key &key)
+  {
+    /* The sets and maps use the lower bits of the hash, so use the higher bits of a scrambled
+     * hash to pick the shard. */
+    return int((uint32_t(key.hash()) * 2654435769u) >> 28);
+  }
+  UniqueName_Set &full_names_for(const UniqueName_Key &key)
+  {
+    return full_names[shard_index(key)];
+  }
+  UniqueName_SuffixMap &base_names_for(const UniqueName_Key &key)
+  {
+    return base_name_to_num_suffix[shard_index(key)];
+  }
 };
+static_assert(UniqueName_TypeMap::shards_num == 1 << (32 - 28));
 
 struct UniqueName_Map {
   UniqueName_TypeMap type_maps[INDEX_ID_MAX];
@@ -185,8 +213,10 @@ void BKE_main_namemap_destroy(struct UniqueName_Map **r_name_map)
   int64_t size_sets = 0;
   int64_t size_maps = 0;
   for (const UniqueName_TypeMap &type_map : (*r_name_map)->type_maps) {
-    size_sets += type_map.full_names.size_in_bytes();
-    size_maps += type_map.base_name_to_num_suffix.size_in_bytes();
+    for (const int shard : IndexRange(UniqueName_TypeMap::shards_num)) {
+      size_sets += type_map.full_names[shard].size_in_bytes();
+      size_maps += type_map.base_name_to_num_suffix[shard].size_in_bytes();
+    }
   }
   printf(
       "NameMap memory usage: sets %.1fKB, maps %.1fKB\n", size_sets / 1024.0, size_maps / 1024.0);
@@ -212,82 +242,141 @@ void BKE_main_namemap_clear(Main *bmain)
   }
 }
 
-static void main_namemap_populate(UniqueName_Map *name_map, struct Main *bmain, ID *ignore_id)
+/* Add the names of the given IDs of a single type, which are known to be unique, to the map. */
+static void type_map_populate(UniqueName_TypeMap &type_map, const Span<const ID *> ids)
+{
+  struct NameInfo {
+    UniqueName_Key base_name;
+    int number;
+    int full_name_shard;
+    int base_name_shard;
+  };
+
+  /* Split and hash the names in parallel. */
+  Array<NameInfo> infos(ids.size());
+  threading::parallel_for(ids.index_range(), 1024, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      NameInfo &info = infos[i];
+      UniqueName_Key key;
+      STRNCPY(key.name, ids[i]->name + 2);
+      info.full_name_shard = UniqueName_TypeMap::shard_index(key);
+      /* Get the name and number parts ("name.number"). */
+      info.number = MIN_NUMBER;
+      BLI_string_split_name_number(key.name, '.', info.base_name.name, &info.number);
+      info.base_name_shard = UniqueName_TypeMap::shard_index(info.base_name);
+    }
+  });
+
+  /* Fill each shard from a single task. Not worth it for the many short lists. */
+  const int64_t grain_size = ids.size() < 1024 ? UniqueName_TypeMap::shards_num : 1;
+  threading::parallel_for(
+      IndexRange(UniqueName_TypeMap::shards_num), grain_size, [&](const IndexRange range) {
+        for (const int shard : range) {
+          UniqueName_Set &full_names = type_map.full_names[shard];
+          UniqueName_SuffixMap &base_names = type_map.base_name_to_num_suffix[shard];
+
+          /* Grow the shard once, instead of repeatedly while adding the names. */
+          int64_t full_names_num = 0;
+          int64_t base_names_num = 0;
+          for (const NameInfo &info : infos) {
+            full_names_num += info.full_name_shard == shard;
+            base_names_num += info.base_name_shard == shard;
+          }
+          full_names.reserve(full_names.size() + full_names_num);
+          base_names.reserve(base_names.size() + base_names_num);
+
+          for (const int64_t i : infos.index_range()) {
+            const NameInfo &info = infos[i];
+            if (info.full_name_shard == shard) {
+              UniqueName_Key key;
+              STRNCPY(key.name, ids[i]->name + 2);
+              full_names.add(key);
+            }
+            if (info.base_name_shard == shard) {
+              base_names.lookup_or_add_default(info.base_name).mark_used(info.number);
+            }
+          }
+        }
+      });
+}
+
+static void main_namemap_populate(UniqueName_Map *name_map,
+                                  struct Main *bmain,
+                                  const Library *library,
+                                  const FunctionRef<bool(const ID *id)> is_ignored_fn)
 {
   BLI_assert_msg(name_map != nullptr, "name_map should not be null");
   for (UniqueName_TypeMap &type_map : name_map->type_maps) {
-    type_map.base_name_to_num_suffix.clear();
+    for (UniqueName_SuffixMap &base_names : type_map.base_name_to_num_suffix) {
+      base_names.clear();
+    }
   }
-  Library *library = ignore_id->lib;
-  ID *id;
-  FOREACH_MAIN_ID_BEGIN (bmain, id) {
-    if ((id == ignore_id) || (id->lib != library)) {
+  Vector<const ID *> ids;
+  ListBase *lbarray[INDEX_ID_MAX];
+  int i = set_listbasepointers(bmain, lbarray);
+  while (i--) {
+    /* Each list only contains IDs of a single type. */
+    ids.clear();
+    LISTBASE_FOREACH (const ID *, id, lbarray[i]) {
+      if ((id->lib == library) && !is_ignored_fn(id)) {
+        ids.append(id);
+      }
+    }
+    if (ids.is_empty()) {
       continue;
     }
-    UniqueName_TypeMap *type_map = name_map->find_by_type(GS(id->name));
+    UniqueName_TypeMap *type_map = name_map->find_by_type(GS(ids.first()->name));
     BLI_assert(type_map != nullptr);
-
-    /* Insert the full name into the set. */
-    UniqueName_Key key;
-    STRNCPY(key.name, id->name + 2);
-    type_map->full_names.add(key);
-
-    /* Get the name and number parts ("name.number"). */
-    int number = MIN_NUMBER;
-    BLI_string_split_name_number(id->name + 2, '.', key.name, &number);
-
-    /* Get and update the entry for this base name. */
-    UniqueName_Value &val = type_map->base_name_to_num_suffix.lookup_or_add_default(key);
-    val.mark_used(number);
+    type_map_populate(*type_map, ids);
   }
-  FOREACH_MAIN_ID_END;
 }
 
 /* Get the name map object used for the given Main/ID.
  * Lazily creates and populates the contents of the name map, if ensure_created is true.
- * NOTE: if the contents are populated, the name of the given ID itself is not added. */
-static UniqueName_Map *get_namemap_for(Main *bmain, ID *id, bool ensure_created)
+ * NOTE: if the contents are populated, the names of the ignored IDs are not added. */
+static UniqueName_Map *get_namemap_for_ex(Main *bmain,
+                                          ID *id,
+                                          bool ensure_created,
+                                          const FunctionRef<bool(const ID *id)> is_ignored_fn)
 {
   if (id->lib != nullptr) {
     if (ensure_created && id->lib->runtime.name_map == nullptr) {
       id->lib->runtime.name_map = BKE_main_namemap_create();
-      main_namemap_populate(id->lib->runtime.name_map, bmain, id);
+      main_namemap_populate(id->lib->runtime.name_map, bmain, id->lib, is_ignored_fn);
     }
     return id->lib->runtime.name_map;
   }
   if (ensure_created && bmain->name_map == nullptr) {
     bmain->name_map = BKE_main_namemap_create();
-    main_namemap_populate(bmain->name_map, bmain, id);
+    main_namemap_populate(bmain->name_map, bmain, nullptr, is_ignored_fn);
   }
   return bmain->name_map;
 }
 
-bool BKE_main_namemap_get_name(struct Main *bmain, struct ID *id, char *name)
+/* Same as #get_namemap_for_ex, the name of the given ID itself is not added. */
+static UniqueName_Map *get_namemap_for(Main *bmain, ID *id, bool ensure_created)
 {
-#ifndef __GNUC__ /* GCC warns with `nonull-compare`. */
-  BLI_assert(bmain != nullptr);
-  BLI_assert(id != nullptr);
-#endif
-  UniqueName_Map *name_map = get_namemap_for(bmain, id, true);
-  BLI_assert(name_map != nullptr);
-  BLI_assert(strlen(name) < MAX_NAME);
-  UniqueName_TypeMap *type_map = name_map->find_by_type(GS(id->name));
-  BLI_assert(type_map != nullptr);
+  return get_namemap_for_ex(
+      bmain, id, ensure_created, [id](const ID *other_id) { return other_id == id; });
+}
 
+static bool type_map_get_name(UniqueName_TypeMap *type_map, char *name)
+{
+  BLI_assert(strlen(name) < MAX_NAME);
   bool is_name_changed = false;
 
   UniqueName_Key key;
   while (true) {
     /* Check if the full original name has a duplicate. */
     STRNCPY(key.name, name);
-    const bool has_dup = type_map->full_names.contains(key);
+    const bool has_dup = type_map->full_names_for(key).contains(key);
 
     /* Get the name and number parts ("name.number"). */
     int number = MIN_NUMBER;
     size_t base_name_len = BLI_string_split_name_number(name, '.', key.name, &number);
 
     bool added_new = false;
-    UniqueName_Value &val = type_map->base_name_to_num_suffix.lookup_or_add_cb(key, [&]() {
+    UniqueName_Value &val = type_map->base_names_for(key).lookup_or_add_cb(key, [&]() {
       added_new = true;
       return UniqueName_Value();
     });
@@ -300,7 +389,7 @@ bool BKE_main_namemap_get_name(struct Main *bmain, struct ID *id, char *name)
 
       if (!has_dup) {
         STRNCPY(key.name, name);
-        type_map->full_names.add(key);
+        type_map->full_names_for(key).add(key);
       }
       return is_name_changed;
     }
@@ -335,7 +424,7 @@ bool BKE_main_namemap_get_name(struct Main *bmain, struct ID *id, char *name)
     if (id_name_final_build(name, key.name, base_name_len, number_to_use)) {
       /* All good, add final name to the set. */
       STRNCPY(key.name, name);
-      type_map->full_names.add(key);
+      type_map->full_names_for(key).add(key);
       break;
     }
 
@@ -347,6 +436,73 @@ bool BKE_main_namemap_get_name(struct Main *bmain, struct ID *id, char *name)
   return is_name_changed;
 }
 
+void BKE_main_namemap_ensure(Main *bmain)
+{
+  if (bmain->name_map == nullptr) {
+    bmain->name_map = BKE_main_namemap_create();
+    main_namemap_populate(bmain->name_map, bmain, nullptr, [](const ID * /*id*/) {
+      return false;
+    });
+  }
+}
+
+bool BKE_main_namemap_get_name(struct Main *bmain, struct ID *id, char *name)
+{
+#ifndef __GNUC__ /* GCC warns with `nonull-compare`. */
+  BLI_assert(bmain != nullptr);
+  BLI_assert(id != nullptr);
+#endif
+  UniqueName_Map *name_map = get_namemap_for(bmain, id, true);
+  BLI_assert(name_map != nullptr);
+  UniqueName_TypeMap *type_map = name_map->find_by_type(GS(id->name));
+  BLI_assert(type_map != nullptr);
+
+  return type_map_get_name(type_map, name);
+}
+
+bool BKE_main_namemap_get_names(struct Main *bmain, struct ID **ids, const int ids_num)
+{
+  const Span<ID *> ids_span(ids, ids_num);
+
+  /* None of the given names are in use yet, so they must not be added when creating the maps. */
+  const Set<const ID *> ignore_ids(ids_span);
+  Map<UniqueName_Set *, int64_t> new_full_names_num;
+  Map<UniqueName_SuffixMap *, int64_t> new_base_names_num;
+  for (ID *id : ids_span) {
+    UniqueName_Map *name_map = get_namemap_for_ex(
+        bmain, id, true, [&](const ID *other_id) { return ignore_ids.contains(other_id); });
+    UniqueName_TypeMap *type_map = name_map->find_by_type(GS(id->name));
+    BLI_assert(type_map != nullptr);
+    UniqueName_Key key;
+    STRNCPY(key.name, id->name + 2);
+    new_full_names_num.lookup_or_add(&type_map->full_names_for(key), 0)++;
+    int number = MIN_NUMBER;
+    BLI_string_split_name_number(id->name + 2, '.', key.name, &number);
+    new_base_names_num.lookup_or_add(&type_map->base_names_for(key), 0)++;
+  }
+
+  /* Grow each shard once for all new names. */
+  for (const auto item : new_full_names_num.items()) {
+    item.key->reserve(item.key->size() + item.value);
+  }
+  for (const auto item : new_base_names_num.items()) {
+    item.key->reserve(item.key->size() + item.value);
+  }
+
+  bool is_any_name_changed = false;
+  for (ID *id : ids_span) {
+    UniqueName_Map *name_map = get_namemap_for(bmain, id, false);
+    UniqueName_TypeMap *type_map = name_map->find_by_type(GS(id->name));
+    char name[MAX_NAME];
+    STRNCPY(name, id->name + 2);
+    if (type_map_get_name(type_map, name)) {
+      is_any_name_changed = true;
+    }
+    BLI_strncpy(id->name + 2, name, sizeof(id->name) - 2);
+  }
+  return is_any_name_changed;
+}
+
 void BKE_main_namemap_remove_name(struct Main *bmain, struct ID *id, const char *name)
 {
 #ifndef __GNUC__ /* GCC warns with `nonull-compare`. */
@@ -370,17 +526,18 @@ void BKE_main_namemap_remove_name(struct Main *bmain, struct ID *id, const char
   UniqueName_Key key;
   /* Remove full name from the set. */
   STRNCPY(key.name, name);
-  type_map->full_names.remove(key);
+  type_map->full_names_for(key).remove(key);
 
   int number = MIN_NUMBER;
   BLI_string_split_name_number(name, '.', key.name, &number);
-  UniqueName_Value *val = type_map->base_name_to_num_suffix.lookup_ptr(key);
+  UniqueName_SuffixMap &base_names = type_map->base_names_for(key);
+  UniqueName_Value *val = base_names.lookup_ptr(key);
   if (val == nullptr) {
     return;
   }
   if (number == 0 && val->max_value == 0) {
     /* This was the only base name usage, remove whole key. */
-    type_map->base_name_to_num_suffix.remove(key);
+    base_names.remove(key);
     return;
   }
   val->mark_unused(number);
@@ -460,7 +617,7 @@ static bool main_namemap_validate_and_fix(Main *bmain, const bool do_fix)
       UniqueName_Key key_namemap;
       /* Remove full name from the set. */
       STRNCPY(key_namemap.name, id_iter->name + 2);
-      if (!type_map->full_names.contains(key_namemap)) {
+      if (!type_map->full_names_for(key_namemap).contains(key_namemap)) {
         is_valid = false;
         if (do_fix) {
           CLOG_INFO(
@@ -494,29 +651,31 @@ static bool main_namemap_validate_and_fix(Main *bmain, const bool do_fix)
       {
         UniqueName_TypeMap *type_map = name_map->find_by_type(idcode);
         if (type_map != nullptr) {
-          for (const UniqueName_Key &id_name : type_map->full_names) {
-            Uniqueness_Key key;
-            *(reinterpret_cast<short *>(key.name)) = idcode;
-            BLI_strncpy(key.name + 2, id_name.name, MAX_NAME);
-            key.lib = lib;
-            if (!id_names_libs.contains(key)) {
-              is_valid = false;
-              if (do_fix) {
-                CLOG_INFO(
-                    &LOG,
-                    3,
-                    "ID name '%s' (from library '%s') is listed in the namemap, but does not "
-                    "exists in current Main",
-                    key.name,
-                    lib != nullptr ? lib->filepath : "<None>");
-              }
-              else {
-                CLOG_ERROR(
-                    &LOG,
-                    "ID name '%s' (from library '%s') is listed in the namemap, but does not "
-                    "exists in current Main",
-                    key.name,
-                    lib != nullptr ? lib->filepath : "<None>");
+          for (const UniqueName_Set &full_names : type_map->full_names) {
+            for (const UniqueName_Key &id_name : full_names) {
+              Uniqueness_Key key;
+              *(reinterpret_cast<short *>(key.name)) = idcode;
+              BLI_strncpy(key.name + 2, id_name.name, MAX_NAME);
+              key.lib = lib;
+              if (!id_names_libs.contains(key)) {
+                is_valid = false;
+                if (do_fix) {
+                  CLOG_INFO(
+                      &LOG,
+                      3,
+                      "ID name '%s' (from library '%s') is listed in the namemap, but does not "
+                      "exists in current Main",
+                      key.name,
+                      lib != nullptr ? lib->filepath : "<None>");
+                }
+                else {
+                  CLOG_ERROR(
+                      &LOG,
+                      "ID name '%s' (from library '%s') is listed in the namemap, but does not "
+                      "exists in current Main",
+                      key.name,
+                      lib != nullptr ? lib->filepath : "<None>");
+                }
               }
             }
           }
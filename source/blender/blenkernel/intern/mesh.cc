@@ -338,9 +338,16 @@ static void mesh_blend_read_data(BlendDataReader *reader, ID *id)
   mesh->runtime = new blender::bke::MeshRuntime();
 
   if (mesh->poly_offset_indices) {
-    BLO_read_int32_array(reader, mesh->totpoly + 1, &mesh->poly_offset_indices);
-    mesh->runtime->poly_offsets_sharing_info = blender::implicit_sharing::info_for_mem_free(
-        mesh->poly_offset_indices);
+    mesh->runtime->poly_offsets_sharing_info = BLO_read_mapped_data_address(
+        reader, reinterpret_cast<void **>(&mesh->poly_offset_indices), alignof(int));
+    if (mesh->runtime->poly_offsets_sharing_info == nullptr) {
+      /* Data referencing the file never needs an endian switch. */
+      if (BLO_read_requires_endian_switch(reader)) {
+        BLI_endian_switch_int32_array(mesh->poly_offset_indices, mesh->totpoly + 1);
+      }
+      mesh->runtime->poly_offsets_sharing_info = blender::implicit_sharing::info_for_mem_free(
+          mesh->poly_offset_indices);
+    }
   }
 
   /* happens with old files */
@@ -393,7 +400,8 @@ IDTypeInfo IDType_ID_ME = {
     /*name*/ "Mesh",
     /*name_plural*/ "meshes",
     /*translation_context*/ BLT_I18NCONTEXT_ID_MESH,
-    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE,
+    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE | IDTYPE_FLAGS_THREADSAFE_BLEND_WRITE |
+        IDTYPE_FLAGS_THREADSAFE_BLEND_READ_DATA,
     /*asset_type_info*/ nullptr,
 
     /*init_data*/ mesh_init_data,
@@ -78,6 +78,13 @@ static void free_bvh_cache(MeshRuntime &mesh_runtime)
   }
 }
 
+static void tag_bvh_cache_positions_changed(MeshRuntime &mesh_runtime)
+{
+  if (mesh_runtime.bvh_cache) {
+    bvhcache_tag_positions_changed(mesh_runtime.bvh_cache);
+  }
+}
+
 static void reset_normals(MeshRuntime &mesh_runtime)
 {
   mesh_runtime.vert_normals.clear_and_shrink();
@@ -347,7 +354,7 @@ void BKE_mesh_tag_positions_changed(Mesh *mesh)
 {
   mesh->runtime->vert_normals_dirty = true;
   mesh->runtime->poly_normals_dirty = true;
-  free_bvh_cache(*mesh->runtime);
+  tag_bvh_cache_positions_changed(*mesh->runtime);
   mesh->runtime->looptris_cache.tag_dirty();
   mesh->runtime->bounds_cache.tag_dirty();
 }
@@ -355,7 +362,7 @@ void BKE_mesh_tag_positions_changed(Mesh *mesh)
 void BKE_mesh_tag_positions_changed_uniformly(Mesh *mesh)
 {
   /* The normals and triangulation didn't change, since all verts moved by the same amount. */
-  free_bvh_cache(*mesh->runtime);
+  tag_bvh_cache_positions_changed(*mesh->runtime);
   mesh->runtime->bounds_cache.tag_dirty();
 }
 
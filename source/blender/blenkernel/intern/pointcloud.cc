@@ -171,7 +171,8 @@ IDTypeInfo IDType_ID_PT = {
     /*name*/ "PointCloud",
     /*name_plural*/ "pointclouds",
     /*translation_context*/ BLT_I18NCONTEXT_ID_POINTCLOUD,
-    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE,
+    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE | IDTYPE_FLAGS_THREADSAFE_BLEND_WRITE |
+        IDTYPE_FLAGS_THREADSAFE_BLEND_READ_DATA,
     /*asset_type_info*/ nullptr,
 
     /*init_data*/ pointcloud_init_data,
@@ -18,10 +18,14 @@
 #include "DNA_modifier_types.h"
 #include "DNA_object_types.h"
 
+#include "BLI_array.hh"
 #include "BLI_math.h"
 #include "BLI_math_solvers.h"
+#include "BLI_math_vector_types.hh"
 #include "BLI_task.h"
+#include "BLI_task.hh"
 #include "BLI_utildefines.h"
+#include "BLI_vector.hh"
 
 #include "BKE_DerivedMesh.h"
 #include "BKE_cdderivedmesh.h"
@@ -82,10 +86,6 @@ struct ShrinkwrapCalcCBData {
   ShrinkwrapCalcData *calc;
 
   ShrinkwrapTreeData *tree;
-  ShrinkwrapTreeData *aux_tree;
-
-  float *proj_axis;
-  SpaceTransform *local2aux;
 };
 
 bool BKE_shrinkwrap_needs_normals(int shrinkType, int shrinkMode)
@@ -419,6 +419,73 @@ static void shrinkwrap_calc_nearest_vertex(ShrinkwrapCalcData *calc)
       0, calc->numVerts, &data, shrinkwrap_calc_nearest_vertex_cb_ex, &settings);
 }
 
+/* don't use this because this dist value could be incompatible
+ * this value used by the callback for comparing previous/new dist values.
+ * also, at the moment there is no need to have a corrected 'dist' value */
+// #define USE_DIST_CORRECT
+
+/* Transform a ray of the normal projection into the space of the target. */
+static void shrinkwrap_ray_to_target_space(const SpaceTransform *transf,
+                                           const float vert[3],
+                                           const float dir[3],
+                                           float r_co[3],
+                                           float r_no[3])
+{
+  copy_v3_v3(r_co, vert);
+  copy_v3_v3(r_no, dir);
+
+  /* Apply space transform (TODO readjust dist) */
+  if (transf) {
+    BLI_space_transform_apply(transf, r_co);
+    BLI_space_transform_apply_normal(transf, r_no);
+  }
+}
+
+/**
+ * Apply the culling options to the hit of a normal projection ray-cast in the space of the
+ * target, and store it in \a hit when it is accepted.
+ */
+static bool shrinkwrap_project_normal_accept_hit(const char options,
+                                                 const float vert[3],
+                                                 const float dir[3],
+                                                 const SpaceTransform *transf,
+                                                 BVHTreeRayHit *hit_tmp,
+                                                 BVHTreeRayHit *hit)
+{
+  if (hit_tmp->index == -1) {
+    return false;
+  }
+
+  /* invert the normal first so face culling works on rotated objects */
+  if (transf) {
+    BLI_space_transform_invert_normal(transf, hit_tmp->no);
+  }
+
+  if (options & MOD_SHRINKWRAP_CULL_TARGET_MASK) {
+    /* Apply back-face. */
+    const float dot = dot_v3v3(dir, hit_tmp->no);
+    if (((options & MOD_SHRINKWRAP_CULL_TARGET_FRONTFACE) && dot <= 0.0f) ||
+        ((options & MOD_SHRINKWRAP_CULL_TARGET_BACKFACE) && dot >= 0.0f))
+    {
+      return false; /* Ignore hit */
+    }
+  }
+
+  if (transf) {
+    /* Inverting space transform (TODO: make coherent with the initial dist readjust). */
+    BLI_space_transform_invert(transf, hit_tmp->co);
+#ifdef USE_DIST_CORRECT
+    hit_tmp->dist = len_v3v3(vert, hit_tmp->co);
+#endif
+  }
+  UNUSED_VARS(vert);
+
+  BLI_assert(hit_tmp->dist <= hit->dist);
+
+  memcpy(hit, hit_tmp, sizeof(*hit_tmp));
+  return true;
+}
+
 bool BKE_shrinkwrap_project_normal(char options,
                                    const float vert[3],
                                    const float dir[3],
@@ -427,210 +494,74 @@ bool BKE_shrinkwrap_project_normal(char options,
                                    ShrinkwrapTreeData *tree,
                                    BVHTreeRayHit *hit)
 {
-  /* don't use this because this dist value could be incompatible
-   * this value used by the callback for comparing previous/new dist values.
-   * also, at the moment there is no need to have a corrected 'dist' value */
-  // #define USE_DIST_CORRECT
-
-  float tmp_co[3], tmp_no[3];
-  const float *co, *no;
+  float co[3], no[3];
   BVHTreeRayHit hit_tmp;
 
   /* Copy from hit (we need to convert hit rays from one space coordinates to the other */
   memcpy(&hit_tmp, hit, sizeof(hit_tmp));
 
-  /* Apply space transform (TODO readjust dist) */
-  if (transf) {
-    copy_v3_v3(tmp_co, vert);
-    BLI_space_transform_apply(transf, tmp_co);
-    co = tmp_co;
-
-    copy_v3_v3(tmp_no, dir);
-    BLI_space_transform_apply_normal(transf, tmp_no);
-    no = tmp_no;
-
+  shrinkwrap_ray_to_target_space(transf, vert, dir, co, no);
 #ifdef USE_DIST_CORRECT
+  if (transf) {
     hit_tmp.dist *= mat4_to_scale(((SpaceTransform *)transf)->local2target);
-#endif
-  }
-  else {
-    co = vert;
-    no = dir;
   }
+#endif
 
   hit_tmp.index = -1;
 
   BLI_bvhtree_ray_cast(
       tree->bvh, co, no, ray_radius, &hit_tmp, tree->treeData.raycast_callback, &tree->treeData);
 
-  if (hit_tmp.index != -1) {
-    /* invert the normal first so face culling works on rotated objects */
-    if (transf) {
-      BLI_space_transform_invert_normal(transf, hit_tmp.no);
-    }
-
-    if (options & MOD_SHRINKWRAP_CULL_TARGET_MASK) {
-      /* Apply back-face. */
-      const float dot = dot_v3v3(dir, hit_tmp.no);
-      if (((options & MOD_SHRINKWRAP_CULL_TARGET_FRONTFACE) && dot <= 0.0f) ||
-          ((options & MOD_SHRINKWRAP_CULL_TARGET_BACKFACE) && dot >= 0.0f))
-      {
-        return false; /* Ignore hit */
-      }
-    }
-
-    if (transf) {
-      /* Inverting space transform (TODO: make coherent with the initial dist readjust). */
-      BLI_space_transform_invert(transf, hit_tmp.co);
-#ifdef USE_DIST_CORRECT
-      hit_tmp.dist = len_v3v3(vert, hit_tmp.co);
-#endif
-    }
-
-    BLI_assert(hit_tmp.dist <= hit->dist);
-
-    memcpy(hit, &hit_tmp, sizeof(hit_tmp));
-    return true;
-  }
-  return false;
+  return shrinkwrap_project_normal_accept_hit(options, vert, dir, transf, &hit_tmp, hit);
 }
 
-static void shrinkwrap_calc_normal_projection_cb_ex(void *__restrict userdata,
-                                                    const int i,
-                                                    const TaskParallelTLS *__restrict tls)
+/**
+ * Same as #BKE_shrinkwrap_project_normal for many points, casting all rays at once with
+ * #BLI_bvhtree_ray_cast_batch. \a r_accepted tells which hits were updated.
+ */
+static void shrinkwrap_project_normal_batch(const char options,
+                                            const blender::Span<blender::float3> verts,
+                                            const blender::Span<blender::float3> dirs,
+                                            const SpaceTransform *transf,
+                                            ShrinkwrapTreeData *tree,
+                                            blender::MutableSpan<BVHTreeRayHit> hits,
+                                            blender::MutableSpan<bool> r_accepted)
 {
-  ShrinkwrapCalcCBData *data = static_cast<ShrinkwrapCalcCBData *>(userdata);
-
-  ShrinkwrapCalcData *calc = data->calc;
-  ShrinkwrapTreeData *tree = data->tree;
-  ShrinkwrapTreeData *aux_tree = data->aux_tree;
-
-  float *proj_axis = data->proj_axis;
-  SpaceTransform *local2aux = data->local2aux;
-
-  BVHTreeRayHit *hit = static_cast<BVHTreeRayHit *>(tls->userdata_chunk);
-
-  const float proj_limit_squared = calc->smd->projLimit * calc->smd->projLimit;
-  float *co = calc->vertexCos[i];
-  float tmp_co[3], tmp_no[3];
-  float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
-
-  if (calc->invert_vgroup) {
-    weight = 1.0f - weight;
-  }
-
-  if (weight == 0.0f) {
-    return;
-  }
-
-  if (calc->vert_positions != nullptr && calc->smd->projAxis == MOD_SHRINKWRAP_PROJECT_OVER_NORMAL)
-  {
-    /* calc->vert_positions contains verts from evaluated mesh. */
-    /* These coordinates are deformed by vertexCos only for normal projection
-     * (to get correct normals) for other cases calc->verts contains undeformed coordinates and
-     * vertexCos should be used */
-    copy_v3_v3(tmp_co, calc->vert_positions[i]);
-    copy_v3_v3(tmp_no, calc->vert_normals[i]);
-  }
-  else {
-    copy_v3_v3(tmp_co, co);
-    copy_v3_v3(tmp_no, proj_axis);
-  }
-
-  hit->index = -1;
-
-  /* TODO: we should use FLT_MAX here, but sweep-sphere code isn't prepared for that. */
-  hit->dist = BVH_RAYCAST_DIST_MAX;
-
-  bool is_aux = false;
-
-  /* Project over positive direction of axis. */
-  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_POS_DIR) {
-    if (aux_tree) {
-      if (BKE_shrinkwrap_project_normal(0, tmp_co, tmp_no, 0.0, local2aux, aux_tree, hit)) {
-        is_aux = true;
-      }
-    }
-
-    if (BKE_shrinkwrap_project_normal(
-            calc->smd->shrinkOpts, tmp_co, tmp_no, 0.0, &calc->local2target, tree, hit))
-    {
-      is_aux = false;
-    }
-  }
-
-  /* Project over negative direction of axis */
-  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_NEG_DIR) {
-    float inv_no[3];
-    negate_v3_v3(inv_no, tmp_no);
-
-    char options = calc->smd->shrinkOpts;
-
-    if ((options & MOD_SHRINKWRAP_INVERT_CULL_TARGET) &&
-        (options & MOD_SHRINKWRAP_CULL_TARGET_MASK)) {
-      options ^= MOD_SHRINKWRAP_CULL_TARGET_MASK;
-    }
-
-    if (aux_tree) {
-      if (BKE_shrinkwrap_project_normal(0, tmp_co, inv_no, 0.0, local2aux, aux_tree, hit)) {
-        is_aux = true;
-      }
-    }
-
-    if (BKE_shrinkwrap_project_normal(
-            options, tmp_co, inv_no, 0.0, &calc->local2target, tree, hit)) {
-      is_aux = false;
-    }
-  }
-
-  /* don't set the initial dist (which is more efficient),
-   * because its calculated in the targets space, we want the dist in our own space */
-  if (proj_limit_squared != 0.0f) {
-    if (hit->index != -1 && len_squared_v3v3(hit->co, co) > proj_limit_squared) {
-      hit->index = -1;
-    }
-  }
-
-  if (hit->index != -1) {
-    if (is_aux) {
-      BKE_shrinkwrap_snap_point_to_surface(aux_tree,
-                                           local2aux,
-                                           calc->smd->shrinkMode,
-                                           hit->index,
-                                           hit->co,
-                                           hit->no,
-                                           calc->keepDist,
-                                           tmp_co,
-                                           hit->co);
+  using namespace blender;
+  Array<float3> cos(verts.size());
+  Array<float3> nos(verts.size());
+  Array<BVHTreeRayHit> hits_tmp(hits.size());
+  threading::parallel_for(verts.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      shrinkwrap_ray_to_target_space(transf, verts[i], dirs[i], cos[i], nos[i]);
+      hits_tmp[i] = hits[i];
+      hits_tmp[i].index = -1;
     }
-    else {
-      BKE_shrinkwrap_snap_point_to_surface(tree,
-                                           &calc->local2target,
-                                           calc->smd->shrinkMode,
-                                           hit->index,
-                                           hit->co,
-                                           hit->no,
-                                           calc->keepDist,
-                                           tmp_co,
-                                           hit->co);
+  });
+
+  BLI_bvhtree_ray_cast_batch_cpp(*tree->bvh,
+                                 cos,
+                                 nos,
+                                 0.0f,
+                                 hits_tmp,
+                                 tree->treeData.raycast_callback,
+                                 tree->treeData.raycast_packet_callback,
+                                 &tree->treeData);
+
+  threading::parallel_for(verts.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      r_accepted[i] = shrinkwrap_project_normal_accept_hit(
+          options, verts[i], dirs[i], transf, &hits_tmp[i], &hits[i]);
     }
-
-    interp_v3_v3v3(co, co, hit->co, weight);
-  }
+  });
 }
 
 static void shrinkwrap_calc_normal_projection(ShrinkwrapCalcData *calc)
 {
+  using namespace blender;
   /* Options about projection direction */
   float proj_axis[3] = {0.0f, 0.0f, 0.0f};
 
-  /* Ray-cast and tree stuff. */
-
-  /** \note 'hit.dist' is kept in the targets space, this is only used
-   * for finding the best hit, to get the real dist,
-   * measure the len_v3v3() from the input coord to hit.co */
-  BVHTreeRayHit hit;
-
   /* auxiliary target */
   Mesh *auxMesh = nullptr;
   ShrinkwrapTreeData *aux_tree = nullptr;
@@ -686,20 +617,139 @@ static void shrinkwrap_calc_normal_projection(ShrinkwrapCalcData *calc)
     aux_tree = &aux_tree_stack;
   }
 
-  /* After successfully build the trees, start projection vertices. */
-  ShrinkwrapCalcCBData data{};
-  data.calc = calc;
-  data.tree = calc->tree;
-  data.aux_tree = aux_tree;
-  data.proj_axis = proj_axis;
-  data.local2aux = &local2aux;
-  TaskParallelSettings settings;
-  BLI_parallel_range_settings_defaults(&settings);
-  settings.use_threading = (calc->numVerts > 10000);
-  settings.userdata_chunk = &hit;
-  settings.userdata_chunk_size = sizeof(hit);
-  BLI_task_parallel_range(
-      0, calc->numVerts, &data, shrinkwrap_calc_normal_projection_cb_ex, &settings);
+  /* After successfully build the trees, start projection vertices.
+   * Vertices with a non-zero weight, and the rays to project them along. */
+  Vector<int> verts;
+  Vector<float> weights;
+  for (int i = 0; i < calc->numVerts; i++) {
+    float weight = BKE_defvert_array_find_weight_safe(calc->dvert, i, calc->vgroup);
+    if (calc->invert_vgroup) {
+      weight = 1.0f - weight;
+    }
+    if (weight != 0.0f) {
+      verts.append(i);
+      weights.append(weight);
+    }
+  }
+
+  Array<float3> ray_cos(verts.size());
+  Array<float3> ray_nos(verts.size());
+  threading::parallel_for(verts.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      const int vert = verts[i];
+      if (calc->vert_positions != nullptr &&
+          calc->smd->projAxis == MOD_SHRINKWRAP_PROJECT_OVER_NORMAL)
+      {
+        /* calc->vert_positions contains verts from evaluated mesh. */
+        /* These coordinates are deformed by vertexCos only for normal projection
+         * (to get correct normals) for other cases calc->verts contains undeformed coordinates
+         * and vertexCos should be used */
+        ray_cos[i] = calc->vert_positions[vert];
+        ray_nos[i] = calc->vert_normals[vert];
+      }
+      else {
+        ray_cos[i] = calc->vertexCos[vert];
+        ray_nos[i] = proj_axis;
+      }
+    }
+  });
+
+  /** \note 'hit.dist' is kept in the targets space, this is only used
+   * for finding the best hit, to get the real dist,
+   * measure the len_v3v3() from the input coord to hit.co */
+  Array<BVHTreeRayHit> hits(verts.size());
+  for (BVHTreeRayHit &hit : hits) {
+    hit.index = -1;
+    /* TODO: we should use FLT_MAX here, but sweep-sphere code isn't prepared for that. */
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+  }
+
+  Array<bool> is_aux(verts.size(), false);
+  Array<bool> accepted(verts.size());
+
+  /* Ray-cast the same direction against the auxiliary target first, as it is done for every
+   * vertex at once the hit distances carry over to the ray-casts on the target. */
+  auto project_direction = [&](const char options, const Span<float3> dirs) {
+    if (aux_tree) {
+      shrinkwrap_project_normal_batch(0, ray_cos, dirs, &local2aux, aux_tree, hits, accepted);
+      for (const int64_t i : verts.index_range()) {
+        is_aux[i] |= accepted[i];
+      }
+    }
+    shrinkwrap_project_normal_batch(
+        options, ray_cos, dirs, &calc->local2target, calc->tree, hits, accepted);
+    for (const int64_t i : verts.index_range()) {
+      is_aux[i] &= !accepted[i];
+    }
+  };
+
+  /* Project over positive direction of axis. */
+  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_POS_DIR) {
+    project_direction(calc->smd->shrinkOpts, ray_nos);
+  }
+
+  /* Project over negative direction of axis */
+  if (calc->smd->shrinkOpts & MOD_SHRINKWRAP_PROJECT_ALLOW_NEG_DIR) {
+    Array<float3> inv_nos(verts.size());
+    for (const int64_t i : verts.index_range()) {
+      inv_nos[i] = -ray_nos[i];
+    }
+
+    char options = calc->smd->shrinkOpts;
+
+    if ((options & MOD_SHRINKWRAP_INVERT_CULL_TARGET) &&
+        (options & MOD_SHRINKWRAP_CULL_TARGET_MASK)) {
+      options ^= MOD_SHRINKWRAP_CULL_TARGET_MASK;
+    }
+
+    project_direction(options, inv_nos);
+  }
+
+  const float proj_limit_squared = calc->smd->projLimit * calc->smd->projLimit;
+
+  threading::parallel_for(verts.index_range(), 1024, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      float *co = calc->vertexCos[verts[i]];
+      BVHTreeRayHit *hit = &hits[i];
+
+      /* don't set the initial dist (which is more efficient),
+       * because its calculated in the targets space, we want the dist in our own space */
+      if (proj_limit_squared != 0.0f) {
+        if (hit->index != -1 && len_squared_v3v3(hit->co, co) > proj_limit_squared) {
+          hit->index = -1;
+        }
+      }
+
+      if (hit->index == -1) {
+        continue;
+      }
+
+      if (is_aux[i]) {
+        BKE_shrinkwrap_snap_point_to_surface(aux_tree,
+                                             &local2aux,
+                                             calc->smd->shrinkMode,
+                                             hit->index,
+                                             hit->co,
+                                             hit->no,
+                                             calc->keepDist,
+                                             ray_cos[i],
+                                             hit->co);
+      }
+      else {
+        BKE_shrinkwrap_snap_point_to_surface(calc->tree,
+                                             &calc->local2target,
+                                             calc->smd->shrinkMode,
+                                             hit->index,
+                                             hit->co,
+                                             hit->no,
+                                             calc->keepDist,
+                                             ray_cos[i],
+                                             hit->co);
+      }
+
+      interp_v3_v3v3(co, co, hit->co, weights[i]);
+    }
+  });
 
   /* free data structures */
   if (aux_tree) {
@@ -199,7 +199,7 @@ void ModifierSimulationState::ensure_bake_loaded() const
     return;
   }
 
-  const DiskBDataReader bdata_reader{*bdata_dir_};
+  const DiskBDataReader bdata_reader{*bdata_dir_, owner_->use_mmap_for_bake_};
   deserialize_modifier_simulation_state(*io_root,
                                         bdata_reader,
                                         *owner_->bdata_sharing_,
@@ -1,5 +1,12 @@
 /* SPDX-License-Identifier: GPL-2.0-or-later */
 
+#include <fcntl.h>
+#ifdef WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
 #include "BKE_curves.hh"
 #include "BKE_instances.hh"
 #include "BKE_lib_id.h"
@@ -16,11 +23,15 @@
 #include "BLI_endian_switch.h"
 #include "BLI_fileops.hh"
 #include "BLI_math_matrix_types.hh"
+#include "BLI_mmap.h"
 #include "BLI_path_util.h"
+#include "BLI_task.hh"
 
 #include "RNA_access.h"
 #include "RNA_enum_types.h"
 
+#include <zstd.h>
+
 namespace blender::bke::sim {
 
 /**
@@ -139,19 +150,245 @@ static std::optional<eCustomDataType> get_data_type_from_io_name(const StringRef
   return eCustomDataType(domain);
 }
 
+/** Raw size of the blocks that are compressed independently. */
+static constexpr int64_t bdata_compression_block_size = 1 << 20;
+static constexpr int bdata_compression_level = 3;
+/** Compressing very small arrays is not worth the overhead. */
+static constexpr int64_t bdata_compression_min_size = 256;
+
+/**
+ * Reorder bytes so that the bytes with the same significance of all scalars are next to each
+ * other. Bytes that change rarely (like the exponents of floats or the high bytes of indices) end
+ * up in long runs which compress much better.
+ */
+static void shuffle_bdata_bytes(const Span<char> src,
+                                const int64_t scalar_size,
+                                MutableSpan<char> dst)
+{
+  BLI_assert(src.size() == dst.size());
+  BLI_assert(src.size() % scalar_size == 0);
+  const int64_t scalars_num = src.size() / scalar_size;
+  for (const int64_t byte : IndexRange(scalar_size)) {
+    char *dst_bytes = dst.data() + byte * scalars_num;
+    for (const int64_t i : IndexRange(scalars_num)) {
+      dst_bytes[i] = src[i * scalar_size + byte];
+    }
+  }
+}
+
+static void unshuffle_bdata_bytes(const Span<char> src,
+                                  const int64_t scalar_size,
+                                  MutableSpan<char> dst)
+{
+  BLI_assert(src.size() == dst.size());
+  BLI_assert(src.size() % scalar_size == 0);
+  const int64_t scalars_num = src.size() / scalar_size;
+  for (const int64_t byte : IndexRange(scalar_size)) {
+    const char *src_bytes = src.data() + byte * scalars_num;
+    for (const int64_t i : IndexRange(scalars_num)) {
+      dst[i * scalar_size + byte] = src_bytes[i];
+    }
+  }
+}
+
+/**
+ * Compress the data in independent blocks and write them as a single slice. The compressed size
+ * of every block is stored, so that the blocks can be found and decompressed in parallel.
+ */
+static std::shared_ptr<DictionaryValue> write_bdata_compressed(BDataWriter &bdata_writer,
+                                                               const Span<char> data,
+                                                               const int64_t scalar_size)
+{
+  const int64_t blocks_num = divide_ceil_ul(data.size(), bdata_compression_block_size);
+  Array<Vector<char>> compressed_blocks(blocks_num);
+  std::atomic<bool> failed = false;
+  threading::parallel_for(IndexRange(blocks_num), 1, [&](const IndexRange range) {
+    Array<char> shuffled;
+    for (const int64_t block_i : range) {
+      const Span<char> block = data.slice_safe(block_i * bdata_compression_block_size,
+                                               bdata_compression_block_size);
+      shuffled.reinitialize(block.size());
+      shuffle_bdata_bytes(block, scalar_size, shuffled);
+      Vector<char> &compressed = compressed_blocks[block_i];
+      compressed.resize(ZSTD_compressBound(block.size()));
+      const size_t compressed_size = ZSTD_compress(compressed.data(),
+                                                   compressed.size(),
+                                                   shuffled.data(),
+                                                   shuffled.size(),
+                                                   bdata_compression_level);
+      if (ZSTD_isError(compressed_size)) {
+        failed = true;
+        return;
+      }
+      compressed.resize(compressed_size);
+    }
+  });
+  if (failed) {
+    return bdata_writer.write(data.data(), data.size()).serialize();
+  }
+
+  Vector<char> compressed_data;
+  auto io_blocks = std::make_shared<io::serialize::ArrayValue>();
+  for (const Vector<char> &compressed : compressed_blocks) {
+    compressed_data.extend(compressed);
+    io_blocks->append_int(compressed.size());
+  }
+
+  auto io_data = bdata_writer.write(compressed_data.data(), compressed_data.size()).serialize();
+  io_data->append_str("compression", "zstd");
+  io_data->append_int("raw_size", data.size());
+  io_data->append_int("block_size", bdata_compression_block_size);
+  io_data->append_int("scalar_size", scalar_size);
+  io_data->append("blocks", io_blocks);
+  return io_data;
+}
+
+[[nodiscard]] static bool read_bdata_compressed(const BDataReader &bdata_reader,
+                                                const DictionaryValue &io_data,
+                                                const BDataSlice &slice,
+                                                MutableSpan<char> r_data)
+{
+  const std::optional<StringRefNull> compression = io_data.lookup_str("compression");
+  const std::optional<int64_t> raw_size = io_data.lookup_int("raw_size");
+  const std::optional<int64_t> block_size = io_data.lookup_int("block_size");
+  const std::optional<int64_t> scalar_size = io_data.lookup_int("scalar_size");
+  const io::serialize::ArrayValue *io_blocks = io_data.lookup_array("blocks");
+  if (!compression || !raw_size || !block_size || !scalar_size || !io_blocks) {
+    return false;
+  }
+  if (*compression != "zstd" || *raw_size != r_data.size() || *block_size <= 0 ||
+      *scalar_size <= 0 || *block_size % *scalar_size != 0)
+  {
+    return false;
+  }
+  const int64_t blocks_num = io_blocks->elements().size();
+  if (blocks_num != divide_ceil_ul(r_data.size(), *block_size)) {
+    return false;
+  }
+  Array<int64_t> block_offsets(blocks_num + 1);
+  block_offsets[0] = 0;
+  for (const int64_t block_i : IndexRange(blocks_num)) {
+    const io::serialize::IntValue *io_block_size = io_blocks->elements()[block_i]->as_int_value();
+    if (!io_block_size || io_block_size->value() < 0) {
+      return false;
+    }
+    block_offsets[block_i + 1] = block_offsets[block_i] + io_block_size->value();
+  }
+  if (block_offsets.last() != slice.range.size()) {
+    return false;
+  }
+
+  Array<char> compressed_data(slice.range.size());
+  if (!bdata_reader.read(slice, compressed_data.data())) {
+    return false;
+  }
+
+  std::atomic<bool> failed = false;
+  threading::parallel_for(IndexRange(blocks_num), 1, [&](const IndexRange range) {
+    Array<char> shuffled;
+    for (const int64_t block_i : range) {
+      const Span<char> compressed = compressed_data.as_span().slice(
+          block_offsets[block_i], block_offsets[block_i + 1] - block_offsets[block_i]);
+      MutableSpan<char> block = r_data.slice_safe(block_i * *block_size, *block_size);
+      if (block.size() % *scalar_size != 0) {
+        failed = true;
+        return;
+      }
+      shuffled.reinitialize(block.size());
+      const size_t decompressed_size = ZSTD_decompress(
+          shuffled.data(), shuffled.size(), compressed.data(), compressed.size());
+      if (ZSTD_isError(decompressed_size) || decompressed_size != size_t(block.size())) {
+        failed = true;
+        return;
+      }
+      unshuffle_bdata_bytes(shuffled, *scalar_size, block);
+    }
+  });
+  return !failed;
+}
+
+/**
+ * Write the data, possibly compressed depending on the writer's settings.
+ * \param scalar_size: Size of the individual values that make up the data, used to improve
+ * compression.
+ */
+static std::shared_ptr<DictionaryValue> write_bdata_slice(BDataWriter &bdata_writer,
+                                                          const void *data,
+                                                          const int64_t size_in_bytes,
+                                                          const int64_t scalar_size)
+{
+  if (bdata_writer.encoding().use_compression && size_in_bytes >= bdata_compression_min_size) {
+    return write_bdata_compressed(
+        bdata_writer, {static_cast<const char *>(data), size_in_bytes}, scalar_size);
+  }
+  return bdata_writer.write(data, size_in_bytes).serialize();
+}
+
+/** Read the data written with #write_bdata_slice. */
+[[nodiscard]] static bool read_bdata_slice(const BDataReader &bdata_reader,
+                                           const DictionaryValue &io_data,
+                                           const int64_t size_in_bytes,
+                                           void *r_data)
+{
+  const std::optional<BDataSlice> slice = BDataSlice::deserialize(io_data);
+  if (!slice) {
+    return false;
+  }
+  if (io_data.lookup("compression")) {
+    return read_bdata_compressed(
+        bdata_reader, io_data, *slice, {static_cast<char *>(r_data), size_in_bytes});
+  }
+  if (slice->range.size() != size_in_bytes) {
+    return false;
+  }
+  return bdata_reader.read(*slice, r_data);
+}
+
+/**
+ * Size of the individual values that make up the type, for endian switching and compression.
+ * Types that are stored as plain bytes have a scalar size of 1.
+ */
+static std::optional<int64_t> get_bdata_scalar_size(const CPPType &type)
+{
+  if (type.size() == 1 || type.is<ColorGeometry4b>()) {
+    return 1;
+  }
+  if (type.is_any<int16_t, uint16_t>()) {
+    return sizeof(int16_t);
+  }
+  if (type.is_any<int32_t, uint32_t, float, float2, int2, float3, float4x4, ColorGeometry4f>()) {
+    return sizeof(int32_t);
+  }
+  if (type.is_any<int64_t, uint64_t>()) {
+    return sizeof(int64_t);
+  }
+  return std::nullopt;
+}
+
 /**
  * Write the data and remember which endianness the data had.
  */
 static std::shared_ptr<DictionaryValue> write_bdata_raw_data_with_endian(
-    BDataWriter &bdata_writer, const void *data, const int64_t size_in_bytes)
+    BDataWriter &bdata_writer,
+    const void *data,
+    const int64_t size_in_bytes,
+    const int64_t element_size)
 {
-  auto io_data = bdata_writer.write(data, size_in_bytes).serialize();
+  auto io_data = write_bdata_slice(bdata_writer, data, size_in_bytes, element_size);
   if (ENDIAN_ORDER == B_ENDIAN) {
     io_data->append_str("endian", get_endian_io_name(ENDIAN_ORDER));
   }
   return io_data;
 }
 
+/** Whether the data has been written on a machine with a different endianness. */
+static bool bdata_needs_endian_switch(const DictionaryValue &io_data)
+{
+  const StringRefNull stored_endian = io_data.lookup_str("endian").value_or("little");
+  const StringRefNull current_endian = get_endian_io_name(ENDIAN_ORDER);
+  return stored_endian != current_endian;
+}
+
 /**
  * Read data of an into an array and optionally perform an endian switch if necessary.
  */
@@ -161,20 +398,10 @@ static std::shared_ptr<DictionaryValue> write_bdata_raw_data_with_endian(
                                                           const int64_t elements_num,
                                                           void *r_data)
 {
-  const std::optional<BDataSlice> slice = BDataSlice::deserialize(io_data);
-  if (!slice) {
+  if (!read_bdata_slice(bdata_reader, io_data, element_size * elements_num, r_data)) {
     return false;
   }
-  if (slice->range.size() != element_size * elements_num) {
-    return false;
-  }
-  if (!bdata_reader.read(*slice, r_data)) {
-    return false;
-  }
-  const StringRefNull stored_endian = io_data.lookup_str("endian").value_or("little");
-  const StringRefNull current_endian = get_endian_io_name(ENDIAN_ORDER);
-  const bool need_endian_switch = stored_endian != current_endian;
-  if (need_endian_switch) {
+  if (bdata_needs_endian_switch(io_data)) {
     switch (element_size) {
       case 1:
         break;
@@ -199,7 +426,7 @@ static std::shared_ptr<DictionaryValue> write_bdata_raw_bytes(BDataWriter &bdata
                                                               const void *data,
                                                               const int64_t size_in_bytes)
 {
-  return bdata_writer.write(data, size_in_bytes).serialize();
+  return write_bdata_slice(bdata_writer, data, size_in_bytes, 1);
 }
 
 /** Read bytes ignoring endianness. */
@@ -208,14 +435,7 @@ static std::shared_ptr<DictionaryValue> write_bdata_raw_bytes(BDataWriter &bdata
                                                const int64_t bytes_num,
                                                void *r_data)
 {
-  const std::optional<BDataSlice> slice = BDataSlice::deserialize(io_data);
-  if (!slice) {
-    return false;
-  }
-  if (slice->range.size() != bytes_num) {
-    return false;
-  }
-  return bdata_reader.read(*slice, r_data);
+  return read_bdata_slice(bdata_reader, io_data, bytes_num, r_data);
 }
 
 static std::shared_ptr<DictionaryValue> write_bdata_simple_gspan(BDataWriter &bdata_writer,
@@ -223,10 +443,12 @@ static std::shared_ptr<DictionaryValue> write_bdata_simple_gspan(BDataWriter &bd
 {
   const CPPType &type = data.type();
   BLI_assert(type.is_trivial());
-  if (type.size() == 1 || type.is<ColorGeometry4b>()) {
+  const int64_t scalar_size = *get_bdata_scalar_size(type);
+  if (scalar_size == 1) {
     return write_bdata_raw_bytes(bdata_writer, data.data(), data.size_in_bytes());
   }
-  return write_bdata_raw_data_with_endian(bdata_writer, data.data(), data.size_in_bytes());
+  return write_bdata_raw_data_with_endian(
+      bdata_writer, data.data(), data.size_in_bytes(), scalar_size);
 }
 
 [[nodiscard]] static bool read_bdata_simple_gspan(const BDataReader &bdata_reader,
@@ -235,40 +457,90 @@ static std::shared_ptr<DictionaryValue> write_bdata_simple_gspan(BDataWriter &bd
 {
   const CPPType &type = r_data.type();
   BLI_assert(type.is_trivial());
-  if (type.size() == 1 || type.is<ColorGeometry4b>()) {
-    return read_bdata_raw_bytes(bdata_reader, io_data, r_data.size_in_bytes(), r_data.data());
-  }
-  if (type.is_any<int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t, float>()) {
-    return read_bdata_raw_data_with_endian(
-        bdata_reader, io_data, type.size(), r_data.size(), r_data.data());
-  }
-  if (type.is_any<float2, int2>()) {
-    return read_bdata_raw_data_with_endian(
-        bdata_reader, io_data, sizeof(int32_t), r_data.size() * 2, r_data.data());
-  }
-  if (type.is<float3>()) {
-    return read_bdata_raw_data_with_endian(
-        bdata_reader, io_data, sizeof(float), r_data.size() * 3, r_data.data());
-  }
-  if (type.is<float4x4>()) {
-    return read_bdata_raw_data_with_endian(
-        bdata_reader, io_data, sizeof(float), r_data.size() * 16, r_data.data());
+  const std::optional<int64_t> scalar_size = get_bdata_scalar_size(type);
+  if (!scalar_size) {
+    return false;
   }
-  if (type.is<ColorGeometry4f>()) {
-    return read_bdata_raw_data_with_endian(
-        bdata_reader, io_data, sizeof(float), r_data.size() * 4, r_data.data());
+  if (*scalar_size == 1) {
+    return read_bdata_raw_bytes(bdata_reader, io_data, r_data.size_in_bytes(), r_data.data());
   }
-  return false;
+  return read_bdata_raw_data_with_endian(bdata_reader,
+                                         io_data,
+                                         *scalar_size,
+                                         r_data.size_in_bytes() / *scalar_size,
+                                         r_data.data());
 }
 
+/**
+ * \param delta_key: Identifies the data across frames for delta encoding. Data is not delta
+ * encoded when this is empty.
+ */
 static std::shared_ptr<DictionaryValue> write_bdata_shared_simple_gspan(
     BDataWriter &bdata_writer,
     BDataSharing &bdata_sharing,
     const GSpan data,
-    const ImplicitSharingInfo *sharing_info)
+    const ImplicitSharingInfo *sharing_info,
+    const StringRef delta_key = "")
+{
+  return bdata_sharing.write_shared(sharing_info, [&]() {
+    const int key_interval = bdata_writer.encoding().delta_key_interval;
+    if (key_interval <= 1 || delta_key.is_empty()) {
+      return write_bdata_simple_gspan(bdata_writer, data);
+    }
+    const Span<char> bytes{static_cast<const char *>(data.data()), data.size_in_bytes()};
+    return bdata_sharing.write_delta(
+        delta_key,
+        bytes,
+        sharing_info,
+        key_interval,
+        [&](const Span<char> bytes_to_write, const DictionaryValuePtr &io_base) {
+          DictionaryValuePtr io_data = write_bdata_simple_gspan(
+              bdata_writer,
+              {data.type(), bytes_to_write.data(), bytes_to_write.size() / data.type().size()});
+          if (io_base) {
+            io_data->append("delta_base", io_base);
+          }
+          return io_data;
+        });
+  });
+}
+
+/**
+ * Try to reference the stored data directly instead of reading it into a new array. This is
+ * possible when the reader supports it and the data can be used as is.
+ */
+static std::optional<ImplicitSharingInfoAndData> try_read_bdata_mapped_simple_gspan(
+    const BDataReader &bdata_reader,
+    const DictionaryValue &io_data,
+    const CPPType &cpp_type,
+    const int size)
+{
+  BLI_assert(cpp_type.is_trivial());
+  if (io_data.lookup("compression") || io_data.lookup("delta_base")) {
+    return std::nullopt;
+  }
+  const std::optional<BDataSlice> slice = BDataSlice::deserialize(io_data);
+  if (!slice) {
+    return std::nullopt;
+  }
+  if (slice->range.size() != cpp_type.size() * size) {
+    return std::nullopt;
+  }
+  if (cpp_type.size() > 1 && bdata_needs_endian_switch(io_data)) {
+    return std::nullopt;
+  }
+  return bdata_reader.read_mapped(*slice, cpp_type.alignment());
+}
+
+/** Undo the delta encoding done by #BDataSharing::write_delta. */
+static void apply_bdata_delta(const Span<char> base, MutableSpan<char> data)
 {
-  return bdata_sharing.write_shared(
-      sharing_info, [&]() { return write_bdata_simple_gspan(bdata_writer, data); });
+  BLI_assert(base.size() == data.size());
+  threading::parallel_for(data.index_range(), 1 << 16, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      data[i] ^= base[i];
+    }
+  });
 }
 
 [[nodiscard]] static const void *read_bdata_shared_simple_gspan(
@@ -279,14 +551,47 @@ static std::shared_ptr<DictionaryValue> write_bdata_shared_simple_gspan(
     const int size,
     const ImplicitSharingInfo **r_sharing_info)
 {
+  /* The base of delta encoded data is read first, because #BDataSharing::read_shared can't be
+   * called recursively. Base data is shared by many arrays, so it is usually cached already. */
+  const void *base_data = nullptr;
+  const ImplicitSharingInfo *base_sharing_info = nullptr;
+  if (const DictionaryValue *io_base = io_data.lookup_dict("delta_base")) {
+    if (io_base->lookup("delta_base")) {
+      /* Bases are never delta encoded themselves. */
+      *r_sharing_info = nullptr;
+      return nullptr;
+    }
+    base_data = read_bdata_shared_simple_gspan(
+        *io_base, bdata_reader, bdata_sharing, cpp_type, size, &base_sharing_info);
+    if (!base_data) {
+      *r_sharing_info = nullptr;
+      return nullptr;
+    }
+  }
+  BLI_SCOPED_DEFER([&]() {
+    if (base_sharing_info) {
+      base_sharing_info->remove_user_and_delete_if_last();
+    }
+  });
+
   const std::optional<ImplicitSharingInfoAndData> sharing_info_and_data =
       bdata_sharing.read_shared(io_data, [&]() -> std::optional<ImplicitSharingInfoAndData> {
+        if (std::optional<ImplicitSharingInfoAndData> mapped_data =
+                try_read_bdata_mapped_simple_gspan(bdata_reader, io_data, cpp_type, size))
+        {
+          return mapped_data;
+        }
         void *data_mem = MEM_mallocN_aligned(
             size * cpp_type.size(), cpp_type.alignment(), __func__);
         if (!read_bdata_simple_gspan(bdata_reader, io_data, {cpp_type, data_mem, size})) {
           MEM_freeN(data_mem);
           return std::nullopt;
         }
+        if (base_data) {
+          const int64_t size_in_bytes = size * cpp_type.size();
+          apply_bdata_delta({static_cast<const char *>(base_data), size_in_bytes},
+                            {static_cast<char *>(data_mem), size_in_bytes});
+        }
         return ImplicitSharingInfoAndData{implicit_sharing::info_for_mem_free(data_mem), data_mem};
       });
   if (!sharing_info_and_data) {
@@ -597,7 +902,8 @@ static std::shared_ptr<io::serialize::ArrayValue> serialize_attributes(
     const bke::AttributeAccessor &attributes,
     BDataWriter &bdata_writer,
     BDataSharing &bdata_sharing,
-    const Set<std::string> &attributes_to_ignore)
+    const Set<std::string> &attributes_to_ignore,
+    const StringRef delta_key_prefix)
 {
   auto io_attributes = std::make_shared<io::serialize::ArrayValue>();
   attributes.for_all(
@@ -624,15 +930,20 @@ static std::shared_ptr<io::serialize::ArrayValue> serialize_attributes(
                                  bdata_writer,
                                  bdata_sharing,
                                  attribute_span,
-                                 attribute.varray.is_span() ? attribute.sharing_info : nullptr));
+                                 attribute.varray.is_span() ? attribute.sharing_info : nullptr,
+                                 delta_key_prefix + "/" + attribute_id.name()));
         return true;
       });
   return io_attributes;
 }
 
+/**
+ * \param delta_key_prefix: Identifies the geometry across frames, used for delta encoding.
+ */
 static std::shared_ptr<DictionaryValue> serialize_geometry_set(const GeometrySet &geometry,
                                                                BDataWriter &bdata_writer,
-                                                               BDataSharing &bdata_sharing)
+                                                               BDataSharing &bdata_sharing,
+                                                               const StringRef delta_key_prefix)
 {
   auto io_geometry = std::make_shared<DictionaryValue>();
   if (geometry.has_mesh()) {
@@ -649,13 +960,15 @@ static std::shared_ptr<DictionaryValue> serialize_geometry_set(const GeometrySet
                       write_bdata_shared_simple_gspan(bdata_writer,
                                                       bdata_sharing,
                                                       mesh.poly_offsets(),
-                                                      mesh.runtime->poly_offsets_sharing_info));
+                                                      mesh.runtime->poly_offsets_sharing_info,
+                                                      delta_key_prefix + "/mesh/poly_offsets"));
     }
 
     auto io_materials = serialize_material_slots({mesh.mat, mesh.totcol});
     io_mesh->append("materials", io_materials);
 
-    auto io_attributes = serialize_attributes(mesh.attributes(), bdata_writer, bdata_sharing, {});
+    auto io_attributes = serialize_attributes(
+        mesh.attributes(), bdata_writer, bdata_sharing, {}, delta_key_prefix + "/mesh");
     io_mesh->append("attributes", io_attributes);
   }
   if (geometry.has_pointcloud()) {
@@ -667,8 +980,11 @@ static std::shared_ptr<DictionaryValue> serialize_geometry_set(const GeometrySet
     auto io_materials = serialize_material_slots({pointcloud.mat, pointcloud.totcol});
     io_pointcloud->append("materials", io_materials);
 
-    auto io_attributes = serialize_attributes(
-        pointcloud.attributes(), bdata_writer, bdata_sharing, {});
+    auto io_attributes = serialize_attributes(pointcloud.attributes(),
+                                              bdata_writer,
+                                              bdata_sharing,
+                                              {},
+                                              delta_key_prefix + "/pointcloud");
     io_pointcloud->append("attributes", io_attributes);
   }
   if (geometry.has_curves()) {
@@ -686,14 +1002,15 @@ static std::shared_ptr<DictionaryValue> serialize_geometry_set(const GeometrySet
           write_bdata_shared_simple_gspan(bdata_writer,
                                           bdata_sharing,
                                           curves.offsets(),
-                                          curves.runtime->curve_offsets_sharing_info));
+                                          curves.runtime->curve_offsets_sharing_info,
+                                          delta_key_prefix + "/curves/curve_offsets"));
     }
 
     auto io_materials = serialize_material_slots({curves_id.mat, curves_id.totcol});
     io_curves->append("materials", io_materials);
 
     auto io_attributes = serialize_attributes(
-        curves.attributes(), bdata_writer, bdata_sharing, {});
+        curves.attributes(), bdata_writer, bdata_sharing, {}, delta_key_prefix + "/curves");
     io_curves->append("attributes", io_attributes);
   }
   if (geometry.has_instances()) {
@@ -703,10 +1020,14 @@ static std::shared_ptr<DictionaryValue> serialize_geometry_set(const GeometrySet
     io_instances->append_int("num_instances", instances.instances_num());
 
     auto io_references = io_instances->append_array("references");
-    for (const bke::InstanceReference &reference : instances.references()) {
+    for (const int reference_i : instances.references().index_range()) {
+      const bke::InstanceReference &reference = instances.references()[reference_i];
       BLI_assert(reference.type() == bke::InstanceReference::Type::GeometrySet);
-      io_references->append(
-          serialize_geometry_set(reference.geometry_set(), bdata_writer, bdata_sharing));
+      io_references->append(serialize_geometry_set(
+          reference.geometry_set(),
+          bdata_writer,
+          bdata_sharing,
+          delta_key_prefix + "/instances/" + std::to_string(reference_i)));
     }
 
     io_instances->append("transforms",
@@ -715,7 +1036,11 @@ static std::shared_ptr<DictionaryValue> serialize_geometry_set(const GeometrySet
                          write_bdata_simple_gspan(bdata_writer, instances.reference_handles()));
 
     auto io_attributes = serialize_attributes(
-        instances.attributes(), bdata_writer, bdata_sharing, {"position"});
+        instances.attributes(),
+        bdata_writer,
+        bdata_sharing,
+        {"position"},
+        delta_key_prefix + "/instances");
     io_instances->append("attributes", io_attributes);
   }
   return io_geometry;
@@ -788,7 +1113,7 @@ void serialize_modifier_simulation_state(const ModifierSimulationState &state,
                                          BDataSharing &bdata_sharing,
                                          DictionaryValue &r_io_root)
 {
-  r_io_root.append_int("version", 1);
+  r_io_root.append_int("version", 2);
   auto io_zones = r_io_root.append_array("zones");
 
   for (const auto item : state.zone_states_.items()) {
@@ -817,7 +1142,13 @@ void serialize_modifier_simulation_state(const ModifierSimulationState &state,
         io_state_item->append_str("type", "GEOMETRY");
 
         const GeometrySet &geometry = geometry_state_item->geometry;
-        auto io_geometry = serialize_geometry_set(geometry, bdata_writer, bdata_sharing);
+        std::stringstream delta_key;
+        for (const int node_id : zone_id.node_ids) {
+          delta_key << node_id << "/";
+        }
+        delta_key << state_item_with_id.key;
+        auto io_geometry = serialize_geometry_set(
+            geometry, bdata_writer, bdata_sharing, delta_key.str());
         io_state_item->append("data", io_geometry);
       }
       else if (const AttributeSimulationStateItem *attribute_state_item =
@@ -980,7 +1311,8 @@ void deserialize_modifier_simulation_state(const DictionaryValue &io_root,
   if (!version) {
     return;
   }
-  if (*version != 1) {
+  /* Version 2 added compression and delta encoding, which are detected per array. */
+  if (!ELEM(*version, 1, 2)) {
     return;
   }
   const io::serialize::ArrayValue *io_zones = io_root.lookup_array("zones");
@@ -1092,7 +1424,111 @@ void deserialize_modifier_simulation_state(const DictionaryValue &io_root,
   }
 }
 
-DiskBDataReader::DiskBDataReader(std::string bdata_dir) : bdata_dir_(std::move(bdata_dir)) {}
+std::optional<ImplicitSharingInfoAndData> BDataReader::read_mapped(
+    const BDataSlice & /*slice*/, const int64_t /*alignment*/) const
+{
+  return std::nullopt;
+}
+
+/**
+ * Owns a user of a mapped bdata file for a single array referencing the mapped memory. Every
+ * array gets its own sharing info, because they are versioned independently.
+ */
+class MappedBDataSharingInfo : public ImplicitSharingInfo {
+ private:
+  std::shared_ptr<BLI_mmap_file> mapped_file_;
+
+ public:
+  MappedBDataSharingInfo(std::shared_ptr<BLI_mmap_file> mapped_file)
+      : mapped_file_(std::move(mapped_file))
+  {
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    MEM_delete(this);
+  }
+
+  void delete_data_only() override
+  {
+    mapped_file_.reset();
+  }
+};
+
+/**
+ * Opening and freeing mapped files modifies global state used for error handling, which is not
+ * thread-safe. Mapped files may be freed from any thread when the last array referencing them is
+ * freed.
+ */
+static std::mutex &get_bdata_mmap_mutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+static std::shared_ptr<BLI_mmap_file> map_bdata_file(const char *bdata_path)
+{
+  const int file = BLI_open(bdata_path, O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return nullptr;
+  }
+  BLI_mmap_file *mapped_file;
+  {
+    std::lock_guard lock{get_bdata_mmap_mutex()};
+    /* Arrays referencing the mapped memory may be modified in place when they are not shared
+     * anymore. A copy-on-write mapping makes sure that this never changes the file on disk. */
+    mapped_file = BLI_mmap_open_copy_on_write(file);
+  }
+  close(file);
+  if (mapped_file == nullptr) {
+    return nullptr;
+  }
+  return std::shared_ptr<BLI_mmap_file>(mapped_file, [](BLI_mmap_file *mapped_file) {
+    std::lock_guard lock{get_bdata_mmap_mutex()};
+    BLI_mmap_free(mapped_file);
+  });
+}
+
+DiskBDataReader::DiskBDataReader(std::string bdata_dir, const bool use_mmap)
+    : bdata_dir_(std::move(bdata_dir)), use_mmap_(use_mmap)
+{
+}
+
+std::optional<ImplicitSharingInfoAndData> DiskBDataReader::read_mapped(
+    const BDataSlice &slice, const int64_t alignment) const
+{
+  if (!use_mmap_ || slice.range.is_empty()) {
+    return std::nullopt;
+  }
+
+  char bdata_path[FILE_MAX];
+  BLI_path_join(bdata_path, sizeof(bdata_path), bdata_dir_.c_str(), slice.name.c_str());
+
+  std::shared_ptr<BLI_mmap_file> mapped_file;
+  {
+    std::lock_guard lock{mutex_};
+    mapped_file = mapped_files_.lookup_or_add_cb_as(bdata_path,
+                                                    [&]() { return map_bdata_file(bdata_path); });
+  }
+  if (!mapped_file) {
+    return std::nullopt;
+  }
+  if (slice.range.one_after_last() > int64_t(BLI_mmap_get_length(mapped_file.get()))) {
+    return std::nullopt;
+  }
+  if (BLI_mmap_any_io_error(mapped_file.get())) {
+    return std::nullopt;
+  }
+  const void *data = static_cast<const char *>(BLI_mmap_get_pointer(mapped_file.get())) +
+                     slice.range.start();
+  if (uintptr_t(data) % uintptr_t(alignment) != 0) {
+    return std::nullopt;
+  }
+  const ImplicitSharingInfo *sharing_info = MEM_new<MappedBDataSharingInfo>(
+      __func__, std::move(mapped_file));
+  return ImplicitSharingInfoAndData{sharing_info, data};
+}
 
 [[nodiscard]] bool DiskBDataReader::read(const BDataSlice &slice, void *r_data) const
 {
@@ -1117,13 +1553,22 @@ DiskBDataReader::DiskBDataReader(std::string bdata_dir) : bdata_dir_(std::move(b
 
 DiskBDataWriter::DiskBDataWriter(std::string bdata_name,
                                  std::ostream &bdata_file,
-                                 const int64_t current_offset)
+                                 const int64_t current_offset,
+                                 const BDataEncoding &encoding)
     : bdata_name_(std::move(bdata_name)), bdata_file_(bdata_file), current_offset_(current_offset)
 {
+  encoding_ = encoding;
 }
 
 BDataSlice DiskBDataWriter::write(const void *data, const int64_t size)
 {
+  const int64_t padding = (slice_alignment - current_offset_ % slice_alignment) %
+                          slice_alignment;
+  if (padding > 0) {
+    const std::array<char, slice_alignment> zeros{};
+    bdata_file_.write(zeros.data(), padding);
+    current_offset_ += padding;
+  }
   const int64_t old_offset = current_offset_;
   bdata_file_.write(static_cast<const char *>(data), size);
   current_offset_ += size;
@@ -1170,6 +1615,41 @@ DictionaryValuePtr BDataSharing::write_shared(const ImplicitSharingInfo *sharing
       });
 }
 
+DictionaryValuePtr BDataSharing::write_delta(
+    const StringRef key,
+    const Span<char> data,
+    const ImplicitSharingInfo *sharing_info,
+    const int key_interval,
+    FunctionRef<DictionaryValuePtr(Span<char> data, const DictionaryValuePtr &io_base)> write_fn)
+{
+  DeltaBase *base = delta_bases_.lookup_ptr_as(key);
+  if (base && base->data().size() == data.size() && base->deltas_num < key_interval - 1) {
+    const Span<char> base_data = base->data();
+    Array<char> delta(data.size(), NoInitialization());
+    threading::parallel_for(data.index_range(), 1 << 16, [&](const IndexRange range) {
+      for (const int64_t i : range) {
+        delta[i] = data[i] ^ base_data[i];
+      }
+    });
+    base->deltas_num++;
+    return write_fn(delta, base->io_data);
+  }
+  DictionaryValuePtr io_data = write_fn(data, nullptr);
+  DeltaBase new_base;
+  new_base.io_data = io_data;
+  if (sharing_info) {
+    /* Data can't be modified while it has more than one user. */
+    sharing_info->add_user();
+    new_base.sharing_info = ImplicitSharingPtr<const ImplicitSharingInfo>(sharing_info);
+    new_base.shared_data = data;
+  }
+  else {
+    new_base.data_copy = data;
+  }
+  delta_bases_.add_overwrite(key, std::move(new_base));
+  return io_data;
+}
+
 std::optional<ImplicitSharingInfoAndData> BDataSharing::read_shared(
     const DictionaryValue &io_data,
     FunctionRef<std::optional<ImplicitSharingInfoAndData>()> read_fn) const
@@ -654,7 +654,8 @@ IDTypeInfo IDType_ID_VO = {
     /*name*/ "Volume",
     /*name_plural*/ "volumes",
     /*translation_context*/ BLT_I18NCONTEXT_ID_VOLUME,
-    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE,
+    /*flags*/ IDTYPE_FLAGS_APPEND_IS_REUSABLE | IDTYPE_FLAGS_THREADSAFE_BLEND_WRITE |
+        IDTYPE_FLAGS_THREADSAFE_BLEND_READ_DATA,
     /*asset_type_info*/ nullptr,
 
     /*init_data*/ volume_init_data,
@@ -90,6 +90,20 @@ enum {
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
 
+/** Number of rays #BLI_bvhtree_ray_cast_batch traverses the tree with at once. */
+#define BVH_RAYCAST_PACKET_SIZE 8
+
+/** Trade-off between the time to build a tree and the time to query it. */
+typedef enum eBVHBuildQuality {
+  /** Split the leafs at the median of the largest axis of every branch. */
+  BVH_BUILD_QUALITY_HIGH = 0,
+  /**
+   * Sort the leafs along a Z-order curve once and split them in order, which is fully
+   * multi-threaded. Queries are somewhat slower, useful for trees which are used only a few times.
+   */
+  BVH_BUILD_QUALITY_FAST = 1,
+} eBVHBuildQuality;
+
 /**
  * Callback must update nearest in case it finds a nearest result.
  */
@@ -106,6 +120,26 @@ typedef void (*BVHTree_RayCastCallback)(void *userdata,
                                         const BVHTreeRay *ray,
                                         BVHTreeRayHit *hit);
 
+/**
+ * Callback for a packet of rays reaching the same leaf, which are passed as arrays of
+ * #BVH_RAYCAST_PACKET_SIZE rays and hits. Bit `i` of \a ray_mask is set when `rays[i]` has to be
+ * tested, the callback must update `hits[i]` in case it finds a nearer successful hit.
+ */
+typedef void (*BVHTree_RayCastPacketCallback)(void *userdata,
+                                              int index,
+                                              const BVHTreeRay *rays,
+                                              BVHTreeRayHit *hits,
+                                              uint ray_mask);
+
+/** Maximum number of points #BVHTree_RefitLeafCallback can return. */
+#define BVH_REFIT_POINTS_MAX 4
+
+/**
+ * Callback to get the current points of the leaf with the given index, used by
+ * #BLI_bvhtree_refit. Returns the number of points written to \a r_co.
+ */
+typedef int (*BVHTree_RefitLeafCallback)(void *userdata, int index, float (*r_co)[3]);
+
 /**
  * Callback to check if 2 nodes overlap (use thread if intersection results need to be stored).
  */
@@ -146,6 +180,10 @@ typedef bool (*BVHTree_WalkOrderCallback)(const BVHTreeAxisRange *bounds,
                                           void *userdata);
 
 /**
+ * Trees of axis aligned bounding boxes (`axis == 6`) are also stored in a flattened layout of
+ * wide nodes when balanced, which makes nearest point, ray-cast, range and overlap queries faster.
+ * This requires a `tree_type` of at most 4 (8 when building with AVX).
+ *
  * \note many callers don't check for `NULL` return.
  */
 BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis);
@@ -156,6 +194,7 @@ void BLI_bvhtree_free(BVHTree *tree);
  */
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints);
 void BLI_bvhtree_balance(BVHTree *tree);
+void BLI_bvhtree_balance_ex(BVHTree *tree, eBVHBuildQuality quality);
 
 /**
  * Update: first update points/nodes, then call update_tree to refit the bounding volumes.
@@ -170,6 +209,18 @@ bool BLI_bvhtree_update_node(
  * too much, operations on the tree may become suboptimal.
  */
 void BLI_bvhtree_update_tree(BVHTree *tree);
+/**
+ * Update the bounding volumes of all leafs with the points given by \a leaf_cb and then the
+ * branches, in parallel. Like #BLI_bvhtree_update_tree this keeps the structure of the tree,
+ * use #BLI_bvhtree_sah_cost to check how much it degraded.
+ */
+void BLI_bvhtree_refit(BVHTree *tree, BVHTree_RefitLeafCallback leaf_cb, void *userdata);
+/**
+ * Sum of the surface areas of all branches relative to the area of the root, which is
+ * proportional to the expected cost of a query. Comparing it to the cost right after building
+ * shows how much refitting the tree to moved points degraded it.
+ */
+float BLI_bvhtree_sah_cost(const BVHTree *tree);
 
 /**
  * Use to check the total number of threads #BLI_bvhtree_overlap will use.
@@ -263,6 +314,37 @@ int BLI_bvhtree_ray_cast(const BVHTree *tree,
                          BVHTree_RayCastCallback callback,
                          void *userdata);
 
+/**
+ * Cast many rays, finding the nearest hit of every ray like #BLI_bvhtree_ray_cast.
+ * The rays are sorted and traversed in coherent packets of #BVH_RAYCAST_PACKET_SIZE rays on
+ * multiple threads, which is much faster than casting them one by one.
+ *
+ * \param hits: One hit per ray, initialized like the hit passed to #BLI_bvhtree_ray_cast
+ * (its distance limits the ray).
+ * \param callback: Called for every ray reaching a leaf, unless \a packet_callback is given.
+ * \param packet_callback: Optional, called once for all rays of a packet reaching a leaf.
+ * \note Callbacks are called from multiple threads.
+ */
+void BLI_bvhtree_ray_cast_batch_ex(const BVHTree *tree,
+                                   const float (*origins)[3],
+                                   const float (*directions)[3],
+                                   int rays_num,
+                                   float radius,
+                                   BVHTreeRayHit *hits,
+                                   BVHTree_RayCastCallback callback,
+                                   BVHTree_RayCastPacketCallback packet_callback,
+                                   void *userdata,
+                                   int flag);
+void BLI_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const float (*origins)[3],
+                                const float (*directions)[3],
+                                int rays_num,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                BVHTree_RayCastPacketCallback packet_callback,
+                                void *userdata);
+
 /**
  * Calls the callback for every ray intersection
  *
@@ -343,6 +425,7 @@ extern const float bvhtree_kdop_axes[13][3];
 
 #  include "BLI_function_ref.hh"
 #  include "BLI_math_vector.hh"
+#  include "BLI_span.hh"
 
 namespace blender {
 
@@ -369,6 +452,27 @@ inline void BLI_bvhtree_ray_cast_all_cpp(const BVHTree &tree,
       &fn);
 }
 
+inline void BLI_bvhtree_ray_cast_batch_cpp(const BVHTree &tree,
+                                           const Span<float3> origins,
+                                           const Span<float3> directions,
+                                           const float radius,
+                                           MutableSpan<BVHTreeRayHit> hits,
+                                           BVHTree_RayCastCallback callback,
+                                           BVHTree_RayCastPacketCallback packet_callback,
+                                           void *userdata)
+{
+  BLI_assert(origins.size() == directions.size() && origins.size() == hits.size());
+  BLI_bvhtree_ray_cast_batch(&tree,
+                             reinterpret_cast<const float(*)[3]>(origins.data()),
+                             reinterpret_cast<const float(*)[3]>(directions.data()),
+                             int(origins.size()),
+                             radius,
+                             hits.data(),
+                             callback,
+                             packet_callback,
+                             userdata);
+}
+
 using BVHTree_RangeQuery_CPP = FunctionRef<void(int index, const float3 &co, float dist_sq)>;
 
 inline void BLI_bvhtree_range_query_cpp(const BVHTree &tree,
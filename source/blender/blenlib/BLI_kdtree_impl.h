@@ -28,6 +28,11 @@ typedef struct KDTreeNearest {
 KDTree *BLI_kdtree_nd_(new)(unsigned int maxsize);
 void BLI_kdtree_nd_(free)(KDTree *tree);
 void BLI_kdtree_nd_(balance)(KDTree *tree) ATTR_NONNULL(1);
+/**
+ * A version of #BLI_kdtree_3d_balance which stores the nodes in depth first order for faster
+ * queries, optionally balancing the sub-trees on multiple threads.
+ */
+void BLI_kdtree_nd_(balance_ex)(KDTree *tree, bool use_threading) ATTR_NONNULL(1);
 
 void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS]) ATTR_NONNULL(1, 3);
 int BLI_kdtree_nd_(find_nearest)(const KDTree *tree,
@@ -57,6 +62,29 @@ void BLI_kdtree_nd_(range_search_cb)(
     bool (*search_cb)(void *user_data, int index, const float co[KD_DIMS], float dist_sq),
     void *user_data);
 
+/**
+ * Batch versions of the queries above, for many query coordinates at once.
+ * The queries are sorted spatially and run on multiple threads.
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        int co_len,
+                                        KDTreeNearest *r_nearest) ATTR_NONNULL(1, 2, 4);
+void BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          int co_len,
+                                          KDTreeNearest *r_nearest,
+                                          uint nearest_len_capacity,
+                                          int *r_nearest_len) ATTR_NONNULL(1, 2, 4);
+void BLI_kdtree_nd_(range_search_batch_cb)(
+    const KDTree *tree,
+    const float (*co)[KD_DIMS],
+    int co_len,
+    float range,
+    bool (*search_cb)(
+        void *user_data, int co_index, int index, const float co[KD_DIMS], float dist_sq),
+    void *user_data) ATTR_NONNULL(1, 2, 5);
+
 int BLI_kdtree_nd_(calc_duplicates_fast)(const KDTree *tree,
                                          float range,
                                          bool use_index_order,
@@ -106,6 +134,29 @@ inline void BLI_kdtree_nd_(range_search_cb_cpp)(const KDTree *tree,
       const_cast<Fn *>(&fn));
 }
 
+template<typename Fn>
+inline void BLI_kdtree_nd_(range_search_batch_cb_cpp)(const KDTree *tree,
+                                                      const float (*co)[KD_DIMS],
+                                                      int co_len,
+                                                      float distance,
+                                                      const Fn &fn)
+{
+  BLI_kdtree_nd_(range_search_batch_cb)(
+      tree,
+      co,
+      co_len,
+      distance,
+      [](void *user_data,
+         const int co_index,
+         const int index,
+         const float *co,
+         const float dist_sq) {
+        const Fn &fn = *static_cast<const Fn *>(user_data);
+        return fn(co_index, index, co, dist_sq);
+      },
+      const_cast<Fn *>(&fn));
+}
+
 template<typename Fn>
 inline int BLI_kdtree_nd_(find_nearest_cb_cpp)(const KDTree *tree,
                                                const float co[KD_DIMS],
@@ -14,12 +14,17 @@
  *
  * - Ray-cast:
  *   #BLI_bvhtree_ray_cast, #BVHRayCastData
+ * - Ray-cast of packets of rays:
+ *   #BLI_bvhtree_ray_cast_batch, #BVHRayPacketData
  * - Nearest point on surface:
  *   #BLI_bvhtree_find_nearest, #BVHNearestData
  * - Overlapping 2 trees:
  *   #BLI_bvhtree_overlap, #BVHOverlapData_Shared, #BVHOverlapData_Thread
  * - Range Query:
  *   #BLI_bvhtree_range_query
+ *
+ * Trees of axis aligned bounding boxes (`axis == 6`) are additionally stored as a flattened
+ * tree of wide nodes (#BVHWideNode) when balanced, which is used by the most common queries.
  */
 
 #include "MEM_guardedalloc.h"
@@ -43,6 +48,9 @@
 /* Check tree is valid. */
 // #define USE_VERIFY_TREE
 
+/* Store trees of axis aligned bounding boxes in wide nodes as well, see #BVHWideNode. */
+#define USE_WIDE_NODES
+
 #define MAX_TREETYPE 32
 
 /* Setting zero so we can catch bugs in BLI_task/KDOPBVH.
@@ -54,6 +62,13 @@
 #  define KDOPBVH_THREAD_LEAF_THRESHOLD 1024
 #endif
 
+/* Number of children of a #BVHWideNode, matching the number of floats in a SIMD register. */
+#ifdef __AVX__
+#  define BVH_WIDE_WIDTH 8
+#else
+#  define BVH_WIDE_WIDTH 4
+#endif
+
 /* -------------------------------------------------------------------- */
 /** \name Struct Definitions
  * \{ */
@@ -72,7 +87,34 @@ typedef struct BVHNode {
   char main_axis; /* Axis used to split this node */
 } BVHNode;
 
-/* keep under 26 bytes for speed purposes */
+/**
+ * Node of the flattened layout used for trees of axis aligned bounding boxes.
+ *
+ * The bounds of all children are stored next to each other for every axis, so a point, ray or
+ * box can be tested against all children at once without chasing pointers. The tests are written
+ * as plain loops over the children which compilers turn into SIMD instructions.
+ * Unused children have inverted bounds.
+ */
+typedef struct BVHWideNode {
+  /** Bounds of the children, in the same order as #BVHNode.bv (X min, X max, Y min...). */
+  float bv[6][BVH_WIDE_WIDTH];
+  /**
+   * Index of the child in #BVHWideTree.nodes, or for leafs `-1 - i`,
+   * with `i` the index of the leaf in #BVHTree.nodearray.
+   */
+  int children[BVH_WIDE_WIDTH];
+  int node_num;
+} BVHWideNode;
+
+typedef struct BVHWideTree {
+  /** Root first, children always have a greater index than their parent. */
+  BVHWideNode *nodes;
+  /** The node whose bounds are stored for every child of the wide nodes, used to update them. */
+  const BVHNode **child_nodes;
+  int nodes_num;
+} BVHWideTree;
+
+/* Keep small for speed purposes, the size is checked below. */
 struct BVHTree {
   BVHNode **nodes;
   BVHNode *nodearray;  /* pre-alloc branch nodes */
@@ -84,11 +126,12 @@ struct BVHTree {
   axis_t start_axis, stop_axis; /* bvhtree_kdop_axes array indices according to axis */
   axis_t axis;                  /* KDOP type (6 => OBB, 7 => AABB, ...) */
   char tree_type;               /* type of tree (4 => quad-tree). */
+  BVHWideTree *wide;            /* Optional flattened layout of the balanced tree. */
 };
 
 /* optimization, ensure we stay small */
-BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
-                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
+BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 56) ||
+                      (sizeof(void *) == 4 && sizeof(BVHTree) <= 36),
                   "over sized")
 
 /* avoid duplicating vars in BVHOverlapData_Thread */
@@ -96,6 +139,8 @@ typedef struct BVHOverlapData_Shared {
   const BVHTree *tree1, *tree2;
   axis_t start_axis, stop_axis;
   bool use_self;
+  /* Traverse the wide nodes of both trees. */
+  bool use_wide;
 
   /* use for callbacks */
   BVHTree_OverlapCallback callback;
@@ -423,11 +468,20 @@ static char get_largest_axis(const float *bv)
   return 5; /* max z axis */
 }
 
+/* Half the surface area of the bounding volume along the first three axes, like
+ * #get_largest_axis. */
+static float bvhtree_node_surface_area(const BVHNode *node)
+{
+  const float *bv = node->bv;
+  const float size[3] = {bv[1] - bv[0], bv[3] - bv[2], bv[5] - bv[4]};
+  return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
 /**
  * bottom-up update of bvh node BV
  * join the children on the parent BV.
  */
-static void node_join(BVHTree *tree, BVHNode *node)
+static void node_join(const BVHTree *tree, BVHNode *node)
 {
   int i;
   axis_t axis_iter;
@@ -654,6 +708,27 @@ static int implicit_needed_branches(int tree_type, int leafs)
   return max_ii(1, (leafs + tree_type - 3) / (tree_type - 1));
 }
 
+/* Enough levels for any number of leafs of a binary tree. */
+#define BVH_LEVELS_MAX 32
+
+/**
+ * Range of branches of every level of the implicit tree, from the root down. Branches are numbered
+ * from 1 like in #non_recursive_bvh_div_nodes. Returns the number of levels.
+ */
+static int implicit_tree_levels(int tree_type, int branches_num, int r_levels[BVH_LEVELS_MAX][2])
+{
+  /* this value is 0 (on binary trees) and negative on the others */
+  const int tree_offset = 2 - tree_type;
+  int levels_num = 0;
+  for (int i = 1; i <= branches_num; i = i * tree_type + tree_offset) {
+    BLI_assert(levels_num < BVH_LEVELS_MAX);
+    r_levels[levels_num][0] = i;
+    r_levels[levels_num][1] = min_ii(i * tree_type + tree_offset, branches_num + 1);
+    levels_num++;
+  }
+  return levels_num;
+}
+
 /**
  * This function handles the problem of "sorting" the leafs (along the split_axis).
  *
@@ -694,6 +769,9 @@ typedef struct BVHDivNodesData {
   int depth;
   int i;
   int first_of_next_level;
+
+  /* The leafs are already in order, see #bvhtree_sort_leafs_morton. */
+  bool leafs_sorted;
 } BVHDivNodesData;
 
 static void non_recursive_bvh_div_nodes_task_cb(void *__restrict userdata,
@@ -705,34 +783,39 @@ static void non_recursive_bvh_div_nodes_task_cb(void *__restrict userdata,
   int k;
   const int parent_level_index = j - data->i;
   BVHNode *parent = &data->branches_array[j];
-  int nth_positions[MAX_TREETYPE + 1];
-  char split_axis;
-
-  int parent_leafs_begin = implicit_leafs_index(data->data, data->depth, parent_level_index);
-  int parent_leafs_end = implicit_leafs_index(data->data, data->depth, parent_level_index + 1);
-
-  /* This calculates the bounding box of this branch
-   * and chooses the largest axis as the axis to divide leafs */
-  refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
-  split_axis = get_largest_axis(parent->bv);
-
-  /* Save split axis (this can be used on ray-tracing to speedup the query time) */
-  parent->main_axis = split_axis / 2;
-
-  /* Split the children along the split_axis, NOTE: its not needed to sort the whole leafs array
-   * Only to assure that the elements are partitioned on a way that each child takes the elements
-   * it would take in case the whole array was sorted.
-   * Split_leafs takes care of that "sort" problem. */
-  nth_positions[0] = parent_leafs_begin;
-  nth_positions[data->tree_type] = parent_leafs_end;
-  for (k = 1; k < data->tree_type; k++) {
-    const int child_index = j * data->tree_type + data->tree_offset + k;
-    /* child level index */
-    const int child_level_index = child_index - data->first_of_next_level;
-    nth_positions[k] = implicit_leafs_index(data->data, data->depth + 1, child_level_index);
-  }
 
-  split_leafs(data->leafs_array, nth_positions, data->tree_type, split_axis);
+  /* Sorted leafs only need the children to be set up, the bounding volumes of the branches are
+   * joined from the leafs up afterwards. */
+  if (!data->leafs_sorted) {
+    int nth_positions[MAX_TREETYPE + 1];
+    char split_axis;
+
+    int parent_leafs_begin = implicit_leafs_index(data->data, data->depth, parent_level_index);
+    int parent_leafs_end = implicit_leafs_index(data->data, data->depth, parent_level_index + 1);
+
+    /* This calculates the bounding box of this branch
+     * and chooses the largest axis as the axis to divide leafs */
+    refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+    split_axis = get_largest_axis(parent->bv);
+
+    /* Save split axis (this can be used on ray-tracing to speedup the query time) */
+    parent->main_axis = split_axis / 2;
+
+    /* Split the children along the split_axis, NOTE: its not needed to sort the whole leafs
+     * array Only to assure that the elements are partitioned on a way that each child takes the
+     * elements it would take in case the whole array was sorted.
+     * Split_leafs takes care of that "sort" problem. */
+    nth_positions[0] = parent_leafs_begin;
+    nth_positions[data->tree_type] = parent_leafs_end;
+    for (k = 1; k < data->tree_type; k++) {
+      const int child_index = j * data->tree_type + data->tree_offset + k;
+      /* child level index */
+      const int child_level_index = child_index - data->first_of_next_level;
+      nth_positions[k] = implicit_leafs_index(data->data, data->depth + 1, child_level_index);
+    }
+
+    split_leafs(data->leafs_array, nth_positions, data->tree_type, split_axis);
+  }
 
   /* Setup `children` and `node_num` counters
    * Not really needed but currently most of BVH code
@@ -762,6 +845,38 @@ static void non_recursive_bvh_div_nodes_task_cb(void *__restrict userdata,
   parent->node_num = (char)k;
 }
 
+/* Center of the bounding volume along the first three axes of the tree. */
+static void bvh_node_center(const BVHTree *tree, const BVHNode *node, float r_center[3])
+{
+  const float *bv = node->bv + (tree->start_axis * 2);
+  for (int axis = 0; axis < 3; axis++) {
+    r_center[axis] = (bv[2 * axis] + bv[2 * axis + 1]) * 0.5f;
+  }
+}
+
+static void bvh_join_nodes_task_cb(void *__restrict userdata,
+                                   const int j,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHDivNodesData *data = userdata;
+  BVHNode *node = &data->branches_array[j];
+  node_join(data->tree, node);
+
+  /* Traversals expect the children to be in order along the main axis. Sorted leafs are in order
+   * along the axis they were split on, where the first and last child are furthest apart. */
+  float center_first[3], center_last[3];
+  bvh_node_center(data->tree, node->children[0], center_first);
+  bvh_node_center(data->tree, node->children[node->node_num - 1], center_last);
+  sub_v3_v3(center_last, center_first);
+  int axis = 0;
+  for (int i = 1; i < 3; i++) {
+    if (center_last[i] > center_last[axis]) {
+      axis = i;
+    }
+  }
+  node->main_axis = (char)axis;
+}
+
 /**
  * This functions builds an optimal implicit tree from the given leafs.
  * Where optimal stands for:
@@ -783,7 +898,8 @@ static void non_recursive_bvh_div_nodes_task_cb(void *__restrict userdata,
 static void non_recursive_bvh_div_nodes(const BVHTree *tree,
                                         BVHNode *branches_array,
                                         BVHNode **leafs_array,
-                                        int leafs_num)
+                                        int leafs_num,
+                                        const bool leafs_sorted)
 {
   int i;
 
@@ -825,13 +941,18 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
       .first_of_next_level = 0,
       .depth = 0,
       .i = 0,
+      .leafs_sorted = leafs_sorted,
   };
 
+  int levels[BVH_LEVELS_MAX][2];
+  const int levels_num = implicit_tree_levels(tree_type, branches_num, levels);
+
   /* Loop tree levels (log N) loops */
-  for (i = 1, depth = 1; i <= branches_num; i = i * tree_type + tree_offset, depth++) {
+  for (depth = 1; depth <= levels_num; depth++) {
+    i = levels[depth - 1][0];
     const int first_of_next_level = i * tree_type + tree_offset;
     /* index of last branch on this level */
-    const int i_stop = min_ii(first_of_next_level, branches_num + 1);
+    const int i_stop = levels[depth - 1][1];
 
     /* Loop all branches on this level */
     cb_data.first_of_next_level = first_of_next_level;
@@ -852,6 +973,361 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
       }
     }
   }
+
+  if (leafs_sorted) {
+    /* Join the bounding volumes level by level, starting at the deepest one. Children always have
+     * a greater index than their parent, so the branches of a level only depend on later ones. */
+    for (int level = levels_num - 1; level >= 0; level--) {
+      TaskParallelSettings settings;
+      BLI_parallel_range_settings_defaults(&settings);
+      settings.use_threading = (leafs_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+      settings.min_iter_per_thread = 1024;
+      BLI_task_parallel_range(
+          levels[level][0], levels[level][1], &cb_data, bvh_join_nodes_task_cb, &settings);
+    }
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Morton Order
+ *
+ * For #BVH_BUILD_QUALITY_FAST the leafs are sorted along a Z-order curve through the centers of
+ * their bounding volumes once, after which every branch of the implicit tree gets a contiguous
+ * range of the sorted leafs. This avoids the partitioning of the leafs at every branch, which
+ * can only run on a single thread for the first levels of the tree.
+ *
+ * All steps run in parallel: the Morton codes are sorted with a radix sort on chunks of leafs.
+ * \{ */
+
+/* Bits of the Morton code of every axis, all of them fit in a 32 bit integer. */
+#define BVH_MORTON_BITS 10
+/* Bits sorted in every pass of the radix sort. */
+#define BVH_RADIX_BITS 8
+#define BVH_RADIX_SIZE (1 << BVH_RADIX_BITS)
+#define BVH_RADIX_CHUNK_SIZE 16384
+
+typedef struct BVHMortonSortData {
+  const BVHTree *tree;
+  int leafs_num;
+  int chunks_num;
+
+  /* Transform of the centers of the leafs to the cells of the Z-order curve. */
+  float bounds_min[3];
+  float bounds_scale[3];
+
+  /* Leafs and their codes, sorted into the other buffer in every pass. */
+  BVHNode **leafs, **leafs_other;
+  uint *codes, *codes_other;
+
+  /* Offset of every digit for every chunk. */
+  int (*chunk_offsets)[BVH_RADIX_SIZE];
+  int shift;
+} BVHMortonSortData;
+
+typedef struct BVHMortonBounds {
+  float min[3];
+  float max[3];
+} BVHMortonBounds;
+
+static void bvh_morton_bounds_task_cb(void *__restrict userdata,
+                                      const int i,
+                                      const TaskParallelTLS *__restrict tls)
+{
+  BVHMortonSortData *data = userdata;
+  BVHMortonBounds *bounds = tls->userdata_chunk;
+  float center[3];
+  bvh_node_center(data->tree, data->leafs[i], center);
+  minmax_v3v3_v3(bounds->min, bounds->max, center);
+}
+
+static void bvh_morton_bounds_reduce(const void *__restrict UNUSED(userdata),
+                                     void *__restrict chunk_join,
+                                     void *__restrict chunk)
+{
+  BVHMortonBounds *bounds_join = chunk_join;
+  const BVHMortonBounds *bounds = chunk;
+  minmax_v3v3_v3(bounds_join->min, bounds_join->max, bounds->min);
+  minmax_v3v3_v3(bounds_join->min, bounds_join->max, bounds->max);
+}
+
+static void bvh_morton_code_task_cb(void *__restrict userdata,
+                                    const int i,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHMortonSortData *data = userdata;
+  const float cells_max = (float)((1 << BVH_MORTON_BITS) - 1);
+
+  float center[3];
+  bvh_node_center(data->tree, data->leafs[i], center);
+  uint cell[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const float co_cell = (center[axis] - data->bounds_min[axis]) * data->bounds_scale[axis];
+    cell[axis] = (uint)clamp_f(co_cell, 0.0f, cells_max);
+  }
+
+  uint code = 0;
+  for (int bit = BVH_MORTON_BITS - 1; bit >= 0; bit--) {
+    for (int axis = 0; axis < 3; axis++) {
+      code = (code << 1) | ((cell[axis] >> bit) & 1u);
+    }
+  }
+  data->codes[i] = code;
+}
+
+static void bvh_radix_count_task_cb(void *__restrict userdata,
+                                    const int chunk,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHMortonSortData *data = userdata;
+  int *counts = data->chunk_offsets[chunk];
+  memset(counts, 0, sizeof(*data->chunk_offsets));
+
+  const int begin = chunk * BVH_RADIX_CHUNK_SIZE;
+  const int end = min_ii(begin + BVH_RADIX_CHUNK_SIZE, data->leafs_num);
+  for (int i = begin; i < end; i++) {
+    counts[(data->codes[i] >> data->shift) & (BVH_RADIX_SIZE - 1)]++;
+  }
+}
+
+static void bvh_radix_scatter_task_cb(void *__restrict userdata,
+                                      const int chunk,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHMortonSortData *data = userdata;
+  int *offsets = data->chunk_offsets[chunk];
+
+  const int begin = chunk * BVH_RADIX_CHUNK_SIZE;
+  const int end = min_ii(begin + BVH_RADIX_CHUNK_SIZE, data->leafs_num);
+  for (int i = begin; i < end; i++) {
+    const int dst = offsets[(data->codes[i] >> data->shift) & (BVH_RADIX_SIZE - 1)]++;
+    data->codes_other[dst] = data->codes[i];
+    data->leafs_other[dst] = data->leafs[i];
+  }
+}
+
+/** Sort the leafs of the tree by the Morton code of their centers. */
+static void bvhtree_sort_leafs_morton(BVHTree *tree)
+{
+  const int leafs_num = tree->leaf_num;
+
+  BVHMortonSortData data;
+  data.tree = tree;
+  data.leafs_num = leafs_num;
+  data.chunks_num = (leafs_num + BVH_RADIX_CHUNK_SIZE - 1) / BVH_RADIX_CHUNK_SIZE;
+  data.leafs = tree->nodes;
+  data.leafs_other = MEM_mallocN(sizeof(BVHNode *) * (size_t)leafs_num, __func__);
+  data.codes = MEM_mallocN(sizeof(uint) * (size_t)leafs_num, __func__);
+  data.codes_other = MEM_mallocN(sizeof(uint) * (size_t)leafs_num, __func__);
+  data.chunk_offsets = MEM_mallocN(sizeof(*data.chunk_offsets) * (size_t)data.chunks_num,
+                                   __func__);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (leafs_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+
+  BVHMortonBounds bounds;
+  INIT_MINMAX(bounds.min, bounds.max);
+  settings.userdata_chunk = &bounds;
+  settings.userdata_chunk_size = sizeof(bounds);
+  settings.func_reduce = bvh_morton_bounds_reduce;
+  BLI_task_parallel_range(0, leafs_num, &data, bvh_morton_bounds_task_cb, &settings);
+  settings.userdata_chunk = NULL;
+  settings.userdata_chunk_size = 0;
+  settings.func_reduce = NULL;
+
+  /* Use cubic cells, so that the curve doesn't favor splitting along thin axes. */
+  float size[3];
+  sub_v3_v3v3(size, bounds.max, bounds.min);
+  const float size_max = max_fff(size[0], size[1], size[2]);
+  copy_v3_v3(data.bounds_min, bounds.min);
+  copy_v3_fl(data.bounds_scale,
+             (size_max > FLT_EPSILON) ? (float)(1 << BVH_MORTON_BITS) / size_max : 0.0f);
+  BLI_task_parallel_range(0, leafs_num, &data, bvh_morton_code_task_cb, &settings);
+
+  /* Stable radix sort, an even number of passes leaves the result in the tree nodes. */
+  BLI_STATIC_ASSERT(((3 * BVH_MORTON_BITS + BVH_RADIX_BITS - 1) / BVH_RADIX_BITS) % 2 == 0,
+                    "odd number of radix sort passes")
+  settings.min_iter_per_thread = 1;
+  for (data.shift = 0; data.shift < 3 * BVH_MORTON_BITS; data.shift += BVH_RADIX_BITS) {
+    BLI_task_parallel_range(0, data.chunks_num, &data, bvh_radix_count_task_cb, &settings);
+
+    /* Elements of a digit are placed after the ones of smaller digits, and for the same digit,
+     * after the ones of previous chunks. */
+    int offset = 0;
+    for (int digit = 0; digit < BVH_RADIX_SIZE; digit++) {
+      for (int chunk = 0; chunk < data.chunks_num; chunk++) {
+        const int count = data.chunk_offsets[chunk][digit];
+        data.chunk_offsets[chunk][digit] = offset;
+        offset += count;
+      }
+    }
+
+    BLI_task_parallel_range(0, data.chunks_num, &data, bvh_radix_scatter_task_cb, &settings);
+
+    SWAP(BVHNode **, data.leafs, data.leafs_other);
+    SWAP(uint *, data.codes, data.codes_other);
+  }
+  BLI_assert(data.leafs == tree->nodes);
+
+  MEM_freeN(data.leafs_other);
+  MEM_freeN(data.codes);
+  MEM_freeN(data.codes_other);
+  MEM_freeN(data.chunk_offsets);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Wide Nodes
+ *
+ * The wide nodes are built from the balanced tree by pulling the children of branches up into
+ * their parents as long as they fit, which flattens binary and quad trees into wider nodes.
+ * The bounds are copied from the tree nodes, so updating the tree updates the wide nodes too.
+ * \{ */
+
+#ifdef USE_WIDE_NODES
+
+static bool bvhtree_wide_supported(const BVHTree *tree)
+{
+  return tree->axis == 6 && tree->tree_type <= BVH_WIDE_WIDTH && tree->leaf_num > 0;
+}
+
+/**
+ * Gather the nodes which become the children of the wide node built from the given node.
+ * The children of the root are never collapsed, so that the children of the wide root match
+ * the ones of the tree root, which the overlap query uses to split work between threads.
+ */
+static int bvhtree_wide_collect_children(const BVHNode *node,
+                                         const bool collapse,
+                                         const BVHNode *r_children[BVH_WIDE_WIDTH])
+{
+  int children_num = 0;
+  for (int i = 0; i < node->node_num; i++) {
+    r_children[children_num++] = node->children[i];
+  }
+
+  while (collapse) {
+    /* Open the largest branch whose children fit. */
+    int best = -1;
+    float best_area = -1.0f;
+    for (int i = 0; i < children_num; i++) {
+      const BVHNode *child = r_children[i];
+      if (child->node_num != 0 && children_num - 1 + child->node_num <= BVH_WIDE_WIDTH) {
+        const float area = bvhtree_node_surface_area(child);
+        if (area > best_area) {
+          best = i;
+          best_area = area;
+        }
+      }
+    }
+    if (best == -1) {
+      break;
+    }
+
+    /* Keep the order of the children, it follows the split axes. */
+    const BVHNode *branch = r_children[best];
+    memmove(&r_children[best + branch->node_num],
+            &r_children[best + 1],
+            sizeof(*r_children) * (size_t)(children_num - best - 1));
+    for (int i = 0; i < branch->node_num; i++) {
+      r_children[best + i] = branch->children[i];
+    }
+    children_num += branch->node_num - 1;
+  }
+  return children_num;
+}
+
+static int bvhtree_wide_build_recursive(const BVHTree *tree,
+                                        BVHWideTree *wide,
+                                        const BVHNode *node,
+                                        const bool is_root)
+{
+  const int wide_index = wide->nodes_num++;
+  BVHWideNode *wide_node = &wide->nodes[wide_index];
+  const BVHNode **children = &wide->child_nodes[wide_index * BVH_WIDE_WIDTH];
+
+  wide_node->node_num = bvhtree_wide_collect_children(node, !is_root, children);
+  for (int i = 0; i < wide_node->node_num; i++) {
+    if (children[i]->node_num == 0) {
+      wide_node->children[i] = -1 - (int)(children[i] - tree->nodearray);
+    }
+    else {
+      wide_node->children[i] = bvhtree_wide_build_recursive(tree, wide, children[i], false);
+    }
+  }
+  for (int i = wide_node->node_num; i < BVH_WIDE_WIDTH; i++) {
+    wide_node->children[i] = 0;
+    children[i] = NULL;
+  }
+  return wide_index;
+}
+
+#endif /* USE_WIDE_NODES */
+
+static void bvhtree_wide_update_task_cb(void *__restrict userdata,
+                                        const int i,
+                                        const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHWideTree *wide = userdata;
+  BVHWideNode *wide_node = &wide->nodes[i];
+  const BVHNode **children = &wide->child_nodes[i * BVH_WIDE_WIDTH];
+
+  for (int j = 0; j < BVH_WIDE_WIDTH; j++) {
+    for (int axis = 0; axis < 3; axis++) {
+      wide_node->bv[2 * axis][j] = children[j] ? children[j]->bv[2 * axis] : FLT_MAX;
+      wide_node->bv[2 * axis + 1][j] = children[j] ? children[j]->bv[2 * axis + 1] : -FLT_MAX;
+    }
+  }
+}
+
+/** Copy the bounds of the tree nodes into the wide nodes. */
+static void bvhtree_wide_update(const BVHTree *tree)
+{
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (tree->leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(
+      0, tree->wide->nodes_num, tree->wide, bvhtree_wide_update_task_cb, &settings);
+}
+
+static void bvhtree_wide_free(BVHTree *tree)
+{
+  if (tree->wide) {
+    MEM_freeN(tree->wide->nodes);
+    MEM_freeN((void *)tree->wide->child_nodes);
+    MEM_freeN(tree->wide);
+    tree->wide = NULL;
+  }
+}
+
+#ifdef USE_WIDE_NODES
+
+static void bvhtree_wide_build(BVHTree *tree)
+{
+  /* The tree may be balanced again, the old layout references the previous branches. */
+  bvhtree_wide_free(tree);
+
+  /* Every wide node is built from a different branch. */
+  const size_t nodes_max = (size_t)tree->branch_num;
+
+  BVHWideTree *wide = MEM_callocN(sizeof(BVHWideTree), __func__);
+  wide->nodes = MEM_mallocN_aligned(sizeof(BVHWideNode) * nodes_max, 32, "BVHWideNodes");
+  wide->child_nodes = MEM_mallocN(sizeof(BVHNode *) * BVH_WIDE_WIDTH * nodes_max,
+                                  "BVHWideChildNodes");
+
+  bvhtree_wide_build_recursive(tree, wide, tree->nodes[tree->leaf_num], true);
+
+  tree->wide = wide;
+  bvhtree_wide_update(tree);
+}
+
+#endif /* USE_WIDE_NODES */
+
+BLI_INLINE const BVHNode *bvhtree_wide_leaf(const BVHTree *tree, const int child)
+{
+  return &tree->nodearray[-1 - child];
 }
 
 /** \} */
@@ -935,6 +1411,7 @@ fail:
 void BLI_bvhtree_free(BVHTree *tree)
 {
   if (tree) {
+    bvhtree_wide_free(tree);
     MEM_SAFE_FREE(tree->nodes);
     MEM_SAFE_FREE(tree->nodearray);
     MEM_SAFE_FREE(tree->nodebv);
@@ -943,7 +1420,7 @@ void BLI_bvhtree_free(BVHTree *tree)
   }
 }
 
-void BLI_bvhtree_balance(BVHTree *tree)
+void BLI_bvhtree_balance_ex(BVHTree *tree, const eBVHBuildQuality quality)
 {
   BVHNode **leafs_array = tree->nodes;
 
@@ -951,9 +1428,14 @@ void BLI_bvhtree_balance(BVHTree *tree)
    * (some big bug goes here if its being called more than once per tree) */
   BLI_assert(tree->branch_num == 0);
 
+  const bool use_morton = (quality == BVH_BUILD_QUALITY_FAST) && (tree->leaf_num > 1);
+  if (use_morton) {
+    bvhtree_sort_leafs_morton(tree);
+  }
+
   /* Build the implicit tree */
   non_recursive_bvh_div_nodes(
-      tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num);
+      tree, tree->nodearray + (tree->leaf_num - 1), leafs_array, tree->leaf_num, use_morton);
 
   /* current code expects the branches to be linked to the nodes array
    * we perform that linkage here */
@@ -966,6 +1448,15 @@ void BLI_bvhtree_balance(BVHTree *tree)
   build_skip_links(tree, tree->nodes[tree->leaf_num], NULL, NULL);
 #endif
 
+#ifdef USE_WIDE_NODES
+  if (bvhtree_wide_supported(tree)) {
+    bvhtree_wide_build(tree);
+  }
+  else {
+    bvhtree_wide_free(tree);
+  }
+#endif
+
 #ifdef USE_VERIFY_TREE
   bvhtree_verify(tree);
 #endif
@@ -975,6 +1466,11 @@ void BLI_bvhtree_balance(BVHTree *tree)
 #endif
 }
 
+void BLI_bvhtree_balance(BVHTree *tree)
+{
+  BLI_bvhtree_balance_ex(tree, BVH_BUILD_QUALITY_HIGH);
+}
+
 static void bvhtree_node_inflate(const BVHTree *tree, BVHNode *node, const float dist)
 {
   axis_t axis_iter;
@@ -1027,19 +1523,115 @@ bool BLI_bvhtree_update_node(
   return true;
 }
 
+static void bvhtree_update_branch_task_cb(void *__restrict userdata,
+                                          const int i,
+                                          const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHTree *tree = userdata;
+  /* Branches of the implicit tree are numbered from 1. */
+  node_join(tree, tree->nodes[tree->leaf_num + i - 1]);
+}
+
 void BLI_bvhtree_update_tree(BVHTree *tree)
 {
   /* Update bottom=>top
    * TRICKY: the way we build the tree all the children have an index greater than the parent
-   * This allows us todo a bottom up update by starting on the bigger numbered branch. */
+   * This allows us todo a bottom up update by starting on the deepest level of branches,
+   * the branches of a level are independent of each other and are updated in parallel. */
+  int levels[BVH_LEVELS_MAX][2];
+  const int levels_num = implicit_tree_levels(tree->tree_type, tree->branch_num, levels);
 
-  BVHNode **root = tree->nodes + tree->leaf_num;
-  BVHNode **index = tree->nodes + tree->leaf_num + tree->branch_num - 1;
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (tree->leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+  for (int level = levels_num - 1; level >= 0; level--) {
+    BLI_task_parallel_range(
+        levels[level][0], levels[level][1], tree, bvhtree_update_branch_task_cb, &settings);
+  }
 
-  for (; index >= root; index--) {
-    node_join(tree, *index);
+  if (tree->wide) {
+    bvhtree_wide_update(tree);
   }
 }
+
+typedef struct BVHRefitData {
+  const BVHTree *tree;
+  BVHTree_RefitLeafCallback leaf_cb;
+  void *userdata;
+} BVHRefitData;
+
+static void bvhtree_refit_leaf_task_cb(void *__restrict userdata,
+                                       const int i,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRefitData *data = userdata;
+  const BVHTree *tree = data->tree;
+  BVHNode *node = &tree->nodearray[i];
+
+  float co[BVH_REFIT_POINTS_MAX][3];
+  const int points_num = data->leaf_cb(data->userdata, node->index, co);
+  BLI_assert(IN_RANGE_INCL(points_num, 1, BVH_REFIT_POINTS_MAX));
+
+  create_kdop_hull(tree, node, co[0], points_num, 0);
+  bvhtree_node_inflate(tree, node, tree->epsilon);
+}
+
+void BLI_bvhtree_refit(BVHTree *tree, BVHTree_RefitLeafCallback leaf_cb, void *userdata)
+{
+  BVHRefitData data = {
+      .tree = tree,
+      .leaf_cb = leaf_cb,
+      .userdata = userdata,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (tree->leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(0, tree->leaf_num, &data, bvhtree_refit_leaf_task_cb, &settings);
+
+  BLI_bvhtree_update_tree(tree);
+}
+
+static void bvhtree_sah_cost_task_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict tls)
+{
+  const BVHTree *tree = userdata;
+  double *area_sum = tls->userdata_chunk;
+  *area_sum += (double)bvhtree_node_surface_area(tree->nodes[tree->leaf_num + i]);
+}
+
+static void bvhtree_sah_cost_reduce(const void *__restrict UNUSED(userdata),
+                                    void *__restrict chunk_join,
+                                    void *__restrict chunk)
+{
+  *(double *)chunk_join += *(const double *)chunk;
+}
+
+float BLI_bvhtree_sah_cost(const BVHTree *tree)
+{
+  if (tree->branch_num == 0) {
+    return 0.0f;
+  }
+  const float root_area = bvhtree_node_surface_area(tree->nodes[tree->leaf_num]);
+  if (root_area <= 0.0f) {
+    return 0.0f;
+  }
+
+  double area_sum = 0.0;
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (tree->leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1024;
+  settings.userdata_chunk = &area_sum;
+  settings.userdata_chunk_size = sizeof(area_sum);
+  settings.func_reduce = bvhtree_sah_cost_reduce;
+  BLI_task_parallel_range(0, tree->branch_num, (void *)tree, bvhtree_sah_cost_task_cb, &settings);
+
+  return (float)(area_sum / (double)root_area);
+}
 int BLI_bvhtree_get_len(const BVHTree *tree)
 {
   return tree->leaf_num;
@@ -1297,6 +1889,96 @@ static void tree_overlap_invoke_traverse_self(BVHOverlapData_Thread *data_thread
   }
 }
 
+BLI_INLINE void wide_node_child_bv(const BVHWideNode *node, const int i, float r_bv[6])
+{
+  for (int axis = 0; axis < 6; axis++) {
+    r_bv[axis] = node->bv[axis][i];
+  }
+}
+
+/** Bit mask of the children of a wide node which overlap the given bounding box. */
+static uint wide_overlap_test(const BVHWideNode *node, const float bv[6])
+{
+  uint mask = 0;
+  for (int i = 0; i < BVH_WIDE_WIDTH; i++) {
+    const bool overlap = (node->bv[0][i] <= bv[1]) & (bv[0] <= node->bv[1][i]) &
+                         (node->bv[2][i] <= bv[3]) & (bv[2] <= node->bv[3][i]) &
+                         (node->bv[4][i] <= bv[5]) & (bv[4] <= node->bv[5][i]);
+    mask |= (uint)overlap << i;
+  }
+  return mask & ((1u << node->node_num) - 1);
+}
+
+/**
+ * Overlap traversal of the wide nodes of both trees, for children `i1` of `node1` and `i2` of
+ * `node2` whose bounds overlap. Like #tree_overlap_traverse, the first tree is descended first.
+ */
+static void tree_overlap_traverse_wide(BVHOverlapData_Thread *data_thread,
+                                       const BVHWideNode *node1,
+                                       const int i1,
+                                       const BVHWideNode *node2,
+                                       const int i2)
+{
+  BVHOverlapData_Shared *data = data_thread->shared;
+  const int child1 = node1->children[i1];
+  const int child2 = node2->children[i2];
+  float bv[6];
+
+  if (child1 >= 0) {
+    const BVHWideNode *next1 = &data->tree1->wide->nodes[child1];
+    wide_node_child_bv(node2, i2, bv);
+    uint mask = wide_overlap_test(next1, bv);
+    for (int i = 0; mask; i++, mask >>= 1) {
+      if (mask & 1) {
+        tree_overlap_traverse_wide(data_thread, next1, i, node2, i2);
+      }
+    }
+  }
+  else if (child2 >= 0) {
+    const BVHWideNode *next2 = &data->tree2->wide->nodes[child2];
+    wide_node_child_bv(node1, i1, bv);
+    uint mask = wide_overlap_test(next2, bv);
+    for (int i = 0; mask; i++, mask >>= 1) {
+      if (mask & 1) {
+        tree_overlap_traverse_wide(data_thread, node1, i1, next2, i);
+      }
+    }
+  }
+  else {
+    if (UNLIKELY(data->tree1 == data->tree2 && child1 == child2)) {
+      return;
+    }
+    const int index1 = bvhtree_wide_leaf(data->tree1, child1)->index;
+    const int index2 = bvhtree_wide_leaf(data->tree2, child2)->index;
+    if (data->callback && !data->callback(data->userdata, index1, index2, data_thread->thread)) {
+      return;
+    }
+    BVHTreeOverlap *overlap = BLI_stack_push_r(data_thread->overlap);
+    overlap->indexA = index1;
+    overlap->indexB = index2;
+  }
+}
+
+/**
+ * Overlap of child `i` of the first tree's root with the second tree. The children of the
+ * wide root match the ones of the tree root, see #bvhtree_wide_collect_children.
+ */
+static void tree_overlap_invoke_traverse_wide(BVHOverlapData_Thread *data_thread, const int i)
+{
+  BVHOverlapData_Shared *data = data_thread->shared;
+  const BVHWideNode *root1 = data->tree1->wide->nodes;
+  const BVHWideNode *root2 = data->tree2->wide->nodes;
+
+  float bv[6];
+  wide_node_child_bv(root1, i, bv);
+  uint mask = wide_overlap_test(root2, bv);
+  for (int j = 0; mask; j++, mask >>= 1) {
+    if (mask & 1) {
+      tree_overlap_traverse_wide(data_thread, root1, i, root2, j);
+    }
+  }
+}
+
 int BLI_bvhtree_overlap_thread_num(const BVHTree *tree)
 {
   return (int)MIN2(tree->tree_type, tree->nodes[tree->leaf_num]->node_num);
@@ -1311,7 +1993,10 @@ static void bvhtree_overlap_task_cb(void *__restrict userdata,
 
   const BVHNode *root1 = data_shared->tree1->nodes[data_shared->tree1->leaf_num];
 
-  if (data_shared->use_self) {
+  if (data_shared->use_wide) {
+    tree_overlap_invoke_traverse_wide(data, j);
+  }
+  else if (data_shared->use_self) {
     /* This code matches one outer loop iteration within traverse_self. */
     tree_overlap_invoke_traverse_self(data, root1->children[j]);
 
@@ -1383,6 +2068,8 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
   data_shared.start_axis = start_axis;
   data_shared.stop_axis = stop_axis;
   data_shared.use_self = use_self;
+  /* The wide traversal does not handle self-overlap and the limited number of interactions. */
+  data_shared.use_wide = tree1->wide && tree2->wide && !use_self && !max_interactions;
 
   /* can be NULL */
   data_shared.callback = callback;
@@ -1404,6 +2091,11 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
     settings.min_iter_per_thread = 1;
     BLI_task_parallel_range(0, root_node_len, data, bvhtree_overlap_task_cb, &settings);
   }
+  else if (data_shared.use_wide) {
+    for (j = 0; j < root_node_len; j++) {
+      tree_overlap_invoke_traverse_wide(data, j);
+    }
+  }
   else if (use_self) {
     tree_overlap_invoke_traverse_self(data, root1);
   }
@@ -1537,7 +2229,7 @@ int *BLI_bvhtree_intersect_plane(const BVHTree *tree, float plane[4], uint *r_in
 
 /* Determines the nearest point of the given node BV.
  * Returns the squared distance to that point. */
-static float calc_nearest_point_squared(const float proj[3], BVHNode *node, float nearest[3])
+static float calc_nearest_point_squared(const float proj[3], const BVHNode *node, float nearest[3])
 {
   int i;
   const float *bv = node->bv;
@@ -1606,6 +2298,79 @@ static void dfs_find_nearest_begin(BVHNearestData *data, BVHNode *node)
   dfs_find_nearest_dfs(data, node);
 }
 
+/* Same as #calc_nearest_point_squared for all children of a wide node. */
+static void wide_nearest_point_squared(const float proj[3],
+                                       const BVHWideNode *node,
+                                       float r_dist_sq[BVH_WIDE_WIDTH])
+{
+  for (int i = 0; i < BVH_WIDE_WIDTH; i++) {
+    float dist_sq = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+      float val = proj[axis];
+      val = (node->bv[2 * axis][i] > val) ? node->bv[2 * axis][i] : val;
+      val = (node->bv[2 * axis + 1][i] < val) ? node->bv[2 * axis + 1][i] : val;
+      dist_sq += (proj[axis] - val) * (proj[axis] - val);
+    }
+    r_dist_sq[i] = dist_sq;
+  }
+  for (int i = node->node_num; i < BVH_WIDE_WIDTH; i++) {
+    r_dist_sq[i] = FLT_MAX;
+  }
+}
+
+/**
+ * Order the children of a wide node which are closer than `dist_max`, nearest first.
+ * Returns the number of ordered children.
+ */
+static int wide_node_order_children(const float dist[BVH_WIDE_WIDTH],
+                                    const float dist_max,
+                                    int r_order[BVH_WIDE_WIDTH])
+{
+  int order_num = 0;
+  for (int i = 0; i < BVH_WIDE_WIDTH; i++) {
+    if (dist[i] >= dist_max) {
+      continue;
+    }
+    int j = order_num++;
+    for (; j > 0 && dist[r_order[j - 1]] > dist[i]; j--) {
+      r_order[j] = r_order[j - 1];
+    }
+    r_order[j] = i;
+  }
+  return order_num;
+}
+
+/* Depth first search on the wide nodes, visiting the nearest children first. */
+static void dfs_find_nearest_wide(BVHNearestData *data, const BVHWideNode *node)
+{
+  float dist_sq[BVH_WIDE_WIDTH];
+  int order[BVH_WIDE_WIDTH];
+  wide_nearest_point_squared(data->proj, node, dist_sq);
+  const int order_num = wide_node_order_children(dist_sq, data->nearest.dist_sq, order);
+
+  for (int k = 0; k < order_num; k++) {
+    const int i = order[k];
+    /* The nearest distance may have changed since the children were ordered. */
+    if (dist_sq[i] >= data->nearest.dist_sq) {
+      continue;
+    }
+    const int child = node->children[i];
+    if (child >= 0) {
+      dfs_find_nearest_wide(data, &data->tree->wide->nodes[child]);
+    }
+    else {
+      const BVHNode *leaf = bvhtree_wide_leaf(data->tree, child);
+      if (data->callback) {
+        data->callback(data->userdata, leaf->index, data->co, &data->nearest);
+      }
+      else {
+        data->nearest.index = leaf->index;
+        data->nearest.dist_sq = calc_nearest_point_squared(data->proj, leaf, data->nearest.co);
+      }
+    }
+  }
+}
+
 /* Priority queue method */
 static void heap_find_nearest_inner(BVHNearestData *data, HeapSimple *heap, BVHNode *node)
 {
@@ -1687,6 +2452,9 @@ int BLI_bvhtree_find_nearest_ex(const BVHTree *tree,
     if (flag & BVH_NEAREST_OPTIMAL_ORDER) {
       heap_find_nearest_begin(&data, root);
     }
+    else if (tree->wide) {
+      dfs_find_nearest_wide(&data, tree->wide->nodes);
+    }
     else {
       dfs_find_nearest_begin(&data, root);
     }
@@ -1873,6 +2641,104 @@ static float fast_ray_nearest_hit(const BVHRayCastData *data, const BVHNode *nod
   return max_fff(t1x, t1y, t1z);
 }
 
+/* Same as #fast_ray_nearest_hit and #ray_nearest_hit for all children of a wide node. */
+static void wide_ray_nearest_hit(const BVHRayCastData *data,
+                                 const BVHWideNode *node,
+                                 float r_dist[BVH_WIDE_WIDTH])
+{
+  if (data->ray.radius == 0.0f) {
+    const float *origin = data->ray.origin;
+    const float *idot_axis = data->idot_axis;
+    const int *index = data->index;
+    const float hit_dist = data->hit.dist;
+
+    for (int i = 0; i < BVH_WIDE_WIDTH; i++) {
+      const float t1x = (node->bv[index[0]][i] - origin[0]) * idot_axis[0];
+      const float t2x = (node->bv[index[1]][i] - origin[0]) * idot_axis[0];
+      const float t1y = (node->bv[index[2]][i] - origin[1]) * idot_axis[1];
+      const float t2y = (node->bv[index[3]][i] - origin[1]) * idot_axis[1];
+      const float t1z = (node->bv[index[4]][i] - origin[2]) * idot_axis[2];
+      const float t2z = (node->bv[index[5]][i] - origin[2]) * idot_axis[2];
+
+      /* Non short-circuiting operators, so all children are tested at once. */
+      const bool miss = (t1x > t2y) | (t2x < t1y) | (t1x > t2z) | (t2x < t1z) | (t1y > t2z) |
+                        (t2y < t1z) | (t2x < 0.0f) | (t2y < 0.0f) | (t2z < 0.0f) |
+                        (t1x > hit_dist) | (t1y > hit_dist) | (t1z > hit_dist);
+      const float t1_max = max_ff(t1x, max_ff(t1y, t1z));
+      r_dist[i] = miss ? FLT_MAX : t1_max;
+    }
+  }
+  else {
+    for (int i = 0; i < node->node_num; i++) {
+      const float bv[6] = {node->bv[0][i],
+                           node->bv[1][i],
+                           node->bv[2][i],
+                           node->bv[3][i],
+                           node->bv[4][i],
+                           node->bv[5][i]};
+      r_dist[i] = ray_nearest_hit(data, bv);
+    }
+  }
+  for (int i = node->node_num; i < BVH_WIDE_WIDTH; i++) {
+    r_dist[i] = FLT_MAX;
+  }
+}
+
+/* Same as #dfs_raycast on the wide nodes, visiting the nearest children first. */
+static void dfs_raycast_wide(BVHRayCastData *data, const BVHWideNode *node)
+{
+  float dist[BVH_WIDE_WIDTH];
+  int order[BVH_WIDE_WIDTH];
+  wide_ray_nearest_hit(data, node, dist);
+  const int order_num = wide_node_order_children(dist, data->hit.dist, order);
+
+  for (int k = 0; k < order_num; k++) {
+    const int i = order[k];
+    /* Skip children behind hits found since the children were ordered. */
+    if (dist[i] >= data->hit.dist) {
+      continue;
+    }
+    const int child = node->children[i];
+    if (child >= 0) {
+      dfs_raycast_wide(data, &data->tree->wide->nodes[child]);
+    }
+    else {
+      const BVHNode *leaf = bvhtree_wide_leaf(data->tree, child);
+      if (data->callback) {
+        data->callback(data->userdata, leaf->index, &data->ray, &data->hit);
+      }
+      else {
+        data->hit.index = leaf->index;
+        data->hit.dist = dist[i];
+        madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[i]);
+      }
+    }
+  }
+}
+
+/* Same as #dfs_raycast_all on the wide nodes. */
+static void dfs_raycast_all_wide(BVHRayCastData *data, const BVHWideNode *node)
+{
+  float dist[BVH_WIDE_WIDTH];
+  int order[BVH_WIDE_WIDTH];
+  wide_ray_nearest_hit(data, node, dist);
+  const int order_num = wide_node_order_children(dist, data->hit.dist, order);
+
+  for (int k = 0; k < order_num; k++) {
+    const int child = node->children[order[k]];
+    if (child >= 0) {
+      dfs_raycast_all_wide(data, &data->tree->wide->nodes[child]);
+    }
+    else {
+      const BVHNode *leaf = bvhtree_wide_leaf(data->tree, child);
+      const float hit_dist = data->hit.dist;
+      data->callback(data->userdata, leaf->index, &data->ray, &data->hit);
+      data->hit.index = -1;
+      data->hit.dist = hit_dist;
+    }
+  }
+}
+
 static void dfs_raycast(BVHRayCastData *data, BVHNode *node)
 {
   int i;
@@ -2017,7 +2883,10 @@ int BLI_bvhtree_ray_cast_ex(const BVHTree *tree,
     data.hit.dist = BVH_RAYCAST_DIST_MAX;
   }
 
-  if (root) {
+  if (tree->wide) {
+    dfs_raycast_wide(&data, tree->wide->nodes);
+  }
+  else if (root) {
     dfs_raycast(&data, root);
     //      iterative_raycast(&data, root);
   }
@@ -2097,6 +2966,11 @@ void BLI_bvhtree_ray_cast_all_ex(const BVHTree *tree,
   data.hit.index = -1;
   data.hit.dist = hit_dist;
 
+  if (tree->wide) {
+    dfs_raycast_all_wide(&data, tree->wide->nodes);
+    return;
+  }
+
   if (root) {
     dfs_raycast_all(&data, root);
   }
@@ -2116,6 +2990,382 @@ void BLI_bvhtree_ray_cast_all(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch
+ *
+ * Casting many rays is done on packets of #BVH_RAYCAST_PACKET_SIZE rays which traverse the
+ * tree together: a node is visited once for all rays of the packet which can still hit it, so
+ * the cost of the traversal is shared by the rays and nodes and primitives stay in the cache.
+ * The bounding volumes are tested against all rays of the packet at once, using arrays with one
+ * element per ray which the compiler can vectorize.
+ *
+ * Rays are sorted by direction and origin beforehand, so that the rays of a packet are coherent.
+ *
+ * \{ */
+
+/* Below this number of rays the order of the rays is kept. */
+#define BVH_RAYCAST_BATCH_SORT_THRESHOLD 4096
+/* Number of bits of each coordinate of the ray origin used for sorting. */
+#define BVH_RAYCAST_BATCH_SORT_BITS 4
+
+typedef struct BVHRayPacketData {
+  const BVHTree *tree;
+
+  BVHTree_RayCastCallback callback;
+  BVHTree_RayCastPacketCallback packet_callback;
+  void *userdata;
+
+  float radius;
+  /* Sum of the ray directions, to pick the loop direction to dive into the tree. */
+  float direction_sum[3];
+
+  /* Rays as separate arrays per axis, for the bounding volume tests. */
+  float origin[3][BVH_RAYCAST_PACKET_SIZE];
+  float idot_axis[3][BVH_RAYCAST_PACKET_SIZE];
+
+  BVHTreeRay rays[BVH_RAYCAST_PACKET_SIZE];
+#ifdef USE_KDOPBVH_WATERTIGHT
+  struct IsectRayPrecalc isect_precalc[BVH_RAYCAST_PACKET_SIZE];
+#endif
+  BVHTreeRayHit hits[BVH_RAYCAST_PACKET_SIZE];
+} BVHRayPacketData;
+
+typedef struct BVHRayCastBatchData {
+  const BVHTree *tree;
+  const float (*origins)[3];
+  const float (*directions)[3];
+  float radius;
+  /* Order to cast the rays in, null when they are cast in their original order. */
+  const int *order;
+  int rays_num;
+  BVHTreeRayHit *hits;
+  BVHTree_RayCastCallback callback;
+  BVHTree_RayCastPacketCallback packet_callback;
+  void *userdata;
+  int flag;
+} BVHRayCastBatchData;
+
+/**
+ * Determines the distance that every ray of the packet must travel to hit the bounding volume,
+ * returns the rays which hit it closer than their current hit.
+ */
+static uint ray_packet_nearest_hit(const BVHRayPacketData *data,
+                                   const float bv[6],
+                                   const uint ray_mask,
+                                   float r_dist[BVH_RAYCAST_PACKET_SIZE])
+{
+  /* Like #fast_ray_nearest_hit, rays without radius starting inside the bounds get a negative
+   * distance, so that the hits are the same as for single rays. */
+  const float low_init = (data->radius == 0.0f) ? -FLT_MAX : 0.0f;
+  float low[BVH_RAYCAST_PACKET_SIZE], upper[BVH_RAYCAST_PACKET_SIZE];
+  for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+    low[i] = low_init;
+    upper[i] = FLT_MAX;
+  }
+
+  for (int axis = 0; axis < 3; axis++) {
+    const float bv_min = bv[2 * axis] - data->radius;
+    const float bv_max = bv[2 * axis + 1] + data->radius;
+    const float *origin = data->origin[axis];
+    const float *idot_axis = data->idot_axis[axis];
+    for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+      const float t1 = (bv_min - origin[i]) * idot_axis[i];
+      const float t2 = (bv_max - origin[i]) * idot_axis[i];
+      low[i] = max_ff(low[i], min_ff(t1, t2));
+      upper[i] = min_ff(upper[i], max_ff(t1, t2));
+    }
+  }
+
+  uint hit_mask = 0;
+  for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+    r_dist[i] = low[i];
+    const bool hit = (low[i] <= upper[i]) & (low[i] <= data->hits[i].dist) & (upper[i] >= 0.0f);
+    hit_mask |= (uint)hit << i;
+  }
+  return hit_mask & ray_mask;
+}
+
+static void dfs_raycast_packet(BVHRayPacketData *data, const BVHNode *node, uint ray_mask)
+{
+  float dist[BVH_RAYCAST_PACKET_SIZE];
+  ray_mask = ray_packet_nearest_hit(data, node->bv, ray_mask, dist);
+  if (ray_mask == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    if (data->packet_callback) {
+      data->packet_callback(data->userdata, node->index, data->rays, data->hits, ray_mask);
+      return;
+    }
+    for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+      if ((ray_mask & (1u << i)) == 0) {
+        continue;
+      }
+      if (data->callback) {
+        data->callback(data->userdata, node->index, &data->rays[i], &data->hits[i]);
+      }
+      else if (dist[i] < data->hits[i].dist) {
+        data->hits[i].index = node->index;
+        data->hits[i].dist = dist[i];
+        madd_v3_v3v3fl(data->hits[i].co, data->rays[i].origin, data->rays[i].direction, dist[i]);
+      }
+    }
+  }
+  else {
+    /* Pick loop direction to dive into the tree (based on ray directions and split axis). */
+    if (node->main_axis >= 3 || data->direction_sum[node->main_axis] > 0.0f) {
+      for (int i = 0; i != node->node_num; i++) {
+        dfs_raycast_packet(data, node->children[i], ray_mask);
+      }
+    }
+    else {
+      for (int i = node->node_num - 1; i >= 0; i--) {
+        dfs_raycast_packet(data, node->children[i], ray_mask);
+      }
+    }
+  }
+}
+
+static void bvhtree_ray_cast_batch_task_cb(void *__restrict userdata,
+                                           const int packet_index,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *batch = (const BVHRayCastBatchData *)userdata;
+  const int start = packet_index * BVH_RAYCAST_PACKET_SIZE;
+  const int rays_num = min_ii(BVH_RAYCAST_PACKET_SIZE, batch->rays_num - start);
+
+  BVHRayPacketData data;
+  data.tree = batch->tree;
+  data.callback = batch->callback;
+  data.packet_callback = batch->packet_callback;
+  data.userdata = batch->userdata;
+  data.radius = batch->radius;
+  zero_v3(data.direction_sum);
+
+  uint ray_mask = 0;
+  for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+    if (i >= rays_num) {
+      /* Unused rays never hit anything. */
+      for (int axis = 0; axis < 3; axis++) {
+        data.origin[axis][i] = 0.0f;
+        data.idot_axis[axis][i] = 0.0f;
+      }
+      data.hits[i].index = -1;
+      data.hits[i].dist = -1.0f;
+      continue;
+    }
+    ray_mask |= 1u << i;
+
+    const int ray_index = batch->order ? batch->order[start + i] : start + i;
+    BVHTreeRay *ray = &data.rays[i];
+    BLI_ASSERT_UNIT_V3(batch->directions[ray_index]);
+    copy_v3_v3(ray->origin, batch->origins[ray_index]);
+    copy_v3_v3(ray->direction, batch->directions[ray_index]);
+    ray->radius = batch->radius;
+    add_v3_v3(data.direction_sum, ray->direction);
+
+    for (int axis = 0; axis < 3; axis++) {
+      data.origin[axis][i] = ray->origin[axis];
+      data.idot_axis[axis][i] = (fabsf(ray->direction[axis]) < FLT_EPSILON) ?
+                                    FLT_MAX :
+                                    1.0f / ray->direction[axis];
+    }
+
+#ifdef USE_KDOPBVH_WATERTIGHT
+    if (batch->flag & BVH_RAYCAST_WATERTIGHT) {
+      isect_ray_tri_watertight_v3_precalc(&data.isect_precalc[i], ray->direction);
+      ray->isect_precalc = &data.isect_precalc[i];
+    }
+    else {
+      ray->isect_precalc = NULL;
+    }
+#endif
+
+    data.hits[i] = batch->hits[ray_index];
+  }
+
+  dfs_raycast_packet(&data, batch->tree->nodes[batch->tree->leaf_num], ray_mask);
+
+  for (int i = 0; i < rays_num; i++) {
+    const int ray_index = batch->order ? batch->order[start + i] : start + i;
+    batch->hits[ray_index] = data.hits[i];
+  }
+}
+
+/**
+ * Key to sort the rays by, grouping rays by the octant of their direction first, and by the
+ * position of their origin in the bounds of the tree along a Z-order curve second.
+ */
+static uint ray_cast_batch_sort_key(const float co[3],
+                                    const float dir[3],
+                                    const float bounds_min[3],
+                                    const float bounds_scale[3])
+{
+  const uint cells_num = 1u << BVH_RAYCAST_BATCH_SORT_BITS;
+  uint cell[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const float co_cell = (co[axis] - bounds_min[axis]) * bounds_scale[axis];
+    cell[axis] = (uint)clamp_f(co_cell, 0.0f, (float)(cells_num - 1));
+  }
+
+  uint key = 0;
+  for (int bit = BVH_RAYCAST_BATCH_SORT_BITS - 1; bit >= 0; bit--) {
+    for (int axis = 0; axis < 3; axis++) {
+      key = (key << 1) | ((cell[axis] >> bit) & 1u);
+    }
+  }
+
+  const uint octant = (uint)(dir[0] < 0.0f) | ((uint)(dir[1] < 0.0f) << 1) |
+                      ((uint)(dir[2] < 0.0f) << 2);
+  return (octant << (3 * BVH_RAYCAST_BATCH_SORT_BITS)) | key;
+}
+
+/** Counting sort of the rays by #ray_cast_batch_sort_key, which keeps the order of equal keys. */
+static int *ray_cast_batch_order(const BVHTree *tree,
+                                 const float (*origins)[3],
+                                 const float (*directions)[3],
+                                 const int rays_num)
+{
+  const uint keys_num = 1u << (3 * BVH_RAYCAST_BATCH_SORT_BITS + 3);
+  const float cells_num = (float)(1 << BVH_RAYCAST_BATCH_SORT_BITS);
+
+  float bounds_min[3], bounds_max[3], bounds_scale[3];
+  BLI_bvhtree_get_bounding_box(tree, bounds_min, bounds_max);
+  for (int axis = 0; axis < 3; axis++) {
+    const float size = bounds_max[axis] - bounds_min[axis];
+    bounds_scale[axis] = (size > FLT_EPSILON) ? cells_num / size : 0.0f;
+  }
+
+  uint *keys = MEM_mallocN(sizeof(*keys) * (size_t)rays_num, __func__);
+  int *offsets = MEM_callocN(sizeof(*offsets) * (keys_num + 1), __func__);
+  for (int i = 0; i < rays_num; i++) {
+    keys[i] = ray_cast_batch_sort_key(origins[i], directions[i], bounds_min, bounds_scale);
+    offsets[keys[i] + 1]++;
+  }
+  for (uint key = 0; key < keys_num; key++) {
+    offsets[key + 1] += offsets[key];
+  }
+
+  int *order = MEM_mallocN(sizeof(*order) * (size_t)rays_num, __func__);
+  for (int i = 0; i < rays_num; i++) {
+    order[offsets[keys[i]]++] = i;
+  }
+
+  MEM_freeN(offsets);
+  MEM_freeN(keys);
+  return order;
+}
+
+/**
+ * Calls the packet callback of the batch for a single ray, for trees which can't be traversed
+ * with packets. Only the first ray of the packet is used.
+ */
+static void ray_cast_packet_callback_single(void *userdata,
+                                            int index,
+                                            const BVHTreeRay *ray,
+                                            BVHTreeRayHit *hit)
+{
+  const BVHRayCastBatchData *batch = (const BVHRayCastBatchData *)userdata;
+  BVHTreeRay rays[BVH_RAYCAST_PACKET_SIZE] = {{{0.0f}}};
+  BVHTreeRayHit hits[BVH_RAYCAST_PACKET_SIZE] = {{0}};
+  rays[0] = *ray;
+  hits[0] = *hit;
+  batch->packet_callback(batch->userdata, index, rays, hits, 1u);
+  *hit = hits[0];
+}
+
+void BLI_bvhtree_ray_cast_batch_ex(const BVHTree *tree,
+                                   const float (*origins)[3],
+                                   const float (*directions)[3],
+                                   const int rays_num,
+                                   const float radius,
+                                   BVHTreeRayHit *hits,
+                                   BVHTree_RayCastCallback callback,
+                                   BVHTree_RayCastPacketCallback packet_callback,
+                                   void *userdata,
+                                   int flag)
+{
+  if (rays_num == 0 || tree->nodes[tree->leaf_num] == NULL) {
+    return;
+  }
+
+  BVHRayCastBatchData data;
+  data.tree = tree;
+  data.origins = origins;
+  data.directions = directions;
+  data.radius = radius;
+  data.rays_num = rays_num;
+  data.hits = hits;
+  data.callback = callback;
+  data.packet_callback = packet_callback;
+  data.userdata = userdata;
+  data.flag = flag;
+  data.order = NULL;
+
+  if (tree->start_axis != 0) {
+    /* The packet traversal only tests the first three axes of the bounding volumes. Cast the rays
+     * one by one, with the packet callback when it is the only one given. */
+    BVHTree_RayCastCallback single_callback = callback;
+    void *single_userdata = userdata;
+    if (callback == NULL && packet_callback != NULL) {
+      single_callback = ray_cast_packet_callback_single;
+      single_userdata = &data;
+    }
+    for (int i = 0; i < rays_num; i++) {
+      BLI_bvhtree_ray_cast_ex(tree,
+                              origins[i],
+                              directions[i],
+                              radius,
+                              &hits[i],
+                              single_callback,
+                              single_userdata,
+                              flag);
+    }
+    return;
+  }
+
+  int *order = NULL;
+  if (rays_num >= BVH_RAYCAST_BATCH_SORT_THRESHOLD) {
+    order = ray_cast_batch_order(tree, origins, directions, rays_num);
+    data.order = order;
+  }
+
+  const int packets_num = (rays_num + BVH_RAYCAST_PACKET_SIZE - 1) / BVH_RAYCAST_PACKET_SIZE;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (rays_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 16;
+  BLI_task_parallel_range(0, packets_num, &data, bvhtree_ray_cast_batch_task_cb, &settings);
+
+  MEM_SAFE_FREE(order);
+}
+
+void BLI_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const float (*origins)[3],
+                                const float (*directions)[3],
+                                const int rays_num,
+                                const float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                BVHTree_RayCastPacketCallback packet_callback,
+                                void *userdata)
+{
+  BLI_bvhtree_ray_cast_batch_ex(tree,
+                                origins,
+                                directions,
+                                rays_num,
+                                radius,
+                                hits,
+                                callback,
+                                packet_callback,
+                                userdata,
+                                BVH_RAYCAST_DEFAULT);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
@@ -2167,6 +3417,26 @@ static void dfs_range_query(RangeQueryData *data, BVHNode *node)
   }
 }
 
+static void dfs_range_query_wide(RangeQueryData *data, const BVHWideNode *node)
+{
+  float dist_sq[BVH_WIDE_WIDTH];
+  wide_nearest_point_squared(data->center, node, dist_sq);
+
+  for (int i = 0; i < node->node_num; i++) {
+    if (dist_sq[i] < data->radius_sq) {
+      const int child = node->children[i];
+      if (child >= 0) {
+        dfs_range_query_wide(data, &data->tree->wide->nodes[child]);
+      }
+      else {
+        data->hits++;
+        data->callback(
+            data->userdata, bvhtree_wide_leaf(data->tree, child)->index, data->center, dist_sq[i]);
+      }
+    }
+  }
+}
+
 int BLI_bvhtree_range_query(const BVHTree *tree,
                             const float co[3],
                             float radius,
@@ -2184,6 +3454,11 @@ int BLI_bvhtree_range_query(const BVHTree *tree,
   data.callback = callback;
   data.userdata = userdata;
 
+  if (tree->wide) {
+    dfs_range_query_wide(&data, tree->wide->nodes);
+    return data.hits;
+  }
+
   if (root != NULL) {
     float nearest[3];
     float dist_sq = calc_nearest_point_squared(data.center, root, nearest);
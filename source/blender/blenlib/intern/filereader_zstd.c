@@ -12,6 +12,8 @@
 #include "BLI_endian_switch.h"
 #include "BLI_filereader.h"
 #include "BLI_math_base.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "MEM_guardedalloc.h"
 
@@ -29,11 +31,19 @@ typedef struct {
     size_t *compressed_ofs;
     size_t *uncompressed_ofs;
 
+    /* Uncompressed content of consecutive frames, starting at `cached_frame`. */
     char *cached_content;
     int cached_frame;
+    int cached_frames_num;
+    /* Number of frames decompressed in parallel when reading sequentially. */
+    int prefetch_frames_num;
   } seek;
 } ZstdReader;
 
+/* Upper limit of the memory used by the cache is this times the frame size (1 MB when written
+ * by Blender). */
+#define ZSTD_PREFETCH_FRAMES_MAX 16
+
 static bool zstd_read_u32(FileReader *base, uint32_t *val)
 {
   if (base->read(base, val, sizeof(uint32_t)) != sizeof(uint32_t)) {
@@ -127,6 +137,7 @@ static bool zstd_read_seek_table(ZstdReader *zstd)
   }
 
   zstd->seek.cached_frame = -1;
+  zstd->seek.prefetch_frames_num = min_ii(BLI_system_thread_count(), ZSTD_PREFETCH_FRAMES_MAX);
 
   return true;
 }
@@ -154,24 +165,66 @@ static int zstd_frame_from_pos(ZstdReader *zstd, size_t pos)
   return low;
 }
 
-/* Ensure that the currently loaded frame is the correct one. */
+typedef struct ZstdDecompressData {
+  const ZstdReader *zstd;
+  int first_frame;
+  const char *compressed_data;
+  char *uncompressed_data;
+  bool error;
+} ZstdDecompressData;
+
+static void zstd_decompress_frame_fn(void *__restrict userdata,
+                                     const int iter,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ZstdDecompressData *data = userdata;
+  const size_t *compressed_ofs = data->zstd->seek.compressed_ofs;
+  const size_t *uncompressed_ofs = data->zstd->seek.uncompressed_ofs;
+  const int frame = data->first_frame + iter;
+
+  const size_t compressed_size = compressed_ofs[frame + 1] - compressed_ofs[frame];
+  const size_t uncompressed_size = uncompressed_ofs[frame + 1] - uncompressed_ofs[frame];
+  const size_t res = ZSTD_decompress(
+      data->uncompressed_data + (uncompressed_ofs[frame] - uncompressed_ofs[data->first_frame]),
+      uncompressed_size,
+      data->compressed_data + (compressed_ofs[frame] - compressed_ofs[data->first_frame]),
+      compressed_size);
+  if (ZSTD_isError(res) || res < uncompressed_size) {
+    data->error = true;
+  }
+}
+
+/* Ensure that the currently loaded frames contain the given one, and return its content. */
 static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
 {
-  if (zstd->seek.cached_frame == frame) {
-    /* Cached frame matches, so just return it. */
-    return zstd->seek.cached_content;
+  const size_t *compressed_ofs = zstd->seek.compressed_ofs;
+  const size_t *uncompressed_ofs = zstd->seek.uncompressed_ofs;
+  const int cached_frame = zstd->seek.cached_frame;
+
+  if (cached_frame != -1 && frame >= cached_frame &&
+      frame < cached_frame + zstd->seek.cached_frames_num)
+  {
+    /* Cached frames contain the wanted one, so just return it. */
+    return zstd->seek.cached_content + (uncompressed_ofs[frame] - uncompressed_ofs[cached_frame]);
   }
 
-  /* Cached frame doesn't match, so discard it and cache the wanted one instead. */
+  /* Cached frames don't match, so discard them and cache the wanted one instead. When reading
+   * sequentially, decompress the following frames in parallel as well, random access (when
+   * linking for example) only needs the one frame. */
   MEM_SAFE_FREE(zstd->seek.cached_content);
+  zstd->seek.cached_frame = -1;
+
+  int frames_num = 1;
+  if (cached_frame != -1 && frame == cached_frame + zstd->seek.cached_frames_num) {
+    frames_num = min_ii(zstd->seek.prefetch_frames_num, zstd->seek.frames_num - frame);
+  }
 
-  size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
-  size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
-                             zstd->seek.uncompressed_ofs[frame];
+  size_t compressed_size = compressed_ofs[frame + frames_num] - compressed_ofs[frame];
+  size_t uncompressed_size = uncompressed_ofs[frame + frames_num] - uncompressed_ofs[frame];
 
   char *uncompressed_data = MEM_mallocN(uncompressed_size, __func__);
   char *compressed_data = MEM_mallocN(compressed_size, __func__);
-  if (zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) < 0 ||
+  if (zstd->base->seek(zstd->base, compressed_ofs[frame], SEEK_SET) < 0 ||
       zstd->base->read(zstd->base, compressed_data, compressed_size) < compressed_size)
   {
     MEM_freeN(compressed_data);
@@ -179,15 +232,34 @@ static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
     return NULL;
   }
 
-  size_t res = ZSTD_decompressDCtx(
-      zstd->ctx, uncompressed_data, uncompressed_size, compressed_data, compressed_size);
+  bool error;
+  if (frames_num == 1) {
+    size_t res = ZSTD_decompressDCtx(
+        zstd->ctx, uncompressed_data, uncompressed_size, compressed_data, compressed_size);
+    error = ZSTD_isError(res) || res < uncompressed_size;
+  }
+  else {
+    ZstdDecompressData data = {
+        .zstd = zstd,
+        .first_frame = frame,
+        .compressed_data = compressed_data,
+        .uncompressed_data = uncompressed_data,
+        .error = false,
+    };
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1;
+    BLI_task_parallel_range(0, frames_num, &data, zstd_decompress_frame_fn, &settings);
+    error = data.error;
+  }
   MEM_freeN(compressed_data);
-  if (ZSTD_isError(res) || res < uncompressed_size) {
+  if (error) {
     MEM_freeN(uncompressed_data);
     return NULL;
   }
 
   zstd->seek.cached_frame = frame;
+  zstd->seek.cached_frames_num = frames_num;
   zstd->seek.cached_content = uncompressed_data;
   return uncompressed_data;
 }
@@ -9,6 +9,7 @@
 #include "BLI_kdtree_impl.h"
 #include "BLI_math.h"
 #include "BLI_strict_flags.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #define _BLI_KDTREE_CONCAT_AUX(MACRO_ARG1, MACRO_ARG2) MACRO_ARG1##MACRO_ARG2
@@ -134,20 +135,15 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+/**
+ * Quick-sort style partitioning of the nodes around their median along \a axis,
+ * returns the median which is placed at its sorted position.
+ */
+static uint kdtree_balance_partition(KDTreeNode *nodes, const uint nodes_len, const uint axis)
 {
-  KDTreeNode *node;
   float co;
   uint left, right, median, i, j;
 
-  if (nodes_len <= 0) {
-    return KD_NODE_UNSET;
-  }
-  else if (nodes_len == 1) {
-    return 0 + ofs;
-  }
-
-  /* Quick-sort style sorting around median. */
   left = 0;
   right = nodes_len - 1;
   median = nodes_len / 2;
@@ -179,6 +175,23 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
     }
   }
 
+  return median;
+}
+
+static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  KDTreeNode *node;
+  uint median;
+
+  if (nodes_len <= 0) {
+    return KD_NODE_UNSET;
+  }
+  else if (nodes_len == 1) {
+    return 0 + ofs;
+  }
+
+  median = kdtree_balance_partition(nodes, nodes_len, axis);
+
   /* Set node and sort sub-nodes. */
   node = &nodes[median];
   node->d = axis;
@@ -190,7 +203,7 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   return median + ofs;
 }
 
-void BLI_kdtree_nd_(balance)(KDTree *tree)
+static void kdtree_balance_reset(KDTree *tree)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
     for (uint i = 0; i < tree->nodes_len; i++) {
@@ -198,6 +211,11 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
       tree->nodes[i].right = KD_NODE_UNSET;
     }
   }
+}
+
+void BLI_kdtree_nd_(balance)(KDTree *tree)
+{
+  kdtree_balance_reset(tree);
 
   tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
 
@@ -206,6 +224,168 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
 #endif
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Extended Balance
+ *
+ * Both halves of every partition can be balanced in separate tasks, until the sub-trees are
+ * small enough to be balanced recursively. The partitioning is the same as #kdtree_balance, so
+ * the resulting tree doesn't depend on the number of threads.
+ *
+ * Afterwards the nodes are copied in depth first order: the left child directly follows its
+ * parent and the right child follows the left sub-tree. The top levels of the tree then share
+ * cache lines, and a traversal mostly moves forward through memory.
+ * \{ */
+
+/* Sub-trees with fewer nodes are handled in a single task. */
+#define KD_BALANCE_TASK_NODES_MIN 8192
+
+typedef struct KDTreeBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+  /* Set to the root of the balanced sub-tree. */
+  uint *r_root;
+} KDTreeBalanceTask;
+
+static void kdtree_balance_task_push(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, uint ofs, uint *r_root);
+
+static void kdtree_balance_task_cb(TaskPool *__restrict pool, void *taskdata)
+{
+  const KDTreeBalanceTask *task = taskdata;
+
+  if (task->nodes_len < KD_BALANCE_TASK_NODES_MIN) {
+    *task->r_root = kdtree_balance(task->nodes, task->nodes_len, task->axis, task->ofs);
+    return;
+  }
+
+  const uint median = kdtree_balance_partition(task->nodes, task->nodes_len, task->axis);
+  const uint axis = (task->axis + 1) % KD_DIMS;
+
+  /* The tasks of the sub-trees only write to nodes on their own side of the median. */
+  KDTreeNode *node = &task->nodes[median];
+  node->d = task->axis;
+  kdtree_balance_task_push(pool, task->nodes, median, axis, task->ofs, &node->left);
+  kdtree_balance_task_push(pool,
+                           task->nodes + median + 1,
+                           task->nodes_len - (median + 1),
+                           axis,
+                           task->ofs + (median + 1),
+                           &node->right);
+
+  *task->r_root = median + task->ofs;
+}
+
+static void kdtree_balance_task_push(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, uint ofs, uint *r_root)
+{
+  KDTreeBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+  task->nodes = nodes;
+  task->nodes_len = nodes_len;
+  task->axis = axis;
+  task->ofs = ofs;
+  task->r_root = r_root;
+  BLI_task_pool_push(pool, kdtree_balance_task_cb, task, true, NULL);
+}
+
+typedef struct KDTreeLayoutTask {
+  const KDTreeNode *nodes;
+  KDTreeNode *r_nodes;
+  /* The sub-tree at `root` contains the nodes `[begin, begin + nodes_len)`. */
+  uint root;
+  uint begin;
+  uint nodes_len;
+  /* Position of the root in `r_nodes`, followed by the rest of the sub-tree. */
+  uint r_root;
+} KDTreeLayoutTask;
+
+static void kdtree_layout_run(TaskPool *pool, const KDTreeLayoutTask *task);
+
+static void kdtree_layout_depth_first(TaskPool *pool, const KDTreeLayoutTask *task)
+{
+  const KDTreeNode *node = &task->nodes[task->root];
+  KDTreeNode *r_node = &task->r_nodes[task->r_root];
+  const uint left_len = task->root - task->begin;
+
+  *r_node = *node;
+
+  if (node->left != KD_NODE_UNSET) {
+    const KDTreeLayoutTask left = {
+        task->nodes, task->r_nodes, node->left, task->begin, left_len, task->r_root + 1};
+    r_node->left = left.r_root;
+    kdtree_layout_run(pool, &left);
+  }
+  if (node->right != KD_NODE_UNSET) {
+    const KDTreeLayoutTask right = {task->nodes,
+                                    task->r_nodes,
+                                    node->right,
+                                    task->root + 1,
+                                    task->nodes_len - (left_len + 1),
+                                    task->r_root + 1 + left_len};
+    r_node->right = right.r_root;
+    kdtree_layout_run(pool, &right);
+  }
+}
+
+static void kdtree_layout_task_cb(TaskPool *__restrict pool, void *taskdata)
+{
+  kdtree_layout_depth_first(pool, taskdata);
+}
+
+static void kdtree_layout_run(TaskPool *pool, const KDTreeLayoutTask *task)
+{
+  if (pool && task->nodes_len >= KD_BALANCE_TASK_NODES_MIN) {
+    KDTreeLayoutTask *task_copy = MEM_mallocN(sizeof(*task_copy), __func__);
+    *task_copy = *task;
+    BLI_task_pool_push(pool, kdtree_layout_task_cb, task_copy, true, NULL);
+  }
+  else {
+    kdtree_layout_depth_first(pool, task);
+  }
+}
+
+void BLI_kdtree_nd_(balance_ex)(KDTree *tree, const bool use_threading)
+{
+  TaskPool *pool = NULL;
+  if (use_threading && tree->nodes_len >= KD_BALANCE_TASK_NODES_MIN) {
+    pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+  }
+
+  kdtree_balance_reset(tree);
+
+  if (pool) {
+    kdtree_balance_task_push(pool, tree->nodes, tree->nodes_len, 0, 0, &tree->root);
+    BLI_task_pool_work_and_wait(pool);
+  }
+  else {
+    tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  }
+
+  if (tree->root != KD_NODE_UNSET) {
+    /* Keep the capacity of the array, more nodes may be inserted before balancing again. */
+    KDTreeNode *nodes = MEM_mallocN(MEM_allocN_len(tree->nodes), "KDTreeNode");
+    const KDTreeLayoutTask task = {tree->nodes, nodes, tree->root, 0, tree->nodes_len, 0};
+    kdtree_layout_run(pool, &task);
+    if (pool) {
+      BLI_task_pool_work_and_wait(pool);
+    }
+    MEM_freeN(tree->nodes);
+    tree->nodes = nodes;
+    tree->root = 0;
+  }
+
+  if (pool) {
+    BLI_task_pool_free(pool);
+  }
+
+#ifdef DEBUG
+  tree->is_balanced = true;
+#endif
+}
+
+/** \} */
+
 static uint *realloc_nodes(uint *stack, uint *stack_len_capacity, const bool is_alloc)
 {
   uint *stack_new = MEM_mallocN((*stack_len_capacity + KD_NEAR_ALLOC_INC) * sizeof(uint),
@@ -795,6 +975,480 @@ finally:
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batch Queries
+ *
+ * The query coordinates are sorted along a Z-order curve, so that consecutive queries traverse
+ * mostly the same nodes, which are then still in the cache. The sorted queries are split into
+ * chunks which run in parallel, every thread reuses a single traversal stack for all of them.
+ *
+ * Within a chunk the results of the previous query bound the distance of the nearest points,
+ * which prunes most of the tree without having to find close candidates first.
+ * \{ */
+
+/* Bits of the Z-order code of every dimension, all of them fit in a 32 bit integer. */
+#define KD_BATCH_ORDER_BITS (30 / KD_DIMS)
+/* Queries of a chunk run on one thread, in order. */
+#define KD_BATCH_CHUNK_SIZE 256
+
+typedef struct KDTreeBatchStack {
+  uint *stack;
+  uint stack_len_capacity;
+} KDTreeBatchStack;
+
+typedef struct KDTreeBatchOrderData {
+  const float (*co)[KD_DIMS];
+  float bounds_min[KD_DIMS];
+  float bounds_scale;
+  uint *codes;
+} KDTreeBatchOrderData;
+
+static void kdtree_batch_order_code_task_cb(void *__restrict userdata,
+                                            const int i,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  KDTreeBatchOrderData *data = userdata;
+  const float cells_max = (float)((1u << KD_BATCH_ORDER_BITS) - 1);
+
+  uint cell[KD_DIMS];
+  for (uint j = 0; j < KD_DIMS; j++) {
+    const float co_cell = (data->co[i][j] - data->bounds_min[j]) * data->bounds_scale;
+    /* Written to also map NAN to the first cell. */
+    cell[j] = (co_cell > 0.0f) ? (uint)min_ff(co_cell, cells_max) : 0;
+  }
+
+  uint code = 0;
+  for (int bit = KD_BATCH_ORDER_BITS - 1; bit >= 0; bit--) {
+    for (uint j = 0; j < KD_DIMS; j++) {
+      code = (code << 1) | ((cell[j] >> bit) & 1u);
+    }
+  }
+  data->codes[i] = code;
+}
+
+/**
+ * Return the indices of the query coordinates sorted along a Z-order curve,
+ * the caller is responsible for freeing the array.
+ */
+static uint *kdtree_batch_order(const float (*co)[KD_DIMS], const uint co_len)
+{
+  KDTreeBatchOrderData data;
+  data.co = co;
+
+  float bounds_max[KD_DIMS];
+  for (uint j = 0; j < KD_DIMS; j++) {
+    data.bounds_min[j] = FLT_MAX;
+    bounds_max[j] = -FLT_MAX;
+  }
+  for (uint i = 0; i < co_len; i++) {
+    for (uint j = 0; j < KD_DIMS; j++) {
+      data.bounds_min[j] = min_ff(data.bounds_min[j], co[i][j]);
+      bounds_max[j] = max_ff(bounds_max[j], co[i][j]);
+    }
+  }
+
+  /* Use cubic cells, so that the curve doesn't favor thin dimensions. */
+  float size_max = 0.0f;
+  for (uint j = 0; j < KD_DIMS; j++) {
+    size_max = max_ff(size_max, bounds_max[j] - data.bounds_min[j]);
+  }
+  data.bounds_scale = (size_max > FLT_EPSILON) ? (float)(1u << KD_BATCH_ORDER_BITS) / size_max :
+                                                 0.0f;
+
+  uint *codes = MEM_mallocN(sizeof(uint) * co_len, __func__);
+  uint *codes_other = MEM_mallocN(sizeof(uint) * co_len, __func__);
+  uint *order = MEM_mallocN(sizeof(uint) * co_len, __func__);
+  uint *order_other = MEM_mallocN(sizeof(uint) * co_len, __func__);
+  data.codes = codes;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (co_len > 10000);
+  settings.min_iter_per_thread = 1024;
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_batch_order_code_task_cb, &settings);
+
+  for (uint i = 0; i < co_len; i++) {
+    order[i] = i;
+  }
+
+  /* Stable radix sort of 8 bits per pass, the four passes leave the result in `order`. */
+  for (uint shift = 0; shift < 32; shift += 8) {
+    uint offsets[256] = {0};
+    for (uint i = 0; i < co_len; i++) {
+      offsets[(codes[i] >> shift) & 0xff]++;
+    }
+    uint offset = 0;
+    for (uint digit = 0; digit < 256; digit++) {
+      const uint count = offsets[digit];
+      offsets[digit] = offset;
+      offset += count;
+    }
+    for (uint i = 0; i < co_len; i++) {
+      const uint dst = offsets[(codes[i] >> shift) & 0xff]++;
+      codes_other[dst] = codes[i];
+      order_other[dst] = order[i];
+    }
+    SWAP(uint *, codes, codes_other);
+    SWAP(uint *, order, order_other);
+  }
+
+  MEM_freeN(codes);
+  MEM_freeN(codes_other);
+  MEM_freeN(order_other);
+  return order;
+}
+
+static void kdtree_batch_stack_ensure(KDTreeBatchStack *batch_stack)
+{
+  if (batch_stack->stack == NULL) {
+    batch_stack->stack_len_capacity = KD_STACK_INIT;
+    batch_stack->stack = MEM_mallocN(sizeof(uint) * KD_STACK_INIT, "KDTree.treestack");
+  }
+}
+
+static void kdtree_batch_stack_free(const void *__restrict UNUSED(userdata),
+                                    void *__restrict chunk)
+{
+  KDTreeBatchStack *batch_stack = chunk;
+  MEM_SAFE_FREE(batch_stack->stack);
+}
+
+/** Run \a func for every chunk of the sorted queries, with a #KDTreeBatchStack per thread. */
+static void kdtree_batch_run(const uint co_len, void *userdata, TaskParallelRangeFunc func)
+{
+  KDTreeBatchStack batch_stack = {NULL, 0};
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (co_len > KD_BATCH_CHUNK_SIZE);
+  settings.userdata_chunk = &batch_stack;
+  settings.userdata_chunk_size = sizeof(batch_stack);
+  settings.func_free = kdtree_batch_stack_free;
+  BLI_task_parallel_range(
+      0, (int)divide_ceil_u(co_len, KD_BATCH_CHUNK_SIZE), userdata, func, &settings);
+}
+
+BLI_INLINE bool nearest_n_is_candidate(const KDTreeNearest *nearest,
+                                       const uint nearest_len,
+                                       const uint nearest_len_capacity,
+                                       const float bound_sq,
+                                       const float dist_sq)
+{
+  if (nearest_len < nearest_len_capacity) {
+    return dist_sq <= bound_sq;
+  }
+  return dist_sq < nearest[nearest_len - 1].dist;
+}
+
+/**
+ * A version of #BLI_kdtree_3d_find_nearest_n which only finds points within \a bound_sq
+ * until all nearest are found, using the stack of the calling thread.
+ */
+static uint kdtree_find_nearest_n_bounded(const KDTree *tree,
+                                          const float co[KD_DIMS],
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          const float bound_sq,
+                                          KDTreeBatchStack *batch_stack)
+{
+  const KDTreeNode *nodes = tree->nodes;
+  uint *stack = batch_stack->stack;
+  uint stack_len_capacity = batch_stack->stack_len_capacity;
+  float cur_dist;
+  uint cur = 0;
+  uint i, nearest_len = 0;
+
+  stack[cur++] = tree->root;
+
+  while (cur--) {
+    const KDTreeNode *node = &nodes[stack[cur]];
+
+    cur_dist = node->co[node->d] - co[node->d];
+
+    if (cur_dist < 0.0f) {
+      cur_dist = -cur_dist * cur_dist;
+
+      if (nearest_n_is_candidate(
+              r_nearest, nearest_len, nearest_len_capacity, bound_sq, -cur_dist)) {
+        cur_dist = len_squared_vnvn(node->co, co);
+        if (nearest_n_is_candidate(
+                r_nearest, nearest_len, nearest_len_capacity, bound_sq, cur_dist)) {
+          nearest_ordered_insert(
+              r_nearest, &nearest_len, nearest_len_capacity, node->index, cur_dist, node->co);
+        }
+
+        if (node->left != KD_NODE_UNSET) {
+          stack[cur++] = node->left;
+        }
+      }
+      if (node->right != KD_NODE_UNSET) {
+        stack[cur++] = node->right;
+      }
+    }
+    else {
+      cur_dist = cur_dist * cur_dist;
+
+      if (nearest_n_is_candidate(
+              r_nearest, nearest_len, nearest_len_capacity, bound_sq, cur_dist)) {
+        cur_dist = len_squared_vnvn(node->co, co);
+        if (nearest_n_is_candidate(
+                r_nearest, nearest_len, nearest_len_capacity, bound_sq, cur_dist)) {
+          nearest_ordered_insert(
+              r_nearest, &nearest_len, nearest_len_capacity, node->index, cur_dist, node->co);
+        }
+
+        if (node->right != KD_NODE_UNSET) {
+          stack[cur++] = node->right;
+        }
+      }
+      if (node->left != KD_NODE_UNSET) {
+        stack[cur++] = node->left;
+      }
+    }
+    if (UNLIKELY(cur + KD_DIMS > stack_len_capacity)) {
+      stack = realloc_nodes(stack, &stack_len_capacity, true);
+    }
+  }
+
+  for (i = 0; i < nearest_len; i++) {
+    r_nearest[i].dist = sqrtf(r_nearest[i].dist);
+  }
+
+  batch_stack->stack = stack;
+  batch_stack->stack_len_capacity = stack_len_capacity;
+
+  return nearest_len;
+}
+
+typedef struct KDTreeBatchNearestData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  uint co_len;
+  const uint *order;
+  KDTreeNearest *r_nearest;
+  uint nearest_len_capacity;
+  int *r_nearest_len;
+} KDTreeBatchNearestData;
+
+static void kdtree_batch_find_nearest_n_task_cb(void *__restrict userdata,
+                                                const int chunk,
+                                                const TaskParallelTLS *__restrict tls)
+{
+  const KDTreeBatchNearestData *data = userdata;
+  KDTreeBatchStack *batch_stack = tls->userdata_chunk;
+  const uint nearest_len_capacity = data->nearest_len_capacity;
+  const uint begin = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = min_uu(begin + KD_BATCH_CHUNK_SIZE, data->co_len);
+
+  kdtree_batch_stack_ensure(batch_stack);
+
+  const KDTreeNearest *nearest_prev = NULL;
+  uint nearest_prev_len = 0;
+
+  for (uint i = begin; i < end; i++) {
+    const uint co_index = data->order[i];
+    const float *co = data->co[co_index];
+    KDTreeNearest *nearest = &data->r_nearest[(size_t)co_index * nearest_len_capacity];
+
+    /* The nearest points of the previous query are candidates for this one too,
+     * so the nearest points are at most as far as the furthest of them. */
+    float bound_sq = INFINITY;
+    if (nearest_prev_len == nearest_len_capacity) {
+      bound_sq = 0.0f;
+      for (uint j = 0; j < nearest_prev_len; j++) {
+        bound_sq = max_ff(bound_sq, len_squared_vnvn(nearest_prev[j].co, co));
+      }
+    }
+
+    const uint nearest_len = kdtree_find_nearest_n_bounded(
+        data->tree, co, nearest, nearest_len_capacity, bound_sq, batch_stack);
+    for (uint j = nearest_len; j < nearest_len_capacity; j++) {
+      nearest[j].index = -1;
+    }
+    if (data->r_nearest_len) {
+      data->r_nearest_len[co_index] = (int)nearest_len;
+    }
+
+    nearest_prev = nearest;
+    nearest_prev_len = nearest_len;
+  }
+}
+
+/**
+ * Batch version of #BLI_kdtree_3d_find_nearest_n.
+ *
+ * \param r_nearest: An array sized at least `co_len * nearest_len_capacity`,
+ * the results of every query are sorted by distance, entries without a result have index -1.
+ * \param r_nearest_len: Optional array of the number of results for every query.
+ */
+void BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                          const float (*co)[KD_DIMS],
+                                          const int co_len,
+                                          KDTreeNearest *r_nearest,
+                                          const uint nearest_len_capacity,
+                                          int *r_nearest_len)
+{
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  if (UNLIKELY(co_len <= 0 || nearest_len_capacity == 0)) {
+    return;
+  }
+
+  if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
+    for (size_t i = 0; i < (size_t)co_len * nearest_len_capacity; i++) {
+      r_nearest[i].index = -1;
+    }
+    if (r_nearest_len) {
+      memset(r_nearest_len, 0, sizeof(*r_nearest_len) * (size_t)co_len);
+    }
+    return;
+  }
+
+  KDTreeBatchNearestData data;
+  data.tree = tree;
+  data.co = co;
+  data.co_len = (uint)co_len;
+  data.order = kdtree_batch_order(co, (uint)co_len);
+  data.r_nearest = r_nearest;
+  data.nearest_len_capacity = nearest_len_capacity;
+  data.r_nearest_len = r_nearest_len;
+
+  kdtree_batch_run((uint)co_len, &data, kdtree_batch_find_nearest_n_task_cb);
+
+  MEM_freeN((void *)data.order);
+}
+
+/**
+ * Batch version of #BLI_kdtree_3d_find_nearest.
+ *
+ * \param r_nearest: An array sized at least \a co_len, queries without a result have index -1.
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const int co_len,
+                                        KDTreeNearest *r_nearest)
+{
+  BLI_kdtree_nd_(find_nearest_n_batch)(tree, co, co_len, r_nearest, 1, NULL);
+}
+
+typedef struct KDTreeBatchRangeData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  uint co_len;
+  const uint *order;
+  float range;
+  bool (*search_cb)(
+      void *user_data, int co_index, int index, const float co[KD_DIMS], float dist_sq);
+  void *user_data;
+} KDTreeBatchRangeData;
+
+static void kdtree_batch_range_search_task_cb(void *__restrict userdata,
+                                              const int chunk,
+                                              const TaskParallelTLS *__restrict tls)
+{
+  const KDTreeBatchRangeData *data = userdata;
+  KDTreeBatchStack *batch_stack = tls->userdata_chunk;
+  const KDTreeNode *nodes = data->tree->nodes;
+  const float range = data->range;
+  const float range_sq = range * range;
+  const uint begin = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = min_uu(begin + KD_BATCH_CHUNK_SIZE, data->co_len);
+
+  kdtree_batch_stack_ensure(batch_stack);
+  uint *stack = batch_stack->stack;
+  uint stack_len_capacity = batch_stack->stack_len_capacity;
+
+  for (uint i = begin; i < end; i++) {
+    const uint co_index = data->order[i];
+    const float *co = data->co[co_index];
+    uint cur = 0;
+
+    stack[cur++] = data->tree->root;
+
+    while (cur--) {
+      const KDTreeNode *node = &nodes[stack[cur]];
+
+      if (co[node->d] + range < node->co[node->d]) {
+        if (node->left != KD_NODE_UNSET) {
+          stack[cur++] = node->left;
+        }
+      }
+      else if (co[node->d] - range > node->co[node->d]) {
+        if (node->right != KD_NODE_UNSET) {
+          stack[cur++] = node->right;
+        }
+      }
+      else {
+        const float dist_sq = len_squared_vnvn(node->co, co);
+        if (dist_sq <= range_sq) {
+          if (data->search_cb(data->user_data, (int)co_index, node->index, node->co, dist_sq) ==
+              false)
+          {
+            break;
+          }
+        }
+
+        if (node->left != KD_NODE_UNSET) {
+          stack[cur++] = node->left;
+        }
+        if (node->right != KD_NODE_UNSET) {
+          stack[cur++] = node->right;
+        }
+      }
+
+      if (UNLIKELY(cur + KD_DIMS > stack_len_capacity)) {
+        stack = realloc_nodes(stack, &stack_len_capacity, true);
+      }
+    }
+  }
+
+  batch_stack->stack = stack;
+  batch_stack->stack_len_capacity = stack_len_capacity;
+}
+
+/**
+ * Batch version of #BLI_kdtree_3d_range_search_cb.
+ *
+ * \param search_cb: Called for every node found in \a range of the query at \a co_index,
+ * false return value ends the search of that query.
+ *
+ * \note The callback runs on multiple threads at once.
+ */
+void BLI_kdtree_nd_(range_search_batch_cb)(
+    const KDTree *tree,
+    const float (*co)[KD_DIMS],
+    const int co_len,
+    const float range,
+    bool (*search_cb)(
+        void *user_data, int co_index, int index, const float co[KD_DIMS], float dist_sq),
+    void *user_data)
+{
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  if (UNLIKELY(co_len <= 0 || tree->root == KD_NODE_UNSET)) {
+    return;
+  }
+
+  KDTreeBatchRangeData data;
+  data.tree = tree;
+  data.co = co;
+  data.co_len = (uint)co_len;
+  data.order = kdtree_batch_order(co, (uint)co_len);
+  data.range = range;
+  data.search_cb = search_cb;
+  data.user_data = user_data;
+
+  kdtree_batch_run((uint)co_len, &data, kdtree_batch_range_search_task_cb);
+
+  MEM_freeN((void *)data.order);
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
@@ -47,6 +47,36 @@ TEST(kdopbvh, Single)
   BLI_bvhtree_free(tree);
 }
 
+/* The wide layout built when balancing has to be rebuilt when the tree is balanced again. */
+TEST(kdopbvh, BalanceTwice)
+{
+  const int points_len = 1000;
+  struct RNG *rng = BLI_rng_new(3);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0f, 4, 6);
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  /* Move a point far away from all others, the old layout would not contain it. */
+  const float moved_co[3] = {10.0f, 10.0f, 10.0f};
+  copy_v3_v3(points[0], moved_co);
+  BLI_bvhtree_update_node(tree, 0, moved_co, nullptr, 1);
+  BLI_bvhtree_balance(tree);
+
+  BVHTreeNearest nearest;
+  nearest.index = -1;
+  nearest.dist_sq = FLT_MAX;
+  const float search_co[3] = {9.0f, 9.0f, 9.0f};
+  EXPECT_EQ(BLI_bvhtree_find_nearest(tree, search_co, &nearest, nullptr, nullptr), 0);
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+}
+
 static void optimal_check_callback(void *userdata,
                                    int index,
                                    const float co[3],
@@ -66,8 +96,12 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     eBVHBuildQuality quality = BVH_BUILD_QUALITY_HIGH)
 {
   struct RNG *rng = BLI_rng_new(random_seed);
   BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
@@ -79,7 +113,7 @@ static void find_nearest_points_test(
     rng_v3_round(points[i], 3, rng, round, scale);
     BLI_bvhtree_insert(tree, i, points[i], 1);
   }
-  BLI_bvhtree_balance(tree);
+  BLI_bvhtree_balance_ex(tree, quality);
 
   /* first find each point */
   BVHTree_NearestPointCallback callback = optimal ? optimal_check_callback : nullptr;
@@ -132,3 +166,334 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+TEST(kdopbvh, FastBuildFindNearest_2)
+{
+  find_nearest_points_test(2, 1.0, 1000, 123, false, BVH_BUILD_QUALITY_FAST);
+}
+TEST(kdopbvh, FastBuildFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, BVH_BUILD_QUALITY_FAST);
+}
+TEST(kdopbvh, FastBuildFindNearest_40000)
+{
+  find_nearest_points_test(40000, 1.0, 100000, 12, false, BVH_BUILD_QUALITY_FAST);
+}
+TEST(kdopbvh, FastBuildOptimalFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, true, BVH_BUILD_QUALITY_FAST);
+}
+
+#define RAY_CAST_POINT_RADIUS 0.01f
+
+/**
+ * Intersect the ray, grown by its radius, with a small sphere around the point.
+ */
+static void point_spherecast_callback(void *userdata,
+                                      int index,
+                                      const BVHTreeRay *ray,
+                                      BVHTreeRayHit *hit)
+{
+  const float(*points)[3] = (const float(*)[3])userdata;
+  const float radius = RAY_CAST_POINT_RADIUS + ray->radius;
+  float offset[3];
+  sub_v3_v3v3(offset, ray->origin, points[index]);
+  const float b = dot_v3v3(ray->direction, offset);
+  const float discriminant = b * b - (len_squared_v3(offset) - radius * radius);
+  if (discriminant < 0.0f) {
+    return;
+  }
+  const float dist = -b - sqrtf(discriminant);
+  if (dist >= 0.0f && dist < hit->dist) {
+    hit->index = index;
+    hit->dist = dist;
+    madd_v3_v3v3fl(hit->co, ray->origin, ray->direction, dist);
+  }
+}
+
+static void point_spherecast_packet_callback(
+    void *userdata, int index, const BVHTreeRay *rays, BVHTreeRayHit *hits, uint ray_mask)
+{
+  for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+    if (ray_mask & (1u << i)) {
+      point_spherecast_callback(userdata, index, &rays[i], &hits[i]);
+    }
+  }
+}
+
+/**
+ * Cast rays at random points one by one and as a batch, both have to find the same hits.
+ * With \a use_callbacks, the batch uses a packet callback, which has to find the same hits as
+ * the callback for single rays. With \a packet_callback_only, the batch is not given the callback
+ * for single rays.
+ */
+static void ray_cast_batch_test(int points_len,
+                                int rays_len,
+                                float radius,
+                                bool use_callbacks,
+                                int random_seed,
+                                int tree_type = 6,
+                                bool packet_callback_only = false)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.01f, 4, tree_type);
+
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  float(*origins)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  float(*directions)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(BVHTreeRayHit) * rays_len, __func__);
+  for (int i = 0; i < rays_len; i++) {
+    rng_v3_round(origins[i], 3, rng, 1000, 2.0f);
+    /* Aim half of the rays at points. */
+    if (i % 2 == 0) {
+      sub_v3_v3v3(directions[i], points[i % points_len], origins[i]);
+    }
+    else {
+      rng_v3_round(directions[i], 3, rng, 1000, 1.0f);
+    }
+    normalize_v3(directions[i]);
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+
+  BVHTree_RayCastCallback callback = use_callbacks ? point_spherecast_callback : nullptr;
+  BLI_bvhtree_ray_cast_batch(tree,
+                             origins,
+                             directions,
+                             rays_len,
+                             radius,
+                             hits,
+                             packet_callback_only ? nullptr : callback,
+                             use_callbacks ? point_spherecast_packet_callback : nullptr,
+                             points);
+
+  for (int i = 0; i < rays_len; i++) {
+    BVHTreeRayHit hit;
+    hit.index = -1;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree, origins[i], directions[i], radius, &hit, callback, points);
+    /* Rays with a radius starting inside the bounds of several leaves hit all of them at zero
+     * distance, which one is found first depends on the traversal order. */
+    if (callback || radius == 0.0f || hit.dist > 0.0f) {
+      EXPECT_EQ(hits[i].index, hit.index);
+    }
+    else {
+      EXPECT_EQ(hits[i].index == -1, hit.index == -1);
+    }
+    if (hit.index != -1) {
+      EXPECT_NEAR(hits[i].dist, hit.dist, 1e-4f);
+    }
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+  MEM_freeN(origins);
+  MEM_freeN(directions);
+  MEM_freeN(hits);
+}
+
+TEST(kdopbvh, RayCastBatch_10)
+{
+  ray_cast_batch_test(100, 10, 0.0f, false, 1234);
+}
+TEST(kdopbvh, RayCastBatch_10000)
+{
+  ray_cast_batch_test(500, 10000, 0.0f, false, 12);
+}
+TEST(kdopbvh, RayCastBatchRadius_10000)
+{
+  ray_cast_batch_test(500, 10000, 0.05f, false, 12);
+}
+TEST(kdopbvh, RayCastBatchPacketCallback_10000)
+{
+  ray_cast_batch_test(500, 10000, 0.0f, true, 12);
+}
+TEST(kdopbvh, RayCastBatchPacketCallbackRadius_10000)
+{
+  ray_cast_batch_test(500, 10000, 0.05f, true, 12);
+}
+/* Trees with 18 axes are not traversed with packets, the rays are cast one by one. */
+TEST(kdopbvh, RayCastBatchAxis18_1000)
+{
+  ray_cast_batch_test(500, 1000, 0.0f, false, 12, 18);
+}
+TEST(kdopbvh, RayCastBatchAxis18PacketCallbackOnly_1000)
+{
+  ray_cast_batch_test(500, 1000, 0.0f, true, 12, 18, true);
+}
+TEST(kdopbvh, RayCastBatchPacketCallbackOnly_10000)
+{
+  ray_cast_batch_test(500, 10000, 0.0f, true, 12, 6, true);
+}
+
+static void range_query_count_callback(void *userdata,
+                                       int /*index*/,
+                                       const float /*co*/[3],
+                                       float /*dist_sq*/)
+{
+  (*(int *)userdata)++;
+}
+
+static bool overlap_skip_same_callback(void * /*userdata*/,
+                                       int index_a,
+                                       int index_b,
+                                       int /*thread*/)
+{
+  return index_a != index_b;
+}
+
+/**
+ * Trees of axis aligned bounding boxes use wide nodes, other trees do not.
+ * Both have to find the same distances, as these queries only use the X, Y and Z bounds.
+ */
+static void wide_nodes_test(int points_len, char tree_type, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree_wide = BLI_bvhtree_new(points_len, 0.01f, tree_type, 6);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.01f, tree_type, 8);
+
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 100000, 1.0f);
+    BLI_bvhtree_insert(tree_wide, i, points[i], 1);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree_wide);
+  BLI_bvhtree_balance(tree);
+
+  for (int i = 0; i < 100; i++) {
+    float co[3], dir[3];
+    rng_v3_round(co, 3, rng, 1000, 1.2f);
+    rng_v3_round(dir, 3, rng, 1000, 1.0f);
+    normalize_v3(dir);
+
+    BVHTreeNearest nearest_wide, nearest;
+    nearest_wide.index = nearest.index = -1;
+    nearest_wide.dist_sq = nearest.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree_wide, co, &nearest_wide, nullptr, nullptr);
+    BLI_bvhtree_find_nearest(tree, co, &nearest, nullptr, nullptr);
+    EXPECT_EQ(nearest_wide.dist_sq, nearest.dist_sq);
+
+    int hits_wide = 0, hits = 0;
+    BLI_bvhtree_range_query(tree_wide, co, 0.1f, range_query_count_callback, &hits_wide);
+    BLI_bvhtree_range_query(tree, co, 0.1f, range_query_count_callback, &hits);
+    EXPECT_EQ(hits_wide, hits);
+
+    BVHTreeRayHit hit_wide, hit;
+    hit_wide.index = hit.index = -1;
+    hit_wide.dist = hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree_wide, co, dir, 0.01f, &hit_wide, nullptr, nullptr);
+    BLI_bvhtree_ray_cast(tree, co, dir, 0.01f, &hit, nullptr, nullptr);
+    EXPECT_EQ(hit_wide.index == -1, hit.index == -1);
+    EXPECT_EQ(hit_wide.dist, hit.dist);
+  }
+
+  uint overlap_wide_num = 0, overlap_num = 0;
+  BVHTreeOverlap *overlap_wide = BLI_bvhtree_overlap(
+      tree_wide, tree_wide, &overlap_wide_num, overlap_skip_same_callback, nullptr);
+  /* Wide nodes are only used when both trees have them. */
+  BVHTreeOverlap *overlap = BLI_bvhtree_overlap(
+      tree, tree_wide, &overlap_num, overlap_skip_same_callback, nullptr);
+  EXPECT_EQ(overlap_wide_num, overlap_num);
+
+  MEM_SAFE_FREE(overlap_wide);
+  MEM_SAFE_FREE(overlap);
+  BLI_bvhtree_free(tree_wide);
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+}
+
+TEST(kdopbvh, WideNodes_1)
+{
+  wide_nodes_test(1, 4, 1234);
+}
+TEST(kdopbvh, WideNodes_1000)
+{
+  wide_nodes_test(1000, 2, 12);
+  wide_nodes_test(1000, 4, 12);
+}
+
+static int refit_points_callback(void *userdata, int index, float (*r_co)[3])
+{
+  const float(*points)[3] = static_cast<const float(*)[3]>(userdata);
+  copy_v3_v3(r_co[0], points[index]);
+  return 1;
+}
+
+/**
+ * Refitting a tree to moved points has to find the same results as building a new tree.
+ * Moving all points by the same amount keeps the cost of the tree, moving them randomly does not.
+ */
+static void refit_test(int points_len, int random_seed)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0f, 4, 6);
+
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 100000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+  const float cost = BLI_bvhtree_sah_cost(tree);
+
+  const float offset[3] = {1.0f, -2.0f, 0.5f};
+  for (int i = 0; i < points_len; i++) {
+    add_v3_v3(points[i], offset);
+  }
+  BLI_bvhtree_refit(tree, refit_points_callback, points);
+  EXPECT_NEAR(BLI_bvhtree_sah_cost(tree), cost, cost * 1e-4f);
+
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 100000, 1.0f);
+  }
+  BLI_bvhtree_refit(tree, refit_points_callback, points);
+  if (points_len > 100) {
+    EXPECT_GT(BLI_bvhtree_sah_cost(tree), cost);
+  }
+
+  BVHTree *tree_new = BLI_bvhtree_new(points_len, 0.0f, 4, 6);
+  for (int i = 0; i < points_len; i++) {
+    BLI_bvhtree_insert(tree_new, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree_new);
+
+  for (int i = 0; i < 100; i++) {
+    float co[3];
+    rng_v3_round(co, 3, rng, 1000, 1.2f);
+
+    BVHTreeNearest nearest_refit, nearest;
+    nearest_refit.index = nearest.index = -1;
+    nearest_refit.dist_sq = nearest.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree, co, &nearest_refit, nullptr, nullptr);
+    BLI_bvhtree_find_nearest(tree_new, co, &nearest, nullptr, nullptr);
+    EXPECT_EQ(nearest_refit.dist_sq, nearest.dist_sq);
+
+    int hits_refit = 0, hits = 0;
+    BLI_bvhtree_range_query(tree, co, 0.1f, range_query_count_callback, &hits_refit);
+    BLI_bvhtree_range_query(tree_new, co, 0.1f, range_query_count_callback, &hits);
+    EXPECT_EQ(hits_refit, hits);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_bvhtree_free(tree_new);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+}
+
+TEST(kdopbvh, Refit_1)
+{
+  refit_test(1, 1234);
+}
+TEST(kdopbvh, Refit_10000)
+{
+  refit_test(10000, 12);
+}
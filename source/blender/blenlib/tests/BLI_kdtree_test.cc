@@ -2,7 +2,10 @@
 
 #include "testing/testing.h"
 
+#include "MEM_guardedalloc.h"
+
 #include "BLI_kdtree.h"
+#include "BLI_rand.h"
 
 #include <cmath>
 
@@ -52,6 +55,164 @@ static void deduplicate_test()
   }
 }
 
+static void rng_points(RNG *rng, float (*co)[3], const int co_len)
+{
+  for (int i = 0; i < co_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, co[i]);
+  }
+}
+
+static KDTree_3d *kdtree_from_points(const float (*co)[3], const int co_len, const bool threaded)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(co_len);
+  for (int i = 0; i < co_len; i++) {
+    BLI_kdtree_3d_insert(tree, i, co[i]);
+  }
+  BLI_kdtree_3d_balance_ex(tree, threaded);
+  return tree;
+}
+
+static void find_nearest_batch_test(const int points_len, const int queries_len)
+{
+  RNG *rng = BLI_rng_new(points_len);
+  float(*points)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(points_len, sizeof(*points), __func__));
+  float(*queries)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(queries_len, sizeof(*queries), __func__));
+  rng_points(rng, points, points_len);
+  rng_points(rng, queries, queries_len);
+
+  KDTree_3d *tree = kdtree_from_points(points, points_len, false);
+  KDTreeNearest_3d *nearest = static_cast<KDTreeNearest_3d *>(
+      MEM_malloc_arrayN(queries_len, sizeof(*nearest), __func__));
+  BLI_kdtree_3d_find_nearest_batch(tree, queries, queries_len, nearest);
+
+  for (int i = 0; i < queries_len; i++) {
+    KDTreeNearest_3d expected;
+    EXPECT_EQ(nearest[i].index, BLI_kdtree_3d_find_nearest(tree, queries[i], &expected));
+    EXPECT_EQ(nearest[i].dist, expected.dist);
+  }
+
+  MEM_freeN(nearest);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+  BLI_rng_free(rng);
+}
+
+static void find_nearest_n_batch_test(const int points_len,
+                                      const int queries_len,
+                                      const int nearest_len_capacity)
+{
+  RNG *rng = BLI_rng_new(points_len);
+  float(*points)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(points_len, sizeof(*points), __func__));
+  float(*queries)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(queries_len, sizeof(*queries), __func__));
+  rng_points(rng, points, points_len);
+  rng_points(rng, queries, queries_len);
+
+  KDTree_3d *tree = kdtree_from_points(points, points_len, false);
+  KDTreeNearest_3d *nearest = static_cast<KDTreeNearest_3d *>(
+      MEM_malloc_arrayN(queries_len * nearest_len_capacity, sizeof(*nearest), __func__));
+  int *nearest_len = static_cast<int *>(
+      MEM_malloc_arrayN(queries_len, sizeof(*nearest_len), __func__));
+  BLI_kdtree_3d_find_nearest_n_batch(
+      tree, queries, queries_len, nearest, nearest_len_capacity, nearest_len);
+
+  KDTreeNearest_3d *expected = static_cast<KDTreeNearest_3d *>(
+      MEM_malloc_arrayN(nearest_len_capacity, sizeof(*expected), __func__));
+  for (int i = 0; i < queries_len; i++) {
+    const int expected_len = BLI_kdtree_3d_find_nearest_n(
+        tree, queries[i], expected, nearest_len_capacity);
+    EXPECT_EQ(nearest_len[i], expected_len);
+    const KDTreeNearest_3d *query_nearest = &nearest[i * nearest_len_capacity];
+    for (int j = 0; j < expected_len; j++) {
+      EXPECT_EQ(query_nearest[j].index, expected[j].index);
+      EXPECT_EQ(query_nearest[j].dist, expected[j].dist);
+    }
+    for (int j = expected_len; j < nearest_len_capacity; j++) {
+      EXPECT_EQ(query_nearest[j].index, -1);
+    }
+  }
+
+  MEM_freeN(expected);
+  MEM_freeN(nearest_len);
+  MEM_freeN(nearest);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+  BLI_rng_free(rng);
+}
+
+static void range_search_batch_test(const int points_len, const int queries_len)
+{
+  const float range = 0.1f;
+  RNG *rng = BLI_rng_new(points_len);
+  float(*points)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(points_len, sizeof(*points), __func__));
+  float(*queries)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(queries_len, sizeof(*queries), __func__));
+  rng_points(rng, points, points_len);
+  rng_points(rng, queries, queries_len);
+
+  KDTree_3d *tree = kdtree_from_points(points, points_len, false);
+  int *found_len = static_cast<int *>(
+      MEM_calloc_arrayN(queries_len, sizeof(*found_len), __func__));
+  BLI_kdtree_3d_range_search_batch_cb_cpp(
+      tree,
+      queries,
+      queries_len,
+      range,
+      [&](const int co_index, const int /*index*/, const float * /*co*/, const float dist_sq) {
+        EXPECT_LE(dist_sq, range * range);
+        found_len[co_index]++;
+        return true;
+      });
+
+  for (int i = 0; i < queries_len; i++) {
+    KDTreeNearest_3d *expected = nullptr;
+    EXPECT_EQ(found_len[i], BLI_kdtree_3d_range_search(tree, queries[i], &expected, range));
+    MEM_SAFE_FREE(expected);
+  }
+
+  MEM_freeN(found_len);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+  BLI_rng_free(rng);
+}
+
+static void balance_threaded_test(const int points_len)
+{
+  RNG *rng = BLI_rng_new(points_len);
+  float(*points)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(points_len, sizeof(*points), __func__));
+  rng_points(rng, points, points_len);
+
+  KDTree_3d *tree = kdtree_from_points(points, points_len, false);
+  KDTree_3d *tree_threaded = kdtree_from_points(points, points_len, true);
+
+  /* Both trees have the same layout, so the range search results are in the same order. */
+  for (int i = 0; i < 1000; i++) {
+    float co[3];
+    BLI_rng_get_float_unit_v3(rng, co);
+    KDTreeNearest_3d *nearest = nullptr, *nearest_threaded = nullptr;
+    const int nearest_len = BLI_kdtree_3d_range_search(tree, co, &nearest, 0.1f);
+    EXPECT_EQ(nearest_len, BLI_kdtree_3d_range_search(tree_threaded, co, &nearest_threaded, 0.1f));
+    for (int j = 0; j < nearest_len; j++) {
+      EXPECT_EQ(nearest[j].index, nearest_threaded[j].index);
+    }
+    MEM_SAFE_FREE(nearest);
+    MEM_SAFE_FREE(nearest_threaded);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  BLI_kdtree_3d_free(tree_threaded);
+  MEM_freeN(points);
+  BLI_rng_free(rng);
+}
+
 TEST(kdtree, Standard)
 {
   standard_test();
@@ -61,3 +222,26 @@ TEST(kdtree, Deduplicate)
 {
   deduplicate_test();
 }
+
+TEST(kdtree, FindNearestBatch)
+{
+  find_nearest_batch_test(1, 10);
+  find_nearest_batch_test(1000, 10000);
+}
+
+TEST(kdtree, FindNearestNBatch)
+{
+  find_nearest_n_batch_test(3, 100, 5);
+  find_nearest_n_batch_test(1000, 10000, 1);
+  find_nearest_n_batch_test(1000, 10000, 8);
+}
+
+TEST(kdtree, RangeSearchBatch)
+{
+  range_search_batch_test(1000, 10000);
+}
+
+TEST(kdtree, BalanceThreaded)
+{
+  balance_threaded_test(100000);
+}
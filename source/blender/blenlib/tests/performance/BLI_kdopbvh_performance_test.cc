@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+#include "BLI_utildefines.h"
+
+#include "PIL_time.h"
+
+/* To compare with the tree layout without wide nodes, disable `USE_WIDE_NODES` in
+ * `BLI_kdopbvh.c`. */
+
+#define QUERIES_NUM 1000000
+
+/* Triangles of a wavy grid of `resolution * resolution` quads, offset along Z. */
+static BVHTree *bvhtree_from_wavy_grid(const int resolution,
+                                       const float offset,
+                                       const int tree_type,
+                                       const eBVHBuildQuality quality)
+{
+  const int tris_num = resolution * resolution * 2;
+  BVHTree *tree = BLI_bvhtree_new(tris_num, 0.0f, char(tree_type), 6);
+
+  int tri_index = 0;
+  for (int y = 0; y < resolution; y++) {
+    for (int x = 0; x < resolution; x++) {
+      float quad[4][3];
+      for (int corner = 0; corner < 4; corner++) {
+        const float fx = float(x + (corner & 1)) / float(resolution);
+        const float fy = float(y + (corner >> 1)) / float(resolution);
+        copy_v3_fl3(quad[corner], fx, fy, 0.1f * sinf(fx * 20.0f) * cosf(fy * 13.0f) + offset);
+      }
+      float tri[3][3];
+      copy_v3_v3(tri[0], quad[0]);
+      copy_v3_v3(tri[1], quad[1]);
+      copy_v3_v3(tri[2], quad[3]);
+      BLI_bvhtree_insert(tree, tri_index++, tri[0], 3);
+      copy_v3_v3(tri[1], quad[3]);
+      copy_v3_v3(tri[2], quad[2]);
+      BLI_bvhtree_insert(tree, tri_index++, tri[0], 3);
+    }
+  }
+  BLI_bvhtree_balance_ex(tree, quality);
+  return tree;
+}
+
+static void range_query_count_cb(void *userdata,
+                                 int /*index*/,
+                                 const float /*co*/[3],
+                                 float /*dist_sq*/)
+{
+  (*static_cast<int *>(userdata))++;
+}
+
+static void kdopbvh_queries_test(const char *id,
+                                 const int resolution,
+                                 const int tree_type,
+                                 const eBVHBuildQuality quality = BVH_BUILD_QUALITY_HIGH)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  double time = PIL_check_seconds_timer();
+  BVHTree *tree = bvhtree_from_wavy_grid(resolution, 0.0f, tree_type, quality);
+  BVHTree *tree_offset = bvhtree_from_wavy_grid(resolution, 0.001f, tree_type, quality);
+  printf("\tBuild %d triangles: %fs\n",
+         BLI_bvhtree_get_len(tree),
+         (PIL_check_seconds_timer() - time) / 2.0);
+
+  RNG *rng = BLI_rng_new(0);
+  /* Accumulate the results to avoid the queries being optimized out. */
+  double result = 0.0;
+
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < QUERIES_NUM; i++) {
+    float co[3];
+    copy_v3_fl3(
+        co, BLI_rng_get_float(rng), BLI_rng_get_float(rng), BLI_rng_get_float(rng) * 0.4f - 0.2f);
+    BVHTreeNearest nearest;
+    nearest.index = -1;
+    nearest.dist_sq = FLT_MAX;
+    BLI_bvhtree_find_nearest(tree, co, &nearest, nullptr, nullptr);
+    result += nearest.dist_sq;
+  }
+  printf("\tFind nearest: %fs\n", PIL_check_seconds_timer() - time);
+
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < QUERIES_NUM; i++) {
+    float co[3], dir[3];
+    copy_v3_fl3(co, BLI_rng_get_float(rng), BLI_rng_get_float(rng), 1.0f);
+    copy_v3_fl3(dir, BLI_rng_get_float(rng) - 0.5f, BLI_rng_get_float(rng) - 0.5f, -1.0f);
+    normalize_v3(dir);
+    BVHTreeRayHit hit;
+    hit.index = -1;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree, co, dir, 0.0f, &hit, nullptr, nullptr);
+    result += hit.dist;
+  }
+  printf("\tRay-cast: %fs\n", PIL_check_seconds_timer() - time);
+
+  time = PIL_check_seconds_timer();
+  int range_hits = 0;
+  for (int i = 0; i < QUERIES_NUM; i++) {
+    float co[3];
+    copy_v3_fl3(co, BLI_rng_get_float(rng), BLI_rng_get_float(rng), 0.0f);
+    BLI_bvhtree_range_query(tree, co, 0.01f, range_query_count_cb, &range_hits);
+  }
+  printf("\tRange query: %fs (%d hits)\n", PIL_check_seconds_timer() - time, range_hits);
+
+  time = PIL_check_seconds_timer();
+  uint overlap_num = 0;
+  BVHTreeOverlap *overlap = BLI_bvhtree_overlap(tree, tree_offset, &overlap_num, nullptr, nullptr);
+  printf("\tOverlap: %fs (%u pairs)\n", PIL_check_seconds_timer() - time, overlap_num);
+  MEM_SAFE_FREE(overlap);
+
+  printf("\tResult: %f\n", result);
+
+  BLI_rng_free(rng);
+  BLI_bvhtree_free(tree);
+  BLI_bvhtree_free(tree_offset);
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(kdopbvh, Queries1M)
+{
+  kdopbvh_queries_test("BVH tree queries - 1M triangles - Quad tree", 707, 4);
+}
+
+TEST(kdopbvh, Queries10M)
+{
+  kdopbvh_queries_test("BVH tree queries - 10M triangles - Quad tree", 2237, 4);
+}
+
+TEST(kdopbvh, Queries10MBinary)
+{
+  kdopbvh_queries_test("BVH tree queries - 10M triangles - Binary tree", 2237, 2);
+}
+
+TEST(kdopbvh, Queries1MFastBuild)
+{
+  kdopbvh_queries_test(
+      "BVH tree queries - 1M triangles - Quad tree - Fast build", 707, 4, BVH_BUILD_QUALITY_FAST);
+}
+
+TEST(kdopbvh, Queries10MFastBuild)
+{
+  kdopbvh_queries_test("BVH tree queries - 10M triangles - Quad tree - Fast build",
+                       2237,
+                       4,
+                       BVH_BUILD_QUALITY_FAST);
+}
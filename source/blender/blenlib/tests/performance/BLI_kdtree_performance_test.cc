@@ -0,0 +1,150 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "BLI_utildefines.h"
+
+#include "PIL_time.h"
+
+#include <cmath>
+
+#define NEAREST_N 8
+
+/* Points of a noisy spherical shell, to get both dense and empty regions. */
+static float (*points_on_shell(const int points_len, const uint seed))[3]
+{
+  float(*points)[3] = static_cast<float(*)[3]>(
+      MEM_malloc_arrayN(points_len, sizeof(*points), __func__));
+  RNG *rng = BLI_rng_new(seed);
+  for (int i = 0; i < points_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, points[i]);
+    const float radius = 1.0f + 0.05f * BLI_rng_get_float(rng);
+    for (int j = 0; j < 3; j++) {
+      points[i][j] *= radius;
+    }
+  }
+  BLI_rng_free(rng);
+  return points;
+}
+
+static bool range_search_count_cb(void *user_data,
+                                  int /*index*/,
+                                  const float * /*co*/,
+                                  float /*dist_sq*/)
+{
+  (*static_cast<int *>(user_data))++;
+  return true;
+}
+
+static void kdtree_queries_test(const char *id, const int points_len, const int queries_len)
+{
+  printf("\n========== STARTING %s ==========\n", id);
+
+  float(*points)[3] = points_on_shell(points_len, 0);
+  float(*queries)[3] = points_on_shell(queries_len, 1);
+  /* Roughly a few points around every query. */
+  const float range = 10.0f / sqrtf(float(points_len));
+
+  KDTree_3d *tree = BLI_kdtree_3d_new(points_len);
+  for (int i = 0; i < points_len; i++) {
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+  }
+  double time = PIL_check_seconds_timer();
+  BLI_kdtree_3d_balance(tree);
+  printf("\tBalance %d points: %fs\n", points_len, PIL_check_seconds_timer() - time);
+  BLI_kdtree_3d_free(tree);
+
+  tree = BLI_kdtree_3d_new(points_len);
+  for (int i = 0; i < points_len; i++) {
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+  }
+  time = PIL_check_seconds_timer();
+  BLI_kdtree_3d_balance_ex(tree, true);
+  printf("\tBalance threaded: %fs\n", PIL_check_seconds_timer() - time);
+
+  /* Accumulate the results to avoid the queries being optimized out. */
+  double result = 0.0;
+  KDTreeNearest_3d *nearest = static_cast<KDTreeNearest_3d *>(
+      MEM_malloc_arrayN(size_t(queries_len) * NEAREST_N, sizeof(*nearest), __func__));
+
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < queries_len; i++) {
+    BLI_kdtree_3d_find_nearest(tree, queries[i], &nearest[i]);
+  }
+  printf("\tFind nearest: %fs\n", PIL_check_seconds_timer() - time);
+  for (int i = 0; i < queries_len; i++) {
+    result += nearest[i].dist;
+  }
+
+  time = PIL_check_seconds_timer();
+  BLI_kdtree_3d_find_nearest_batch(tree, queries, queries_len, nearest);
+  printf("\tFind nearest batch: %fs\n", PIL_check_seconds_timer() - time);
+  for (int i = 0; i < queries_len; i++) {
+    result -= nearest[i].dist;
+  }
+
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < queries_len; i++) {
+    BLI_kdtree_3d_find_nearest_n(tree, queries[i], &nearest[i * NEAREST_N], NEAREST_N);
+  }
+  printf("\tFind nearest %d: %fs\n", NEAREST_N, PIL_check_seconds_timer() - time);
+  for (int i = 0; i < queries_len * NEAREST_N; i++) {
+    result += nearest[i].dist;
+  }
+
+  time = PIL_check_seconds_timer();
+  BLI_kdtree_3d_find_nearest_n_batch(tree, queries, queries_len, nearest, NEAREST_N, nullptr);
+  printf("\tFind nearest %d batch: %fs\n", NEAREST_N, PIL_check_seconds_timer() - time);
+  for (int i = 0; i < queries_len * NEAREST_N; i++) {
+    result -= nearest[i].dist;
+  }
+
+  time = PIL_check_seconds_timer();
+  int range_hits = 0;
+  for (int i = 0; i < queries_len; i++) {
+    BLI_kdtree_3d_range_search_cb(tree, queries[i], range, range_search_count_cb, &range_hits);
+  }
+  printf("\tRange search: %fs (%d hits)\n", PIL_check_seconds_timer() - time, range_hits);
+
+  time = PIL_check_seconds_timer();
+  int *range_hits_batch = static_cast<int *>(
+      MEM_calloc_arrayN(queries_len, sizeof(*range_hits_batch), __func__));
+  BLI_kdtree_3d_range_search_batch_cb_cpp(
+      tree,
+      queries,
+      queries_len,
+      range,
+      [&](const int co_index, const int /*index*/, const float * /*co*/, float /*dist_sq*/) {
+        range_hits_batch[co_index]++;
+        return true;
+      });
+  printf("\tRange search batch: %fs\n", PIL_check_seconds_timer() - time);
+  for (int i = 0; i < queries_len; i++) {
+    range_hits -= range_hits_batch[i];
+  }
+
+  /* Zero when the batch queries found the same results. */
+  printf("\tResult: %f %d\n", result, range_hits);
+
+  MEM_freeN(range_hits_batch);
+  MEM_freeN(nearest);
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(queries);
+
+  printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(kdtree, Queries1M)
+{
+  kdtree_queries_test("KD-tree queries - 1M points", 1000000, 1000000);
+}
+
+TEST(kdtree, Queries10M)
+{
+  kdtree_queries_test("KD-tree queries - 10M points", 10000000, 1000000);
+}
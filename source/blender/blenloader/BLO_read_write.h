@@ -331,3 +331,30 @@ void BLO_reportf_wrap(struct BlendFileReadReport *reports,
 #ifdef __cplusplus
 }
 #endif
+
+#ifdef __cplusplus
+
+namespace blender {
+class ImplicitSharingInfo;
+}
+
+/**
+ * Same as #BLO_read_data_address, but large arrays which don't need any conversion may keep
+ * referencing the memory-mapped file instead of being read, when lazy loading of file data is
+ * enabled. Pages of the file are then only loaded when the array is accessed.
+ *
+ * \return The sharing info owning the array when it references the file. Otherwise null, and the
+ * array is owned by the caller like with #BLO_read_data_address.
+ */
+const blender::ImplicitSharingInfo *BLO_read_mapped_data_address(BlendDataReader *reader,
+                                                                 void **ptr_p,
+                                                                 int64_t alignment);
+
+/**
+ * Check whether the array owned by \a sharing_info references a memory-mapped file, i.e. it was
+ * returned by #BLO_read_mapped_data_address. Such arrays are not allocated with the guarded
+ * allocator.
+ */
+bool BLO_read_is_mapped_data(const blender::ImplicitSharingInfo *sharing_info);
+
+#endif
@@ -80,7 +80,11 @@ typedef struct BlendFileReadReport {
   /* Timing information. */
   struct {
     double whole;
+    /* Reading the data-blocks of the main file. */
+    double read_data;
     double libraries;
+    /* Versioning, before and after linking. */
+    double versioning;
     double lib_overrides;
     double lib_overrides_resync;
     double lib_overrides_recursive_resync;
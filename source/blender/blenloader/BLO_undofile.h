@@ -20,6 +20,10 @@ typedef struct {
   size_t size;
   /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
   bool is_identical;
+  /** When true, this chunk doesn't own the memory either, it was found by content in the previous
+   * step (see #BLO_memfile_chunk_add_array). Unlike #is_identical, it does not mean that the data
+   * at this position is unchanged. */
+  bool is_shared;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
    * detect unchanged IDs).
    * Defined when writing the next step (i.e. last undo step has those always false). */
@@ -27,11 +31,17 @@ typedef struct {
   /** Session UUID of the ID being currently written (MAIN_ID_SESSION_UUID_UNSET when not writing
    * ID-related data). Used to find matching chunks in previous memundo step. */
   uint id_session_uuid;
+  /** Hash of the content, only computed for chunks big enough to be de-duplicated by content. */
+  uint hash;
 } MemFileChunk;
 
 typedef struct MemFile {
   ListBase chunks;
   size_t size;
+  /** Statistics: bytes shared with the previous step at the same position. */
+  size_t identical_size;
+  /** Statistics: bytes shared with the previous step found by their content. */
+  size_t deduplicated_size;
 } MemFile;
 
 typedef struct MemFileWriteData {
@@ -43,6 +53,8 @@ typedef struct MemFileWriteData {
 
   /** Maps an ID session uuid to its first reference MemFileChunk, if existing. */
   struct GHash *id_session_uuid_mapping;
+  /** Maps a content hash to a reference MemFileChunk, to share data which moved. */
+  struct GHash *chunk_store;
 } MemFileWriteData;
 
 typedef struct MemFileUndoData {
@@ -73,6 +85,11 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
 void BLO_memfile_write_finalize(MemFileWriteData *mem_data);
 
 void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size);
+/**
+ * Add a big block of data (typically an array), split into chunks at content-defined boundaries,
+ * so that a local change only affects the chunks around it.
+ */
+void BLO_memfile_chunk_add_array(MemFileWriteData *mem_data, const char *buf, size_t size);
 
 /* exports */
 
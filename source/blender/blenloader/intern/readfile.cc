@@ -50,12 +50,16 @@
 #include "BLI_endian_defines.h"
 #include "BLI_endian_switch.h"
 #include "BLI_ghash.h"
+#include "BLI_implicit_sharing.hh"
 #include "BLI_linklist.h"
 #include "BLI_map.hh"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_mmap.h"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
+#include "BLI_vector.hh"
 
 #include "PIL_time.h"
 
@@ -242,6 +246,9 @@ struct NewAddress {
 
   /** `nr` is "user count" for data, and ID code for libdata. */
   int nr;
+
+  /** When not zero, `newp` points into #FileData.mapped_file and is not owned by the map. */
+  int mapped_len;
 };
 
 struct OldNewMap {
@@ -262,6 +269,18 @@ static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr,
   onm->map.add_overwrite(oldaddr, NewAddress{newaddr, nr});
 }
 
+static void oldnewmap_insert_mapped(OldNewMap *onm,
+                                    const void *oldaddr,
+                                    void *mapped_addr,
+                                    int mapped_len)
+{
+  if (oldaddr == nullptr) {
+    return;
+  }
+
+  onm->map.add_overwrite(oldaddr, NewAddress{mapped_addr, 0, mapped_len});
+}
+
 static void oldnewmap_lib_insert(FileData *fd, const void *oldaddr, ID *newaddr, int id_code)
 {
   oldnewmap_insert(fd->libmap, oldaddr, newaddr, id_code);
@@ -305,7 +324,7 @@ static void oldnewmap_clear(OldNewMap *onm)
 {
   /* Free unused data. */
   for (NewAddress &new_addr : onm->map.values()) {
-    if (new_addr.nr == 0) {
+    if (new_addr.nr == 0 && new_addr.mapped_len == 0) {
       MEM_freeN(new_addr.newp);
     }
   }
@@ -319,6 +338,68 @@ static void oldnewmap_free(OldNewMap *onm)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Mapped File Data
+ *
+ * With lazy loading, large data blocks of uncompressed files are not read but reference a
+ * copy-on-write mapping of the file. Code that supports it keeps referencing the mapped memory
+ * with #BLO_read_mapped_data_address, so the operating system only reads the pages that are
+ * actually accessed. All other lookups copy the data, like it would have been read before.
+ * \{ */
+
+/** Data blocks smaller than this are always read, referencing them would not save much. */
+#define MAPPED_DATA_MIN_SIZE (64 * 1024)
+
+struct MappedBlendFile {
+  std::shared_ptr<BLI_mmap_file> file;
+};
+
+/**
+ * Owns a user of the mapped file for a single array referencing the mapped memory. The private
+ * mapping makes it safe for the sole owner of the array to modify it in place.
+ */
+class MappedBlendDataSharingInfo : public blender::ImplicitSharingInfo {
+ private:
+  std::shared_ptr<BLI_mmap_file> mapped_file_;
+
+ public:
+  MappedBlendDataSharingInfo(std::shared_ptr<BLI_mmap_file> mapped_file)
+      : mapped_file_(std::move(mapped_file))
+  {
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    MEM_delete(this);
+  }
+
+  void delete_data_only() override
+  {
+    mapped_file_.reset();
+  }
+};
+
+static MappedBlendFile *mapped_file_open(const int filedes)
+{
+#ifdef WIN32
+  /* Mapped files can't be replaced, which would make it impossible to save over the file while
+   * any of its data is still referenced. */
+  UNUSED_VARS(filedes);
+  return nullptr;
+#else
+  BLI_mmap_file *file = BLI_mmap_open_copy_on_write(filedes);
+  if (file == nullptr) {
+    return nullptr;
+  }
+  MappedBlendFile *mapped_file = MEM_new<MappedBlendFile>(__func__);
+  mapped_file->file = std::shared_ptr<BLI_mmap_file>(file, BLI_mmap_free);
+  return mapped_file;
+#endif
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Helper Functions
  * \{ */
@@ -1107,6 +1188,7 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   char header[7];
   FileReader *rawfile = BLI_filereader_new_file(filedes);
   FileReader *file = nullptr;
+  MappedBlendFile *mapped_file = nullptr;
 
   errno = 0;
   /* If opening the file failed or we can't read the header, give up. */
@@ -1130,6 +1212,10 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   /* Check if we have a regular file. */
   if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
+    if (USER_EXPERIMENTAL_TEST(&U, use_lazy_blend_data)) {
+      /* Large data blocks may reference this mapping after the file is closed. */
+      mapped_file = mapped_file_open(filedes);
+    }
     /* Try opening the file with memory-mapped IO. */
     file = BLI_filereader_new_mmap(filedes);
     if (file == nullptr) {
@@ -1157,11 +1243,13 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   }
   if (file == nullptr) {
     BKE_reportf(reports->reports, RPT_WARNING, "Unrecognized file format '%s'", filepath);
+    MEM_delete(mapped_file);
     return nullptr;
   }
 
   FileData *fd = filedata_new(reports);
   fd->file = file;
+  fd->mapped_file = mapped_file;
 
   return fd;
 }
@@ -1286,6 +1374,11 @@ void blo_filedata_free(FileData *fd)
       DNA_reconstruct_info_free(fd->reconstruct_info);
     }
 
+    BLI_assert(BLI_listbase_is_empty(&fd->deferred_read_data));
+
+    /* Data referencing the mapped file keeps its own user. */
+    MEM_delete(fd->mapped_file);
+
     if (fd->datamap) {
       oldnewmap_free(fd->datamap);
     }
@@ -1358,16 +1451,46 @@ BlendThumbnail *BLO_thumbnail_from_file(const char *filepath)
 /** \name Old/New Pointer Map
  * \{ */
 
+/**
+ * Lookup of direct data, which may still reference the mapped file. The caller owns the returned
+ * memory, so mapped data is copied on first access.
+ */
+static void *newdataadr_ex(FileData *fd, const void *adr, const bool increase_users)
+{
+  NewAddress *entry = fd->datamap->map.lookup_ptr(adr);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  if (entry->mapped_len != 0) {
+    BLI_mmap_file *file = fd->mapped_file->file.get();
+    const size_t offset = size_t(static_cast<const char *>(entry->newp) -
+                                 static_cast<const char *>(BLI_mmap_get_pointer(file)));
+    void *data = MEM_mallocN(size_t(entry->mapped_len), "mapped data read");
+    if (UNLIKELY(!BLI_mmap_read(file, data, offset, size_t(entry->mapped_len)))) {
+      fd->flags &= ~FD_FLAGS_FILE_OK;
+      MEM_freeN(data);
+      fd->datamap->map.remove(adr);
+      return nullptr;
+    }
+    entry->newp = data;
+    entry->mapped_len = 0;
+  }
+  if (increase_users) {
+    entry->nr++;
+  }
+  return entry->newp;
+}
+
 /* Only direct data-blocks. */
 static void *newdataadr(FileData *fd, const void *adr)
 {
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  return newdataadr_ex(fd, adr, true);
 }
 
 /* Only direct data-blocks. */
 static void *newdataadr_no_us(FileData *fd, const void *adr)
 {
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, false);
+  return newdataadr_ex(fd, adr, false);
 }
 
 void *blo_read_get_new_globaldata_address(FileData *fd, const void *adr)
@@ -1382,7 +1505,7 @@ static void *newpackedadr(FileData *fd, const void *adr)
     return oldnewmap_lookup_and_inc(fd->packedmap, adr, true);
   }
 
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  return newdataadr(fd, adr);
 }
 
 /* only lib data */
@@ -1806,6 +1929,31 @@ static const void *peek_struct_undo(FileData *fd, BHead *bhead)
   return (bhead->len) ? (const void *)(bhead + 1) : nullptr;
 }
 
+/* Like read_struct, but gets a pointer into the mapped file without reading the data. Only works
+ * for large blocks which can be used without conversion. */
+static void *peek_struct_mapped(FileData *fd, BHead *bh)
+{
+  if (fd->mapped_file == nullptr || bh->len < MAPPED_DATA_MIN_SIZE) {
+    return nullptr;
+  }
+  if ((fd->flags & FD_FLAGS_SWITCH_ENDIAN) || fd->compflags[bh->SDNAnr] != SDNA_CMP_EQUAL) {
+    return nullptr;
+  }
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  const BHeadN *new_bhead = BHEADN_FROM_BHEAD(bh);
+  if (new_bhead->has_data) {
+    return nullptr;
+  }
+  BLI_mmap_file *file = fd->mapped_file->file.get();
+  if (size_t(new_bhead->file_offset) + size_t(bh->len) > BLI_mmap_get_length(file)) {
+    return nullptr;
+  }
+  return POINTER_OFFSET(BLI_mmap_get_pointer(file), new_bhead->file_offset);
+#else
+  return nullptr;
+#endif
+}
+
 static void link_glob_list(FileData *fd, ListBase *lb) /* for glob data */
 {
   Link *ln, *prev;
@@ -2951,6 +3099,112 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
   return success;
 }
 
+/** ID whose `blend_read_data` callback is deferred, see #FileData.use_deferred_read_data. */
+struct DeferredReadData {
+  DeferredReadData *next, *prev;
+  ID *id;
+  /** The data of the ID, moved out of #FileData.datamap. */
+  OldNewMap *datamap;
+  /**
+   * Reports of reading the ID, #FileData.reports is not thread-safe. They are added to the
+   * reports of the file in the order of the IDs once all IDs are read.
+   */
+  BlendFileReadReport reports;
+  ReportList report_list;
+  /** #FileData.flags after reading the ID, to pass on read errors. */
+  int fd_flags;
+};
+
+/** Move the reports and counters of \a src to \a dst. */
+static void read_reports_merge(BlendFileReadReport *dst, BlendFileReadReport *src)
+{
+  if (dst->reports != nullptr && src->reports != nullptr) {
+    BLI_movelisttolist(&dst->reports->list, &src->reports->list);
+  }
+  dst->count.missing_libraries += src->count.missing_libraries;
+  dst->count.missing_linked_id += src->count.missing_linked_id;
+  dst->count.missing_obdata += src->count.missing_obdata;
+  dst->count.missing_obproxies += src->count.missing_obproxies;
+  dst->count.resynced_lib_overrides += src->count.resynced_lib_overrides;
+  dst->count.proxies_to_lib_overrides_success += src->count.proxies_to_lib_overrides_success;
+  dst->count.proxies_to_lib_overrides_failures += src->count.proxies_to_lib_overrides_failures;
+  dst->count.sequence_strips_skipped += src->count.sequence_strips_skipped;
+}
+
+static bool read_libblock_can_defer_read_data(FileData *fd, Main *main, ID *id, ID **r_id)
+{
+  if (!fd->use_deferred_read_data || main->id_map != nullptr || r_id != nullptr) {
+    return false;
+  }
+  const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
+  return (id_type->flags & IDTYPE_FLAGS_THREADSAFE_BLEND_READ_DATA) != 0;
+}
+
+/* Read the common part of the ID now, and the data of the ID type later. The common part is not
+ * deferred, since it generates the session UUID of the ID, which should not depend on
+ * threading. */
+static void read_libblock_defer_read_data(FileData *fd, Main *main, const int tag, ID *id)
+{
+  BLI_assert((fd->flags & FD_FLAGS_IS_MEMFILE) == 0);
+  BlendDataReader reader = {fd};
+  direct_link_id_common(&reader, main->curlib, id, nullptr, tag);
+
+  DeferredReadData *deferred = MEM_cnew<DeferredReadData>(__func__);
+  deferred->id = id;
+  deferred->datamap = fd->datamap;
+  BLI_addtail(&fd->deferred_read_data, deferred);
+  fd->datamap = oldnewmap_new();
+}
+
+/* Run the deferred `blend_read_data` callbacks in parallel. */
+static void read_libblock_deferred_read_data_run(FileData *fd)
+{
+  using namespace blender;
+  Vector<DeferredReadData *> deferred_ids;
+  LISTBASE_FOREACH (DeferredReadData *, deferred, &fd->deferred_read_data) {
+    deferred_ids.append(deferred);
+  }
+
+  threading::parallel_for(deferred_ids.index_range(), 1, [&](const IndexRange range) {
+    for (const int i : range) {
+      DeferredReadData *deferred = deferred_ids[i];
+      /* Every ID has its own data map and reports. Other members of the file data are only read,
+       * changes to the flags are passed on below. */
+      FileData id_fd = *fd;
+      id_fd.datamap = deferred->datamap;
+      if (fd->reports->reports != nullptr) {
+        BKE_reports_init(&deferred->report_list, fd->reports->reports->flag);
+        deferred->report_list.printlevel = fd->reports->reports->printlevel;
+        deferred->report_list.storelevel = fd->reports->reports->storelevel;
+        deferred->reports.reports = &deferred->report_list;
+      }
+      id_fd.reports = &deferred->reports;
+      BlendDataReader reader = {&id_fd};
+
+      ID *id = deferred->id;
+      const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
+      if (id_type->blend_read_data != nullptr) {
+        id_type->blend_read_data(&reader, id);
+      }
+      if (id_type->foreach_cache != nullptr) {
+        BKE_idtype_id_foreach_cache(id, blo_cache_storage_entry_restore_in_new, nullptr);
+      }
+
+      oldnewmap_clear(deferred->datamap);
+      oldnewmap_free(deferred->datamap);
+      deferred->fd_flags = id_fd.flags;
+    }
+  });
+
+  for (DeferredReadData *deferred : deferred_ids) {
+    read_reports_merge(fd->reports, &deferred->reports);
+    if ((deferred->fd_flags & FD_FLAGS_FILE_OK) == 0) {
+      fd->flags &= ~FD_FLAGS_FILE_OK;
+    }
+  }
+  BLI_freelistN(&fd->deferred_read_data);
+}
+
 /* Read all data associated with a datablock into datamap. */
 static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *allocname)
 {
@@ -2977,9 +3231,14 @@ static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *all
     }
 #endif
 
-    void *data = read_struct(fd, bhead, allocname);
-    if (data) {
-      oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+    if (void *mapped_data = peek_struct_mapped(fd, bhead)) {
+      oldnewmap_insert_mapped(fd->datamap, bhead->old, mapped_data, bhead->len);
+    }
+    else {
+      void *data = read_struct(fd, bhead, allocname);
+      if (data) {
+        oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+      }
     }
 
     bhead = blo_bhead_next(fd, bhead);
@@ -3349,6 +3608,12 @@ static BHead *read_libblock(FileData *fd,
    * Use convenient malloc name for debugging and better memory link prints. */
   const char *allocname = dataname(idcode);
   bhead = read_data_into_datamap(fd, bhead, allocname);
+
+  if (id_old == nullptr && read_libblock_can_defer_read_data(fd, main, id, r_id)) {
+    read_libblock_defer_read_data(fd, main, id_tag, id);
+    return bhead;
+  }
+
   const bool success = direct_link_id(fd, main, id_tag, id, id_old);
   oldnewmap_clear(fd->datamap);
 
@@ -3853,6 +4118,15 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  /* Skip in undo case, where most data-blocks are not read anyway. */
+  if ((fd->flags & FD_FLAGS_IS_MEMFILE) == 0 &&
+      USER_EXPERIMENTAL_TEST(&U, use_threaded_blend_read))
+  {
+    fd->use_deferred_read_data = true;
+  }
+
+  fd->reports->duration.read_data = PIL_check_seconds_timer();
+
   while (bhead) {
     switch (bhead->code) {
       case BLO_CODE_DATA:
@@ -3904,12 +4178,24 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
 
     if (bfd->main->is_read_invalid) {
-      return bfd;
+      break;
     }
   }
 
+  /* Libraries are read with the deferred data of the main file already available. */
+  read_libblock_deferred_read_data_run(fd);
+  fd->use_deferred_read_data = false;
+
+  fd->reports->duration.read_data = PIL_check_seconds_timer() - fd->reports->duration.read_data;
+
+  if (bfd->main->is_read_invalid) {
+    return bfd;
+  }
+
   /* do before read_libraries, but skip undo case */
   if ((fd->flags & FD_FLAGS_IS_MEMFILE) == 0) {
+    const double versioning_start_time = PIL_check_seconds_timer();
+
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
       do_versions(fd, nullptr, bfd->main);
     }
@@ -3917,6 +4203,8 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     if ((fd->skip_flags & BLO_READ_SKIP_USERDEF) == 0) {
       do_versions_userdef(fd, bfd);
     }
+
+    fd->reports->duration.versioning += PIL_check_seconds_timer() - versioning_start_time;
   }
 
   if (bfd->main->is_read_invalid) {
@@ -3946,12 +4234,14 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
       BKE_main_id_refcount_recompute(bfd->main, false);
 
       /* Yep, second splitting... but this is a very cheap operation, so no big deal. */
+      const double versioning_start_time = PIL_check_seconds_timer();
       blo_split_main(&mainlist, bfd->main);
       LISTBASE_FOREACH (Main *, mainvar, &mainlist) {
         BLI_assert(mainvar->versionfile != 0);
         do_versions_after_linking(fd, mainvar);
       }
       blo_join_main(&mainlist);
+      fd->reports->duration.versioning += PIL_check_seconds_timer() - versioning_start_time;
 
       /* And we have to compute those user-reference-counts again, as `do_versions_after_linking()`
        * does not always properly handle user counts, and/or that function does not take into
@@ -5020,6 +5310,29 @@ void *BLO_read_get_new_data_address_no_us(BlendDataReader *reader, const void *o
   return newdataadr_no_us(reader->fd, old_address);
 }
 
+const blender::ImplicitSharingInfo *BLO_read_mapped_data_address(BlendDataReader *reader,
+                                                                 void **ptr_p,
+                                                                 const int64_t alignment)
+{
+  FileData *fd = reader->fd;
+  NewAddress *entry = fd->datamap->map.lookup_ptr(*ptr_p);
+  if (entry == nullptr || entry->mapped_len == 0 ||
+      uintptr_t(entry->newp) % uintptr_t(alignment) != 0 ||
+      BLI_mmap_any_io_error(fd->mapped_file->file.get()))
+  {
+    *ptr_p = newdataadr(fd, *ptr_p);
+    return nullptr;
+  }
+  entry->nr++;
+  *ptr_p = entry->newp;
+  return MEM_new<MappedBlendDataSharingInfo>(__func__, fd->mapped_file->file);
+}
+
+bool BLO_read_is_mapped_data(const blender::ImplicitSharingInfo *sharing_info)
+{
+  return dynamic_cast<const MappedBlendDataSharingInfo *>(sharing_info) != nullptr;
+}
+
 void *BLO_read_get_new_packed_address(BlendDataReader *reader, const void *old_address)
 {
   return newpackedadr(reader->fd, old_address);
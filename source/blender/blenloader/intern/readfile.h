@@ -120,6 +120,22 @@ typedef struct FileData {
   struct IDNameLib_Map *old_idmap_uuid;
 
   struct BlendFileReadReport *reports;
+
+  /**
+   * When set, the `blend_read_data` callbacks of IDs with
+   * #IDTYPE_FLAGS_THREADSAFE_BLEND_READ_DATA are deferred, to run in parallel once all the
+   * data-blocks of the file are read.
+   */
+  bool use_deferred_read_data;
+  /** #DeferredReadData items. */
+  ListBase deferred_read_data;
+
+  /**
+   * Copy-on-write mapping of uncompressed files. Large data blocks are not read but reference the
+   * mapped memory, until they are either claimed by #BLO_read_mapped_data_address or copied on
+   * first lookup. Null when lazy loading is disabled or not possible for this file.
+   */
+  struct MappedBlendFile *mapped_file;
 } FileData;
 
 #define SIZEOFBLENDERHEADER 12
@@ -5,6 +5,7 @@
  * \ingroup blenloader
  */
 
+#include <algorithm>
 #include <cerrno>
 #include <cmath>
 #include <cstdio>
@@ -25,6 +26,7 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 
 #include "BLO_readfile.h"
 #include "BLO_undofile.h"
@@ -33,22 +35,89 @@
 #include "BKE_main.h"
 #include "BKE_undo_system.h"
 
+#include "CLG_log.h"
+
 /* keep last */
 #include "BLI_strict_flags.h"
 
+static CLG_LogRef LOG = {"blo.undofile"};
+
 /* **************** support for memory-write, for undo buffers *************** */
 
+/** Chunks smaller than this are not worth looking up by content. */
+#define MEMFILE_DEDUP_MIN_SIZE 1024
+
+/**
+ * Content-defined chunking of big arrays: a piece ends where a rolling hash of the last 64 bytes
+ * matches a pattern, so inserting or removing data only changes the pieces around it, and the
+ * following pieces can still be found in the previous step by their content.
+ *
+ * Sizes are chosen to give pieces of about the size of regular write chunks.
+ */
+#define MEMFILE_CDC_MIN_SIZE (8 * 1024)
+#define MEMFILE_CDC_MAX_SIZE (64 * 1024)
+/* Only the high bits of the gear hash depend on all the bytes of the window. */
+#define MEMFILE_CDC_MASK (~uint64_t(0) << (64 - 14))
+
+namespace {
+
+struct GearTable {
+  uint64_t values[256];
+
+  constexpr GearTable() : values()
+  {
+    /* Split-mix generator, any fixed random values work. */
+    uint64_t state = 0x9e3779b97f4a7c15;
+    for (int i = 0; i < 256; i++) {
+      state += 0x9e3779b97f4a7c15;
+      uint64_t z = state;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      values[i] = z ^ (z >> 31);
+    }
+  }
+};
+
+constexpr GearTable gear_table;
+
+}  // namespace
+
+static size_t memfile_cdc_piece_size(const uchar *data, const size_t size)
+{
+  if (size <= MEMFILE_CDC_MIN_SIZE) {
+    return size;
+  }
+  const size_t end = std::min(size, size_t(MEMFILE_CDC_MAX_SIZE));
+  uint64_t hash = 0;
+  /* Older bytes are shifted out of the hash, so there is no need to look at what comes before
+   * the window ending at the minimum size. */
+  for (size_t i = MEMFILE_CDC_MIN_SIZE - 64; i < end; i++) {
+    hash = (hash << 1) + gear_table.values[data[i]];
+    if (i >= MEMFILE_CDC_MIN_SIZE && (hash & MEMFILE_CDC_MASK) == 0) {
+      return i + 1;
+    }
+  }
+  return end;
+}
+
+static bool memfile_chunk_owns_buffer(const MemFileChunk *chunk)
+{
+  return !(chunk->is_identical || chunk->is_shared);
+}
+
 void BLO_memfile_free(MemFile *memfile)
 {
   MemFileChunk *chunk;
 
   while ((chunk = static_cast<MemFileChunk *>(BLI_pophead(&memfile->chunks)))) {
-    if (chunk->is_identical == false) {
+    if (memfile_chunk_owns_buffer(chunk)) {
       MEM_freeN((void *)chunk->buf);
     }
     MEM_freeN(chunk);
   }
   memfile->size = 0;
+  memfile->identical_size = 0;
+  memfile->deduplicated_size = 0;
 }
 
 void BLO_memfile_merge(MemFile *first, MemFile *second)
@@ -62,8 +131,12 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
   for (MemFileChunk *sc = static_cast<MemFileChunk *>(second->chunks.first); sc != nullptr;
        sc = static_cast<MemFileChunk *>(sc->next))
   {
-    if (sc->is_identical) {
-      BLI_ghash_insert(buffer_to_second_memchunk, (void *)sc->buf, sc);
+    if (!memfile_chunk_owns_buffer(sc)) {
+      /* Several chunks can share the same buffer, one of them taking the ownership is enough. */
+      void **entry;
+      if (!BLI_ghash_ensure_p(buffer_to_second_memchunk, (void *)sc->buf, &entry)) {
+        *entry = sc;
+      }
     }
   }
 
@@ -72,12 +145,13 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
   for (MemFileChunk *fc = static_cast<MemFileChunk *>(first->chunks.first); fc != nullptr;
        fc = static_cast<MemFileChunk *>(fc->next))
   {
-    if (!fc->is_identical) {
+    if (memfile_chunk_owns_buffer(fc)) {
       MemFileChunk *sc = static_cast<MemFileChunk *>(
           BLI_ghash_lookup(buffer_to_second_memchunk, fc->buf));
       if (sc != nullptr) {
-        BLI_assert(sc->is_identical);
+        BLI_assert(!memfile_chunk_owns_buffer(sc));
         sc->is_identical = false;
+        sc->is_shared = false;
         fc->is_identical = true;
       }
       /* Note that if the second memfile does not use that chunk, we assume that the first one
@@ -107,6 +181,10 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
   mem_data->reference_current_chunk = reference_memfile ? static_cast<MemFileChunk *>(
                                                               reference_memfile->chunks.first) :
                                                           nullptr;
+  mem_data->id_session_uuid_mapping = nullptr;
+  mem_data->chunk_store = nullptr;
+  written_memfile->identical_size = 0;
+  written_memfile->deduplicated_size = 0;
 
   /* If we have a reference memfile, we generate a mapping between the session_uuid's of the
    * IDs stored in that previous undo step, and its first matching memchunk. This will allow
@@ -116,8 +194,20 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
   if (reference_memfile != nullptr) {
     mem_data->id_session_uuid_mapping = BLI_ghash_new(
         BLI_ghashutil_inthash_p_simple, BLI_ghashutil_intcmp, __func__);
+    /* Only chunks of the reference memfile are used, so that the shared buffers are always
+     * owned by the previous step or older ones, see #BLO_memfile_merge. */
+    mem_data->chunk_store = BLI_ghash_new(
+        BLI_ghashutil_inthash_p_simple, BLI_ghashutil_intcmp, __func__);
     uint current_session_uuid = MAIN_ID_SESSION_UUID_UNSET;
     LISTBASE_FOREACH (MemFileChunk *, mem_chunk, &reference_memfile->chunks) {
+      if (mem_chunk->size >= MEMFILE_DEDUP_MIN_SIZE) {
+        void **entry;
+        /* On hash collisions, keep the first chunk. */
+        if (!BLI_ghash_ensure_p(mem_data->chunk_store, POINTER_FROM_UINT(mem_chunk->hash), &entry))
+        {
+          *entry = mem_chunk;
+        }
+      }
       if (!ELEM(mem_chunk->id_session_uuid, MAIN_ID_SESSION_UUID_UNSET, current_session_uuid)) {
         current_session_uuid = mem_chunk->id_session_uuid;
         void **entry;
@@ -140,6 +230,17 @@ void BLO_memfile_write_finalize(MemFileWriteData *mem_data)
   if (mem_data->id_session_uuid_mapping != nullptr) {
     BLI_ghash_free(mem_data->id_session_uuid_mapping, nullptr, nullptr);
   }
+  if (mem_data->chunk_store != nullptr) {
+    BLI_ghash_free(mem_data->chunk_store, nullptr, nullptr);
+  }
+
+  const MemFile *memfile = mem_data->written_memfile;
+  CLOG_INFO(&LOG,
+            1,
+            "Undo step: %zu bytes stored, %zu bytes identical, %zu bytes de-duplicated by content",
+            memfile->size,
+            memfile->identical_size,
+            memfile->deduplicated_size);
 }
 
 void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size)
@@ -152,6 +253,8 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
   curchunk->size = size;
   curchunk->buf = nullptr;
   curchunk->is_identical = false;
+  curchunk->is_shared = false;
+  curchunk->hash = 0;
   /* This is unsafe in the sense that an app handler or other code that does not
    * perform an undo push may make changes after the last undo push that
    * will then not be undo. Though it's not entirely clear that is wrong behavior. */
@@ -166,12 +269,32 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
       if (memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
         curchunk->is_identical = true;
+        curchunk->hash = compchunk->hash;
         compchunk->is_identical_future = true;
+        memfile->identical_size += size;
       }
     }
     *compchunk_step = static_cast<MemFileChunk *>(compchunk->next);
   }
 
+  /* Look for the same content anywhere in the reference memfile, e.g. when data was inserted or
+   * removed before it. The chunk is not considered identical: the positional comparison is what
+   * undo uses to detect unchanged IDs. */
+  if (curchunk->buf == nullptr && size >= MEMFILE_DEDUP_MIN_SIZE) {
+    curchunk->hash = BLI_hash_mm2((const uchar *)buf, size, 0);
+    if (mem_data->chunk_store != nullptr) {
+      MemFileChunk *sharedchunk = static_cast<MemFileChunk *>(
+          BLI_ghash_lookup(mem_data->chunk_store, POINTER_FROM_UINT(curchunk->hash)));
+      if (sharedchunk != nullptr && sharedchunk->size == size &&
+          memcmp(sharedchunk->buf, buf, size) == 0)
+      {
+        curchunk->buf = sharedchunk->buf;
+        curchunk->is_shared = true;
+        memfile->deduplicated_size += size;
+      }
+    }
+  }
+
   /* not equal... */
   if (curchunk->buf == nullptr) {
     char *buf_new = static_cast<char *>(MEM_mallocN(size, "Chunk buffer"));
@@ -181,6 +304,16 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
   }
 }
 
+void BLO_memfile_chunk_add_array(MemFileWriteData *mem_data, const char *buf, size_t size)
+{
+  while (size > 0) {
+    const size_t piece_size = memfile_cdc_piece_size((const uchar *)buf, size);
+    BLO_memfile_chunk_add(mem_data, buf, piece_size);
+    buf += piece_size;
+    size -= piece_size;
+  }
+}
+
 struct Main *BLO_memfile_main_get(struct MemFile *memfile,
                                   struct Main *bmain,
                                   struct Scene **r_scene)
@@ -8,11 +8,15 @@
 
 #include "CLG_log.h"
 
-#include "DNA_movieclip_types.h"
-
 #include "BLI_assert.h"
 #include "BLI_listbase.h"
 #include "BLI_set.hh"
+#include "BLI_utildefines.h"
+
+#include "DNA_genfile.h"
+#include "DNA_modifier_types.h"
+#include "DNA_movieclip_types.h"
+#include "DNA_object_types.h"
 
 #include "BKE_main.h"
 #include "BKE_mesh_legacy_convert.h"
@@ -99,7 +103,7 @@ static void version_geometry_nodes_add_realize_instance_nodes(bNodeTree *ntree)
   }
 }
 
-void blo_do_versions_400(FileData * /*fd*/, Library * /*lib*/, Main *bmain)
+void blo_do_versions_400(FileData *fd, Library * /*lib*/, Main *bmain)
 {
   if (!MAIN_VERSION_ATLEAST(bmain, 400, 1)) {
     LISTBASE_FOREACH (Mesh *, mesh, &bmain->meshes) {
@@ -133,5 +137,19 @@ void blo_do_versions_400(FileData * /*fd*/, Library * /*lib*/, Main *bmain)
    */
   {
     /* Keep this block, even when empty. */
+
+    if (!DNA_struct_elem_find(
+            fd->filesdna, "NodesModifierData", "int", "eval_cache_memory_budget"))
+    {
+      LISTBASE_FOREACH (Object *, ob, &bmain->objects) {
+        LISTBASE_FOREACH (ModifierData *, md, &ob->modifiers) {
+          if (md->type == eModifierType_Nodes) {
+            NodesModifierData *nmd = reinterpret_cast<NodesModifierData *>(md);
+            nmd->eval_cache_memory_budget = 256;
+            nmd->eval_cache_min_execution_time = 0.5f;
+          }
+        }
+      }
+    }
   }
 }
@@ -55,6 +55,7 @@
  * - write #USER (#UserDef struct) if filename is `~/.config/blender/X.XX/config/startup.blend`.
  */
 
+#include <atomic>
 #include <cerrno>
 #include <climits>
 #include <cmath>
@@ -91,7 +92,9 @@
 #include "BLI_linklist.h"
 #include "BLI_math_base.h"
 #include "BLI_mempool.h"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
+#include "BLI_vector.hh"
 #include "MEM_guardedalloc.h" /* MEM_freeN */
 
 #include "BKE_blender_version.h"
@@ -109,6 +112,8 @@
 #include "BKE_report.h"
 #include "BKE_workspace.h"
 
+#include "PIL_time.h"
+
 #include "BLO_blend_defs.h"
 #include "BLO_blend_validate.h"
 #include "BLO_read_write.h"
@@ -146,6 +151,8 @@ static CLG_LogRef LOG = {"blo.writefile"};
 enum eWriteWrapType {
   WW_WRAP_NONE = 1,
   WW_WRAP_ZSTD,
+  /** Keep the written data in memory, see #write_id_batch. */
+  WW_WRAP_MEMORY,
 };
 
 struct ZstdFrame {
@@ -155,7 +162,16 @@ struct ZstdFrame {
   uint32_t uncompressed_size;
 };
 
+struct WriteMemoryChunk {
+  struct WriteMemoryChunk *next, *prev;
+
+  void *data;
+  size_t size;
+};
+
 struct WriteWrap {
+  eWriteWrapType type;
+
   /* callbacks */
   bool (*open)(WriteWrap *ww, const char *filepath);
   bool (*close)(WriteWrap *ww);
@@ -179,6 +195,11 @@ struct WriteWrap {
 
     bool write_error;
   } zstd;
+
+  /** #WriteMemoryChunk items, when writing to memory. */
+  ListBase memory_chunks;
+  /** Total size of the #memory_chunks. */
+  size_t memory_size;
 };
 
 /* none */
@@ -364,11 +385,40 @@ static size_t ww_write_zstd(WriteWrap *ww, const char *buf, size_t buf_len)
   return buf_len;
 }
 
+/* memory */
+
+static bool ww_open_memory(WriteWrap * /*ww*/, const char * /*filepath*/)
+{
+  return true;
+}
+static bool ww_close_memory(WriteWrap *ww)
+{
+  LISTBASE_FOREACH_MUTABLE (WriteMemoryChunk *, chunk, &ww->memory_chunks) {
+    MEM_freeN(chunk->data);
+    MEM_freeN(chunk);
+  }
+  BLI_listbase_clear(&ww->memory_chunks);
+  ww->memory_size = 0;
+  return true;
+}
+static size_t ww_write_memory(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+  WriteMemoryChunk *chunk = static_cast<WriteMemoryChunk *>(
+      MEM_mallocN(sizeof(WriteMemoryChunk), __func__));
+  chunk->data = MEM_mallocN(buf_len, __func__);
+  memcpy(chunk->data, buf, buf_len);
+  chunk->size = buf_len;
+  BLI_addtail(&ww->memory_chunks, chunk);
+  ww->memory_size += buf_len;
+  return buf_len;
+}
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
 {
   memset(r_ww, 0, sizeof(*r_ww));
+  r_ww->type = ww_type;
 
   switch (ww_type) {
     case WW_WRAP_ZSTD: {
@@ -378,6 +428,13 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
       r_ww->use_buf = true;
       break;
     }
+    case WW_WRAP_MEMORY: {
+      r_ww->open = ww_open_memory;
+      r_ww->close = ww_close_memory;
+      r_ww->write = ww_write_memory;
+      r_ww->use_buf = true;
+      break;
+    }
     default: {
       r_ww->open = ww_open_none;
       r_ww->close = ww_close_none;
@@ -443,7 +500,7 @@ static WriteData *writedata_new(WriteWrap *ww)
   wd->ww = ww;
 
   if ((ww == nullptr) || (ww->use_buf)) {
-    if (ww == nullptr) {
+    if ((ww == nullptr) || (ww->type == WW_WRAP_MEMORY)) {
       wd->buffer.max_size = MEM_BUFFER_SIZE;
       wd->buffer.chunk_size = MEM_CHUNK_SIZE;
     }
@@ -541,6 +598,13 @@ static void mywrite(WriteData *wd, const void *adr, size_t len)
         wd->buffer.used_len = 0;
       }
 
+      if (wd->use_memfile) {
+        /* Split at content-defined boundaries instead, so that a change in a big array (when
+         * sculpting for example) does not shift the data of all the following chunks. */
+        BLO_memfile_chunk_add_array(&wd->mem, static_cast<const char *>(adr), len);
+        return;
+      }
+
       do {
         size_t writelen = MIN2(len, wd->buffer.chunk_size);
         writedata_do_write(wd, adr, writelen);
@@ -1189,6 +1253,88 @@ static int write_id_direct_linked_data_process_cb(LibraryIDLinkCallbackData *cb_
   return IDWALK_RET_NOP;
 }
 
+/**
+ * IDs of types with #IDTYPE_FLAGS_THREADSAFE_BLEND_WRITE can be serialized into memory on worker
+ * threads. The result is written in the same order as when writing on a single thread, so the
+ * content of the file does not depend on the threading.
+ */
+struct WriteIDTask {
+  ID *id;
+  WriteWrap ww;
+  /** Time spent serializing the ID. */
+  double time;
+};
+
+/**
+ * Serialized IDs are written out once they use more memory than this. The limit can be exceeded
+ * by the size of the IDs that are serialized on other threads at the same time.
+ */
+#define WRITE_ID_BATCH_MAX_SIZE (64 * 1024 * 1024)
+
+/** Time spent on each ID type, reported on the log. */
+struct WriteIDTypeTiming {
+  const IDTypeInfo *id_type;
+  int id_num;
+  /** Wall clock time. */
+  double time;
+  /** Time spent serializing IDs on worker threads. */
+  double thread_time;
+};
+
+static void write_id_batch(WriteData *wd,
+                           const IDTypeInfo *id_type,
+                           blender::Vector<WriteIDTask> &batch,
+                           WriteIDTypeTiming &timing)
+{
+  using namespace blender;
+  const int64_t threads_num = std::min<int64_t>(BLI_system_thread_count(), batch.size());
+  int64_t written_num = 0;
+  while (written_num < batch.size()) {
+    /* IDs are serialized in order, so that all IDs before the next index are ready to be written
+     * out when the memory limit is reached. */
+    std::atomic<int64_t> next_index = written_num;
+    std::atomic<size_t> buffered_size = 0;
+    threading::parallel_for(IndexRange(threads_num), 1, [&](const IndexRange range) {
+      BLO_Write_IDBuffer *id_buffer = BLO_write_allocate_id_buffer();
+      id_buffer_init_for_id_type(id_buffer, id_type);
+      for ([[maybe_unused]] const int thread_index : range) {
+        while (buffered_size < WRITE_ID_BATCH_MAX_SIZE) {
+          const int64_t i = next_index++;
+          if (i >= batch.size()) {
+            break;
+          }
+          WriteIDTask &task = batch[i];
+          const double start_time = PIL_check_seconds_timer();
+
+          ww_handle_init(WW_WRAP_MEMORY, &task.ww);
+          WriteData *task_wd = writedata_new(&task.ww);
+          BlendWriter writer = {task_wd};
+
+          id_buffer_init_from_id(id_buffer, task.id, false);
+          id_type->blend_write(&writer, static_cast<ID *>(id_buffer->temp_id), task.id);
+
+          mywrite_end(task_wd);
+          task.time = PIL_check_seconds_timer() - start_time;
+          buffered_size += task.ww.memory_size;
+        }
+      }
+      BLO_write_destroy_id_buffer(&id_buffer);
+    });
+
+    const int64_t serialized_num = std::min<int64_t>(next_index, batch.size());
+    for (const int64_t i : IndexRange(written_num, serialized_num - written_num)) {
+      WriteIDTask &task = batch[i];
+      LISTBASE_FOREACH (WriteMemoryChunk *, chunk, &task.ww.memory_chunks) {
+        mywrite(wd, chunk->data, chunk->size);
+      }
+      task.ww.close(&task.ww);
+      timing.thread_time += task.time;
+    }
+    written_num = serialized_num;
+  }
+  batch.clear();
+}
+
 /* if MemFile * there's filesave to memory */
 static bool write_file_handle(Main *mainvar,
                               WriteWrap *ww,
@@ -1264,6 +1410,10 @@ static bool write_file_handle(Main *mainvar,
    * if needed, without duplicating whole code. */
   Main *bmain = mainvar;
   BLO_Write_IDBuffer *id_buffer = BLO_write_allocate_id_buffer();
+  WriteIDTypeTiming id_type_timings[INDEX_ID_MAX] = {};
+  const bool use_threads = !wd->use_memfile &&
+                           USER_EXPERIMENTAL_TEST(&U, use_threaded_blend_write);
+  blender::Vector<WriteIDTask> id_batch;
   do {
     ListBase *lbarray[INDEX_ID_MAX];
     int a = set_listbasepointers(bmain, lbarray);
@@ -1277,6 +1427,12 @@ static bool write_file_handle(Main *mainvar,
       const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
       id_buffer_init_for_id_type(id_buffer, id_type);
 
+      const bool use_id_threads = use_threads && id_type->blend_write != nullptr &&
+                                  (id_type->flags & IDTYPE_FLAGS_THREADSAFE_BLEND_WRITE);
+      WriteIDTypeTiming &timing = id_type_timings[a];
+      timing.id_type = id_type;
+      const double start_time = PIL_check_seconds_timer();
+
       for (; id; id = static_cast<ID *>(id->next)) {
         /* We should never attempt to write non-regular IDs
          * (i.e. all kind of temp/runtime ones). */
@@ -1306,6 +1462,19 @@ static bool write_file_handle(Main *mainvar,
               bmain, id, write_id_direct_linked_data_process_cb, nullptr, IDWALK_READONLY);
         }
 
+        timing.id_num++;
+
+        if (use_id_threads && !do_override) {
+          /* The batch is written out when an ID has to be written on this thread or when all IDs
+           * of this type have been added, #write_id_batch limits the memory used. */
+          id_batch.append({id});
+          continue;
+        }
+        /* Keep the order of IDs. */
+        if (!id_batch.is_empty()) {
+          write_id_batch(wd, id_type, id_batch, timing);
+        }
+
         if (do_override) {
           BKE_lib_override_library_operations_store_start(bmain, override_storage, id);
         }
@@ -1325,12 +1494,42 @@ static bool write_file_handle(Main *mainvar,
         mywrite_id_end(wd, id);
       }
 
+      if (!id_batch.is_empty()) {
+        write_id_batch(wd, id_type, id_batch, timing);
+      }
+
       mywrite_flush(wd);
+      timing.time += PIL_check_seconds_timer() - start_time;
     }
   } while ((bmain != override_storage) && (bmain = override_storage));
 
   BLO_write_destroy_id_buffer(&id_buffer);
 
+  if (CLOG_CHECK(&LOG, 1)) {
+    for (const WriteIDTypeTiming &timing : id_type_timings) {
+      if (timing.id_num == 0) {
+        continue;
+      }
+      if (timing.thread_time > 0.0) {
+        CLOG_INFO(&LOG,
+                  1,
+                  "Wrote %d %s in %.4f seconds (%.4f seconds serializing on worker threads)",
+                  timing.id_num,
+                  timing.id_type->name_plural,
+                  timing.time,
+                  timing.thread_time);
+      }
+      else {
+        CLOG_INFO(&LOG,
+                  1,
+                  "Wrote %d %s in %.4f seconds",
+                  timing.id_num,
+                  timing.id_type->name_plural,
+                  timing.time);
+      }
+    }
+  }
+
   if (override_storage) {
     BKE_lib_override_library_operations_store_finalize(override_storage);
     override_storage = nullptr;
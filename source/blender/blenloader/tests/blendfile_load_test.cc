@@ -2,11 +2,57 @@
  * Copyright 2019 Blender Foundation. */
 #include "blendfile_loading_base_test.h"
 
+#include "MEM_guardedalloc.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
 #include "BLI_path_util.h"
 
+#include "BKE_appdir.h"
+#include "BKE_customdata.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.hh"
+
+#include "BLO_read_write.h"
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_userdef_types.h"
+
 class BlendfileLoadingTest : public BlendfileLoadingBaseTest {
 };
 
+/* Add meshes of different sizes, so that threads serializing them finish out of order. */
+static void add_test_meshes(Main *bmain, const int meshes_num)
+{
+  using namespace blender;
+  for (const int mesh_index : IndexRange(meshes_num)) {
+    Mesh *mesh = BKE_mesh_add(bmain, "ThreadingMesh");
+    id_fake_user_set(&mesh->id);
+    const int verts_num = (mesh_index % 5 + 1) * 2000;
+    mesh->totvert = verts_num;
+    CustomData_add_layer_named(&mesh->vdata, CD_PROP_FLOAT3, CD_CONSTRUCT, verts_num, "position");
+    MutableSpan<float3> positions = mesh->vert_positions_for_write();
+    for (const int i : positions.index_range()) {
+      positions[i] = float3(float(i), float(mesh_index), 0.0f);
+    }
+  }
+}
+
+static bool write_file_threaded(Main *bmain, const char *filepath, const bool use_threads)
+{
+  const int flag_orig = U.flag;
+  U.flag |= USER_DEVELOPER_UI;
+  U.experimental.use_threaded_blend_write = use_threads;
+  BlendFileWriteParams params{};
+  const bool success = BLO_write_file(bmain, filepath, 0, &params, nullptr);
+  U.flag = flag_orig;
+  U.experimental.use_threaded_blend_write = false;
+  return success;
+}
+
 TEST_F(BlendfileLoadingTest, CanaryTest)
 {
   /* Load the smallest blend file we have in the SVN lib/tests directory. */
@@ -16,3 +62,170 @@ TEST_F(BlendfileLoadingTest, CanaryTest)
   depsgraph_create(DAG_EVAL_RENDER);
   EXPECT_NE(nullptr, this->depsgraph);
 }
+
+TEST_F(BlendfileLoadingTest, LazyLoadedMeshCopy)
+{
+  using namespace blender;
+  if (!blendfile_load("modifier_stack" SEP_STR "array_test.blend")) {
+    return;
+  }
+
+  /* Large enough for the positions to reference the file when it is loaded lazily. */
+  const int verts_num = 100000;
+  Mesh *mesh = BKE_mesh_add(bfile->main, "LazyMesh");
+  id_fake_user_set(&mesh->id);
+  mesh->totvert = verts_num;
+  CustomData_add_layer_named(&mesh->vdata, CD_PROP_FLOAT3, CD_CONSTRUCT, verts_num, "position");
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  for (const int i : positions.index_range()) {
+    positions[i] = float3(float(i), 0.0f, 0.0f);
+  }
+
+  char filepath[FILE_MAX];
+  BLI_path_join(filepath, sizeof(filepath), BKE_tempdir_session(), "lazy_loading_test.blend");
+  BlendFileWriteParams params{};
+  ASSERT_TRUE(BLO_write_file(bfile->main, filepath, 0, &params, nullptr));
+  blendfile_free();
+
+  const int flag_orig = U.flag;
+  U.flag |= USER_DEVELOPER_UI;
+  U.experimental.use_lazy_blend_data = true;
+  BlendFileReadReport bf_reports = {nullptr};
+  bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, &bf_reports);
+  U.flag = flag_orig;
+  U.experimental.use_lazy_blend_data = false;
+  ASSERT_NE(bfile, nullptr);
+
+  mesh = reinterpret_cast<Mesh *>(BKE_libblock_find_name(bfile->main, ID_ME, "LazyMesh"));
+  ASSERT_NE(mesh, nullptr);
+  ASSERT_EQ(mesh->totvert, verts_num);
+
+  /* Otherwise the test would not cover mapped data at all. */
+  const int layer_index = CustomData_get_named_layer_index(
+      &mesh->vdata, CD_PROP_FLOAT3, "position");
+  ASSERT_NE(layer_index, -1);
+  ASSERT_TRUE(BLO_read_is_mapped_data(mesh->vdata.layers[layer_index].sharing_info));
+
+  /* The copy shares the positions with the loaded mesh, so they are copied when the copy is made
+   * mutable. */
+  Mesh *mesh_copy = reinterpret_cast<Mesh *>(BKE_id_copy(bfile->main, &mesh->id));
+  EXPECT_EQ(mesh_copy->vert_positions().data(), mesh->vert_positions().data());
+  MutableSpan<float3> copy_positions = mesh_copy->vert_positions_for_write();
+  EXPECT_NE(copy_positions.data(), mesh->vert_positions().data());
+
+  /* The copied array is an allocation owned by the copy, not a reference to the file. */
+  const int copy_layer_index = CustomData_get_named_layer_index(
+      &mesh_copy->vdata, CD_PROP_FLOAT3, "position");
+  EXPECT_FALSE(BLO_read_is_mapped_data(mesh_copy->vdata.layers[copy_layer_index].sharing_info));
+  EXPECT_EQ(MEM_allocN_len(copy_positions.data()), sizeof(float3) * verts_num);
+  copy_positions.first() = float3(-1.0f);
+
+  const Span<float3> loaded_positions = mesh->vert_positions();
+  EXPECT_EQ(loaded_positions.first(), float3(0.0f));
+  for (const int i : loaded_positions.index_range().drop_front(1)) {
+    EXPECT_EQ(loaded_positions[i], copy_positions[i]);
+  }
+
+  EXPECT_FALSE(BKE_mesh_validate(mesh, false, true));
+  EXPECT_FALSE(BKE_mesh_validate(mesh_copy, false, true));
+
+  BLI_delete(filepath, false, false);
+}
+
+static BlendFileData *read_file_threaded(const char *filepath, const bool use_threads)
+{
+  const int flag_orig = U.flag;
+  U.flag |= USER_DEVELOPER_UI;
+  U.experimental.use_threaded_blend_read = use_threads;
+  BlendFileReadReport bf_reports = {nullptr};
+  BlendFileData *bfd = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, &bf_reports);
+  U.flag = flag_orig;
+  U.experimental.use_threaded_blend_read = false;
+  return bfd;
+}
+
+static bool files_equal(const char *filepath_a, const char *filepath_b)
+{
+  size_t size_a = 0;
+  size_t size_b = 0;
+  void *data_a = BLI_file_read_binary_as_mem(filepath_a, 0, &size_a);
+  void *data_b = BLI_file_read_binary_as_mem(filepath_b, 0, &size_b);
+  const bool equal = data_a != nullptr && data_b != nullptr && size_a == size_b &&
+                     memcmp(data_a, data_b, size_a) == 0;
+  MEM_SAFE_FREE(data_a);
+  MEM_SAFE_FREE(data_b);
+  return equal;
+}
+
+TEST_F(BlendfileLoadingTest, ThreadedWriteMatchesSerialWrite)
+{
+  if (!blendfile_load("modifier_stack" SEP_STR "array_test.blend")) {
+    return;
+  }
+  add_test_meshes(bfile->main, 50);
+
+  char filepath_serial[FILE_MAX];
+  char filepath_threaded[FILE_MAX];
+  BLI_path_join(
+      filepath_serial, sizeof(filepath_serial), BKE_tempdir_session(), "write_serial.blend");
+  BLI_path_join(
+      filepath_threaded, sizeof(filepath_threaded), BKE_tempdir_session(), "write_threaded.blend");
+  ASSERT_TRUE(write_file_threaded(bfile->main, filepath_serial, false));
+  ASSERT_TRUE(write_file_threaded(bfile->main, filepath_threaded, true));
+
+  EXPECT_TRUE(files_equal(filepath_serial, filepath_threaded));
+
+  BLI_delete(filepath_serial, false, false);
+  BLI_delete(filepath_threaded, false, false);
+}
+
+TEST_F(BlendfileLoadingTest, ThreadedReadMatchesSerialRead)
+{
+  using namespace blender;
+  if (!blendfile_load("modifier_stack" SEP_STR "array_test.blend")) {
+    return;
+  }
+  const int meshes_num = 50;
+  add_test_meshes(bfile->main, meshes_num);
+
+  char filepath[FILE_MAX];
+  BLI_path_join(filepath, sizeof(filepath), BKE_tempdir_session(), "read_threading_test.blend");
+  ASSERT_TRUE(write_file_threaded(bfile->main, filepath, false));
+  blendfile_free();
+
+  BlendFileData *bfile_serial = read_file_threaded(filepath, false);
+  BlendFileData *bfile_threaded = read_file_threaded(filepath, true);
+  ASSERT_NE(bfile_serial, nullptr);
+  ASSERT_NE(bfile_threaded, nullptr);
+
+  const ListBase &meshes_serial = bfile_serial->main->meshes;
+  const ListBase &meshes_threaded = bfile_threaded->main->meshes;
+  EXPECT_GE(BLI_listbase_count(&meshes_serial), meshes_num);
+  ASSERT_EQ(BLI_listbase_count(&meshes_serial), BLI_listbase_count(&meshes_threaded));
+  const Mesh *mesh_threaded = static_cast<const Mesh *>(meshes_threaded.first);
+  LISTBASE_FOREACH (const Mesh *, mesh_serial, &meshes_serial) {
+    EXPECT_STREQ(mesh_serial->id.name, mesh_threaded->id.name);
+    ASSERT_EQ(mesh_serial->totvert, mesh_threaded->totvert);
+    EXPECT_EQ_ARRAY(mesh_serial->vert_positions().data(),
+                    mesh_threaded->vert_positions().data(),
+                    mesh_serial->totvert);
+    mesh_threaded = static_cast<const Mesh *>(mesh_threaded->id.next);
+  }
+
+  /* Saving both again must give the same files, which compares all the data that was read. */
+  char filepath_serial[FILE_MAX];
+  char filepath_threaded[FILE_MAX];
+  BLI_path_join(
+      filepath_serial, sizeof(filepath_serial), BKE_tempdir_session(), "read_serial.blend");
+  BLI_path_join(
+      filepath_threaded, sizeof(filepath_threaded), BKE_tempdir_session(), "read_threaded.blend");
+  EXPECT_TRUE(write_file_threaded(bfile_serial->main, filepath_serial, false));
+  EXPECT_TRUE(write_file_threaded(bfile_threaded->main, filepath_threaded, false));
+  EXPECT_TRUE(files_equal(filepath_serial, filepath_threaded));
+
+  BLO_blendfiledata_free(bfile_serial);
+  BLO_blendfiledata_free(bfile_threaded);
+  BLI_delete(filepath, false, false);
+  BLI_delete(filepath_serial, false, false);
+  BLI_delete(filepath_threaded, false, false);
+}
@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_listBase.h"
+
+#include "BLI_listbase.h"
+#include "BLI_map.hh"
+#include "BLI_rand.hh"
+#include "BLI_set.hh"
+#include "BLI_vector.hh"
+
+#include "BKE_lib_id.h"
+
+#include "BLO_undofile.h"
+
+namespace blender::blenloader::tests {
+
+static Vector<char> random_data(const int64_t size, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Vector<char> data(size);
+  for (char &c : data) {
+    c = char(rng.get_int32(256));
+  }
+  return data;
+}
+
+/** Write the data as a single big array, like the arrays of undo steps. */
+static void memfile_write(MemFile *memfile, MemFile *reference, const Span<char> data)
+{
+  MemFileWriteData mem_data;
+  BLO_memfile_write_init(&mem_data, memfile, reference);
+  mem_data.current_id_session_uuid = MAIN_ID_SESSION_UUID_UNSET;
+  BLO_memfile_chunk_add_array(&mem_data, data.data(), size_t(data.size()));
+  BLO_memfile_write_finalize(&mem_data);
+}
+
+static Vector<char> memfile_content(const MemFile &memfile)
+{
+  Vector<char> content;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile.chunks) {
+    content.extend(Span<char>(chunk->buf, int64_t(chunk->size)));
+  }
+  return content;
+}
+
+static bool chunk_owns_buffer(const MemFileChunk &chunk)
+{
+  return !(chunk.is_identical || chunk.is_shared);
+}
+
+/** When no other memfile is left, every buffer must be owned by exactly one of its chunks. */
+static void expect_buffers_owned_once(const MemFile &memfile)
+{
+  Map<const char *, int> owners_num;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile.chunks) {
+    int &num = owners_num.lookup_or_add(chunk->buf, 0);
+    if (chunk_owns_buffer(*chunk)) {
+      num++;
+    }
+  }
+  for (const int num : owners_num.values()) {
+    EXPECT_EQ(num, 1);
+  }
+}
+
+TEST(undofile, ChunksOfShiftedDataAreShared)
+{
+  const Vector<char> data_a = random_data(1024 * 1024, 1);
+  /* Insert data close to the start. It adds chunks, so the following chunks of both steps are not
+   * at the same positions anymore. */
+  Vector<char> data_b(data_a.as_span().take_front(1000));
+  data_b.extend(random_data(40 * 1024, 2));
+  data_b.extend(data_a.as_span().drop_front(1000));
+
+  MemFile memfile_a = {};
+  memfile_write(&memfile_a, nullptr, data_a);
+  EXPECT_EQ(memfile_a.size, size_t(data_a.size()));
+  EXPECT_EQ(memfile_a.deduplicated_size, size_t(0));
+  EXPECT_GT(BLI_listbase_count(&memfile_a.chunks), 1);
+
+  MemFile memfile_b = {};
+  memfile_write(&memfile_b, &memfile_a, data_b);
+  EXPECT_TRUE(memfile_content(memfile_b) == data_b);
+  /* Only the chunks around the inserted data are stored again. */
+  EXPECT_LT(memfile_b.size, size_t(data_b.size() / 4));
+  EXPECT_EQ(memfile_b.size + memfile_b.identical_size + memfile_b.deduplicated_size,
+            size_t(data_b.size()));
+
+  /* Shared chunks reference buffers owned by the previous step. */
+  Set<const char *> buffers_a;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile_a.chunks) {
+    EXPECT_TRUE(chunk_owns_buffer(*chunk));
+    buffers_a.add(chunk->buf);
+  }
+  int shared_chunks_num = 0;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile_b.chunks) {
+    EXPECT_EQ(chunk_owns_buffer(*chunk), !buffers_a.contains(chunk->buf));
+    if (chunk->is_shared) {
+      EXPECT_FALSE(chunk->is_identical);
+      shared_chunks_num++;
+    }
+  }
+  EXPECT_GT(shared_chunks_num, 0);
+
+  /* Removing the first step transfers the ownership of the buffers still used by the second. */
+  BLO_memfile_merge(&memfile_a, &memfile_b);
+  expect_buffers_owned_once(memfile_b);
+  EXPECT_TRUE(memfile_content(memfile_b) == data_b);
+
+  BLO_memfile_free(&memfile_b);
+}
+
+TEST(undofile, MergeIdenticalAndSharedChunks)
+{
+  const Vector<char> data_a = random_data(512 * 1024, 3);
+  Vector<char> data_b = random_data(5000, 4);
+  data_b.extend(data_a);
+
+  MemFile memfile_a = {};
+  memfile_write(&memfile_a, nullptr, data_a);
+  MemFile memfile_b = {};
+  memfile_write(&memfile_b, &memfile_a, data_b);
+  EXPECT_GT(memfile_b.deduplicated_size, size_t(0));
+
+  /* The third step is unchanged, so it shares all chunks with the second one at the same
+   * positions, including the ones the second step shares with the first. */
+  MemFile memfile_c = {};
+  memfile_write(&memfile_c, &memfile_b, data_b);
+  EXPECT_EQ(memfile_c.size, size_t(0));
+  EXPECT_EQ(memfile_c.identical_size, size_t(data_b.size()));
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile_c.chunks) {
+    EXPECT_TRUE(chunk->is_identical);
+  }
+
+  BLO_memfile_merge(&memfile_a, &memfile_b);
+  expect_buffers_owned_once(memfile_b);
+  BLO_memfile_merge(&memfile_b, &memfile_c);
+  expect_buffers_owned_once(memfile_c);
+  EXPECT_TRUE(memfile_content(memfile_c) == data_b);
+
+  BLO_memfile_free(&memfile_c);
+}
+
+}  // namespace blender::blenloader::tests
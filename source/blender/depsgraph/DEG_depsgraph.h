@@ -189,6 +189,60 @@ void DEG_evaluate_on_refresh(Depsgraph *graph);
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Frame Parallel Evaluation
+ *
+ * Evaluates consecutive frames concurrently on independent dependency graphs. This is useful
+ * when the evaluation of a single frame is too cheap to keep all threads busy, e.g. for playblasts
+ * or exporting caches.
+ *
+ * Frames can only be evaluated independently when the result of a frame does not depend on
+ * previous frames. When there are point caches, rigid body simulations, physics modifiers or
+ * simulation zones in geometry nodes, a single dependency graph is used and frames are evaluated
+ * one after another.
+ *
+ * Unlike #BKE_scene_graph_update_for_newframe, frame change handlers are not run and the frame of
+ * image sequences used outside of the evaluated data is not updated, so this is only to be used
+ * when the user opted in to it. Every dependency graph has its own copy of the evaluated data, so
+ * memory usage grows with the number of graphs.
+ * \{ */
+
+typedef struct DEGFrameParallelEvaluator DEGFrameParallelEvaluator;
+
+/**
+ * Called for every evaluated frame, in frame order and on the thread which started the
+ * evaluation. The evaluated data of the frame can be accessed with the given dependency graph
+ * until the callback returns. Returning false stops the evaluation of further frames.
+ */
+typedef bool (*DEG_FrameEvaluatedCb)(struct Depsgraph *depsgraph, float frame, void *user_data);
+
+/**
+ * Create an evaluator with up to \a max_graphs_num dependency graphs for the given view layer.
+ * The graphs are built immediately, so the evaluator has to be recreated when relations change.
+ */
+DEGFrameParallelEvaluator *DEG_frame_parallel_evaluator_new(struct Main *bmain,
+                                                            struct Scene *scene,
+                                                            struct ViewLayer *view_layer,
+                                                            eEvaluationMode mode,
+                                                            int max_graphs_num);
+void DEG_frame_parallel_evaluator_free(DEGFrameParallelEvaluator *evaluator);
+
+/** Number of frames which are evaluated at the same time. */
+int DEG_frame_parallel_evaluator_graphs_num(const DEGFrameParallelEvaluator *evaluator);
+
+/**
+ * Evaluate all frames from \a frame_start to \a frame_end (inclusive) with the given step and
+ * call \a callback for each of them in order.
+ */
+void DEG_frame_parallel_evaluate(DEGFrameParallelEvaluator *evaluator,
+                                 float frame_start,
+                                 float frame_end,
+                                 float frame_step,
+                                 DEG_FrameEvaluatedCb callback,
+                                 void *user_data);
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Editors Integration
  *
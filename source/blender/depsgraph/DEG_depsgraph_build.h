@@ -64,12 +64,31 @@ void DEG_graph_build_from_ids(struct Depsgraph *graph, struct ID **ids, int num_
 /** Tag relations from the given graph for update. */
 void DEG_graph_tag_relations_update(struct Depsgraph *graph);
 
+/**
+ * Tag relations of the given ID for update.
+ *
+ * Unlike #DEG_graph_tag_relations_update, only the nodes of this ID and the relations of the IDs
+ * connected to it are rebuilt on the next relations update, as long as there is no full update
+ * requested. Use this when only the dependencies of the ID changed, or when an object was added to
+ * or removed from the view layer. Removal of the ID itself needs a full update.
+ */
+void DEG_graph_id_tag_relations_update(struct Depsgraph *graph, struct ID *id);
+
 /** Create or update relations in the specified graph. */
 void DEG_graph_relations_update(struct Depsgraph *graph);
 
 /** Tag all relations in the database for update. */
 void DEG_relations_tag_update(struct Main *bmain);
 
+/** Tag relations of the given ID for update in all dependency graphs. */
+void DEG_id_tag_relations_update(struct Main *bmain, struct ID *id);
+
+/**
+ * Tag relations of the collection, its child collections and all of their objects for update in
+ * all dependency graphs. Use this when the visibility of the collection changed.
+ */
+void DEG_collection_tag_relations_update(struct Main *bmain, struct Collection *collection);
+
 /* Add Dependencies  ----------------------------- */
 
 /**
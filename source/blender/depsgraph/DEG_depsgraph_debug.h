@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
@@ -42,6 +43,14 @@ void DEG_stats_simple(const struct Depsgraph *graph,
                       size_t *r_operations,
                       size_t *r_relations);
 
+/**
+ * Obtain the size of geometry arrays which copy-on-write updates during the last evaluation had to
+ * copy, and the size of arrays they shared with the original data-blocks instead.
+ */
+void DEG_stats_copy_on_write(const struct Depsgraph *graph,
+                             int64_t *r_bytes_copied,
+                             int64_t *r_bytes_shared);
+
 /* ************************************************ */
 /* Diagram-Based Graph Debugging */
 
@@ -52,6 +61,27 @@ void DEG_debug_stats_gnuplot(const struct Depsgraph *graph,
                              const char *label,
                              const char *output_filename);
 
+/* ************************************************ */
+/* Evaluation Trace */
+
+/**
+ * Start recording the timeline of evaluations of the dependency graph: every evaluated operation
+ * with the thread it was evaluated on.
+ */
+void DEG_debug_trace_begin(struct Depsgraph *depsgraph);
+
+/**
+ * Stop recording and write the evaluations recorded since #DEG_debug_trace_begin() as a JSON file
+ * in the trace event format, which can be opened in `chrome://tracing` or Perfetto.
+ * Returns false if the graph was not being recorded or the file could not be written.
+ */
+bool DEG_debug_trace_end(struct Depsgraph *depsgraph, const char *filepath);
+
+/**
+ * Record evaluations of all dependency graphs, writing the trace to the file on exit.
+ */
+void DEG_debug_trace_global_begin(const char *filepath);
+
 /* ************************************************ */
 
 /** Compare two dependency graphs. */
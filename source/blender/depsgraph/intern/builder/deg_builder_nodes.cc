@@ -375,31 +375,36 @@ ID *DepsgraphNodeBuilder::ensure_cow_id(ID *id_orig)
 
 /* **** Build functions for entity nodes **** */
 
+void DepsgraphNodeBuilder::save_id_info(IDNode *id_node)
+{
+  /* It is possible that the ID does not need to have CoW version in which case id_cow is the
+   * same as id_orig. Additionally, such ID might have been removed, which makes the check
+   * for whether id_cow is expanded to access freed memory. In order to deal with this we
+   * check whether CoW is needed based on a scalar value which does not lead to access of
+   * possibly deleted memory. */
+  IDInfo *id_info = (IDInfo *)MEM_mallocN(sizeof(IDInfo), "depsgraph id info");
+  if (deg_copy_on_write_is_needed(id_node->id_type) &&
+      deg_copy_on_write_is_expanded(id_node->id_cow) && id_node->id_orig != id_node->id_cow)
+  {
+    id_info->id_cow = id_node->id_cow;
+  }
+  else {
+    id_info->id_cow = nullptr;
+  }
+  id_info->previously_visible_components_mask = id_node->visible_components_mask;
+  id_info->previous_eval_flags = id_node->eval_flags;
+  id_info->previous_customdata_masks = id_node->customdata_masks;
+  BLI_assert(!id_info_hash_.contains(id_node->id_orig_session_uuid));
+  id_info_hash_.add_new(id_node->id_orig_session_uuid, id_info);
+  id_node->id_cow = nullptr;
+}
+
 void DepsgraphNodeBuilder::begin_build()
 {
   /* Store existing copy-on-write versions of datablock, so we can re-use
    * them for new ID nodes. */
   for (IDNode *id_node : graph_->id_nodes) {
-    /* It is possible that the ID does not need to have CoW version in which case id_cow is the
-     * same as id_orig. Additionally, such ID might have been removed, which makes the check
-     * for whether id_cow is expanded to access freed memory. In order to deal with this we
-     * check whether CoW is needed based on a scalar value which does not lead to access of
-     * possibly deleted memory. */
-    IDInfo *id_info = (IDInfo *)MEM_mallocN(sizeof(IDInfo), "depsgraph id info");
-    if (deg_copy_on_write_is_needed(id_node->id_type) &&
-        deg_copy_on_write_is_expanded(id_node->id_cow) && id_node->id_orig != id_node->id_cow)
-    {
-      id_info->id_cow = id_node->id_cow;
-    }
-    else {
-      id_info->id_cow = nullptr;
-    }
-    id_info->previously_visible_components_mask = id_node->visible_components_mask;
-    id_info->previous_eval_flags = id_node->eval_flags;
-    id_info->previous_customdata_masks = id_node->customdata_masks;
-    BLI_assert(!id_info_hash_.contains(id_node->id_orig_session_uuid));
-    id_info_hash_.add_new(id_node->id_orig_session_uuid, id_info);
-    id_node->id_cow = nullptr;
+    save_id_info(id_node);
   }
 
   for (const OperationNode *op_node : graph_->entry_tags) {
@@ -412,6 +417,36 @@ void DepsgraphNodeBuilder::begin_build()
   graph_->entry_tags.clear();
 }
 
+void DepsgraphNodeBuilder::begin_build_partial(const Set<ID *> &rebuild_ids)
+{
+  Set<IDNode *> id_nodes_to_remove;
+  for (IDNode *id_node : graph_->id_nodes) {
+    if (rebuild_ids.contains(id_node->id_orig)) {
+      id_nodes_to_remove.add_new(id_node);
+    }
+  }
+
+  /* Same as in the full build: keep copy-on-write versions and entry tags of the nodes which are
+   * about to be re-created. */
+  for (IDNode *id_node : id_nodes_to_remove) {
+    save_id_info(id_node);
+  }
+  for (const OperationNode *op_node : graph_->entry_tags) {
+    if (id_nodes_to_remove.contains(op_node->owner->owner)) {
+      saved_entry_tags_.append_as(op_node);
+    }
+  }
+
+  graph_->remove_id_nodes(id_nodes_to_remove);
+
+  /* Nodes of all other IDs stay in the graph. Consider them built, so that they are only visited
+   * to accumulate linked state and visibility, and allow adding operations to them again. */
+  for (IDNode *id_node : graph_->id_nodes) {
+    id_node->reopen_build();
+    built_map_.tagBuild(id_node->id_orig);
+  }
+}
+
 /* Util callbacks for `BKE_library_foreach_ID_link`, used to detect when a COW ID is using ID
  * pointers that are either:
  *  - COW ID pointers that do not exist anymore in current depsgraph.
@@ -877,19 +912,24 @@ void DepsgraphNodeBuilder::build_object_flags(int base_index,
   if (base_index == -1) {
     return;
   }
+  /* TODO(sergey): Is this really best component to be used? */
+  add_operation_node(&object->id,
+                     NodeType::OBJECT_FROM_LAYER,
+                     OperationCode::OBJECT_BASE_FLAGS,
+                     object_flags_function(base_index, object, linked_state));
+}
+
+DepsEvalOperationCb DepsgraphNodeBuilder::object_flags_function(
+    int base_index, Object *object, eDepsNode_LinkedState_Type linked_state)
+{
   Scene *scene_cow = get_cow_datablock(scene_);
   Object *object_cow = get_cow_datablock(object);
   const bool is_from_set = (linked_state == DEG_ID_LINKED_VIA_SET);
-  /* TODO(sergey): Is this really best component to be used? */
-  add_operation_node(
-      &object->id,
-      NodeType::OBJECT_FROM_LAYER,
-      OperationCode::OBJECT_BASE_FLAGS,
-      [view_layer_index = view_layer_index_, scene_cow, object_cow, base_index, is_from_set](
-          ::Depsgraph *depsgraph) {
-        BKE_object_eval_eval_base_flags(
-            depsgraph, scene_cow, view_layer_index, object_cow, base_index, is_from_set);
-      });
+  return [view_layer_index = view_layer_index_, scene_cow, object_cow, base_index, is_from_set](
+             ::Depsgraph *depsgraph) {
+    BKE_object_eval_eval_base_flags(
+        depsgraph, scene_cow, view_layer_index, object_cow, base_index, is_from_set);
+  };
 }
 
 void DepsgraphNodeBuilder::build_object_instance_collection(Object *object, bool is_object_visible)
@@ -85,6 +85,9 @@ class DepsgraphNodeBuilder : public DepsgraphBuilder {
   }
 
   virtual void begin_build();
+  /* Begin partial rebuild of the existing graph: nodes of the given IDs are removed so that they
+   * can be built again, nodes of all other IDs are kept and considered built. */
+  virtual void begin_build_partial(const Set<ID *> &rebuild_ids);
   virtual void end_build();
 
   /**
@@ -171,6 +174,15 @@ class DepsgraphNodeBuilder : public DepsgraphBuilder {
   virtual void build_view_layer(Scene *scene,
                                 ViewLayer *view_layer,
                                 eDepsNode_LinkedState_Type linked_state);
+  /* Build nodes of the given IDs, after #begin_build_partial().
+   *
+   * Objects are built from their base in the view layer when they have one. Other IDs are only
+   * built when they are a dependency of another ID in the graph, which is the case for
+   * `required_ids`. */
+  virtual void build_view_layer_partial(Scene *scene,
+                                        ViewLayer *view_layer,
+                                        const Set<ID *> &rebuild_ids,
+                                        const Set<ID *> &required_ids);
   virtual void build_collection(LayerCollection *from_layer_collection, Collection *collection);
   virtual void build_object(int base_index,
                             Object *object,
@@ -183,6 +195,10 @@ class DepsgraphNodeBuilder : public DepsgraphBuilder {
   virtual void build_object_flags(int base_index,
                                   Object *object,
                                   eDepsNode_LinkedState_Type linked_state);
+  /* Evaluation function of the base flags operation of the object. */
+  DepsEvalOperationCb object_flags_function(int base_index,
+                                            Object *object,
+                                            eDepsNode_LinkedState_Type linked_state);
   virtual void build_object_modifiers(Object *object);
   virtual void build_object_data(Object *object);
   virtual void build_object_data_camera(Object *object);
@@ -299,6 +315,10 @@ class DepsgraphNodeBuilder : public DepsgraphBuilder {
                               bool is_reference,
                               void *user_data);
 
+  /* Store information from the given node which is to be transferred to the new node of the same
+   * ID, and take ownership of its copy-on-write data-block. */
+  void save_id_info(IDNode *id_node);
+
   void tag_previously_tagged_nodes();
   /**
    * Check for IDs that need to be flushed (COW-updated)
@@ -170,4 +170,51 @@ void DepsgraphNodeBuilder::build_view_layer(Scene *scene,
   }
 }
 
+void DepsgraphNodeBuilder::build_view_layer_partial(Scene *scene,
+                                                    ViewLayer *view_layer,
+                                                    const Set<ID *> &rebuild_ids,
+                                                    const Set<ID *> &required_ids)
+{
+  view_layer_index_ = 0;
+  scene_ = scene;
+  view_layer_ = view_layer;
+  /* Base indices need to match the ones of the full build, so iterate over all bases. */
+  int base_index = 0;
+  BKE_view_layer_synced_ensure(scene, view_layer);
+  LISTBASE_FOREACH (Base *, base, BKE_view_layer_object_bases_get(view_layer)) {
+    if (!need_pull_base_into_graph(base)) {
+      continue;
+    }
+    if (rebuild_ids.contains(&base->object->id)) {
+      build_object(base_index, base->object, DEG_ID_LINKED_DIRECTLY, true);
+      if (!graph_->has_animated_visibility) {
+        graph_->has_animated_visibility |= is_object_visibility_animated(base->object);
+      }
+    }
+    else if (OperationNode *op_node = find_operation_node(
+                 &base->object->id, NodeType::OBJECT_FROM_LAYER, OperationCode::OBJECT_BASE_FLAGS))
+    {
+      /* Bases were possibly added or removed before this one, which shifts its index. */
+      op_node->evaluate = object_flags_function(
+          base_index, base->object, find_id_node(&base->object->id)->linked_state);
+    }
+    else {
+      /* The object was only used indirectly so far, add the evaluation of its base flags. */
+      build_object(base_index, base->object, DEG_ID_LINKED_DIRECTLY, true);
+    }
+    base_index++;
+  }
+  /* Collections which are already in the graph return early, so this only builds the rebuilt
+   * ones with the visibility of their layer collection. */
+  build_layer_collections(&view_layer->layer_collections);
+  if (scene->camera != nullptr && rebuild_ids.contains(&scene->camera->id)) {
+    build_object(-1, scene->camera, DEG_ID_LINKED_INDIRECTLY, true);
+  }
+  for (ID *id : rebuild_ids) {
+    if (required_ids.contains(id) && !built_map_.checkIsBuilt(id)) {
+      build_id(id);
+    }
+  }
+}
+
 }  // namespace blender::deg
@@ -242,7 +242,10 @@ bool object_have_geometry_component(const Object *object)
 DepsgraphRelationBuilder::DepsgraphRelationBuilder(Main *bmain,
                                                    Depsgraph *graph,
                                                    DepsgraphBuilderCache *cache)
-    : DepsgraphBuilder(bmain, graph, cache), scene_(nullptr), rna_node_query_(graph, this)
+    : DepsgraphBuilder(bmain, graph, cache),
+      scene_(nullptr),
+      relation_flags_(0),
+      rna_node_query_(graph, this)
 {
 }
 
@@ -358,7 +361,7 @@ Relation *DepsgraphRelationBuilder::add_time_relation(TimeSourceNode *timesrc,
                                                       int flags)
 {
   if (timesrc && node_to) {
-    return graph_->add_new_relation(timesrc, node_to, description, flags);
+    return graph_->add_new_relation(timesrc, node_to, description, flags | relation_flags_);
   }
 
   DEG_DEBUG_PRINTF((::Depsgraph *)graph_,
@@ -386,7 +389,7 @@ Relation *DepsgraphRelationBuilder::add_operation_relation(OperationNode *node_f
                                                            int flags)
 {
   if (node_from && node_to) {
-    return graph_->add_new_relation(node_from, node_to, description, flags);
+    return graph_->add_new_relation(node_from, node_to, description, flags | relation_flags_);
   }
 
   DEG_DEBUG_PRINTF((::Depsgraph *)graph_,
@@ -500,6 +503,19 @@ Depsgraph *DepsgraphRelationBuilder::getGraph()
 
 void DepsgraphRelationBuilder::begin_build() {}
 
+void DepsgraphRelationBuilder::begin_build_partial(const Set<ID *> &rebuild_ids)
+{
+  relation_flags_ = RELATION_CHECK_BEFORE_ADD;
+  for (IDNode *id_node : graph_->id_nodes) {
+    /* Scene relations are cheap to build compared to the objects in it, and have no single
+     * owner, so always build them again. */
+    if (id_node->id_type == ID_SCE || rebuild_ids.contains(id_node->id_orig)) {
+      continue;
+    }
+    built_map_.tagBuild(id_node->id_orig);
+  }
+}
+
 void DepsgraphRelationBuilder::build_id(ID *id)
 {
   if (id == nullptr) {
@@ -3317,6 +3333,12 @@ void DepsgraphRelationBuilder::build_nested_shapekey(ID *owner, Key *key)
 }
 
 void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
+{
+  build_copy_on_write_relations(id_node, nullptr);
+}
+
+void DepsgraphRelationBuilder::build_copy_on_write_relations(
+    IDNode *id_node, const Set<OperationNode *> *only_op_nodes)
 {
   ID *id_orig = id_node->id_orig;
 
@@ -3377,7 +3399,7 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
     /* All entry operations of each component should wait for a proper
      * copy of ID. */
     OperationNode *op_entry = comp_node->get_entry_operation();
-    if (op_entry != nullptr) {
+    if (op_entry != nullptr && (only_op_nodes == nullptr || only_op_nodes->contains(op_entry))) {
       Relation *rel = graph_->add_new_relation(op_cow, op_entry, "CoW Dependency");
       rel->flag |= rel_flag;
     }
@@ -3386,6 +3408,9 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
       if (op_node == op_entry) {
         continue;
       }
+      if (only_op_nodes != nullptr && !only_op_nodes->contains(op_node)) {
+        continue;
+      }
       if (op_node->inlinks.is_empty()) {
         Relation *rel = graph_->add_new_relation(op_cow, op_node, "CoW Dependency");
         rel->flag |= rel_flag;
@@ -3418,7 +3443,7 @@ void DepsgraphRelationBuilder::build_copy_on_write_relations(IDNode *id_node)
   }
   /* TODO(sergey): This solves crash for now, but causes too many
    * updates potentially. */
-  if (GS(id_orig->name) == ID_OB) {
+  if (GS(id_orig->name) == ID_OB && only_op_nodes == nullptr) {
     Object *object = (Object *)id_orig;
     ID *object_data_id = (ID *)object->data;
     if (object_data_id != nullptr) {
@@ -85,6 +85,11 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
   DepsgraphRelationBuilder(Main *bmain, Depsgraph *graph, DepsgraphBuilderCache *cache);
 
   void begin_build();
+  /* Begin partial rebuild of relations after the nodes of the graph were partially rebuilt.
+   * Relations of the given IDs, and of IDs which are not in the graph yet, are built again. Other
+   * IDs are considered built, except for the scenes. Relations which already exist are not added
+   * again. */
+  void begin_build_partial(const Set<ID *> &rebuild_ids);
 
   template<typename KeyFrom, typename KeyTo>
   Relation *add_relation(const KeyFrom &key_from,
@@ -254,6 +259,10 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
 
   virtual void build_copy_on_write_relations();
   virtual void build_copy_on_write_relations(IDNode *id_node);
+  /* Only build the relations of the given operations of the ID, when they were added to an ID
+   * whose copy-on-write relations are already built. */
+  virtual void build_copy_on_write_relations(IDNode *id_node,
+                                             const Set<OperationNode *> *only_op_nodes);
   virtual void build_driver_relations();
   virtual void build_driver_relations(IDNode *id_node);
 
@@ -319,6 +328,9 @@ class DepsgraphRelationBuilder : public DepsgraphBuilder {
   /* State which demotes currently built entities. */
   Scene *scene_;
 
+  /* Flags added to every new relation. */
+  int relation_flags_;
+
   BuilderMap built_map_;
   RNANodeQuery rna_node_query_;
   BuilderStack stack_;
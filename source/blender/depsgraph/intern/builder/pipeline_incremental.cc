@@ -0,0 +1,375 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+#include "pipeline_incremental.h"
+
+#include "PIL_time.h"
+
+#include "BLI_listbase.h"
+
+#include "BKE_global.h"
+#include "BKE_layer.h"
+
+#include "DNA_layer_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "DEG_depsgraph_physics.h"
+
+#include "intern/builder/deg_builder_nodes.h"
+#include "intern/builder/deg_builder_relations.h"
+#include "intern/builder/pipeline_view_layer.h"
+#include "intern/depsgraph.h"
+#include "intern/depsgraph_relation.h"
+#include "intern/node/deg_node.h"
+#include "intern/node/deg_node_component.h"
+#include "intern/node/deg_node_id.h"
+#include "intern/node/deg_node_operation.h"
+
+namespace blender::deg {
+
+namespace {
+
+class IncrementalRelationBuilder : public DepsgraphRelationBuilder {
+ public:
+  IncrementalRelationBuilder(Main *bmain,
+                             Depsgraph *graph,
+                             DepsgraphBuilderCache *cache,
+                             const Set<ID *> &relation_ids)
+      : DepsgraphRelationBuilder(bmain, graph, cache), relation_ids_(relation_ids)
+  {
+  }
+
+  bool need_pull_base_into_graph(const Base *base) override
+  {
+    /* Relations from the view layer to objects are built by the objects. */
+    if (!relation_ids_.contains(&base->object->id)) {
+      return false;
+    }
+    return DepsgraphRelationBuilder::need_pull_base_into_graph(base);
+  }
+
+ protected:
+  const Set<ID *> &relation_ids_;
+};
+
+/* Call the function for every ID node which is connected to the given one by a relation.
+ * The second argument tells whether the other node depends on the given one. */
+template<typename Func> void foreach_connected_id_node(IDNode *id_node, const Func &func)
+{
+  for (ComponentNode *comp_node : id_node->components.values()) {
+    for (OperationNode *op_node : comp_node->operations) {
+      for (Relation *rel : op_node->inlinks) {
+        if (rel->from->type == NodeType::OPERATION) {
+          IDNode *other = static_cast<OperationNode *>(rel->from)->owner->owner;
+          if (other != id_node) {
+            func(other, false);
+          }
+        }
+      }
+      for (Relation *rel : op_node->outlinks) {
+        if (rel->to->type == NodeType::OPERATION) {
+          IDNode *other = static_cast<OperationNode *>(rel->to)->owner->owner;
+          if (other != id_node) {
+            func(other, true);
+          }
+        }
+      }
+    }
+  }
+}
+
+bool has_cached_physics_relations(const Depsgraph *graph)
+{
+  for (int i = 0; i < DEG_PHYSICS_RELATIONS_NUM; i++) {
+    const Map<const ID *, ListBase *> *hash = graph->physics_relations[i];
+    if (hash != nullptr && !hash->is_empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+string operation_signature(const OperationNode *op_node)
+{
+  return string(nodeTypeAsString(op_node->owner->type)) + " " + op_node->full_identifier() + "[" +
+         to_string(op_node->name_tag) + "]";
+}
+
+void print_signature_difference(const char *what, const Set<string> &a, const Set<string> &b)
+{
+  const int max_printed = 16;
+  int num_printed = 0;
+  for (const string &signature : a) {
+    if (b.contains(signature)) {
+      continue;
+    }
+    if (num_printed++ == max_printed) {
+      printf("  ...\n");
+      break;
+    }
+    printf("  %s: %s\n", what, signature.c_str());
+  }
+}
+
+}  // namespace
+
+void collect_graph_signature(const Depsgraph *graph,
+                             Set<string> &r_operations,
+                             Set<string> &r_relations)
+{
+  for (const IDNode *id_node : graph->id_nodes) {
+    for (const ComponentNode *comp_node : id_node->components.values()) {
+      for (const OperationNode *op_node : comp_node->operations) {
+        const string op_signature = operation_signature(op_node);
+        r_operations.add(op_signature);
+        for (const Relation *rel : op_node->inlinks) {
+          const string from_signature = (rel->from->type == NodeType::OPERATION) ?
+                                            operation_signature(
+                                                static_cast<OperationNode *>(rel->from)) :
+                                            rel->from->identifier();
+          r_relations.add(from_signature + " -> " + op_signature + " (" + rel->name + ")");
+        }
+      }
+    }
+  }
+}
+
+IncrementalBuilderPipeline::IncrementalBuilderPipeline(::Depsgraph *graph)
+    : AbstractBuilderPipeline(graph)
+{
+}
+
+bool IncrementalBuilderPipeline::build_incremental()
+{
+  double start_time = 0.0;
+  if (G.debug & (G_DEBUG_DEPSGRAPH_BUILD | G_DEBUG_DEPSGRAPH_TIME)) {
+    start_time = PIL_check_seconds_timer();
+  }
+
+  if (!build_step_collect_ids()) {
+    return false;
+  }
+
+  build_step_sanity_check();
+  build_step_nodes();
+  build_step_relations();
+  build_step_finalize();
+
+  if (G.debug & (G_DEBUG_DEPSGRAPH_BUILD | G_DEBUG_DEPSGRAPH_TIME)) {
+    printf("Depsgraph relations of %d IDs updated in %f seconds.\n",
+           int(relation_ids_.size()),
+           PIL_check_seconds_timer() - start_time);
+  }
+
+  if (G.debug & G_DEBUG_DEPSGRAPH_VALIDATE_INCREMENTAL) {
+    build_step_validate();
+  }
+
+  return true;
+}
+
+bool IncrementalBuilderPipeline::build_step_collect_ids()
+{
+  if (deg_graph_->need_update_relations_full || deg_graph_->relations_update_ids.is_empty() ||
+      deg_graph_->id_nodes.is_empty())
+  {
+    return false;
+  }
+  /* Relations of set scenes and rigid body worlds involve all of their objects, and cached
+   * light linking and physics relations are computed for the whole scene. */
+  if (scene_->set != nullptr || scene_->rigidbody_world != nullptr ||
+      deg_graph_->light_linking_cache.has_light_linking() ||
+      has_cached_physics_relations(deg_graph_))
+  {
+    return false;
+  }
+
+  for (ID *id : deg_graph_->relations_update_ids) {
+    if (GS(id->name) == ID_SCE) {
+      return false;
+    }
+    /* IDs which are not in the graph yet are built from the IDs which use them, except for new
+     * objects which can be pulled into the graph by their base. */
+    if (deg_graph_->find_id_node(id) != nullptr || GS(id->name) == ID_OB) {
+      rebuild_ids_.add(id);
+    }
+  }
+
+  /* Bases which start or stop being evaluated without their object being tagged, for example when
+   * only the visibility of their collection was tagged. Objects which were only used indirectly so
+   * far are kept and get the evaluation of their base added. */
+  Vector<ID *> base_added_ids;
+  const int base_flag = (deg_graph_->mode == DAG_EVAL_VIEWPORT) ? BASE_ENABLED_VIEWPORT :
+                                                                  BASE_ENABLED_RENDER;
+  BKE_view_layer_synced_ensure(scene_, view_layer_);
+  LISTBASE_FOREACH (Base *, base, BKE_view_layer_object_bases_get(view_layer_)) {
+    ID *id = &base->object->id;
+    if (rebuild_ids_.contains(id)) {
+      continue;
+    }
+    const IDNode *id_node = deg_graph_->find_id_node(id);
+    const bool is_enabled = (base->flag & base_flag) != 0;
+    if (id_node == nullptr) {
+      if (is_enabled) {
+        rebuild_ids_.add(id);
+      }
+    }
+    else if (is_enabled && !id_node->has_base) {
+      base_added_ids.append(id);
+    }
+    /* Bases of objects with animated visibility are evaluated even when they are disabled. */
+    else if (!is_enabled && id_node->has_base && !deg_graph_->has_animated_visibility) {
+      rebuild_ids_.add(id);
+    }
+  }
+
+  /* Nodes of objects depend on their data (bones of an armature, for example), so rebuild the
+   * objects using the tagged data as well. */
+  Vector<ID *> data_users;
+  for (ID *id : rebuild_ids_) {
+    IDNode *id_node = deg_graph_->find_id_node(id);
+    if (id_node == nullptr || !OB_DATA_SUPPORT_ID(GS(id->name))) {
+      continue;
+    }
+    foreach_connected_id_node(id_node, [&](IDNode *other, const bool is_user) {
+      if (is_user && other->id_type == ID_OB && ((Object *)other->id_orig)->data == id) {
+        data_users.append(other->id_orig);
+      }
+    });
+  }
+  rebuild_ids_.add_multiple(data_users);
+
+  for (ID *id : rebuild_ids_) {
+    relation_ids_.add(id);
+    IDNode *id_node = deg_graph_->find_id_node(id);
+    if (id_node == nullptr) {
+      continue;
+    }
+    foreach_connected_id_node(id_node, [&](IDNode *other, const bool is_user) {
+      if (rebuild_ids_.contains(other->id_orig)) {
+        return;
+      }
+      if (is_user) {
+        required_ids_.add(id);
+      }
+      /* Scene relations are always rebuilt, see #DepsgraphRelationBuilder::begin_build_partial. */
+      if (other->id_type != ID_SCE) {
+        relation_ids_.add(other->id_orig);
+      }
+    });
+  }
+  relation_ids_.add_multiple(base_added_ids);
+
+  /* Rebuilding a big part of the graph piece by piece is slower than building it at once. */
+  if (relation_ids_.size() > deg_graph_->id_nodes.size() / 2) {
+    return false;
+  }
+
+  for (IDNode *id_node : deg_graph_->id_nodes) {
+    if (!rebuild_ids_.contains(id_node->id_orig)) {
+      kept_id_nodes_.add_new(id_node);
+    }
+  }
+
+  return true;
+}
+
+void IncrementalBuilderPipeline::build_step_nodes()
+{
+  unique_ptr<DepsgraphNodeBuilder> node_builder = construct_node_builder();
+  node_builder->begin_build_partial(rebuild_ids_);
+  const int64_t kept_operations_num = deg_graph_->operations.size();
+  build_nodes(*node_builder);
+  node_builder->end_build();
+
+  /* New operations are appended to the graph, the kept nodes can get some as well. */
+  for (const int64_t i : deg_graph_->operations.index_range().drop_front(kept_operations_num)) {
+    OperationNode *op_node = deg_graph_->operations[i];
+    if (kept_id_nodes_.contains(op_node->owner->owner)) {
+      kept_nodes_new_operations_.add(op_node);
+    }
+  }
+}
+
+void IncrementalBuilderPipeline::build_step_relations()
+{
+  unique_ptr<DepsgraphRelationBuilder> relation_builder = construct_relation_builder();
+  relation_builder->begin_build_partial(relation_ids_);
+  build_relations(*relation_builder);
+  /* Copy-on-write and driver relations stay within a single ID, so they only need to be built
+   * for the new nodes. */
+  for (IDNode *id_node : deg_graph_->id_nodes) {
+    if (kept_id_nodes_.contains(id_node)) {
+      continue;
+    }
+    relation_builder->build_copy_on_write_relations(id_node);
+    relation_builder->build_driver_relations(id_node);
+  }
+  /* Copy-on-write relations of the kept nodes are built already, except for their new operations.
+   * Kept nodes do not get new driver operations. */
+  if (!kept_nodes_new_operations_.is_empty()) {
+    Set<IDNode *> id_nodes;
+    for (OperationNode *op_node : kept_nodes_new_operations_) {
+      id_nodes.add(op_node->owner->owner);
+    }
+    for (IDNode *id_node : id_nodes) {
+      relation_builder->build_copy_on_write_relations(id_node, &kept_nodes_new_operations_);
+    }
+  }
+}
+
+void IncrementalBuilderPipeline::build_step_validate()
+{
+  /* Transitive reduction removes relations depending on the whole graph. */
+  if (G.debug_value == 799) {
+    return;
+  }
+
+  Depsgraph *full_graph = new Depsgraph(
+      deg_graph_->bmain, deg_graph_->scene, deg_graph_->view_layer, deg_graph_->mode);
+  ViewLayerBuilderPipeline full_builder(reinterpret_cast<::Depsgraph *>(full_graph));
+  full_builder.build();
+
+  Set<string> operations, full_operations;
+  Set<string> relations, full_relations;
+  collect_graph_signature(deg_graph_, operations, relations);
+  collect_graph_signature(full_graph, full_operations, full_relations);
+  delete full_graph;
+
+  /* Operations and relations of IDs which are not used anymore stay in the graph until the next
+   * full rebuild, so extra entries are expected. Missing ones are errors. */
+  if (operations == full_operations && relations == full_relations) {
+    printf("Incremental depsgraph relations update matches full rebuild.\n");
+    return;
+  }
+  printf("Incremental depsgraph relations update differs from full rebuild.\n");
+  print_signature_difference("Missing operation", full_operations, operations);
+  print_signature_difference("Missing relation", full_relations, relations);
+  print_signature_difference("Extra operation", operations, full_operations);
+  print_signature_difference("Extra relation", relations, full_relations);
+}
+
+unique_ptr<DepsgraphRelationBuilder> IncrementalBuilderPipeline::construct_relation_builder()
+{
+  return std::make_unique<IncrementalRelationBuilder>(
+      bmain_, deg_graph_, &builder_cache_, relation_ids_);
+}
+
+void IncrementalBuilderPipeline::build_nodes(DepsgraphNodeBuilder &node_builder)
+{
+  node_builder.build_view_layer_partial(scene_, view_layer_, rebuild_ids_, required_ids_);
+}
+
+void IncrementalBuilderPipeline::build_relations(DepsgraphRelationBuilder &relation_builder)
+{
+  relation_builder.build_view_layer(scene_, view_layer_, DEG_ID_LINKED_DIRECTLY);
+  for (ID *id : relation_ids_) {
+    /* Rebuilt IDs which are not used anymore are not in the graph. */
+    if (deg_graph_->find_id_node(id) != nullptr) {
+      relation_builder.build_id(id);
+    }
+  }
+}
+
+}  // namespace blender::deg
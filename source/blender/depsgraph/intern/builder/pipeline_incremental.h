@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#pragma once
+
+#include "pipeline.h"
+
+namespace blender::deg {
+
+struct IDNode;
+struct OperationNode;
+
+/* Incremental update of a dependency graph which was built by #ViewLayerBuilderPipeline.
+ *
+ * Only the nodes and relations of the IDs tagged with #DEG_graph_id_tag_relations_update() are
+ * rebuilt, together with the relations of the IDs they are connected to. All other nodes and
+ * their relations are kept as-is. */
+class IncrementalBuilderPipeline : public AbstractBuilderPipeline {
+ public:
+  IncrementalBuilderPipeline(::Depsgraph *graph);
+
+  /* Update the graph. Returns false if the tagged changes can not be handled incrementally, in
+   * which case the graph is left unchanged and needs to be fully rebuilt. */
+  bool build_incremental();
+
+ protected:
+  /* IDs whose nodes and relations are rebuilt. */
+  Set<ID *> rebuild_ids_;
+  /* Rebuilt IDs which other IDs in the graph depend on. They are kept in the graph even when
+   * they are not reachable from the view layer anymore. */
+  Set<ID *> required_ids_;
+  /* Rebuilt IDs and their neighbors, whose relations are rebuilt. */
+  Set<ID *> relation_ids_;
+  /* Nodes which are kept from the previous state of the graph. */
+  Set<IDNode *> kept_id_nodes_;
+  /* Operations which were added to the kept nodes, for example when an object which was only used
+   * indirectly gets a base. */
+  Set<OperationNode *> kept_nodes_new_operations_;
+
+  virtual unique_ptr<DepsgraphRelationBuilder> construct_relation_builder() override;
+
+  bool build_step_collect_ids();
+  virtual void build_step_nodes() override;
+  virtual void build_step_relations() override;
+  void build_step_validate();
+
+  virtual void build_nodes(DepsgraphNodeBuilder &node_builder) override;
+  virtual void build_relations(DepsgraphRelationBuilder &relation_builder) override;
+};
+
+/* Description of all operations and relations of the graph which does not depend on memory
+ * addresses, so that different graphs built for the same view layer can be compared. */
+void collect_graph_signature(const Depsgraph *graph,
+                             Set<string> &r_operations,
+                             Set<string> &r_relations);
+
+}  // namespace blender::deg
@@ -0,0 +1,252 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "testing/testing.h"
+
+#include "CLG_log.h"
+
+#include "DNA_collection_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BKE_collection.h"
+#include "BKE_global.h"
+#include "BKE_idtype.h"
+#include "BKE_layer.h"
+#include "BKE_main.h"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "RNA_access.h"
+#include "RNA_define.h"
+
+#include "DEG_depsgraph.h"
+#include "DEG_depsgraph_build.h"
+
+#include "intern/builder/pipeline_incremental.h"
+#include "intern/depsgraph.h"
+
+namespace blender::deg::tests {
+
+class DepsgraphIncrementalTest : public testing::Test {
+ protected:
+  Main *bmain = nullptr;
+  Scene *scene = nullptr;
+  ViewLayer *view_layer = nullptr;
+  ::Depsgraph *depsgraph = nullptr;
+
+  static void SetUpTestSuite()
+  {
+    CLG_init();
+    BKE_idtype_init();
+    RNA_init();
+    DEG_register_node_types();
+  }
+
+  static void TearDownTestSuite()
+  {
+    DEG_free_node_types();
+    RNA_exit();
+    CLG_exit();
+  }
+
+  void SetUp() override
+  {
+    bmain = BKE_main_new();
+    G.main = bmain;
+    scene = BKE_scene_add(bmain, "Scene");
+    view_layer = BKE_view_layer_default_view(scene);
+  }
+
+  void TearDown() override
+  {
+    if (depsgraph != nullptr) {
+      DEG_graph_free(depsgraph);
+    }
+    BKE_main_free(bmain);
+    G.main = nullptr;
+  }
+
+  Object *add_object(const char *name, Object *parent = nullptr)
+  {
+    Object *object = BKE_object_add_only_object(bmain, OB_EMPTY, name);
+    object->parent = parent;
+    object->partype = PAROBJECT;
+    BKE_collection_object_add(bmain, scene->master_collection, object);
+    BKE_main_collection_sync(bmain);
+    return object;
+  }
+
+  /* Enough unrelated objects so that the changes in the tests affect less than half of the graph,
+   * which is the limit for using the incremental update. */
+  void build_scene_and_graph()
+  {
+    for ([[maybe_unused]] const int i : IndexRange(16)) {
+      add_object("Unrelated");
+    }
+    depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+    DEG_graph_build_from_view_layer(depsgraph);
+  }
+
+  void update_relations_incremental(ID *id)
+  {
+    DEG_graph_id_tag_relations_update(depsgraph, id);
+    IncrementalBuilderPipeline builder(depsgraph);
+    EXPECT_TRUE(builder.build_incremental());
+  }
+
+  Depsgraph *deg_graph()
+  {
+    return reinterpret_cast<Depsgraph *>(depsgraph);
+  }
+
+  /* Change the property including its update, like the user interface does. */
+  void set_boolean_property(ID *id, const char *name, const bool value)
+  {
+    PointerRNA ptr;
+    RNA_id_pointer_create(id, &ptr);
+    PropertyRNA *prop = RNA_struct_find_property(&ptr, name);
+    ASSERT_NE(prop, nullptr);
+    RNA_property_boolean_set(&ptr, prop, value);
+    RNA_property_update_main(bmain, scene, &ptr, prop);
+  }
+
+  /* The IDs tagged by the updates have to be handled without a full rebuild. */
+  void update_relations_from_tags()
+  {
+    EXPECT_FALSE(deg_graph()->need_update_relations_full);
+    EXPECT_FALSE(deg_graph()->relations_update_ids.is_empty());
+    IncrementalBuilderPipeline builder(depsgraph);
+    EXPECT_TRUE(builder.build_incremental());
+    EXPECT_TRUE(deg_graph()->relations_update_ids.is_empty());
+  }
+
+  /* Operations and relations of IDs which are not used anymore are allowed to stay in the graph
+   * until the next full rebuild. */
+  void expect_matches_full_rebuild(const bool allow_extra)
+  {
+    ::Depsgraph *full_depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+    DEG_graph_build_from_view_layer(full_depsgraph);
+
+    Set<string> operations, full_operations;
+    Set<string> relations, full_relations;
+    collect_graph_signature(reinterpret_cast<Depsgraph *>(depsgraph), operations, relations);
+    collect_graph_signature(
+        reinterpret_cast<Depsgraph *>(full_depsgraph), full_operations, full_relations);
+    DEG_graph_free(full_depsgraph);
+
+    for (const string &signature : full_operations) {
+      EXPECT_TRUE(operations.contains(signature)) << "Missing operation: " << signature;
+    }
+    for (const string &signature : full_relations) {
+      EXPECT_TRUE(relations.contains(signature)) << "Missing relation: " << signature;
+    }
+    if (!allow_extra) {
+      for (const string &signature : operations) {
+        EXPECT_TRUE(full_operations.contains(signature)) << "Extra operation: " << signature;
+      }
+      for (const string &signature : relations) {
+        EXPECT_TRUE(full_relations.contains(signature)) << "Extra relation: " << signature;
+      }
+    }
+  }
+};
+
+TEST_F(DepsgraphIncrementalTest, AddObject)
+{
+  Object *parent = add_object("Parent");
+  build_scene_and_graph();
+
+  Object *child = add_object("Child", parent);
+  update_relations_incremental(&child->id);
+  expect_matches_full_rebuild(false);
+}
+
+TEST_F(DepsgraphIncrementalTest, RemoveObject)
+{
+  Object *parent = add_object("Parent");
+  Object *child = add_object("Child", parent);
+  build_scene_and_graph();
+
+  BKE_collection_object_remove(bmain, scene->master_collection, child, false);
+  BKE_main_collection_sync(bmain);
+  update_relations_incremental(&child->id);
+  expect_matches_full_rebuild(true);
+}
+
+TEST_F(DepsgraphIncrementalTest, ReparentObject)
+{
+  Object *parent_a = add_object("ParentA");
+  Object *parent_b = add_object("ParentB");
+  Object *child = add_object("Child", parent_a);
+  add_object("GrandChild", child);
+  build_scene_and_graph();
+
+  child->parent = parent_b;
+  update_relations_incremental(&child->id);
+  expect_matches_full_rebuild(false);
+}
+
+TEST_F(DepsgraphIncrementalTest, ObjectVisibilityThroughRNA)
+{
+  Object *parent = add_object("Parent");
+  add_object("Child", parent);
+  build_scene_and_graph();
+
+  /* The hidden parent stays in the graph indirectly, for its child. */
+  set_boolean_property(&parent->id, "hide_viewport", true);
+  EXPECT_TRUE(deg_graph()->relations_update_ids.contains(&parent->id));
+  update_relations_from_tags();
+  expect_matches_full_rebuild(true);
+
+  set_boolean_property(&parent->id, "hide_viewport", false);
+  EXPECT_TRUE(deg_graph()->relations_update_ids.contains(&parent->id));
+  update_relations_from_tags();
+  expect_matches_full_rebuild(false);
+}
+
+TEST_F(DepsgraphIncrementalTest, CollectionVisibilityThroughRNA)
+{
+  Collection *collection = BKE_collection_add(bmain, scene->master_collection, "Collection");
+  Object *object_a = BKE_object_add_only_object(bmain, OB_EMPTY, "ObjectA");
+  Object *object_b = BKE_object_add_only_object(bmain, OB_EMPTY, "ObjectB");
+  BKE_collection_object_add(bmain, collection, object_a);
+  BKE_collection_object_add(bmain, collection, object_b);
+  object_b->parent = object_a;
+  object_b->partype = PAROBJECT;
+  BKE_main_collection_sync(bmain);
+  build_scene_and_graph();
+
+  set_boolean_property(&collection->id, "hide_viewport", true);
+  EXPECT_TRUE(deg_graph()->relations_update_ids.contains(&collection->id));
+  EXPECT_TRUE(deg_graph()->relations_update_ids.contains(&object_a->id));
+  EXPECT_TRUE(deg_graph()->relations_update_ids.contains(&object_b->id));
+  update_relations_from_tags();
+  expect_matches_full_rebuild(true);
+
+  set_boolean_property(&collection->id, "hide_viewport", false);
+  update_relations_from_tags();
+  expect_matches_full_rebuild(false);
+}
+
+TEST_F(DepsgraphIncrementalTest, KeptObjectGetsBase)
+{
+  Object *parent = add_object("Parent");
+  Object *child = add_object("Child", parent);
+  parent->visibility_flag |= OB_HIDE_VIEWPORT;
+  BKE_main_collection_sync(bmain);
+  build_scene_and_graph();
+
+  /* Only the child is tagged, the node of the parent is kept and gets the operations of its
+   * base added. */
+  parent->visibility_flag &= ~OB_HIDE_VIEWPORT;
+  BKE_main_collection_sync(bmain);
+  update_relations_incremental(&child->id);
+  expect_matches_full_rebuild(false);
+}
+
+}  // namespace blender::deg::tests
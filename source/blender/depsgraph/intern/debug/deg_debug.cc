@@ -19,7 +19,11 @@
 namespace blender::deg {
 
 DepsgraphDebug::DepsgraphDebug()
-    : flags(G.debug), is_ever_evaluated(false), graph_evaluation_start_time_(0)
+    : flags(G.debug),
+      is_ever_evaluated(false),
+      cow_bytes_copied(0),
+      cow_bytes_shared(0),
+      graph_evaluation_start_time_(0)
 {
 }
 
@@ -28,8 +32,19 @@ bool DepsgraphDebug::do_time_debug() const
   return ((G.debug & G_DEBUG_DEPSGRAPH_TIME) != 0);
 }
 
+TraceRecorder *DepsgraphDebug::active_trace() const
+{
+  if (trace) {
+    return trace.get();
+  }
+  return trace_recorder_global();
+}
+
 void DepsgraphDebug::begin_graph_evaluation()
 {
+  cow_bytes_copied = 0;
+  cow_bytes_shared = 0;
+
   if (!do_time_debug()) {
     return;
   }
@@ -53,6 +68,12 @@ void DepsgraphDebug::end_graph_evaluation()
   printf("Depsgraph updated in %f seconds.\n", graph_eval_end_time - graph_evaluation_start_time_);
   printf("Depsgraph evaluation FPS: %f\n", 1.0f / fps_samples_.get_averaged());
 
+  char copied_str[BLI_STR_FORMAT_INT64_BYTE_UNIT_SIZE];
+  char shared_str[BLI_STR_FORMAT_INT64_BYTE_UNIT_SIZE];
+  BLI_str_format_byte_unit(copied_str, cow_bytes_copied, false);
+  BLI_str_format_byte_unit(shared_str, cow_bytes_shared, false);
+  printf("Depsgraph copy-on-write geometry: %s copied, %s shared\n", copied_str, shared_str);
+
   is_ever_evaluated = true;
 }
 
@@ -7,6 +7,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+
+#include "intern/debug/deg_debug_trace.h"
 #include "intern/debug/deg_time_average.h"
 #include "intern/depsgraph_type.h"
 
@@ -22,6 +26,9 @@ class DepsgraphDebug {
 
   bool do_time_debug() const;
 
+  /* Recorder which evaluation of this graph is to be traced into, or null. */
+  TraceRecorder *active_trace() const;
+
   void begin_graph_evaluation();
   void end_graph_evaluation();
 
@@ -36,6 +43,14 @@ class DepsgraphDebug {
    * This is NOT an indication that depsgraph is at its evaluated state. */
   bool is_ever_evaluated;
 
+  /* Size of geometry arrays which copy-on-write updates of the last evaluation copied or shared
+   * with the original data-blocks. Updated from multiple threads during evaluation. */
+  mutable std::atomic<int64_t> cow_bytes_copied;
+  mutable std::atomic<int64_t> cow_bytes_shared;
+
+  /* Recorder of the evaluations of this graph only, see #DEG_debug_trace_begin(). */
+  std::unique_ptr<TraceRecorder> trace;
+
  protected:
   /* Maximum number of counters used to calculate frame rate of depsgraph update. */
   static const constexpr int MAX_FPS_COUNTERS = 64;
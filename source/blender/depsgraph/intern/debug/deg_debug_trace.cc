@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+/** \file
+ * \ingroup depsgraph
+ *
+ * Export of the evaluation timeline in the trace event format.
+ */
+
+#include "intern/debug/deg_debug_trace.h"
+
+#include <atomic>
+
+#include "PIL_time.h"
+
+#include "BLI_fileops.hh"
+#include "BLI_serialize.hh"
+
+#include "BKE_blender.h"
+
+#include "DEG_depsgraph_debug.h"
+
+#include "intern/depsgraph.h"
+
+namespace deg = blender::deg;
+
+namespace blender::deg {
+
+namespace {
+
+/* Small number identifying the calling thread, which keeps the trace readable. */
+int current_thread_index()
+{
+  static std::atomic<int> threads_num = 0;
+  static thread_local const int index = threads_num++;
+  return index;
+}
+
+struct GlobalTrace {
+  std::unique_ptr<TraceRecorder> recorder;
+  string filepath;
+};
+
+GlobalTrace &global_trace()
+{
+  static GlobalTrace trace;
+  return trace;
+}
+
+void global_trace_write_at_exit(void * /*user_data*/)
+{
+  GlobalTrace &trace = global_trace();
+  if (!trace.recorder) {
+    return;
+  }
+  if (trace.recorder->write(trace.filepath.c_str())) {
+    printf("Depsgraph evaluation trace written to %s\n", trace.filepath.c_str());
+  }
+  else {
+    fprintf(stderr, "Failed to write depsgraph evaluation trace to %s\n", trace.filepath.c_str());
+  }
+  trace.recorder.reset();
+}
+
+}  // namespace
+
+TraceRecorder::TraceRecorder() : start_time_(PIL_check_seconds_timer()) {}
+
+int TraceRecorder::process_for_graph(const void *graph, StringRef name)
+{
+  std::lock_guard lock(mutex_);
+  return process_by_graph_.lookup_or_add_cb(graph, [&]() {
+    process_names_.append(name.is_empty() ? string("Depsgraph") : string(name));
+    return int(process_names_.size()) - 1;
+  });
+}
+
+void TraceRecorder::add_event(
+    const int process, string name, const char *category, const double start, const double end)
+{
+  const int thread = current_thread_index();
+  std::lock_guard lock(mutex_);
+  threads_.add({process, thread});
+  events_.append({std::move(name), category, start, end, process, thread});
+}
+
+bool TraceRecorder::write(const char *filepath) const
+{
+  using namespace io::serialize;
+
+  std::lock_guard lock(mutex_);
+
+  DictionaryValue root;
+  ArrayValue &events = *root.append_array("traceEvents");
+
+  for (const int process : process_names_.index_range()) {
+    DictionaryValue &metadata = *events.append_dict();
+    metadata.append_str("name", "process_name");
+    metadata.append_str("ph", "M");
+    metadata.append_int("pid", process);
+    metadata.append_dict("args")->append_str("name", process_names_[process]);
+  }
+  for (const std::pair<int, int> &thread : threads_) {
+    DictionaryValue &metadata = *events.append_dict();
+    metadata.append_str("name", "thread_name");
+    metadata.append_str("ph", "M");
+    metadata.append_int("pid", thread.first);
+    metadata.append_int("tid", thread.second);
+    metadata.append_dict("args")->append_str("name", "Thread " + std::to_string(thread.second));
+  }
+
+  /* Timestamps and durations are in microseconds. */
+  for (const Event &event : events_) {
+    DictionaryValue &value = *events.append_dict();
+    value.append_str("name", event.name);
+    value.append_str("cat", event.category);
+    value.append_str("ph", "X");
+    value.append_double("ts", (event.start - start_time_) * 1e6);
+    value.append_double("dur", (event.end - event.start) * 1e6);
+    value.append_int("pid", event.process);
+    value.append_int("tid", event.thread);
+  }
+  root.append_str("displayTimeUnit", "ms");
+
+  fstream stream(filepath, std::ios::out | std::ios::trunc);
+  if (!stream.is_open()) {
+    return false;
+  }
+  JsonFormatter formatter;
+  formatter.serialize(stream, root);
+  return stream.good();
+}
+
+TraceRecorder *trace_recorder_global()
+{
+  return global_trace().recorder.get();
+}
+
+}  // namespace blender::deg
+
+void DEG_debug_trace_begin(Depsgraph *depsgraph)
+{
+  deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(depsgraph);
+  deg_graph->debug.trace = std::make_unique<deg::TraceRecorder>();
+}
+
+bool DEG_debug_trace_end(Depsgraph *depsgraph, const char *filepath)
+{
+  deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(depsgraph);
+  if (!deg_graph->debug.trace) {
+    return false;
+  }
+  const bool success = deg_graph->debug.trace->write(filepath);
+  deg_graph->debug.trace.reset();
+  return success;
+}
+
+void DEG_debug_trace_global_begin(const char *filepath)
+{
+  deg::GlobalTrace &trace = deg::global_trace();
+  if (!trace.recorder) {
+    BKE_blender_atexit_register(deg::global_trace_write_at_exit, nullptr);
+  }
+  trace.recorder = std::make_unique<deg::TraceRecorder>();
+  trace.filepath = filepath;
+}
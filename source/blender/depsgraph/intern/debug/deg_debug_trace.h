@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#pragma once
+
+#include <mutex>
+
+#include "BLI_map.hh"
+#include "BLI_set.hh"
+#include "BLI_vector.hh"
+
+#include "intern/depsgraph_type.h"
+
+namespace blender::deg {
+
+/* Recorder of the timeline of dependency graph evaluations, which is written in the trace event
+ * format understood by `chrome://tracing` and https://ui.perfetto.dev.
+ *
+ * Every dependency graph which is evaluated while recording becomes a process of the trace, and
+ * every thread which evaluated its operations a thread of that process. Events can be added from
+ * multiple threads at the same time. */
+class TraceRecorder {
+ public:
+  TraceRecorder();
+
+  /* Get identifier of the trace process for the given dependency graph, adding it to the trace
+   * when it is recorded for the first time. */
+  int process_for_graph(const void *graph, StringRef name);
+
+  /* Add an event which lasted from start to end time, in seconds as returned by
+   * #PIL_check_seconds_timer(). The event is assigned to the calling thread. */
+  void add_event(int process, string name, const char *category, double start, double end);
+
+  /* Write all recorded events to a JSON file. Returns false when the file could not be
+   * written. */
+  bool write(const char *filepath) const;
+
+ protected:
+  struct Event {
+    string name;
+    const char *category;
+    double start;
+    double end;
+    int process;
+    int thread;
+  };
+
+  /* Point in time the recording was started at. Timestamps in the file are relative to it. */
+  double start_time_;
+
+  mutable std::mutex mutex_;
+  Map<const void *, int> process_by_graph_;
+  Vector<string> process_names_;
+  /* Pairs of process and thread, used to name threads in the file. */
+  Set<std::pair<int, int>> threads_;
+  Vector<Event> events_;
+};
+
+/* Recorder which traces evaluation of all dependency graphs, used by the
+ * `--debug-depsgraph-trace` command line argument. Null when not recording. */
+TraceRecorder *trace_recorder_global();
+
+}  // namespace blender::deg
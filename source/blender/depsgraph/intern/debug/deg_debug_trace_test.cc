@@ -0,0 +1,246 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "testing/testing.h"
+
+#include <thread>
+
+#include "CLG_log.h"
+
+#include "PIL_time.h"
+
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BLI_fileops.hh"
+#include "BLI_path_util.h"
+#include "BLI_serialize.hh"
+#include "BLI_tempfile.h"
+#include "BLI_threads.h"
+
+#include "BKE_collection.h"
+#include "BKE_global.h"
+#include "BKE_idtype.h"
+#include "BKE_layer.h"
+#include "BKE_main.h"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "RNA_define.h"
+
+#include "DEG_depsgraph.h"
+#include "DEG_depsgraph_build.h"
+#include "DEG_depsgraph_debug.h"
+
+#include "intern/debug/deg_debug_trace.h"
+
+namespace blender::deg::tests {
+
+using namespace io::serialize;
+
+static std::string trace_test_filepath(const char *filename)
+{
+  char temp_dir[FILE_MAX];
+  BLI_temp_directory_path_get(temp_dir, sizeof(temp_dir));
+  char filepath[FILE_MAX];
+  BLI_path_join(filepath, sizeof(filepath), temp_dir, filename);
+  return filepath;
+}
+
+static std::unique_ptr<Value> read_trace(const std::string &filepath)
+{
+  fstream stream(filepath, std::ios::in);
+  EXPECT_TRUE(stream.is_open()) << "could not open " << filepath;
+  JsonFormatter formatter;
+  return formatter.deserialize(stream);
+}
+
+/* Events of the given phase, `X` for timed events and `M` for process and thread names. */
+static Vector<const DictionaryValue *> trace_events(const Value &trace, const StringRef phase)
+{
+  Vector<const DictionaryValue *> result;
+  const DictionaryValue *root = trace.as_dictionary_value();
+  EXPECT_NE(root, nullptr);
+  if (root == nullptr) {
+    return result;
+  }
+  const ArrayValue *events = root->lookup_array("traceEvents");
+  EXPECT_NE(events, nullptr);
+  if (events == nullptr) {
+    return result;
+  }
+  for (const std::shared_ptr<Value> &event : events->elements()) {
+    const DictionaryValue *event_dict = event->as_dictionary_value();
+    if (event_dict != nullptr && event_dict->lookup_str("ph") == phase) {
+      result.append(event_dict);
+    }
+  }
+  return result;
+}
+
+TEST(depsgraph_trace, WriteEvents)
+{
+  const int graph_a = 0;
+  const int graph_b = 0;
+
+  TraceRecorder recorder;
+  const int process_a = recorder.process_for_graph(&graph_a, "Viewport");
+  const int process_b = recorder.process_for_graph(&graph_b, "");
+  EXPECT_EQ(process_a, 0);
+  EXPECT_EQ(process_b, 1);
+  /* Graphs keep the process they were added with. */
+  EXPECT_EQ(recorder.process_for_graph(&graph_a, "Render"), process_a);
+
+  const double start_time = PIL_check_seconds_timer();
+  recorder.add_event(process_a,
+                     "OBCube/TRANSFORM/TRANSFORM_EVAL",
+                     "TRANSFORM",
+                     start_time,
+                     start_time + 0.002);
+  std::thread thread([&]() {
+    recorder.add_event(process_b, "Evaluation", "GRAPH", start_time, start_time + 0.001);
+  });
+  thread.join();
+
+  const std::string filepath = trace_test_filepath("depsgraph_trace_write_events.json");
+  ASSERT_TRUE(recorder.write(filepath.c_str()));
+  std::unique_ptr<Value> trace = read_trace(filepath);
+  BLI_delete(filepath.c_str(), false, false);
+  ASSERT_NE(trace, nullptr);
+
+  Map<int64_t, std::string> process_names;
+  Set<std::pair<int64_t, int64_t>> named_threads;
+  for (const DictionaryValue *metadata : trace_events(*trace, "M")) {
+    const std::optional<StringRefNull> name = metadata->lookup_str("name");
+    const DictionaryValue *args = metadata->lookup_dict("args");
+    ASSERT_TRUE(name.has_value());
+    ASSERT_NE(args, nullptr);
+    if (*name == "process_name") {
+      process_names.add(*metadata->lookup_int("pid"), *args->lookup_str("name"));
+    }
+    else if (*name == "thread_name") {
+      named_threads.add({*metadata->lookup_int("pid"), *metadata->lookup_int("tid")});
+    }
+  }
+  EXPECT_EQ(process_names.size(), 2);
+  EXPECT_EQ(process_names.lookup_default(process_a, ""), "Viewport");
+  EXPECT_EQ(process_names.lookup_default(process_b, ""), "Depsgraph");
+
+  const Vector<const DictionaryValue *> events = trace_events(*trace, "X");
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_EQ(events[0]->lookup_str("name"), "OBCube/TRANSFORM/TRANSFORM_EVAL");
+  EXPECT_EQ(events[0]->lookup_str("cat"), "TRANSFORM");
+  EXPECT_EQ(events[0]->lookup_int("pid"), process_a);
+  EXPECT_GE(*events[0]->lookup_double("ts"), 0.0);
+  EXPECT_NEAR(*events[0]->lookup_double("dur"), 2000.0, 1.0);
+  EXPECT_EQ(events[1]->lookup_str("name"), "Evaluation");
+  EXPECT_EQ(events[1]->lookup_int("pid"), process_b);
+  EXPECT_NEAR(*events[1]->lookup_double("dur"), 1000.0, 1.0);
+
+  /* Events added from different threads are on different threads of the trace, and every thread
+   * with events is named. */
+  EXPECT_NE(events[0]->lookup_int("tid"), events[1]->lookup_int("tid"));
+  EXPECT_EQ(named_threads.size(), 2);
+  for (const DictionaryValue *event : events) {
+    EXPECT_TRUE(named_threads.contains({*event->lookup_int("pid"), *event->lookup_int("tid")}));
+  }
+}
+
+TEST(depsgraph_trace, WriteFailure)
+{
+  TraceRecorder recorder;
+  const std::string filepath = trace_test_filepath(
+      "depsgraph_trace_missing_directory" SEP_STR "trace.json");
+  EXPECT_FALSE(recorder.write(filepath.c_str()));
+}
+
+class DepsgraphTraceTest : public testing::Test {
+ protected:
+  Main *bmain = nullptr;
+  Scene *scene = nullptr;
+  ::Depsgraph *depsgraph = nullptr;
+
+  static void SetUpTestSuite()
+  {
+    CLG_init();
+    BLI_threadapi_init();
+    BKE_idtype_init();
+    RNA_init();
+    DEG_register_node_types();
+  }
+
+  static void TearDownTestSuite()
+  {
+    DEG_free_node_types();
+    RNA_exit();
+    BLI_threadapi_exit();
+    CLG_exit();
+  }
+
+  void SetUp() override
+  {
+    bmain = BKE_main_new();
+    G.main = bmain;
+    scene = BKE_scene_add(bmain, "Scene");
+    Object *object = BKE_object_add_only_object(bmain, OB_EMPTY, "Empty");
+    BKE_collection_object_add(bmain, scene->master_collection, object);
+    BKE_main_collection_sync(bmain);
+
+    ViewLayer *view_layer = BKE_view_layer_default_view(scene);
+    depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+    DEG_graph_build_from_view_layer(depsgraph);
+  }
+
+  void TearDown() override
+  {
+    DEG_graph_free(depsgraph);
+    BKE_main_free(bmain);
+    G.main = nullptr;
+  }
+};
+
+TEST_F(DepsgraphTraceTest, EvaluationIsTraced)
+{
+  const std::string filepath = trace_test_filepath("depsgraph_trace_evaluation.json");
+
+  /* Nothing to write when the graph is not traced. */
+  EXPECT_FALSE(DEG_debug_trace_end(depsgraph, filepath.c_str()));
+
+  DEG_debug_trace_begin(depsgraph);
+  DEG_evaluate_on_refresh(depsgraph);
+  ASSERT_TRUE(DEG_debug_trace_end(depsgraph, filepath.c_str()));
+  std::unique_ptr<Value> trace = read_trace(filepath);
+  BLI_delete(filepath.c_str(), false, false);
+  ASSERT_NE(trace, nullptr);
+
+  int graph_events_num = 0;
+  int stage_events_num = 0;
+  int object_events_num = 0;
+  for (const DictionaryValue *event : trace_events(*trace, "X")) {
+    const StringRefNull name = *event->lookup_str("name");
+    const StringRefNull category = *event->lookup_str("cat");
+    EXPECT_GE(*event->lookup_double("dur"), 0.0);
+    if (category == "GRAPH") {
+      EXPECT_EQ(name, "Evaluation");
+      graph_events_num++;
+    }
+    else if (category == "STAGE") {
+      stage_events_num++;
+    }
+    else if (name.startswith("OBEmpty/")) {
+      object_events_num++;
+    }
+  }
+  EXPECT_EQ(graph_events_num, 1);
+  EXPECT_GT(stage_events_num, 0);
+  EXPECT_GT(object_events_num, 0);
+
+  /* The recording stops with writing the file. */
+  EXPECT_FALSE(DEG_debug_trace_end(depsgraph, filepath.c_str()));
+}
+
+}  // namespace blender::deg::tests
@@ -47,6 +47,7 @@ Depsgraph::Depsgraph(Main *bmain, Scene *scene, ViewLayer *view_layer, eEvaluati
     : time_source(nullptr),
       has_animated_visibility(false),
       need_update_relations(true),
+      need_update_relations_full(true),
       need_update_nodes_visibility(true),
       need_tag_id_on_graph_visibility_update(true),
       need_tag_id_on_graph_visibility_time_update(false),
@@ -171,6 +172,51 @@ void Depsgraph::clear_id_nodes()
   light_linking_cache.clear();
 }
 
+void Depsgraph::remove_id_nodes(const Set<IDNode *> &id_nodes_to_remove)
+{
+  if (id_nodes_to_remove.is_empty()) {
+    return;
+  }
+
+  Set<const Node *> removed_operations;
+  for (IDNode *id_node : id_nodes_to_remove) {
+    for (ComponentNode *comp_node : id_node->components.values()) {
+      BLI_assert(comp_node->operations_map == nullptr);
+      for (OperationNode *op_node : comp_node->operations) {
+        removed_operations.add(op_node);
+      }
+    }
+  }
+
+  /* Relations are only owned by the node they lead to (see `Node::~Node()`), and are not
+   * unregistered from the other side on destruction. Unlink the relations which connect removed
+   * and kept nodes, and free those which are not owned by a removed operation. */
+  for (const Node *node : removed_operations) {
+    for (Relation *rel : node->inlinks) {
+      if (!removed_operations.contains(rel->from)) {
+        rel->from->outlinks.remove_first_occurrence_and_reorder(rel);
+      }
+    }
+    for (Relation *rel : node->outlinks) {
+      if (!removed_operations.contains(rel->to)) {
+        rel->to->inlinks.remove_first_occurrence_and_reorder(rel);
+        delete rel;
+      }
+    }
+  }
+
+  entry_tags.remove_if(
+      [&](OperationNode *op_node) { return removed_operations.contains(op_node); });
+  operations.remove_if(
+      [&](OperationNode *op_node) { return removed_operations.contains(op_node); });
+  id_nodes.remove_if([&](IDNode *id_node) { return id_nodes_to_remove.contains(id_node); });
+
+  for (IDNode *id_node : id_nodes_to_remove) {
+    id_hash.remove(id_node->id_orig);
+    delete id_node;
+  }
+}
+
 Relation *Depsgraph::add_new_relation(Node *from, Node *to, const char *description, int flags)
 {
   Relation *rel = nullptr;
@@ -201,6 +247,21 @@ Relation *Depsgraph::check_nodes_connected(const Node *from,
                                            const Node *to,
                                            const char *description)
 {
+  /* Scan the shorter list of links: nodes like the view layer evaluation have an outgoing
+   * relation to every object in the scene. */
+  if (to->inlinks.size() < from->outlinks.size()) {
+    for (Relation *rel : to->inlinks) {
+      BLI_assert(rel->to == to);
+      if (rel->from != from) {
+        continue;
+      }
+      if (description != nullptr && !STREQ(rel->name, description)) {
+        continue;
+      }
+      return rel;
+    }
+    return nullptr;
+  }
   for (Relation *rel : from->outlinks) {
     BLI_assert(rel->from == from);
     if (rel->to != to) {
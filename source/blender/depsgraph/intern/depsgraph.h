@@ -55,6 +55,9 @@ struct Depsgraph {
   IDNode *find_id_node(const ID *id) const;
   IDNode *add_id_node(ID *id, ID *id_cow_hint = nullptr);
   void clear_id_nodes();
+  /* Remove given ID nodes together with all relations to and from their operations.
+   * Used by the incremental relations update, the nodes are expected to be finalized. */
+  void remove_id_nodes(const Set<IDNode *> &id_nodes_to_remove);
 
   /** Add new relationship between two nodes. */
   Relation *add_new_relation(Node *from, Node *to, const char *description, int flags = 0);
@@ -95,6 +98,13 @@ struct Depsgraph {
   /* Indicates whether relations needs to be updated. */
   bool need_update_relations;
 
+  /* Indicates whether relations update needs to rebuild the whole graph. When it is false only
+   * the IDs from `relations_update_ids` and their direct neighbors are rebuilt. */
+  bool need_update_relations_full;
+
+  /* IDs tagged with DEG_graph_id_tag_relations_update() since the last relations update. */
+  Set<ID *> relations_update_ids;
+
   /* Indicates whether indirect effect of nodes on a directly visible ones needs to be updated. */
   bool need_update_nodes_visibility;
 
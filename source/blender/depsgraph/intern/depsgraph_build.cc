@@ -34,6 +34,7 @@
 #include "builder/pipeline_all_objects.h"
 #include "builder/pipeline_compositor.h"
 #include "builder/pipeline_from_ids.h"
+#include "builder/pipeline_incremental.h"
 #include "builder/pipeline_render.h"
 #include "builder/pipeline_view_layer.h"
 
@@ -276,6 +277,8 @@ void DEG_graph_tag_relations_update(Depsgraph *graph)
   DEG_DEBUG_PRINTF(graph, TAG, "%s: Tagging relations for update.\n", __func__);
   deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(graph);
   deg_graph->need_update_relations = true;
+  deg_graph->need_update_relations_full = true;
+  deg_graph->relations_update_ids.clear();
   /* NOTE: When relations are updated, it's quite possible that
    * we've got new bases in the scene. This means, we need to
    * re-create flat array of bases in view layer.
@@ -288,6 +291,21 @@ void DEG_graph_tag_relations_update(Depsgraph *graph)
   }
 }
 
+void DEG_graph_id_tag_relations_update(Depsgraph *graph, ID *id)
+{
+  DEG_DEBUG_PRINTF(graph, TAG, "%s: Tagging relations of %s for update.\n", __func__, id->name);
+  deg::Depsgraph *deg_graph = reinterpret_cast<deg::Depsgraph *>(graph);
+  deg_graph->need_update_relations = true;
+  if (!deg_graph->need_update_relations_full) {
+    deg_graph->relations_update_ids.add(id);
+  }
+  /* Same as above, bases might have changed. */
+  deg::IDNode *id_node = deg_graph->find_id_node(&deg_graph->scene->id);
+  if (id_node != nullptr) {
+    id_node->tag_update(deg_graph, deg::DEG_UPDATE_SOURCE_RELATIONS);
+  }
+}
+
 void DEG_graph_relations_update(Depsgraph *graph)
 {
   deg::Depsgraph *deg_graph = (deg::Depsgraph *)graph;
@@ -295,6 +313,12 @@ void DEG_graph_relations_update(Depsgraph *graph)
     /* Graph is up to date, nothing to do. */
     return;
   }
+  if (!deg_graph->need_update_relations_full) {
+    deg::IncrementalBuilderPipeline builder(graph);
+    if (builder.build_incremental()) {
+      return;
+    }
+  }
   DEG_graph_build_from_view_layer(graph);
 }
 
@@ -305,3 +329,22 @@ void DEG_relations_tag_update(Main *bmain)
     DEG_graph_tag_relations_update(reinterpret_cast<Depsgraph *>(depsgraph));
   }
 }
+
+void DEG_id_tag_relations_update(Main *bmain, ID *id)
+{
+  DEG_GLOBAL_DEBUG_PRINTF(TAG, "%s: Tagging relations of %s for update.\n", __func__, id->name);
+  for (deg::Depsgraph *depsgraph : deg::get_all_registered_graphs(bmain)) {
+    DEG_graph_id_tag_relations_update(reinterpret_cast<Depsgraph *>(depsgraph), id);
+  }
+}
+
+void DEG_collection_tag_relations_update(Main *bmain, Collection *collection)
+{
+  DEG_id_tag_relations_update(bmain, &collection->id);
+  LISTBASE_FOREACH (CollectionChild *, child, &collection->children) {
+    DEG_collection_tag_relations_update(bmain, child->collection);
+  }
+  LISTBASE_FOREACH (CollectionObject *, cob, &collection->gobject) {
+    DEG_id_tag_relations_update(bmain, &cob->ob->id);
+  }
+}
@@ -223,6 +223,15 @@ void DEG_stats_simple(const Depsgraph *graph,
   }
 }
 
+void DEG_stats_copy_on_write(const Depsgraph *graph,
+                             int64_t *r_bytes_copied,
+                             int64_t *r_bytes_shared)
+{
+  const deg::Depsgraph *deg_graph = reinterpret_cast<const deg::Depsgraph *>(graph);
+  *r_bytes_copied = deg_graph->debug.cow_bytes_copied;
+  *r_bytes_shared = deg_graph->debug.cow_bytes_shared;
+}
+
 static deg::string depsgraph_name_for_logging(struct Depsgraph *depsgraph)
 {
   const char *name = DEG_debug_name_get(depsgraph);
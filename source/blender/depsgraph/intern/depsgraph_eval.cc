@@ -10,20 +10,33 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_listbase.h"
+#include "BLI_task.hh"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
+#include "BLI_vector.hh"
 
+#include "BKE_node.h"
+#include "BKE_pointcache.h"
 #include "BKE_scene.h"
 
+#include "DNA_modifier_types.h"
+#include "DNA_node_types.h"
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
 
 #include "DEG_depsgraph.h"
+#include "DEG_depsgraph_build.h"
 #include "DEG_depsgraph_query.h"
 
+#ifdef WITH_PYTHON
+#  include "BPY_extern.h"
+#endif
+
 #include "intern/eval/deg_eval.h"
 #include "intern/eval/deg_eval_flush.h"
 
 #include "intern/node/deg_node.h"
+#include "intern/node/deg_node_id.h"
 #include "intern/node/deg_node_operation.h"
 #include "intern/node/deg_node_time.h"
 
@@ -78,3 +91,157 @@ void DEG_evaluate_on_framechange(Depsgraph *graph, float frame)
   deg_graph->ctime = BKE_scene_frame_to_ctime(scene, frame);
   deg_flush_updates_and_refresh(deg_graph);
 }
+
+/* -------------------------------------------------------------------- */
+/** \name Frame Parallel Evaluation
+ * \{ */
+
+struct DEGFrameParallelEvaluator {
+  blender::Vector<Depsgraph *> graphs;
+};
+
+static bool node_tree_has_simulation(const bNodeTree &ntree)
+{
+  LISTBASE_FOREACH (const bNode *, node, &ntree.nodes) {
+    if (node->type == GEO_NODE_SIMULATION_OUTPUT) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Physics keep state from the previous frame, like the positions stored by collision modifiers,
+ * or read caches which are only filled when frames are evaluated in order. */
+static bool object_has_physics(Scene *scene, Object *object)
+{
+  if (object->soft != nullptr || BKE_ptcache_object_has(scene, object, 0)) {
+    return true;
+  }
+  LISTBASE_FOREACH (const ModifierData *, md, &object->modifiers) {
+    if (ELEM(md->type,
+             eModifierType_Cloth,
+             eModifierType_Collision,
+             eModifierType_DynamicPaint,
+             eModifierType_Fluid,
+             eModifierType_ParticleSystem,
+             eModifierType_Softbody,
+             eModifierType_Surface))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Check whether the evaluated state of a frame may depend on the state of previous frames. */
+static bool graph_has_frame_dependencies(const deg::Depsgraph &deg_graph)
+{
+  Scene *scene = deg_graph.scene;
+  if (scene->rigidbody_world != nullptr) {
+    return true;
+  }
+  for (const deg::IDNode *id_node : deg_graph.id_nodes) {
+    switch (id_node->id_type) {
+      case ID_OB:
+        if (object_has_physics(scene, reinterpret_cast<Object *>(id_node->id_orig))) {
+          return true;
+        }
+        break;
+      case ID_NT:
+        /* Node groups used by modifiers are part of the graph as well. */
+        if (node_tree_has_simulation(*reinterpret_cast<const bNodeTree *>(id_node->id_orig))) {
+          return true;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
+DEGFrameParallelEvaluator *DEG_frame_parallel_evaluator_new(Main *bmain,
+                                                            Scene *scene,
+                                                            ViewLayer *view_layer,
+                                                            eEvaluationMode mode,
+                                                            const int max_graphs_num)
+{
+  DEGFrameParallelEvaluator *evaluator = MEM_new<DEGFrameParallelEvaluator>(__func__);
+
+  Depsgraph *first_graph = DEG_graph_new(bmain, scene, view_layer, mode);
+  DEG_graph_build_from_view_layer(first_graph);
+  evaluator->graphs.append(first_graph);
+
+  if (graph_has_frame_dependencies(*reinterpret_cast<const deg::Depsgraph *>(first_graph))) {
+    return evaluator;
+  }
+
+  /* Building is not thread-safe, because it accesses the original data-blocks. */
+  const int graphs_num = std::min(max_graphs_num, BLI_system_thread_count());
+  while (evaluator->graphs.size() < graphs_num) {
+    Depsgraph *graph = DEG_graph_new(bmain, scene, view_layer, mode);
+    DEG_graph_build_from_view_layer(graph);
+    evaluator->graphs.append(graph);
+  }
+  return evaluator;
+}
+
+void DEG_frame_parallel_evaluator_free(DEGFrameParallelEvaluator *evaluator)
+{
+  for (Depsgraph *graph : evaluator->graphs) {
+    DEG_graph_free(graph);
+  }
+  MEM_delete(evaluator);
+}
+
+int DEG_frame_parallel_evaluator_graphs_num(const DEGFrameParallelEvaluator *evaluator)
+{
+  return int(evaluator->graphs.size());
+}
+
+void DEG_frame_parallel_evaluate(DEGFrameParallelEvaluator *evaluator,
+                                 const float frame_start,
+                                 const float frame_end,
+                                 const float frame_step,
+                                 DEG_FrameEvaluatedCb callback,
+                                 void *user_data)
+{
+  using namespace blender;
+  BLI_assert(frame_step > 0.0f);
+  /* Use a small epsilon to include the end frame with fractional steps. */
+  const int frames_num = int(floorf((frame_end - frame_start) / frame_step + 1e-4f)) + 1;
+  const Span<Depsgraph *> graphs = evaluator->graphs;
+
+  for (int batch_start = 0; batch_start < frames_num; batch_start += int(graphs.size())) {
+    const int batch_size = std::min(int(graphs.size()), frames_num - batch_start);
+    auto frame_at = [&](const int i) { return frame_start + float(batch_start + i) * frame_step; };
+
+    if (batch_size == 1) {
+      DEG_evaluate_on_framechange(graphs[0], frame_at(0));
+    }
+    else {
+#ifdef WITH_PYTHON
+      /* Other threads may need the GIL to evaluate drivers while this thread waits. */
+      BPy_BEGIN_ALLOW_THREADS;
+#endif
+      threading::parallel_for(IndexRange(batch_size), 1, [&](const IndexRange range) {
+        for (const int i : range) {
+          /* Evaluation waits for its own tasks, which must not pick up the evaluation of another
+           * frame while waiting. */
+          threading::isolate_task([&]() { DEG_evaluate_on_framechange(graphs[i], frame_at(i)); });
+        }
+      });
+#ifdef WITH_PYTHON
+      BPy_END_ALLOW_THREADS;
+#endif
+    }
+
+    for (const int i : IndexRange(batch_size)) {
+      if (!callback(graphs[i], frame_at(i), user_data)) {
+        return;
+      }
+    }
+  }
+}
+
+/** \} */
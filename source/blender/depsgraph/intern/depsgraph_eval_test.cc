@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "testing/testing.h"
+
+#include "CLG_log.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_anim_types.h"
+#include "DNA_curve_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BLI_listbase.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+#include "BLI_vector.hh"
+
+#include "BKE_action.h"
+#include "BKE_anim_data.h"
+#include "BKE_collection.h"
+#include "BKE_fcurve.h"
+#include "BKE_global.h"
+#include "BKE_idtype.h"
+#include "BKE_layer.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_modifier.h"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "RNA_define.h"
+
+#include "DEG_depsgraph.h"
+#include "DEG_depsgraph_build.h"
+#include "DEG_depsgraph_query.h"
+
+namespace blender::deg::tests {
+
+struct EvaluatedFrame {
+  float frame;
+  float location_x;
+};
+
+struct RecordFramesData {
+  Object *object;
+  Vector<EvaluatedFrame> frames;
+  /* Stop the evaluation after this number of frames, when positive. */
+  int max_frames_num = 0;
+};
+
+static bool record_frame(Depsgraph *depsgraph, const float frame, void *user_data)
+{
+  RecordFramesData *data = static_cast<RecordFramesData *>(user_data);
+  const Object *object_eval = DEG_get_evaluated_object(depsgraph, data->object);
+  data->frames.append({frame, object_eval->object_to_world[3][0]});
+  return data->max_frames_num <= 0 || data->frames.size() < data->max_frames_num;
+}
+
+class DepsgraphFrameParallelTest : public testing::Test {
+ protected:
+  Main *bmain = nullptr;
+  Scene *scene = nullptr;
+  ViewLayer *view_layer = nullptr;
+  Object *object = nullptr;
+
+  static void SetUpTestSuite()
+  {
+    CLG_init();
+    BLI_threadapi_init();
+    BKE_idtype_init();
+    BKE_modifier_init();
+    RNA_init();
+    DEG_register_node_types();
+    /* Evaluate frames in parallel on machines with few cores as well. */
+    BLI_system_num_threads_override_set(4);
+  }
+
+  static void TearDownTestSuite()
+  {
+    BLI_system_num_threads_override_set(0);
+    DEG_free_node_types();
+    RNA_exit();
+    BLI_threadapi_exit();
+    CLG_exit();
+  }
+
+  void SetUp() override
+  {
+    bmain = BKE_main_new();
+    G.main = bmain;
+    scene = BKE_scene_add(bmain, "Scene");
+    view_layer = BKE_view_layer_default_view(scene);
+
+    /* The X location of the object goes from 0 to 19 over frames 1 to 20. */
+    object = BKE_object_add_only_object(bmain, OB_EMPTY, "Animated");
+    BKE_collection_object_add(bmain, scene->master_collection, object);
+    FCurve *fcu = BKE_fcurve_create();
+    fcu->rna_path = BLI_strdup("location");
+    fcu->array_index = 0;
+    fcu->totvert = 2;
+    fcu->bezt = static_cast<BezTriple *>(MEM_callocN(sizeof(BezTriple) * 2, __func__));
+    for (const int i : IndexRange(2)) {
+      BezTriple &bezt = fcu->bezt[i];
+      bezt.vec[1][0] = i == 0 ? 1.0f : 20.0f;
+      bezt.vec[1][1] = i == 0 ? 0.0f : 19.0f;
+      bezt.ipo = BEZT_IPO_LIN;
+      bezt.h1 = bezt.h2 = HD_AUTO_ANIM;
+    }
+    BKE_fcurve_handles_recalc(fcu);
+    bAction *action = BKE_action_add(bmain, "Action");
+    BLI_addtail(&action->curves, fcu);
+    AnimData *adt = BKE_animdata_ensure_id(&object->id);
+    adt->action = action;
+    id_us_plus(&action->id);
+    BKE_main_collection_sync(bmain);
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+    G.main = nullptr;
+  }
+
+  Vector<EvaluatedFrame> evaluate_serial(const float frame_start,
+                                         const float frame_end,
+                                         const float frame_step)
+  {
+    Depsgraph *depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+    DEG_graph_build_from_view_layer(depsgraph);
+    RecordFramesData data = {object};
+    for (float frame = frame_start; frame <= frame_end; frame += frame_step) {
+      DEG_evaluate_on_framechange(depsgraph, frame);
+      record_frame(depsgraph, frame, &data);
+    }
+    DEG_graph_free(depsgraph);
+    return data.frames;
+  }
+};
+
+TEST_F(DepsgraphFrameParallelTest, MatchesSerialEvaluation)
+{
+  DEGFrameParallelEvaluator *evaluator = DEG_frame_parallel_evaluator_new(
+      bmain, scene, view_layer, DAG_EVAL_VIEWPORT, 4);
+  EXPECT_EQ(DEG_frame_parallel_evaluator_graphs_num(evaluator), 4);
+
+  /* More frames than graphs, and a last batch which does not use all graphs. */
+  RecordFramesData data = {object};
+  DEG_frame_parallel_evaluate(evaluator, 1.0f, 11.5f, 0.5f, record_frame, &data);
+  DEG_frame_parallel_evaluator_free(evaluator);
+
+  const Vector<EvaluatedFrame> serial_frames = evaluate_serial(1.0f, 11.5f, 0.5f);
+  ASSERT_EQ(data.frames.size(), 22);
+  ASSERT_EQ(data.frames.size(), serial_frames.size());
+  for (const int i : data.frames.index_range()) {
+    EXPECT_EQ(data.frames[i].frame, serial_frames[i].frame);
+    EXPECT_EQ(data.frames[i].location_x, serial_frames[i].location_x);
+    EXPECT_FLOAT_EQ(data.frames[i].location_x, data.frames[i].frame - 1.0f);
+  }
+}
+
+TEST_F(DepsgraphFrameParallelTest, CallbackStopsEvaluation)
+{
+  DEGFrameParallelEvaluator *evaluator = DEG_frame_parallel_evaluator_new(
+      bmain, scene, view_layer, DAG_EVAL_VIEWPORT, 4);
+  RecordFramesData data = {object};
+  data.max_frames_num = 6;
+  DEG_frame_parallel_evaluate(evaluator, 1.0f, 20.0f, 1.0f, record_frame, &data);
+  DEG_frame_parallel_evaluator_free(evaluator);
+
+  ASSERT_EQ(data.frames.size(), 6);
+  EXPECT_EQ(data.frames.last().frame, 6.0f);
+}
+
+TEST_F(DepsgraphFrameParallelTest, PhysicsEvaluatedInOrder)
+{
+  Mesh *mesh = BKE_mesh_add(bmain, "Mesh");
+  Object *collider = BKE_object_add_only_object(bmain, OB_MESH, "Collider");
+  collider->data = mesh;
+  BLI_addtail(&collider->modifiers, BKE_modifier_new(eModifierType_Collision));
+  BKE_collection_object_add(bmain, scene->master_collection, collider);
+  BKE_main_collection_sync(bmain);
+
+  DEGFrameParallelEvaluator *evaluator = DEG_frame_parallel_evaluator_new(
+      bmain, scene, view_layer, DAG_EVAL_VIEWPORT, 4);
+  EXPECT_EQ(DEG_frame_parallel_evaluator_graphs_num(evaluator), 1);
+  DEG_frame_parallel_evaluator_free(evaluator);
+}
+
+}  // namespace blender::deg::tests
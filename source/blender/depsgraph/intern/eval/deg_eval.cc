@@ -9,6 +9,9 @@
 
 #include "intern/eval/deg_eval.h"
 
+#include <algorithm>
+#include <mutex>
+
 #include "PIL_time.h"
 
 #include "BLI_compiler_attrs.h"
@@ -16,6 +19,7 @@
 #include "BLI_gsqueue.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
+#include "BLI_vector.hh"
 
 #include "BKE_global.h"
 
@@ -32,6 +36,7 @@
 
 #include "atomic_ops.h"
 
+#include "intern/debug/deg_debug_trace.h"
 #include "intern/depsgraph.h"
 #include "intern/depsgraph_relation.h"
 #include "intern/depsgraph_tag.h"
@@ -52,6 +57,7 @@ namespace {
 struct DepsgraphEvalState;
 
 void deg_task_run_func(TaskPool *pool, void *taskdata);
+void deg_task_push(TaskPool *pool, DepsgraphEvalState *state, OperationNode *node);
 
 void schedule_children(DepsgraphEvalState *state,
                        OperationNode *node,
@@ -77,12 +83,65 @@ enum class EvaluationStage {
   SINGLE_THREADED_WORKAROUND,
 };
 
+const char *evaluation_stage_as_string(const EvaluationStage stage)
+{
+  switch (stage) {
+    case EvaluationStage::COPY_ON_WRITE:
+      return "Copy-on-Write";
+    case EvaluationStage::DYNAMIC_VISIBILITY:
+      return "Dynamic Visibility";
+    case EvaluationStage::THREADED_EVALUATION:
+      return "Threaded Evaluation";
+    case EvaluationStage::SINGLE_THREADED_WORKAROUND:
+      return "Single Threaded Workaround";
+  }
+  return "Unknown";
+}
+
+/* Operations which are ready to be evaluated, ordered by their critical path cost.
+ *
+ * Tasks in the task pool are executed in an order which is not controlled by the depsgraph. With
+ * the critical path scheduling every task picks the most important ready operation from this
+ * queue instead of evaluating a fixed operation. This way long chains of dependent operations,
+ * for example in character rigs, are started as early as possible. */
+class ReadyOperationQueue {
+ public:
+  void push(OperationNode *node)
+  {
+    std::lock_guard lock(mutex_);
+    heap_.append(node);
+    std::push_heap(heap_.begin(), heap_.end(), compare);
+  }
+
+  OperationNode *pop()
+  {
+    std::lock_guard lock(mutex_);
+    BLI_assert(!heap_.is_empty());
+    std::pop_heap(heap_.begin(), heap_.end(), compare);
+    return heap_.pop_last();
+  }
+
+ private:
+  static bool compare(const OperationNode *a, const OperationNode *b)
+  {
+    return a->critical_path_cost < b->critical_path_cost;
+  }
+
+  std::mutex mutex_;
+  Vector<OperationNode *> heap_;
+};
+
 struct DepsgraphEvalState {
   Depsgraph *graph;
   bool do_stats;
+  bool use_critical_path_scheduling;
+  /* Recorder of the evaluation timeline, null when the evaluation is not traced. */
+  TraceRecorder *trace = nullptr;
+  int trace_process = 0;
   EvaluationStage stage;
   bool need_update_pending_parents = true;
   bool need_single_thread_pass = false;
+  ReadyOperationQueue ready_queue;
 };
 
 void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_node)
@@ -92,10 +151,24 @@ void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_nod
   /* Sanity checks. */
   BLI_assert_msg(!operation_node->is_noop(), "NOOP nodes should not actually be scheduled");
   /* Perform operation. */
-  if (state->do_stats) {
+  if (state->do_stats || state->use_critical_path_scheduling || state->trace) {
     const double start_time = PIL_check_seconds_timer();
     operation_node->evaluate(depsgraph);
-    operation_node->stats.current_time += PIL_check_seconds_timer() - start_time;
+    const double end_time = PIL_check_seconds_timer();
+    const double time = end_time - start_time;
+    if (state->trace) {
+      state->trace->add_event(state->trace_process,
+                              operation_node->full_identifier(),
+                              nodeTypeAsString(operation_node->owner->type),
+                              start_time,
+                              end_time);
+    }
+    if (state->do_stats) {
+      operation_node->stats.current_time += time;
+    }
+    if (state->use_critical_path_scheduling) {
+      deg_eval_stats_update_cost_estimate(operation_node, time);
+    }
   }
   else {
     operation_node->evaluate(depsgraph);
@@ -108,19 +181,32 @@ void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_nod
   operation_node->flag &= ~DEPSOP_FLAG_CLEAR_ON_EVAL;
 }
 
+void deg_task_push(TaskPool *pool, DepsgraphEvalState *state, OperationNode *node)
+{
+  if (state->use_critical_path_scheduling) {
+    /* The task evaluates whichever operation is the most important one once it runs. */
+    state->ready_queue.push(node);
+    BLI_task_pool_push(pool, deg_task_run_func, nullptr, false, nullptr);
+  }
+  else {
+    BLI_task_pool_push(pool, deg_task_run_func, node, false, nullptr);
+  }
+}
+
 void deg_task_run_func(TaskPool *pool, void *taskdata)
 {
   void *userdata_v = BLI_task_pool_user_data(pool);
   DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
 
   /* Evaluate node. */
-  OperationNode *operation_node = reinterpret_cast<OperationNode *>(taskdata);
+  OperationNode *operation_node = state->use_critical_path_scheduling ?
+                                      state->ready_queue.pop() :
+                                      reinterpret_cast<OperationNode *>(taskdata);
   evaluate_node(state, operation_node);
 
   /* Schedule children. */
-  schedule_children(state, operation_node, [&](OperationNode *node) {
-    BLI_task_pool_push(pool, deg_task_run_func, node, false, nullptr);
-  });
+  schedule_children(
+      state, operation_node, [&](OperationNode *node) { deg_task_push(pool, state, node); });
 }
 
 bool check_operation_node_visible(const DepsgraphEvalState *state, OperationNode *op_node)
@@ -194,6 +280,9 @@ void initialize_execution(DepsgraphEvalState *state, Depsgraph *graph)
       node->stats.reset_current();
     }
   }
+  if (state->use_critical_path_scheduling) {
+    deg_eval_stats_update_critical_path(graph);
+  }
 }
 
 bool is_metaball_object_operation(const OperationNode *operation_node)
@@ -315,12 +404,20 @@ void evaluate_graph_threaded_stage(DepsgraphEvalState *state,
 {
   state->stage = stage;
 
+  const double start_time = state->trace ? PIL_check_seconds_timer() : 0.0;
+
   calculate_pending_parents_if_needed(state);
 
-  schedule_graph(state, [&](OperationNode *node) {
-    BLI_task_pool_push(task_pool, deg_task_run_func, node, false, nullptr);
-  });
+  schedule_graph(state, [&](OperationNode *node) { deg_task_push(task_pool, state, node); });
   BLI_task_pool_work_and_wait(task_pool);
+
+  if (state->trace) {
+    state->trace->add_event(state->trace_process,
+                            evaluation_stage_as_string(stage),
+                            "STAGE",
+                            start_time,
+                            PIL_check_seconds_timer());
+  }
 }
 
 /* Evaluate remaining operations of the dependency graph in a single threaded manner. */
@@ -334,6 +431,8 @@ void evaluate_graph_single_threaded_if_needed(DepsgraphEvalState *state)
 
   state->stage = EvaluationStage::SINGLE_THREADED_WORKAROUND;
 
+  const double start_time = state->trace ? PIL_check_seconds_timer() : 0.0;
+
   GSQueue *evaluation_queue = BLI_gsqueue_new(sizeof(OperationNode *));
   auto schedule_node_to_queue = [&](OperationNode *node) {
     BLI_gsqueue_push(evaluation_queue, &node);
@@ -349,6 +448,14 @@ void evaluate_graph_single_threaded_if_needed(DepsgraphEvalState *state)
   }
 
   BLI_gsqueue_free(evaluation_queue);
+
+  if (state->trace) {
+    state->trace->add_event(state->trace_process,
+                            evaluation_stage_as_string(state->stage),
+                            "STAGE",
+                            start_time,
+                            PIL_check_seconds_timer());
+  }
 }
 
 void depsgraph_ensure_view_layer(Depsgraph *graph)
@@ -388,6 +495,9 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
 
   graph->debug.begin_graph_evaluation();
 
+  TraceRecorder *trace = graph->debug.active_trace();
+  const double trace_start_time = trace ? PIL_check_seconds_timer() : 0.0;
+
 #ifdef WITH_PYTHON
   /* Release the GIL so that Python drivers can be evaluated. See #91046. */
   BPy_BEGIN_ALLOW_THREADS;
@@ -400,6 +510,12 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   DepsgraphEvalState state;
   state.graph = graph;
   state.do_stats = graph->debug.do_time_debug();
+  state.use_critical_path_scheduling = (G.debug & G_DEBUG_DEPSGRAPH_CRITICAL_PATH) != 0 &&
+                                       (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) == 0;
+  if (trace) {
+    state.trace = trace;
+    state.trace_process = trace->process_for_graph(graph, graph->debug.name);
+  }
 
   /* Prepare all nodes for evaluation. */
   initialize_execution(&state, graph);
@@ -459,6 +575,11 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   deg_graph_clear_tags(graph);
   graph->is_evaluating = false;
 
+  if (trace) {
+    trace->add_event(
+        state.trace_process, "Evaluation", "GRAPH", trace_start_time, PIL_check_seconds_timer());
+  }
+
 #ifdef WITH_PYTHON
   BPy_END_ALLOW_THREADS;
 #endif
@@ -25,6 +25,7 @@
 #include "BLI_utildefines.h"
 
 #include "BKE_curve.h"
+#include "BKE_customdata.h"
 #include "BKE_global.h"
 #include "BKE_gpencil_legacy.h"
 #include "BKE_gpencil_update_cache_legacy.h"
@@ -41,11 +42,13 @@
 #include "DNA_ID.h"
 #include "DNA_anim_types.h"
 #include "DNA_armature_types.h"
+#include "DNA_curves_types.h"
 #include "DNA_gpencil_legacy_types.h"
 #include "DNA_mesh_types.h"
 #include "DNA_modifier_types.h"
 #include "DNA_object_types.h"
 #include "DNA_particle_types.h"
+#include "DNA_pointcloud_types.h"
 #include "DNA_rigidbody_types.h"
 #include "DNA_scene_types.h"
 #include "DNA_sequence_types.h"
@@ -749,6 +752,100 @@ void update_id_after_copy(const Depsgraph *depsgraph,
   BKE_animsys_update_driver_array(id_cow);
 }
 
+/* Accumulate the size of custom data layers of the copy which were copied from the original
+ * data-block or which share their data with it. */
+void count_custom_data_bytes(const CustomData &data_orig,
+                             const CustomData &data_cow,
+                             const int totelem,
+                             int64_t &r_copied,
+                             int64_t &r_shared)
+{
+  for (const CustomDataLayer &layer : blender::Span(data_cow.layers, data_cow.totlayer)) {
+    if (layer.data == nullptr) {
+      continue;
+    }
+    const eCustomDataType type = eCustomDataType(layer.type);
+    const int64_t size = int64_t(totelem) * CustomData_sizeof(type);
+    const int index_orig = CustomData_get_named_layer_index(&data_orig, type, layer.name);
+    if (index_orig != -1 && data_orig.layers[index_orig].data == layer.data) {
+      r_shared += size;
+    }
+    else {
+      r_copied += size;
+    }
+  }
+}
+
+void count_array_bytes(const void *array_orig,
+                       const void *array_cow,
+                       const int64_t size,
+                       int64_t &r_copied,
+                       int64_t &r_shared)
+{
+  if (array_cow == nullptr) {
+    return;
+  }
+  if (array_orig == array_cow) {
+    r_shared += size;
+  }
+  else {
+    r_copied += size;
+  }
+}
+
+/* Gather statistics about how much geometry data was copied when copying the original data-block.
+ * Unchanged arrays are shared with the original data-block using implicit sharing. */
+void update_copy_on_write_stats(const Depsgraph *depsgraph, const ID *id_orig, const ID *id_cow)
+{
+  int64_t copied = 0;
+  int64_t shared = 0;
+  switch (GS(id_orig->name)) {
+    case ID_ME: {
+      const Mesh *mesh_orig = reinterpret_cast<const Mesh *>(id_orig);
+      const Mesh *mesh_cow = reinterpret_cast<const Mesh *>(id_cow);
+      count_custom_data_bytes(
+          mesh_orig->vdata, mesh_cow->vdata, mesh_cow->totvert, copied, shared);
+      count_custom_data_bytes(
+          mesh_orig->edata, mesh_cow->edata, mesh_cow->totedge, copied, shared);
+      count_custom_data_bytes(
+          mesh_orig->ldata, mesh_cow->ldata, mesh_cow->totloop, copied, shared);
+      count_custom_data_bytes(
+          mesh_orig->pdata, mesh_cow->pdata, mesh_cow->totpoly, copied, shared);
+      count_array_bytes(mesh_orig->poly_offset_indices,
+                        mesh_cow->poly_offset_indices,
+                        int64_t(mesh_cow->totpoly + 1) * sizeof(int),
+                        copied,
+                        shared);
+      break;
+    }
+    case ID_PT: {
+      const PointCloud *pointcloud_orig = reinterpret_cast<const PointCloud *>(id_orig);
+      const PointCloud *pointcloud_cow = reinterpret_cast<const PointCloud *>(id_cow);
+      count_custom_data_bytes(
+          pointcloud_orig->pdata, pointcloud_cow->pdata, pointcloud_cow->totpoint, copied, shared);
+      break;
+    }
+    case ID_CV: {
+      const CurvesGeometry &curves_orig = reinterpret_cast<const Curves *>(id_orig)->geometry;
+      const CurvesGeometry &curves_cow = reinterpret_cast<const Curves *>(id_cow)->geometry;
+      count_custom_data_bytes(
+          curves_orig.point_data, curves_cow.point_data, curves_cow.point_num, copied, shared);
+      count_custom_data_bytes(
+          curves_orig.curve_data, curves_cow.curve_data, curves_cow.curve_num, copied, shared);
+      count_array_bytes(curves_orig.curve_offsets,
+                        curves_cow.curve_offsets,
+                        int64_t(curves_cow.curve_num + 1) * sizeof(int),
+                        copied,
+                        shared);
+      break;
+    }
+    default:
+      return;
+  }
+  depsgraph->debug.cow_bytes_copied += copied;
+  depsgraph->debug.cow_bytes_shared += shared;
+}
+
 /* This callback is used to validate that all nested ID data-blocks are
  * properly expanded. */
 int foreach_libblock_validate_callback(LibraryIDLinkCallbackData *cb_data)
@@ -788,9 +885,8 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph, const IDNode
   BLI_assert(check_datablock_expanded(id_cow) == false);
   BLI_assert(id_cow->py_instance == nullptr);
 
-  /* Copy data from original ID to a copied version. */
-  /* TODO(sergey): Avoid doing full ID copy somehow, make Mesh to reference
-   * original geometry arrays for until those are modified. */
+  /* Copy data from original ID to a copied version. Geometry arrays of meshes, point clouds and
+   * curves are not duplicated, they are shared with the original until they are modified. */
   /* TODO(sergey): We do some trickery with temp bmain and extra ID pointer
    * just to be able to use existing API. Ideally we need to replace this with
    * in-place copy from existing datablock to a prepared memory.
@@ -813,11 +909,6 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph, const IDNode
       }
       break;
     }
-    case ID_ME: {
-      /* TODO(sergey): Ideally we want to handle meshes in a special
-       * manner here to avoid initial copy of all the geometry arrays. */
-      break;
-    }
     default:
       break;
   }
@@ -827,6 +918,7 @@ ID *deg_expand_copy_on_write_datablock(const Depsgraph *depsgraph, const IDNode
   if (!done) {
     BLI_assert_msg(0, "No idea how to perform CoW on datablock");
   }
+  update_copy_on_write_stats(depsgraph, id_orig, id_cow);
   /* Update pointers to nested ID datablocks. */
   DEG_COW_PRINT(
       "  Remapping ID links for %s: id_orig=%p id_cow=%p\n", id_orig->name, id_orig, id_cow);
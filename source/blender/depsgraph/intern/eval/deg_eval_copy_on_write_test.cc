@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright 2023 Blender Foundation */
+
+/** \file
+ * \ingroup depsgraph
+ */
+
+#include "testing/testing.h"
+
+#include "CLG_log.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+
+#include "BLI_math_vector_types.hh"
+#include "BLI_threads.h"
+
+#include "BKE_collection.h"
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_idtype.h"
+#include "BKE_layer.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh.hh"
+#include "BKE_object.h"
+#include "BKE_scene.h"
+
+#include "RNA_define.h"
+
+#include "DEG_depsgraph.h"
+#include "DEG_depsgraph_build.h"
+#include "DEG_depsgraph_debug.h"
+#include "DEG_depsgraph_query.h"
+
+namespace blender::deg::tests {
+
+class DepsgraphCopyOnWriteTest : public testing::Test {
+ protected:
+  Main *bmain = nullptr;
+  Scene *scene = nullptr;
+  ViewLayer *view_layer = nullptr;
+  Mesh *mesh = nullptr;
+
+  static const int verts_num = 1000;
+
+  static void SetUpTestSuite()
+  {
+    CLG_init();
+    BLI_threadapi_init();
+    BKE_idtype_init();
+    RNA_init();
+    DEG_register_node_types();
+  }
+
+  static void TearDownTestSuite()
+  {
+    DEG_free_node_types();
+    RNA_exit();
+    BLI_threadapi_exit();
+    CLG_exit();
+  }
+
+  void SetUp() override
+  {
+    bmain = BKE_main_new();
+    G.main = bmain;
+    scene = BKE_scene_add(bmain, "Scene");
+    view_layer = BKE_view_layer_default_view(scene);
+
+    mesh = BKE_mesh_add(bmain, "Mesh");
+    mesh->totvert = verts_num;
+    CustomData_add_layer_named(&mesh->vdata, CD_PROP_FLOAT3, CD_CONSTRUCT, verts_num, "position");
+    Object *object = BKE_object_add_only_object(bmain, OB_MESH, "Object");
+    object->data = mesh;
+    BKE_collection_object_add(bmain, scene->master_collection, object);
+    BKE_main_collection_sync(bmain);
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+    G.main = nullptr;
+  }
+};
+
+TEST_F(DepsgraphCopyOnWriteTest, GeometryArraysShared)
+{
+  const int64_t positions_size = int64_t(verts_num) * sizeof(float3);
+  Depsgraph *depsgraph = DEG_graph_new(bmain, scene, view_layer, DAG_EVAL_VIEWPORT);
+  DEG_graph_build_from_view_layer(depsgraph);
+  DEG_evaluate_on_refresh(depsgraph);
+
+  int64_t bytes_copied = -1;
+  int64_t bytes_shared = -1;
+  DEG_stats_copy_on_write(depsgraph, &bytes_copied, &bytes_shared);
+  EXPECT_EQ(bytes_copied, 0);
+  EXPECT_EQ(bytes_shared, positions_size);
+
+  const Mesh *mesh_cow = reinterpret_cast<const Mesh *>(
+      DEG_get_evaluated_id(depsgraph, &mesh->id));
+  EXPECT_EQ(mesh_cow->vert_positions().data(), mesh->vert_positions().data());
+
+  /* Changing the original copies its shared positions, the copy is updated to share the new
+   * array. The counters only contain the last evaluation. */
+  mesh->vert_positions_for_write().first() = float3(1.0f);
+  EXPECT_NE(mesh_cow->vert_positions().data(), mesh->vert_positions().data());
+  DEG_id_tag_update_ex(bmain, &mesh->id, ID_RECALC_GEOMETRY);
+  DEG_evaluate_on_refresh(depsgraph);
+
+  DEG_stats_copy_on_write(depsgraph, &bytes_copied, &bytes_shared);
+  EXPECT_EQ(bytes_copied, 0);
+  EXPECT_EQ(bytes_shared, positions_size);
+  mesh_cow = reinterpret_cast<const Mesh *>(DEG_get_evaluated_id(depsgraph, &mesh->id));
+  EXPECT_EQ(mesh_cow->vert_positions().data(), mesh->vert_positions().data());
+  EXPECT_EQ(mesh_cow->vert_positions().first(), float3(1.0f));
+
+  DEG_graph_free(depsgraph);
+}
+
+}  // namespace blender::deg::tests
@@ -8,8 +8,10 @@
 #include "intern/eval/deg_eval_stats.h"
 
 #include "BLI_utildefines.h"
+#include "BLI_vector.hh"
 
 #include "intern/depsgraph.h"
+#include "intern/depsgraph_relation.h"
 
 #include "intern/node/deg_node.h"
 #include "intern/node/deg_node_component.h"
@@ -38,4 +40,66 @@ void deg_eval_stats_aggregate(Depsgraph *graph)
   }
 }
 
+void deg_eval_stats_update_cost_estimate(OperationNode *operation_node, const double time)
+{
+  /* Weight of the new measurement. Smooths out the noise of individual measurements while still
+   * adapting quickly when the cost of an operation changes, e.g. when a modifier is enabled. */
+  const double factor = 0.3;
+  if (operation_node->cost_estimate == 0.0) {
+    operation_node->cost_estimate = time;
+  }
+  else {
+    operation_node->cost_estimate = operation_node->cost_estimate * (1.0 - factor) +
+                                    time * factor;
+  }
+}
+
+static bool is_critical_path_relation(const Relation *rel)
+{
+  return rel->to->type == NodeType::OPERATION && (rel->flag & RELATION_FLAG_CYCLIC) == 0;
+}
+
+void deg_eval_stats_update_critical_path(Depsgraph *graph)
+{
+  /* Visit operations in reverse topological order, so that the critical path cost of all children
+   * is known when an operation is visited. The custom flags hold the number of children which
+   * have not been visited yet. */
+  Vector<OperationNode *> stack;
+  for (OperationNode *op_node : graph->operations) {
+    op_node->critical_path_cost = 0.0;
+    op_node->custom_flags = 0;
+    for (const Relation *rel : op_node->outlinks) {
+      if (is_critical_path_relation(rel)) {
+        op_node->custom_flags++;
+      }
+    }
+    if (op_node->custom_flags == 0) {
+      stack.append(op_node);
+    }
+  }
+  while (!stack.is_empty()) {
+    OperationNode *op_node = stack.pop_last();
+    double children_cost = 0.0;
+    for (const Relation *rel : op_node->outlinks) {
+      if (is_critical_path_relation(rel)) {
+        const OperationNode *child = (const OperationNode *)rel->to;
+        children_cost = std::max(children_cost, child->critical_path_cost);
+      }
+    }
+    /* Operations which are up to date are not evaluated, but they may still be on the path between
+     * operations which are evaluated. */
+    const double own_cost = (op_node->flag & DEPSOP_FLAG_NEEDS_UPDATE) ? op_node->cost_estimate :
+                                                                         0.0;
+    op_node->critical_path_cost = own_cost + children_cost;
+    for (Relation *rel : op_node->inlinks) {
+      if (rel->from->type == NodeType::OPERATION && (rel->flag & RELATION_FLAG_CYCLIC) == 0) {
+        OperationNode *parent = (OperationNode *)rel->from;
+        if (--parent->custom_flags == 0) {
+          stack.append(parent);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace blender::deg
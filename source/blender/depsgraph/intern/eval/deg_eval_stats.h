@@ -14,4 +14,13 @@ struct Depsgraph;
 /* Aggregate operation timings to overall component and ID nodes timing. */
 void deg_eval_stats_aggregate(Depsgraph *graph);
 
+struct OperationNode;
+
+/* Add a measured evaluation time to the running estimate of the operation's cost. */
+void deg_eval_stats_update_cost_estimate(OperationNode *operation_node, double time);
+
+/* Calculate the critical path cost of all operations, based on the cost estimates of operations
+ * which are tagged for update. */
+void deg_eval_stats_update_critical_path(Depsgraph *graph);
+
 }  // namespace blender::deg
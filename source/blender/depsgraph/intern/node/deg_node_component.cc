@@ -286,6 +286,18 @@ void ComponentNode::finalize_build(Depsgraph * /*graph*/)
   operations_map = nullptr;
 }
 
+void ComponentNode::reopen_build()
+{
+  BLI_assert(operations_map == nullptr);
+  operations_map = new Map<ComponentNode::OperationIDKey, OperationNode *>();
+  operations_map->reserve(operations.size());
+  for (OperationNode *op_node : operations) {
+    OperationIDKey key(op_node->opcode, op_node->name.c_str(), op_node->name_tag);
+    operations_map->add_new(key, op_node);
+  }
+  operations.clear();
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
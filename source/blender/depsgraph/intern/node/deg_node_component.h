@@ -108,6 +108,9 @@ struct ComponentNode : public Node {
   virtual OperationNode *get_exit_operation() override;
 
   void finalize_build(Depsgraph *graph);
+  /* Revert #finalize_build(), so that operations can be looked up and added again when the
+   * graph is partially rebuilt. */
+  void reopen_build();
 
   IDNode *owner;
 
@@ -184,6 +184,17 @@ void IDNode::finalize_build(Depsgraph *graph)
   visible_components_mask = get_visible_components_mask();
 }
 
+void IDNode::reopen_build()
+{
+  for (ComponentNode *comp_node : components.values()) {
+    comp_node->reopen_build();
+  }
+  /* The node is kept as-is, so nothing has changed compared to the previous build yet. */
+  previously_visible_components_mask = visible_components_mask;
+  previous_eval_flags = eval_flags;
+  previous_customdata_masks = customdata_masks;
+}
+
 IDComponentsMask IDNode::get_visible_components_mask() const
 {
   IDComponentsMask result = 0;
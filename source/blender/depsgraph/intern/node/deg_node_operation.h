@@ -284,6 +284,13 @@ struct OperationNode : public Node {
   /* (OperationFlag) extra settings affecting evaluation. */
   int flag;
 
+  /* Evaluation time in seconds, averaged over previous evaluations. Only measured when the
+   * critical path scheduling is enabled. */
+  double cost_estimate;
+  /* Estimated time in seconds to evaluate this operation and the most expensive chain of
+   * operations which depend on it. Operations with the highest value are scheduled first. */
+  double critical_path_cost;
+
   DEG_DEPSNODE_DECLARE;
 };
 
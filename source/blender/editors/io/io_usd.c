@@ -146,6 +146,7 @@ static int wm_usd_export_exec(bContext *C, wmOperator *op)
   const bool export_normals = RNA_boolean_get(op->ptr, "export_normals");
   const bool export_materials = RNA_boolean_get(op->ptr, "export_materials");
   const bool use_instancing = RNA_boolean_get(op->ptr, "use_instancing");
+  const bool use_parallel_frames = RNA_boolean_get(op->ptr, "use_parallel_frames");
   const bool evaluation_mode = RNA_enum_get(op->ptr, "evaluation_mode");
 
   const bool generate_preview_surface = RNA_boolean_get(op->ptr, "generate_preview_surface");
@@ -166,6 +167,7 @@ static int wm_usd_export_exec(bContext *C, wmOperator *op)
       selected_objects_only,
       visible_objects_only,
       use_instancing,
+      use_parallel_frames,
       evaluation_mode,
       generate_preview_surface,
       export_textures,
@@ -228,6 +230,12 @@ static void wm_usd_export_draw(bContext *UNUSED(C), wmOperator *op)
   box = uiLayoutBox(layout);
   uiItemL(box, IFACE_("Experimental"), ICON_NONE);
   uiItemR(box, ptr, "use_instancing", 0, NULL, ICON_NONE);
+
+  col = uiLayoutColumn(box, true);
+  uiItemR(col, ptr, "use_parallel_frames", 0, NULL, ICON_NONE);
+  uiLayoutSetActive(col,
+                    RNA_boolean_get(ptr, "export_animation") &&
+                        RNA_boolean_get(ptr, "visible_objects_only"));
 }
 
 static void free_operator_customdata(wmOperator *op)
@@ -325,6 +333,15 @@ void WM_OT_usd_export(struct wmOperatorType *ot)
                   "Instancing",
                   "Export instanced objects as references in USD rather than real objects");
 
+  RNA_def_boolean(ot->srna,
+                  "use_parallel_frames",
+                  false,
+                  "Parallel Frames",
+                  "Evaluate multiple frames of the animation at the same time, using more memory. "
+                  "Only for exporting visible objects, and only when the result does not depend "
+                  "on frame change handlers. Scenes with simulations are evaluated frame by "
+                  "frame");
+
   RNA_def_enum(ot->srna,
                "evaluation_mode",
                rna_enum_usd_export_evaluation_mode_items,
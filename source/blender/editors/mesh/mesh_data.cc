@@ -272,13 +272,14 @@ int ED_mesh_uv_add(
     }
 
     if (CustomData_has_layer(&me->ldata, CD_PROP_FLOAT2) && do_init) {
+      /* The source layer may reference a memory-mapped file, so #MEM_dupallocN can't be used. */
+      float2 *uv_map = static_cast<float2 *>(
+          MEM_malloc_arrayN(me->totloop, sizeof(float2), __func__));
+      memcpy(uv_map,
+             CustomData_get_layer(&me->ldata, CD_PROP_FLOAT2),
+             sizeof(float2) * me->totloop);
       CustomData_add_layer_named_with_data(
-          &me->ldata,
-          CD_PROP_FLOAT2,
-          MEM_dupallocN(CustomData_get_layer(&me->ldata, CD_PROP_FLOAT2)),
-          me->totloop,
-          unique_name,
-          nullptr);
+          &me->ldata, CD_PROP_FLOAT2, uv_map, me->totloop, unique_name, nullptr);
 
       is_init = true;
     }
@@ -224,6 +224,7 @@ struct BakeSimulationJob {
   Depsgraph *depsgraph;
   Scene *scene;
   Vector<Object *> objects;
+  bool use_compression;
 };
 
 static void bake_simulation_job_startjob(void *customdata,
@@ -323,7 +324,12 @@ static void bake_simulation_job_startjob(void *customdata,
 
         BLI_file_ensure_parent_dir_exists(bdata_path);
         fstream bdata_file{bdata_path, std::ios::out | std::ios::binary};
-        bke::sim::DiskBDataWriter bdata_writer{bdata_file_name, bdata_file, 0};
+        bke::sim::BDataEncoding bdata_encoding;
+        if (job.use_compression) {
+          bdata_encoding.use_compression = true;
+          bdata_encoding.delta_key_interval = 10;
+        }
+        bke::sim::DiskBDataWriter bdata_writer{bdata_file_name, bdata_file, 0, bdata_encoding};
 
         io::serialize::DictionaryValue io_root;
         bke::sim::serialize_modifier_simulation_state(
@@ -376,6 +382,7 @@ static int bake_simulation_invoke(bContext *C, wmOperator *op, const wmEvent * /
   job->bmain = bmain;
   job->depsgraph = depsgraph;
   job->scene = scene;
+  job->use_compression = RNA_boolean_get(op->ptr, "use_compression");
 
   if (RNA_boolean_get(op->ptr, "selected")) {
     CTX_DATA_BEGIN (C, Object *, object, selected_objects) {
@@ -502,6 +509,11 @@ void OBJECT_OT_simulation_nodes_cache_bake(wmOperatorType *ot)
   ot->poll = bake_simulation_poll;
 
   RNA_def_boolean(ot->srna, "selected", false, "Selected", "Bake cache on all selected objects");
+  RNA_def_boolean(ot->srna,
+                  "use_compression",
+                  false,
+                  "Compress",
+                  "Compress the baked data, which uses less disk space but loads slower");
 }
 
 void OBJECT_OT_simulation_nodes_cache_delete(wmOperatorType *ot)
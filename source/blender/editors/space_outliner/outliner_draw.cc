@@ -283,6 +283,7 @@ static void outliner_object_set_flag_recursive_fn(bContext *C,
       if (ob) {
         RNA_id_pointer_create(&ob_iter->id, &ptr);
         DEG_id_tag_update(&ob_iter->id, ID_RECALC_COPY_ON_WRITE);
+        DEG_id_tag_relations_update(bmain, &ob_iter->id);
       }
       else {
         BKE_view_layer_synced_ensure(scene, view_layer);
@@ -299,8 +300,9 @@ static void outliner_object_set_flag_recursive_fn(bContext *C,
 
   /* We don't call RNA_property_update() due to performance, so we batch update them. */
   if (ob) {
+    /* Only the relations of the object and its children need to be rebuilt. */
     BKE_main_collection_sync_remap(bmain);
-    DEG_relations_tag_update(bmain);
+    DEG_id_tag_relations_update(bmain, &ob->id);
   }
   else {
     BKE_view_layer_need_resync_tag(view_layer);
@@ -631,7 +633,15 @@ static void outliner_collection_set_flag_recursive_fn(bContext *C,
 
   /* We don't call RNA_property_update() due to performance, so we batch update them. */
   BKE_main_collection_sync_remap(bmain);
-  DEG_relations_tag_update(bmain);
+  if (extend) {
+    /* Only the toggled collection hierarchy changed. */
+    DEG_collection_tag_relations_update(bmain,
+                                        collection ? collection : layer_collection->collection);
+  }
+  else {
+    /* Isolating changes the flags of all other collections as well. */
+    DEG_relations_tag_update(bmain);
+  }
 }
 
 /**
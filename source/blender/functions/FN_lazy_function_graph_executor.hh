@@ -9,6 +9,7 @@
  * another #Graph again).
  */
 
+#include "BLI_timeit.hh"
 #include "BLI_vector.hh"
 #include "BLI_vector_set.hh"
 
@@ -16,6 +17,63 @@
 
 namespace blender::fn::lazy_function {
 
+/**
+ * Decides how the #GraphExecutor distributes scheduled nodes over threads.
+ */
+enum class GraphExecutorScheduling {
+  /**
+   * Stay single-threaded until a node indicates that it will take a while. Then all nodes that
+   * are scheduled on the current thread are pushed to a task pool as a single task. This works
+   * well when most nodes are cheap and only a few are expensive.
+   */
+  TaskPool,
+  /**
+   * Every thread has a queue of scheduled nodes that other threads can steal from. The thread
+   * keeps running the most recently scheduled nodes itself, because their inputs were just
+   * computed, and shares older nodes when other threads run out of work. Multi-threading is
+   * enabled as soon as enough nodes are scheduled at the same time. This works better for large
+   * graphs with many small independent nodes.
+   */
+  WorkStealing,
+};
+
+/**
+ * Scheduling information about a single run of a node. See
+ * #GraphExecutorLogger::log_node_scheduling.
+ */
+struct GraphExecutorNodeSchedulingInfo {
+  /** Time between the node being scheduled and the start of its run. */
+  timeit::Nanoseconds wait_time{0};
+  /** Time spent in the executor for this run, excluding the node function itself. */
+  timeit::Nanoseconds overhead_time{0};
+  /** Time spent in the node function. Zero when the node did not have to be executed. */
+  timeit::Nanoseconds execute_time{0};
+  /** True when the node was stolen from the queue of another thread. */
+  bool was_stolen = false;
+};
+
+/**
+ * Scheduling counters that are accumulated during a single execution of a #GraphExecutor. See
+ * #GraphExecutorLogger::log_scheduling_stats.
+ */
+struct GraphExecutorSchedulingStats {
+  /** Number of times a node was taken from a queue and run. */
+  int64_t node_runs = 0;
+  /** Number of runs in which the node function was actually executed. */
+  int64_t node_executions = 0;
+  /** Number of times a thread looked for nodes in the queues of other threads. */
+  int64_t steal_attempts = 0;
+  /** Number of successful steal attempts and the total number of nodes taken by them. */
+  int64_t steals = 0;
+  int64_t stolen_nodes = 0;
+  /** Number of times a thread made some of its scheduled nodes available to other threads. */
+  int64_t publishes = 0;
+  /** Sums of the corresponding #GraphExecutorNodeSchedulingInfo times of all node runs. */
+  timeit::Nanoseconds total_wait_time{0};
+  timeit::Nanoseconds total_overhead_time{0};
+  timeit::Nanoseconds total_execute_time{0};
+};
+
 /**
  * Can be implemented to log values produced during graph evaluation.
  */
@@ -35,6 +93,26 @@ class GraphExecutorLogger {
                                       const Params &params,
                                       const Context &context) const;
 
+  /**
+   * Return true to gather scheduling statistics during evaluation. This is disabled by default,
+   * because it requires timing every node run.
+   */
+  virtual bool use_scheduling_stats() const;
+
+  /**
+   * Called after every run of a node when #use_scheduling_stats is enabled. This may be called
+   * from multiple threads at the same time.
+   */
+  virtual void log_node_scheduling(const FunctionNode &node,
+                                   const GraphExecutorNodeSchedulingInfo &info,
+                                   const Context &context) const;
+
+  /**
+   * Called at the end of every execution of the graph when #use_scheduling_stats is enabled.
+   */
+  virtual void log_scheduling_stats(const GraphExecutorSchedulingStats &stats,
+                                    const Context &context) const;
+
   virtual void dump_when_outputs_are_missing(const FunctionNode &node,
                                              Span<const OutputSocket *> missing_sockets,
                                              const Context &context) const;
@@ -58,6 +136,7 @@ class GraphExecutor : public LazyFunction {
  public:
   using Logger = GraphExecutorLogger;
   using SideEffectProvider = GraphExecutorSideEffectProvider;
+  using Scheduling = GraphExecutorScheduling;
 
  private:
   /**
@@ -78,6 +157,10 @@ class GraphExecutor : public LazyFunction {
    * during evaluation.
    */
   const SideEffectProvider *side_effect_provider_;
+  /**
+   * How nodes are distributed over threads.
+   */
+  Scheduling scheduling_;
 
   friend class Executor;
 
@@ -86,7 +169,8 @@ class GraphExecutor : public LazyFunction {
                 Span<const OutputSocket *> graph_inputs,
                 Span<const InputSocket *> graph_outputs,
                 const Logger *logger,
-                const SideEffectProvider *side_effect_provider);
+                const SideEffectProvider *side_effect_provider,
+                Scheduling scheduling = Scheduling::TaskPool);
 
   void *init_storage(LinearAllocator<> &allocator) const override;
   void destruct_storage(void *storage) const override;
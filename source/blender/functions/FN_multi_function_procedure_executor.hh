@@ -10,18 +10,41 @@
 
 namespace blender::fn::multi_function {
 
+/**
+ * A procedure that has been preprocessed so that it can be evaluated in small chunks. See
+ * #ProcedureExecutor::call_fused.
+ */
+struct FusedProcedureKernel;
+
 /** A multi-function that executes a procedure internally. */
 class ProcedureExecutor : public MultiFunction {
  private:
   Signature signature_;
   const Procedure &procedure_;
+  /**
+   * Only available when fusing was requested and the procedure is simple enough. Otherwise the
+   * procedure is interpreted.
+   */
+  std::unique_ptr<FusedProcedureKernel> fused_kernel_;
 
  public:
-  ProcedureExecutor(const Procedure &procedure);
+  /**
+   * \param allow_fusing: Try to evaluate the procedure in small chunks of indices, running all
+   * instructions on one chunk before moving on to the next. This keeps intermediate values in the
+   * CPU cache and avoids allocating them for the entire mask. Only procedures without branches
+   * and vector parameters support this, all others are still interpreted.
+   */
+  ProcedureExecutor(const Procedure &procedure, bool allow_fusing = false);
+  ~ProcedureExecutor();
 
   void call(const IndexMask &mask, Params params, Context context) const override;
 
+  /** True when the procedure is evaluated in chunks. */
+  bool is_fused() const;
+
  private:
+  void call_fused(const IndexMask &mask, Params params, Context context) const;
+
   ExecutionHints get_execution_hints() const override;
 };
 
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup fn
+ *
+ * Multi-functions for the most common element-wise math operations on `float` and `float3`.
+ * Functions created with #build::SI2_SO depend on the compiler to vectorize the generated loops,
+ * which often does not happen, e.g. when one of the inputs is a single value or when the type is
+ * `float3`. The functions here have explicit SIMD loops instead. `float3` arrays are processed as
+ * flat `float` arrays, so that no SIMD lanes are wasted.
+ */
+
+#include "FN_multi_function.hh"
+
+namespace blender::fn::multi_function {
+
+enum class SIMDMathOperation {
+  Add,
+  Subtract,
+  Multiply,
+  /** Returns zero when dividing by zero. */
+  SafeDivide,
+  /** Same as `std::min(a, b)`, only supported for `float`. */
+  Minimum,
+  /** Same as `std::max(a, b)`, only supported for `float`. */
+  Maximum,
+};
+
+/**
+ * Computes `result = a <operation> b` with two inputs and one output of type `float` or `float3`.
+ * Inputs that are spans or single values are processed with SIMD instructions. Other virtual
+ * arrays are passed on to a fallback function.
+ */
+class SIMDMathFunction : public MultiFunction {
+ private:
+  SIMDMathOperation operation_;
+  /** Number of floats per element, 1 for `float` and 3 for `float3`. */
+  int components_num_;
+  /** Computes the same result element by element and has the same signature. */
+  const MultiFunction &fallback_fn_;
+
+ public:
+  SIMDMathFunction(SIMDMathOperation operation, const MultiFunction &fallback_fn);
+
+  void call(const IndexMask &mask, Params params, Context context) const override;
+};
+
+}  // namespace blender::fn::multi_function
@@ -369,7 +369,8 @@ Vector<GVArray> evaluate_fields(ResourceScope &scope,
     mf::Procedure procedure;
     build_multi_function_procedure_for_fields(
         procedure, scope, field_tree_info, varying_fields_to_evaluate);
-    mf::ProcedureExecutor procedure_executor{procedure};
+    /* Field procedures don't contain branches, so they can be evaluated in small chunks. */
+    mf::ProcedureExecutor procedure_executor{procedure, true};
 
     mf::ParamsBuilder mf_params{procedure_executor, &mask};
     mf::ContextBuilder mf_context;
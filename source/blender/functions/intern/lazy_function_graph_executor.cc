@@ -37,6 +37,12 @@
  * When all tasks are completed, the executor gives back control to the caller which may later
  * provide new inputs to the graph which in turn leads to new nodes being scheduled and the process
  * starts again.
+ *
+ * With #GraphExecutorScheduling::WorkStealing, multi-threading is enabled as soon as enough nodes
+ * are scheduled at the same time. Every thread then owns a #WorkerQueue. Threads publish older
+ * scheduled nodes to their queue when other threads may run out of work, and idle threads steal
+ * from the queues of other threads. The schedule state of a node is changed with atomic
+ * operations, which allows skipping the node lock when running a node that has finished already.
  */
 
 #include <mutex>
@@ -147,9 +153,9 @@ struct NodeState {
   int missing_required_inputs = 0;
   /**
    * Is set to true once the node is done with its work, i.e. when all outputs that may be used
-   * have been computed.
+   * have been computed. It is only set while the node is locked, but can be read without locking.
    */
-  bool node_has_finished = false;
+  std::atomic<bool> node_has_finished = false;
   /**
    * Set to true once the always required inputs have been requested.
    * This happens the first time the node is run.
@@ -172,9 +178,19 @@ struct NodeState {
   bool enabled_multi_threading = false;
   /**
    * A node is always in one specific schedule state. This helps to ensure that the same node does
-   * not run twice at the same time accidentally.
+   * not run twice at the same time accidentally. It is only changed with atomic operations, so
+   * transitions don't require the node lock.
+   */
+  std::atomic<NodeScheduleState> schedule_state = NodeScheduleState::NotScheduled;
+  /**
+   * Set when the node is taken from the queue of another thread. Only accessed by the thread that
+   * has the node scheduled.
    */
-  NodeScheduleState schedule_state = NodeScheduleState::NotScheduled;
+  bool was_stolen = false;
+  /**
+   * Time when the node was scheduled last. Only set when scheduling statistics are gathered.
+   */
+  timeit::TimePoint schedule_time;
   /**
    * Custom storage of the node.
    */
@@ -245,6 +261,84 @@ struct ScheduledNodes {
   {
     return this->priority_.is_empty() && this->normal_.is_empty();
   }
+
+  int64_t size() const
+  {
+    return this->priority_.size() + this->normal_.size();
+  }
+
+  /**
+   * Move scheduled nodes into the given vector, oldest first, so that they can be run by other
+   * threads. If #keep_newest is true, only normal nodes are moved and the node that would be
+   * popped next stays scheduled.
+   */
+  void extract_oldest(Vector<const FunctionNode *> &r_nodes, const bool keep_newest)
+  {
+    if (!keep_newest) {
+      r_nodes.extend(this->priority_);
+      this->priority_.clear();
+      r_nodes.extend(this->normal_);
+      this->normal_.clear();
+      return;
+    }
+    const int64_t nodes_to_keep = this->priority_.is_empty() ? 1 : 0;
+    const int64_t nodes_to_move = std::max<int64_t>(0, this->normal_.size() - nodes_to_keep);
+    r_nodes.extend(this->normal_.as_span().take_front(nodes_to_move));
+    this->normal_.remove(0, nodes_to_move);
+  }
+};
+
+/**
+ * Nodes that were scheduled on one thread and can be stolen by other threads. This is only used
+ * with #GraphExecutorScheduling::WorkStealing. The owning thread takes nodes from the back,
+ * because those were scheduled most recently, while other threads steal from the front.
+ */
+struct WorkerQueue {
+  std::mutex mutex;
+  Vector<const FunctionNode *> nodes;
+  /**
+   * Nodes before this index have been stolen already.
+   */
+  int64_t front = 0;
+  /**
+   * Number of nodes in the queue. This can be read without locking to find a queue to steal from.
+   */
+  std::atomic<int64_t> size = 0;
+};
+
+/**
+ * Thread-safe counterpart of #GraphExecutorSchedulingStats that is updated during execution.
+ */
+struct SchedulingCounters {
+  std::atomic<int64_t> node_runs = 0;
+  std::atomic<int64_t> node_executions = 0;
+  std::atomic<int64_t> steal_attempts = 0;
+  std::atomic<int64_t> steals = 0;
+  std::atomic<int64_t> stolen_nodes = 0;
+  std::atomic<int64_t> publishes = 0;
+  std::atomic<int64_t> wait_ns = 0;
+  std::atomic<int64_t> overhead_ns = 0;
+  std::atomic<int64_t> execute_ns = 0;
+
+  static void add(std::atomic<int64_t> &counter, const int64_t value)
+  {
+    counter.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  GraphExecutorSchedulingStats extract()
+  {
+    GraphExecutorSchedulingStats stats;
+    stats.node_runs = node_runs.exchange(0);
+    stats.node_executions = node_executions.exchange(0);
+    stats.steal_attempts = steal_attempts.exchange(0);
+    stats.steals = steals.exchange(0);
+    stats.stolen_nodes = stolen_nodes.exchange(0);
+    stats.publishes = publishes.exchange(0);
+    stats.total_wait_time = timeit::Nanoseconds(wait_ns.exchange(0));
+    stats.total_overhead_time = timeit::Nanoseconds(overhead_ns.exchange(0));
+    stats.total_execute_time = timeit::Nanoseconds(execute_ns.exchange(0));
+    return stats;
+  }
 };
 
 struct CurrentTask {
@@ -288,6 +382,37 @@ class Executor {
 #ifdef FN_LAZY_FUNCTION_DEBUG_THREADS
   std::thread::id current_main_thread_;
 #endif
+  /**
+   * Queues that threads can steal scheduled nodes from. Only used with
+   * #GraphExecutorScheduling::WorkStealing once multi-threading is enabled.
+   */
+  Array<WorkerQueue, 0> worker_queues_;
+  std::atomic<int> next_worker_index_ = 0;
+  /**
+   * Total number of nodes in #worker_queues_.
+   */
+  std::atomic<int64_t> stealable_nodes_num_ = 0;
+  /**
+   * Number of task pool tasks that are currently looking for or running stolen nodes.
+   */
+  std::atomic<int> active_workers_ = 0;
+  int max_workers_ = 0;
+  /**
+   * Set when enabling multi-threading for work stealing failed, to avoid trying it again for
+   * every node.
+   */
+  bool work_stealing_unavailable_ = false;
+  /**
+   * Only gathered when the logger asks for it, because timing every node run has a cost.
+   */
+  bool gather_scheduling_stats_ = false;
+  SchedulingCounters scheduling_counters_;
+
+  /**
+   * Work stealing only starts when at least this many nodes are scheduled at the same time.
+   * Otherwise the overhead of multi-threading is likely higher than the benefit.
+   */
+  static constexpr int64_t min_scheduled_nodes_for_work_stealing = 4;
 
   struct ThreadLocalStorage {
     /**
@@ -296,6 +421,10 @@ class Executor {
      */
     LinearAllocator<> allocator;
     std::optional<destruct_ptr<LocalUserData>> local_user_data;
+    /**
+     * Index into #worker_queues_ of the queue that this thread publishes nodes to.
+     */
+    int worker_index = -1;
   };
   std::unique_ptr<threading::EnumerableThreadSpecific<ThreadLocalStorage>> thread_locals_;
   LinearAllocator<> main_allocator_;
@@ -322,6 +451,7 @@ class Executor {
   {
     /* The indices are necessary, because they are used as keys in #node_states_. */
     BLI_assert(self_.graph_.node_indices_are_valid());
+    gather_scheduling_stats_ = self_.logger_ != nullptr && self_.logger_->use_scheduling_stats();
   }
 
   ~Executor()
@@ -394,6 +524,13 @@ class Executor {
     if (TaskPool *task_pool = task_pool_.load()) {
       BLI_task_pool_work_and_wait(task_pool);
     }
+    BLI_assert(stealable_nodes_num_.load() == 0);
+
+    if (gather_scheduling_stats_) {
+      const Context local_context{
+          context_->storage, context_->user_data, local_data.local_user_data};
+      self_.logger_->log_scheduling_stats(scheduling_counters_.extract(), local_context);
+    }
   }
 
  private:
@@ -710,29 +847,46 @@ class Executor {
   void schedule_node(LockedNode &locked_node, CurrentTask &current_task, const bool is_priority)
   {
     BLI_assert(locked_node.node.is_function());
-    switch (locked_node.node_state.schedule_state) {
-      case NodeScheduleState::NotScheduled: {
-        locked_node.node_state.schedule_state = NodeScheduleState::Scheduled;
-        const FunctionNode &node = static_cast<const FunctionNode &>(locked_node.node);
-        if (this->use_multi_threading()) {
-          std::lock_guard lock{current_task.mutex};
-          current_task.scheduled_nodes.schedule(node, is_priority);
+    NodeState &node_state = locked_node.node_state;
+    /* The schedule state may also be changed by #run_node_task without holding the node lock, so
+     * transitions have to be done atomically. */
+    NodeScheduleState old_state = node_state.schedule_state.load(std::memory_order_relaxed);
+    while (true) {
+      switch (old_state) {
+        case NodeScheduleState::NotScheduled: {
+          if (!node_state.schedule_state.compare_exchange_weak(old_state,
+                                                               NodeScheduleState::Scheduled))
+          {
+            continue;
+          }
+          if (gather_scheduling_stats_) {
+            node_state.schedule_time = timeit::Clock::now();
+          }
+          const FunctionNode &node = static_cast<const FunctionNode &>(locked_node.node);
+          if (this->use_multi_threading()) {
+            std::lock_guard lock{current_task.mutex};
+            current_task.scheduled_nodes.schedule(node, is_priority);
+          }
+          else {
+            current_task.scheduled_nodes.schedule(node, is_priority);
+          }
+          current_task.has_scheduled_nodes.store(true, std::memory_order_relaxed);
+          return;
         }
-        else {
-          current_task.scheduled_nodes.schedule(node, is_priority);
+        case NodeScheduleState::Scheduled: {
+          return;
+        }
+        case NodeScheduleState::Running: {
+          if (!node_state.schedule_state.compare_exchange_weak(
+                  old_state, NodeScheduleState::RunningAndRescheduled))
+          {
+            continue;
+          }
+          return;
+        }
+        case NodeScheduleState::RunningAndRescheduled: {
+          return;
         }
-        current_task.has_scheduled_nodes.store(true, std::memory_order_relaxed);
-        break;
-      }
-      case NodeScheduleState::Scheduled: {
-        break;
-      }
-      case NodeScheduleState::Running: {
-        locked_node.node_state.schedule_state = NodeScheduleState::RunningAndRescheduled;
-        break;
-      }
-      case NodeScheduleState::RunningAndRescheduled: {
-        break;
       }
     }
   }
@@ -780,11 +934,23 @@ class Executor {
 
   void run_task(CurrentTask &current_task, const LocalData &local_data)
   {
-    while (const FunctionNode *node = current_task.scheduled_nodes.pop_next_node()) {
-      if (current_task.scheduled_nodes.is_empty()) {
-        current_task.has_scheduled_nodes.store(false, std::memory_order_relaxed);
+    while (true) {
+      while (const FunctionNode *node = current_task.scheduled_nodes.pop_next_node()) {
+        if (current_task.scheduled_nodes.is_empty()) {
+          current_task.has_scheduled_nodes.store(false, std::memory_order_relaxed);
+        }
+        else if (self_.scheduling_ == GraphExecutorScheduling::WorkStealing) {
+          this->share_scheduled_nodes_if_useful(current_task);
+        }
+        this->run_node_task(*node, current_task, local_data);
+      }
+      if (!this->use_work_stealing()) {
+        return;
+      }
+      /* Look for work in the queues before giving up. */
+      if (!this->take_stealable_nodes(current_task)) {
+        return;
       }
-      this->run_node_task(*node, current_task, local_data);
     }
   }
 
@@ -797,11 +963,33 @@ class Executor {
     Context local_context{context_->storage, context_->user_data, local_data.local_user_data};
     const LazyFunction &fn = node.function();
 
+    const timeit::TimePoint run_start = gather_scheduling_stats_ ? timeit::Clock::now() :
+                                                                   timeit::TimePoint();
+    timeit::Nanoseconds execute_time{0};
+    const bool was_stolen = node_state.was_stolen;
+    node_state.was_stolen = false;
+
+    /* Running a node that has finished already does nothing. This happens quite often when many
+     * nodes notify the same node about unused outputs. Skip locking the node in this case. */
+    if (node_state.node_has_finished.load(std::memory_order_acquire)) {
+      const NodeScheduleState old_state = node_state.schedule_state.exchange(
+          NodeScheduleState::NotScheduled);
+      BLI_assert(old_state == NodeScheduleState::Scheduled);
+      UNUSED_VARS_NDEBUG(old_state);
+      if (gather_scheduling_stats_) {
+        this->log_node_scheduling(
+            node, node_state, run_start, false, execute_time, was_stolen, local_data);
+      }
+      return;
+    }
+
     bool node_needs_execution = false;
     this->with_locked_node(
         node, node_state, current_task, local_data, [&](LockedNode &locked_node) {
-          BLI_assert(node_state.schedule_state == NodeScheduleState::Scheduled);
-          node_state.schedule_state = NodeScheduleState::Running;
+          const NodeScheduleState old_state = node_state.schedule_state.exchange(
+              NodeScheduleState::Running);
+          BLI_assert(old_state == NodeScheduleState::Scheduled);
+          UNUSED_VARS_NDEBUG(old_state);
 
           if (node_state.node_has_finished) {
             return;
@@ -883,7 +1071,14 @@ class Executor {
       /* Importantly, the node must not be locked when it is executed. That would result in locks
        * being hold very long in some cases and results in multiple locks being hold by the same
        * thread in the same graph which can lead to deadlocks. */
-      this->execute_node(node, node_state, current_task, local_data);
+      if (gather_scheduling_stats_) {
+        const timeit::TimePoint execute_start = timeit::Clock::now();
+        this->execute_node(node, node_state, current_task, local_data);
+        execute_time = timeit::Clock::now() - execute_start;
+      }
+      else {
+        this->execute_node(node, node_state, current_task, local_data);
+      }
     }
 
     this->with_locked_node(
@@ -894,13 +1089,50 @@ class Executor {
           }
 #endif
           this->finish_node_if_possible(locked_node);
-          const bool reschedule_requested = node_state.schedule_state ==
+          const bool reschedule_requested = node_state.schedule_state.exchange(
+                                                NodeScheduleState::NotScheduled) ==
                                             NodeScheduleState::RunningAndRescheduled;
-          node_state.schedule_state = NodeScheduleState::NotScheduled;
           if (reschedule_requested && !node_state.node_has_finished) {
             this->schedule_node(locked_node, current_task, false);
           }
         });
+
+    if (gather_scheduling_stats_) {
+      this->log_node_scheduling(node,
+                                node_state,
+                                run_start,
+                                node_needs_execution,
+                                execute_time,
+                                was_stolen,
+                                local_data);
+    }
+  }
+
+  void log_node_scheduling(const FunctionNode &node,
+                           const NodeState &node_state,
+                           const timeit::TimePoint run_start,
+                           const bool node_was_executed,
+                           const timeit::Nanoseconds execute_time,
+                           const bool was_stolen,
+                           const LocalData &local_data)
+  {
+    const timeit::TimePoint run_end = timeit::Clock::now();
+    GraphExecutorNodeSchedulingInfo info;
+    info.wait_time = run_start - node_state.schedule_time;
+    info.execute_time = execute_time;
+    info.overhead_time = (run_end - run_start) - execute_time;
+    info.was_stolen = was_stolen;
+
+    SchedulingCounters &counters = scheduling_counters_;
+    SchedulingCounters::add(counters.node_runs, 1);
+    SchedulingCounters::add(counters.node_executions, node_was_executed ? 1 : 0);
+    SchedulingCounters::add(counters.wait_ns, info.wait_time.count());
+    SchedulingCounters::add(counters.overhead_ns, info.overhead_time.count());
+    SchedulingCounters::add(counters.execute_ns, info.execute_time.count());
+
+    const Context local_context{
+        context_->storage, context_->user_data, local_data.local_user_data};
+    self_.logger_->log_node_scheduling(node, info, local_context);
   }
 
   void assert_expected_outputs_have_been_computed(LockedNode &locked_node,
@@ -1170,6 +1402,12 @@ class Executor {
     return task_pool_.load() != nullptr;
   }
 
+  bool use_work_stealing() const
+  {
+    return self_.scheduling_ == GraphExecutorScheduling::WorkStealing &&
+           this->use_multi_threading();
+  }
+
   bool try_enable_multi_threading()
   {
 #ifndef WITH_TBB
@@ -1197,6 +1435,12 @@ class Executor {
       return false;
     }
     this->ensure_thread_locals();
+    if (self_.scheduling_ == GraphExecutorScheduling::WorkStealing) {
+      /* Has to be initialized before the task pool is set, because other threads may start using
+       * the queues as soon as multi-threading is enabled. */
+      max_workers_ = BLI_system_thread_count();
+      worker_queues_.reinitialize(max_workers_ + 1);
+    }
     task_pool_.store(BLI_task_pool_create(this, TASK_PRIORITY_HIGH));
     return true;
   }
@@ -1246,6 +1490,181 @@ class Executor {
         [](TaskPool * /*pool*/, void *data) { MEM_delete(static_cast<ScheduledNodes *>(data)); });
   }
 
+  /**
+   * Share scheduled nodes of the current thread with other threads when they may run out of work.
+   * Enables multi-threading when enough nodes are scheduled.
+   */
+  void share_scheduled_nodes_if_useful(CurrentTask &current_task)
+  {
+    if (!this->use_multi_threading()) {
+      if (work_stealing_unavailable_) {
+        return;
+      }
+      if (current_task.scheduled_nodes.size() < min_scheduled_nodes_for_work_stealing) {
+        return;
+      }
+      if (!this->try_enable_multi_threading()) {
+        work_stealing_unavailable_ = true;
+        return;
+      }
+    }
+    /* Only share nodes when there are not enough nodes for the other threads already. */
+    if (stealable_nodes_num_.load(std::memory_order_relaxed) >= max_workers_) {
+      return;
+    }
+    this->publish_scheduled_nodes(current_task, true);
+  }
+
+  /**
+   * Move scheduled nodes of the current thread to its #WorkerQueue, where they can be stolen by
+   * other threads. Makes sure that there is a task that will take them.
+   */
+  void publish_scheduled_nodes(CurrentTask &current_task, const bool keep_newest)
+  {
+    BLI_assert(this->use_work_stealing());
+    Vector<const FunctionNode *> nodes;
+    {
+      std::lock_guard lock{current_task.mutex};
+      current_task.scheduled_nodes.extract_oldest(nodes, keep_newest);
+      if (current_task.scheduled_nodes.is_empty()) {
+        current_task.has_scheduled_nodes.store(false, std::memory_order_relaxed);
+      }
+    }
+    if (nodes.is_empty()) {
+      return;
+    }
+    WorkerQueue &queue = worker_queues_[this->get_worker_index()];
+    {
+      std::lock_guard lock{queue.mutex};
+      queue.nodes.extend(nodes);
+      queue.size.store(queue.nodes.size() - queue.front, std::memory_order_relaxed);
+      stealable_nodes_num_.fetch_add(nodes.size());
+    }
+    if (gather_scheduling_stats_) {
+      SchedulingCounters::add(scheduling_counters_.publishes, 1);
+    }
+    /* A worker that stops decrements #active_workers_ before checking #stealable_nodes_num_. Since
+     * the nodes have been added before #active_workers_ is checked here, either that worker sees
+     * the new nodes or a new worker is started. */
+    if (active_workers_.load() < max_workers_) {
+      this->start_worker();
+    }
+  }
+
+  void start_worker()
+  {
+    active_workers_.fetch_add(1);
+    BLI_task_pool_push(
+        task_pool_.load(),
+        [](TaskPool *pool, void * /*data*/) {
+          Executor &executor = *static_cast<Executor *>(BLI_task_pool_user_data(pool));
+          executor.run_worker();
+        },
+        nullptr,
+        false,
+        nullptr);
+  }
+
+  void run_worker()
+  {
+    const LocalData local_data = this->get_local_data();
+    CurrentTask current_task;
+    while (true) {
+      this->run_task(current_task, local_data);
+      active_workers_.fetch_sub(1);
+      if (stealable_nodes_num_.load() == 0) {
+        return;
+      }
+      /* Nodes have been published concurrently, keep working. */
+      active_workers_.fetch_add(1);
+    }
+  }
+
+  /**
+   * Move nodes from the worker queues to the scheduled nodes of the current thread. The own queue
+   * of the thread is checked first, because those nodes are most likely to still be in cache.
+   * Otherwise, half of the nodes of another queue are stolen.
+   * \return False if no node was found.
+   */
+  bool take_stealable_nodes(CurrentTask &current_task)
+  {
+    if (stealable_nodes_num_.load() == 0) {
+      return false;
+    }
+    const int own_index = this->get_worker_index();
+    {
+      WorkerQueue &queue = worker_queues_[own_index];
+      std::lock_guard lock{queue.mutex};
+      if (queue.front < queue.nodes.size()) {
+        const FunctionNode *node = queue.nodes.pop_last();
+        this->update_worker_queue_size(queue);
+        stealable_nodes_num_.fetch_sub(1);
+        this->schedule_taken_nodes({node}, current_task, false);
+        return true;
+      }
+    }
+    if (gather_scheduling_stats_) {
+      SchedulingCounters::add(scheduling_counters_.steal_attempts, 1);
+    }
+    const int queues_num = worker_queues_.size();
+    for (const int i : IndexRange(1, queues_num - 1)) {
+      WorkerQueue &queue = worker_queues_[(own_index + i) % queues_num];
+      if (queue.size.load(std::memory_order_relaxed) == 0) {
+        continue;
+      }
+      std::lock_guard lock{queue.mutex};
+      const int64_t available = queue.nodes.size() - queue.front;
+      if (available == 0) {
+        continue;
+      }
+      const int64_t steal_num = (available + 1) / 2;
+      const Span<const FunctionNode *> stolen_nodes = queue.nodes.as_span().slice(queue.front,
+                                                                                  steal_num);
+      this->schedule_taken_nodes(stolen_nodes, current_task, true);
+      queue.front += steal_num;
+      this->update_worker_queue_size(queue);
+      stealable_nodes_num_.fetch_sub(steal_num);
+      if (gather_scheduling_stats_) {
+        SchedulingCounters::add(scheduling_counters_.steals, 1);
+        SchedulingCounters::add(scheduling_counters_.stolen_nodes, steal_num);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void schedule_taken_nodes(const Span<const FunctionNode *> nodes,
+                            CurrentTask &current_task,
+                            const bool were_stolen)
+  {
+    std::lock_guard lock{current_task.mutex};
+    for (const FunctionNode *node : nodes) {
+      NodeState &node_state = *node_states_[node->index_in_graph()];
+      BLI_assert(node_state.schedule_state == NodeScheduleState::Scheduled);
+      node_state.was_stolen = were_stolen;
+      current_task.scheduled_nodes.schedule(*node, false);
+    }
+    current_task.has_scheduled_nodes.store(true, std::memory_order_relaxed);
+  }
+
+  static void update_worker_queue_size(WorkerQueue &queue)
+  {
+    if (queue.front == queue.nodes.size()) {
+      queue.nodes.clear();
+      queue.front = 0;
+    }
+    queue.size.store(queue.nodes.size() - queue.front, std::memory_order_relaxed);
+  }
+
+  int get_worker_index()
+  {
+    ThreadLocalStorage &local_storage = thread_locals_->local();
+    if (local_storage.worker_index == -1) {
+      local_storage.worker_index = next_worker_index_.fetch_add(1) % worker_queues_.size();
+    }
+    return local_storage.worker_index;
+  }
+
   LocalData get_local_data()
   {
     if (!this->use_multi_threading()) {
@@ -1253,7 +1672,12 @@ class Executor {
     }
     ThreadLocalStorage &local_storage = thread_locals_->local();
     if (!local_storage.local_user_data.has_value()) {
-      local_storage.local_user_data = context_->user_data->get_local(local_storage.allocator);
+      if (context_->user_data == nullptr) {
+        local_storage.local_user_data.emplace(nullptr);
+      }
+      else {
+        local_storage.local_user_data = context_->user_data->get_local(local_storage.allocator);
+      }
     }
     return {&local_storage.allocator, local_storage.local_user_data->get()};
   }
@@ -1397,7 +1821,12 @@ inline void Executor::execute_node(const FunctionNode &node,
     if (!this->try_enable_multi_threading()) {
       return;
     }
-    this->move_scheduled_nodes_to_task_pool(current_task);
+    if (self_.scheduling_ == GraphExecutorScheduling::WorkStealing) {
+      this->publish_scheduled_nodes(current_task, false);
+    }
+    else {
+      this->move_scheduled_nodes_to_task_pool(current_task);
+    }
   };
 
   lazy_threading::HintReceiver blocking_hint_receiver{blocking_hint_fn};
@@ -1412,12 +1841,14 @@ GraphExecutor::GraphExecutor(const Graph &graph,
                              const Span<const OutputSocket *> graph_inputs,
                              const Span<const InputSocket *> graph_outputs,
                              const Logger *logger,
-                             const SideEffectProvider *side_effect_provider)
+                             const SideEffectProvider *side_effect_provider,
+                             const Scheduling scheduling)
     : graph_(graph),
       graph_inputs_(graph_inputs),
       graph_outputs_(graph_outputs),
       logger_(logger),
-      side_effect_provider_(side_effect_provider)
+      side_effect_provider_(side_effect_provider),
+      scheduling_(scheduling)
 {
   /* The graph executor can handle partial execution when there are still missing inputs. */
   allow_missing_requested_inputs_ = true;
@@ -1470,6 +1901,24 @@ void GraphExecutorLogger::log_after_node_execute(const FunctionNode &node,
   UNUSED_VARS(node, params, context);
 }
 
+bool GraphExecutorLogger::use_scheduling_stats() const
+{
+  return false;
+}
+
+void GraphExecutorLogger::log_node_scheduling(const FunctionNode &node,
+                                              const GraphExecutorNodeSchedulingInfo &info,
+                                              const Context &context) const
+{
+  UNUSED_VARS(node, info, context);
+}
+
+void GraphExecutorLogger::log_scheduling_stats(const GraphExecutorSchedulingStats &stats,
+                                               const Context &context) const
+{
+  UNUSED_VARS(stats, context);
+}
+
 Vector<const FunctionNode *> GraphExecutorSideEffectProvider::get_nodes_with_side_effects(
     const Context &context) const
 {
@@ -2,11 +2,205 @@
 
 #include "FN_multi_function_procedure_executor.hh"
 
+#include "BLI_map.hh"
 #include "BLI_stack.hh"
 
 namespace blender::fn::multi_function {
 
-ProcedureExecutor::ProcedureExecutor(const Procedure &procedure) : procedure_(procedure)
+/**
+ * Number of indices that are processed by all instructions of a fused procedure before moving on
+ * to the next indices. The intermediate buffers of a typical procedure fit into the L1/L2 cache.
+ */
+static constexpr int64_t fused_chunk_size = 1024;
+
+/**
+ * A straight-line version of a procedure. Every variable assignment gets its own value. Values
+ * that are not parameters of the procedure are stored in chunk-sized slots that are reused once
+ * the value has been destructed.
+ */
+struct FusedProcedureKernel {
+  struct Value {
+    const CPPType *type;
+    /** Index of the procedure parameter this value is bound to, or -1 for intermediate values. */
+    int param_index = -1;
+    bool is_input_param = false;
+    /** True for output parameters that are destructed and assigned again. */
+    bool is_reassigned = false;
+    int slot = -1;
+  };
+
+  struct Step {
+    /** Null for destruct steps. */
+    const CallInstruction *call = nullptr;
+    /** Value for every parameter of the called function, -1 for ignored outputs. */
+    Vector<int> values;
+    /** Value destructed by a destruct step. */
+    int destruct_value = -1;
+  };
+
+  Vector<Value> values;
+  Vector<const CPPType *> slot_types;
+  Vector<Step> steps;
+
+  static std::unique_ptr<FusedProcedureKernel> compile(const Procedure &procedure);
+};
+
+std::unique_ptr<FusedProcedureKernel> FusedProcedureKernel::compile(const Procedure &procedure)
+{
+  auto kernel = std::make_unique<FusedProcedureKernel>();
+  Map<const Variable *, int> value_by_variable;
+  Vector<bool> is_defined;
+  Vector<bool> is_destructed;
+  Map<const CPPType *, Vector<int>> free_slots;
+
+  auto add_value = [&](const Variable &variable, const int param_index, const bool is_input) {
+    const int value_index = kernel->values.append_and_get_index(
+        {&variable.data_type().single_type(), param_index, is_input});
+    is_defined.append(is_input);
+    is_destructed.append(false);
+    value_by_variable.add_overwrite(&variable, value_index);
+    return value_index;
+  };
+
+  for (const int param_index : procedure.params().index_range()) {
+    const ConstParameter &param = procedure.params()[param_index];
+    if (param.type == ParamType::Mutable || !param.variable->data_type().is_single()) {
+      return {};
+    }
+    if (value_by_variable.contains(param.variable)) {
+      return {};
+    }
+    add_value(*param.variable, param_index, param.type == ParamType::Input);
+  }
+
+  const Instruction *instruction = procedure.entry();
+  while (instruction != nullptr && instruction->type() != InstructionType::Return) {
+    switch (instruction->type()) {
+      case InstructionType::Call: {
+        const CallInstruction &call = *static_cast<const CallInstruction *>(instruction);
+        const MultiFunction &fn = call.fn();
+        Step step;
+        step.call = &call;
+        for (const int param_index : fn.param_indices()) {
+          const ParamType param_type = fn.param_type(param_index);
+          const Variable *variable = call.params()[param_index];
+          if (param_type.category() != ParamCategory::SingleInput &&
+              param_type.category() != ParamCategory::SingleMutable &&
+              param_type.category() != ParamCategory::SingleOutput)
+          {
+            return {};
+          }
+          if (variable == nullptr) {
+            if (param_type.interface_type() != ParamType::Output) {
+              return {};
+            }
+            step.values.append(-1);
+            continue;
+          }
+          const int *existing_value = value_by_variable.lookup_ptr(variable);
+          if (param_type.interface_type() == ParamType::Output) {
+            if (existing_value == nullptr || is_destructed[*existing_value]) {
+              const int value_index = add_value(*variable, -1, false);
+              Value &value = kernel->values[value_index];
+              Vector<int> &slots = free_slots.lookup_or_add_default(value.type);
+              if (slots.is_empty()) {
+                value.slot = kernel->slot_types.append_and_get_index(value.type);
+              }
+              else {
+                value.slot = slots.pop_last();
+              }
+              is_defined[value_index] = true;
+              step.values.append(value_index);
+            }
+            else if (kernel->values[*existing_value].param_index != -1 &&
+                     !is_defined[*existing_value])
+            {
+              is_defined[*existing_value] = true;
+              step.values.append(*existing_value);
+            }
+            else {
+              return {};
+            }
+            continue;
+          }
+          if (existing_value == nullptr || !is_defined[*existing_value] ||
+              is_destructed[*existing_value])
+          {
+            return {};
+          }
+          if (param_type.interface_type() == ParamType::Mutable &&
+              kernel->values[*existing_value].is_input_param)
+          {
+            return {};
+          }
+          step.values.append(*existing_value);
+        }
+        kernel->steps.append(std::move(step));
+        instruction = call.next();
+        break;
+      }
+      case InstructionType::Destruct: {
+        const DestructInstruction &destruct = *static_cast<const DestructInstruction *>(
+            instruction);
+        const int *value_index = value_by_variable.lookup_ptr(destruct.variable());
+        if (value_index == nullptr || !is_defined[*value_index] || is_destructed[*value_index]) {
+          return {};
+        }
+        const Value &value = kernel->values[*value_index];
+        if (value.is_input_param) {
+          /* Inputs are owned by the caller. */
+          is_destructed[*value_index] = true;
+        }
+        else {
+          Step step;
+          step.destruct_value = *value_index;
+          kernel->steps.append(std::move(step));
+          if (value.param_index == -1) {
+            free_slots.lookup(value.type).append(value.slot);
+            is_destructed[*value_index] = true;
+          }
+          else {
+            /* Outputs may be assigned again later on. */
+            kernel->values[*value_index].is_reassigned = true;
+            is_defined[*value_index] = false;
+          }
+        }
+        instruction = destruct.next();
+        break;
+      }
+      case InstructionType::Dummy: {
+        instruction = static_cast<const DummyInstruction *>(instruction)->next();
+        break;
+      }
+      case InstructionType::Branch:
+      case InstructionType::Return: {
+        /* Branches require masking individual indices, leave that to the interpreter. */
+        return {};
+      }
+    }
+  }
+  if (instruction == nullptr) {
+    return {};
+  }
+
+  for (const int value_index : kernel->values.index_range()) {
+    const Value &value = kernel->values[value_index];
+    if (value.param_index != -1) {
+      if (!is_defined[value_index]) {
+        return {};
+      }
+    }
+    else if (!is_destructed[value_index]) {
+      Step step;
+      step.destruct_value = value_index;
+      kernel->steps.append(std::move(step));
+    }
+  }
+  return kernel;
+}
+
+ProcedureExecutor::ProcedureExecutor(const Procedure &procedure, const bool allow_fusing)
+    : procedure_(procedure)
 {
   SignatureBuilder builder("Procedure Executor", signature_);
 
@@ -15,6 +209,17 @@ ProcedureExecutor::ProcedureExecutor(const Procedure &procedure) : procedure_(pr
   }
 
   this->set_signature(&signature_);
+
+  if (allow_fusing) {
+    fused_kernel_ = FusedProcedureKernel::compile(procedure);
+  }
+}
+
+ProcedureExecutor::~ProcedureExecutor() = default;
+
+bool ProcedureExecutor::is_fused() const
+{
+  return bool(fused_kernel_);
 }
 
 using IndicesSplitVectors = std::array<Vector<int64_t>, 2>;
@@ -1158,6 +1363,11 @@ void ProcedureExecutor::call(const IndexMask &full_mask, Params params, Context
 {
   BLI_assert(procedure_.validate());
 
+  if (fused_kernel_) {
+    this->call_fused(full_mask, params, context);
+    return;
+  }
+
   AlignedBuffer<512, 64> local_buffer;
   LinearAllocator<> linear_allocator;
   linear_allocator.provide_buffer(local_buffer);
@@ -1238,6 +1448,270 @@ void ProcedureExecutor::call(const IndexMask &full_mask, Params params, Context
   }
 }
 
+/**
+ * Find the values that are the same for all indices, because they only depend on single-value
+ * inputs. The steps computing them only have to be executed once. Uniform outputs are filled in
+ * the end.
+ */
+static void find_uniform_fused_values(const FusedProcedureKernel &kernel,
+                                      Params params,
+                                      MutableSpan<bool> r_uniform_values,
+                                      MutableSpan<bool> r_uniform_steps)
+{
+  using Value = FusedProcedureKernel::Value;
+  for (const int value_index : kernel.values.index_range()) {
+    const Value &value = kernel.values[value_index];
+    if (value.is_input_param) {
+      r_uniform_values[value_index] = params.readonly_single_input(value.param_index).is_single();
+    }
+    else {
+      r_uniform_values[value_index] = !value.is_reassigned;
+    }
+  }
+
+  /* Values only ever become non-uniform, so this terminates. Usually one iteration is enough,
+   * more are only necessary when a varying value is written into a mutable parameter. */
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (const int step_index : kernel.steps.index_range()) {
+      const FusedProcedureKernel::Step &step = kernel.steps[step_index];
+      if (step.call == nullptr) {
+        r_uniform_steps[step_index] = r_uniform_values[step.destruct_value];
+        continue;
+      }
+      bool is_uniform = true;
+      for (const int value_index : step.values) {
+        if (value_index != -1 && !r_uniform_values[value_index]) {
+          is_uniform = false;
+          break;
+        }
+      }
+      r_uniform_steps[step_index] = is_uniform;
+      if (is_uniform) {
+        continue;
+      }
+      const MultiFunction &fn = step.call->fn();
+      for (const int param_index : fn.param_indices()) {
+        const int value_index = step.values[param_index];
+        if (value_index != -1 && fn.param_type(param_index).interface_type() != ParamType::Input &&
+            r_uniform_values[value_index])
+        {
+          r_uniform_values[value_index] = false;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Call the function of a fused step for `size` indices. Uniform values are passed as single
+ * values, all other values are read from and written to the chunk buffers.
+ */
+static void execute_fused_call(const FusedProcedureKernel &kernel,
+                               const FusedProcedureKernel::Step &step,
+                               const int64_t size,
+                               const Span<bool> uniform_values,
+                               const Span<void *> uniform_buffers,
+                               const Span<void *> chunk_buffers,
+                               const Span<GVArray> chunk_inputs,
+                               const Context &context)
+{
+  const MultiFunction &fn = step.call->fn();
+  const IndexMask mask(size);
+  ParamsBuilder params(fn, &mask);
+  for (const int param_index : fn.param_indices()) {
+    const int value_index = step.values[param_index];
+    if (value_index == -1) {
+      params.add_ignored_single_output();
+      continue;
+    }
+    const CPPType &type = *kernel.values[value_index].type;
+    const bool is_uniform = uniform_values[value_index];
+    switch (fn.param_type(param_index).interface_type()) {
+      case ParamType::Input: {
+        if (is_uniform) {
+          params.add_readonly_single_input(
+              GVArray::ForSingleRef(type, size, uniform_buffers[value_index]));
+        }
+        else if (chunk_inputs[value_index]) {
+          params.add_readonly_single_input(chunk_inputs[value_index]);
+        }
+        else {
+          params.add_readonly_single_input(
+              GVArray::ForSpan(GSpan(type, chunk_buffers[value_index], size)));
+        }
+        break;
+      }
+      case ParamType::Mutable: {
+        void *buffer = is_uniform ? uniform_buffers[value_index] : chunk_buffers[value_index];
+        params.add_single_mutable(GMutableSpan(type, buffer, size));
+        break;
+      }
+      case ParamType::Output: {
+        void *buffer = is_uniform ? uniform_buffers[value_index] : chunk_buffers[value_index];
+        params.add_uninitialized_single_output(GMutableSpan(type, buffer, size));
+        break;
+      }
+    }
+  }
+
+  fn.call(mask, params, context);
+}
+
+/**
+ * Instead of executing every instruction on the full mask, all instructions are executed on a
+ * small chunk of indices before continuing with the next chunk. Intermediate values only need
+ * buffers for a single chunk, which are reused for all chunks and stay in the CPU cache.
+ */
+void ProcedureExecutor::call_fused(const IndexMask &full_mask,
+                                   Params params,
+                                   Context context) const
+{
+  const FusedProcedureKernel &kernel = *fused_kernel_;
+  const int values_num = kernel.values.size();
+  const int steps_num = kernel.steps.size();
+
+  AlignedBuffer<512, 64> local_buffer;
+  LinearAllocator<> allocator;
+  allocator.provide_buffer(local_buffer);
+
+  Array<bool, 16> uniform_values(values_num);
+  Array<bool, 32> uniform_steps(steps_num);
+  find_uniform_fused_values(kernel, params, uniform_values, uniform_steps);
+
+  /* Compute uniform values once. Their destruction is delayed until all chunks are done. */
+  Array<void *, 16> uniform_buffers(values_num, nullptr);
+  for (const int value_index : IndexRange(values_num)) {
+    if (!uniform_values[value_index]) {
+      continue;
+    }
+    const FusedProcedureKernel::Value &value = kernel.values[value_index];
+    uniform_buffers[value_index] = allocator.allocate(value.type->size(),
+                                                      value.type->alignment());
+    if (value.is_input_param) {
+      params.readonly_single_input(value.param_index)
+          .get_internal_single_to_uninitialized(uniform_buffers[value_index]);
+    }
+  }
+  for (const int step_index : IndexRange(steps_num)) {
+    const FusedProcedureKernel::Step &step = kernel.steps[step_index];
+    if (uniform_steps[step_index] && step.call != nullptr) {
+      execute_fused_call(kernel, step, 1, uniform_values, uniform_buffers, {}, {}, context);
+    }
+  }
+
+  const int64_t chunk_size = std::min(full_mask.size(), fused_chunk_size);
+  Array<void *, 16> slot_buffers(kernel.slot_types.size());
+  for (const int slot : kernel.slot_types.index_range()) {
+    const CPPType &type = *kernel.slot_types[slot];
+    slot_buffers[slot] = allocator.allocate(type.size() * chunk_size, type.alignment());
+  }
+  /* Parameters use separate buffers when the indices in a chunk are not contiguous. */
+  Array<void *, 16> param_buffers(values_num, nullptr);
+
+  Array<void *, 16> chunk_buffers(values_num, nullptr);
+  Array<GVArray, 16> chunk_inputs(values_num);
+
+  for (int64_t chunk_start = 0; chunk_start < full_mask.size(); chunk_start += chunk_size) {
+    const IndexMask sub_mask = full_mask.slice(
+        chunk_start, std::min(chunk_size, full_mask.size() - chunk_start));
+    const int64_t size = sub_mask.size();
+    const std::optional<IndexRange> range = sub_mask.to_range();
+
+    for (const int value_index : IndexRange(values_num)) {
+      if (uniform_values[value_index]) {
+        continue;
+      }
+      const FusedProcedureKernel::Value &value = kernel.values[value_index];
+      const CPPType &type = *value.type;
+      if (value.param_index == -1) {
+        chunk_buffers[value_index] = slot_buffers[value.slot];
+        continue;
+      }
+      if (range.has_value()) {
+        if (value.is_input_param) {
+          chunk_inputs[value_index] = params.readonly_single_input(value.param_index)
+                                          .slice(*range);
+        }
+        else {
+          chunk_buffers[value_index] = params.uninitialized_single_output(value.param_index)
+                                           .slice(*range)
+                                           .data();
+        }
+        continue;
+      }
+      if (param_buffers[value_index] == nullptr) {
+        param_buffers[value_index] = allocator.allocate(type.size() * chunk_size,
+                                                        type.alignment());
+      }
+      chunk_buffers[value_index] = param_buffers[value_index];
+      if (value.is_input_param) {
+        params.readonly_single_input(value.param_index)
+            .materialize_compressed_to_uninitialized(sub_mask, chunk_buffers[value_index]);
+        chunk_inputs[value_index] = GVArray::ForSpan(
+            GSpan(type, chunk_buffers[value_index], size));
+      }
+    }
+
+    for (const int step_index : IndexRange(steps_num)) {
+      if (uniform_steps[step_index]) {
+        continue;
+      }
+      const FusedProcedureKernel::Step &step = kernel.steps[step_index];
+      if (step.call == nullptr) {
+        kernel.values[step.destruct_value].type->destruct_n(chunk_buffers[step.destruct_value],
+                                                             size);
+        continue;
+      }
+      execute_fused_call(kernel,
+                         step,
+                         size,
+                         uniform_values,
+                         uniform_buffers,
+                         chunk_buffers,
+                         chunk_inputs,
+                         context);
+    }
+
+    if (range.has_value()) {
+      continue;
+    }
+    /* Move the outputs to the indices of the chunk and free the gathered inputs. */
+    for (const int value_index : IndexRange(values_num)) {
+      const FusedProcedureKernel::Value &value = kernel.values[value_index];
+      if (value.param_index == -1 || uniform_values[value_index]) {
+        continue;
+      }
+      const CPPType &type = *value.type;
+      void *buffer = chunk_buffers[value_index];
+      if (!value.is_input_param) {
+        void *dst = params.uninitialized_single_output(value.param_index).data();
+        sub_mask.foreach_index([&](const int64_t i, const int64_t pos) {
+          type.move_construct(POINTER_OFFSET(buffer, type.size() * pos),
+                              POINTER_OFFSET(dst, type.size() * i));
+        });
+      }
+      type.destruct_n(buffer, size);
+    }
+  }
+
+  for (const int value_index : IndexRange(values_num)) {
+    if (!uniform_values[value_index]) {
+      continue;
+    }
+    const FusedProcedureKernel::Value &value = kernel.values[value_index];
+    if (value.param_index != -1 && !value.is_input_param) {
+      value.type->fill_construct_indices(
+          uniform_buffers[value_index],
+          params.uninitialized_single_output(value.param_index).data(),
+          full_mask);
+    }
+    value.type->destruct(uniform_buffers[value_index]);
+  }
+}
+
 MultiFunction::ExecutionHints ProcedureExecutor::get_execution_hints() const
 {
   ExecutionHints hints;
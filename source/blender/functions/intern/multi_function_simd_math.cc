@@ -0,0 +1,273 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "BLI_math_vector_types.hh"
+#include "BLI_simd.h"
+
+#include "FN_multi_function_simd_math.hh"
+
+namespace blender::fn::multi_function {
+
+SIMDMathFunction::SIMDMathFunction(const SIMDMathOperation operation,
+                                   const MultiFunction &fallback_fn)
+    : operation_(operation), fallback_fn_(fallback_fn)
+{
+  this->set_signature(&fallback_fn.signature());
+
+  const CPPType &type = this->param_type(0).data_type().single_type();
+  BLI_assert(this->param_amount() == 3);
+  BLI_assert(this->param_type(1).data_type().single_type() == type);
+  BLI_assert(this->param_type(2).data_type().single_type() == type);
+  BLI_assert(type.is<float>() || type.is<float3>());
+  components_num_ = type.is<float3>() ? 3 : 1;
+  BLI_assert(components_num_ == 1 ||
+             !ELEM(operation, SIMDMathOperation::Minimum, SIMDMathOperation::Maximum));
+}
+
+namespace simd_math {
+
+/**
+ * An input that is either a span or a single value. The components of a single value are
+ * repeated so that component `i % 3` can be used for every flat float index `i`.
+ */
+struct FloatInput {
+  const float *span = nullptr;
+  float single[3];
+};
+
+struct AddOp {
+  static float scalar(const float a, const float b)
+  {
+    return a + b;
+  }
+#ifdef BLI_HAVE_SSE2
+  static __m128 simd(const __m128 a, const __m128 b)
+  {
+    return _mm_add_ps(a, b);
+  }
+#endif
+};
+
+struct SubtractOp {
+  static float scalar(const float a, const float b)
+  {
+    return a - b;
+  }
+#ifdef BLI_HAVE_SSE2
+  static __m128 simd(const __m128 a, const __m128 b)
+  {
+    return _mm_sub_ps(a, b);
+  }
+#endif
+};
+
+struct MultiplyOp {
+  static float scalar(const float a, const float b)
+  {
+    return a * b;
+  }
+#ifdef BLI_HAVE_SSE2
+  static __m128 simd(const __m128 a, const __m128 b)
+  {
+    return _mm_mul_ps(a, b);
+  }
+#endif
+};
+
+struct SafeDivideOp {
+  static float scalar(const float a, const float b)
+  {
+    return (b != 0.0f) ? a / b : 0.0f;
+  }
+#ifdef BLI_HAVE_SSE2
+  static __m128 simd(const __m128 a, const __m128 b)
+  {
+    /* Lanes that divide by zero are masked out. */
+    return _mm_and_ps(_mm_div_ps(a, b), _mm_cmpneq_ps(b, _mm_setzero_ps()));
+  }
+#endif
+};
+
+struct MinimumOp {
+  static float scalar(const float a, const float b)
+  {
+    return std::min(a, b);
+  }
+#ifdef BLI_HAVE_SSE2
+  static __m128 simd(const __m128 a, const __m128 b)
+  {
+    /* The order of the arguments matches `std::min` for NaN and signed zero. */
+    return _mm_min_ps(b, a);
+  }
+#endif
+};
+
+struct MaximumOp {
+  static float scalar(const float a, const float b)
+  {
+    return std::max(a, b);
+  }
+#ifdef BLI_HAVE_SSE2
+  static __m128 simd(const __m128 a, const __m128 b)
+  {
+    return _mm_max_ps(b, a);
+  }
+#endif
+};
+
+#ifdef BLI_HAVE_SSE2
+/**
+ * Three registers that contain the repeated components of a single value. Because 3 and 4 are
+ * coprime, the pattern repeats every 12 floats.
+ */
+static void load_single_pattern(const FloatInput &input, __m128 r_pattern[3])
+{
+  const float *s = input.single;
+  r_pattern[0] = _mm_setr_ps(s[0], s[1], s[2], s[0]);
+  r_pattern[1] = _mm_setr_ps(s[1], s[2], s[0], s[1]);
+  r_pattern[2] = _mm_setr_ps(s[2], s[0], s[1], s[2]);
+}
+#endif
+
+/**
+ * Compute `size` contiguous floats. The start has to be at the beginning of an element, so that
+ * single values can use the same component pattern.
+ */
+template<typename Op, bool ASingle, bool BSingle>
+static void compute_contiguous(const FloatInput &a,
+                               const FloatInput &b,
+                               const int64_t start,
+                               const int64_t size,
+                               float *__restrict dst)
+{
+  const float *__restrict a_span = ASingle ? nullptr : a.span + start;
+  const float *__restrict b_span = BSingle ? nullptr : b.span + start;
+  dst += start;
+
+  int64_t i = 0;
+#ifdef BLI_HAVE_SSE2
+  __m128 a_pattern[3];
+  __m128 b_pattern[3];
+  if constexpr (ASingle) {
+    load_single_pattern(a, a_pattern);
+  }
+  if constexpr (BSingle) {
+    load_single_pattern(b, b_pattern);
+  }
+  for (; i + 12 <= size; i += 12) {
+    for (int j = 0; j < 3; j++) {
+      const __m128 a_value = ASingle ? a_pattern[j] : _mm_loadu_ps(a_span + i + j * 4);
+      const __m128 b_value = BSingle ? b_pattern[j] : _mm_loadu_ps(b_span + i + j * 4);
+      _mm_storeu_ps(dst + i + j * 4, Op::simd(a_value, b_value));
+    }
+  }
+#endif
+  for (; i < size; i++) {
+    const float a_value = ASingle ? a.single[i % 3] : a_span[i];
+    const float b_value = BSingle ? b.single[i % 3] : b_span[i];
+    dst[i] = Op::scalar(a_value, b_value);
+  }
+}
+
+template<typename Op, bool ASingle, bool BSingle>
+static void compute(const IndexMask &mask,
+                    const FloatInput &a,
+                    const FloatInput &b,
+                    const int components_num,
+                    float *dst)
+{
+  mask.foreach_segment_optimized([&](const auto segment) {
+    if constexpr (std::is_same_v<std::decay_t<decltype(segment)>, IndexRange>) {
+      compute_contiguous<Op, ASingle, BSingle>(
+          a, b, segment.start() * components_num, segment.size() * components_num, dst);
+    }
+    else {
+      for (const int64_t index : segment) {
+        for (int component = 0; component < components_num; component++) {
+          const int64_t i = index * components_num + component;
+          const float a_value = ASingle ? a.single[component] : a.span[i];
+          const float b_value = BSingle ? b.single[component] : b.span[i];
+          dst[i] = Op::scalar(a_value, b_value);
+        }
+      }
+    }
+  });
+}
+
+template<typename Op>
+static void compute(const IndexMask &mask,
+                    const FloatInput &a,
+                    const FloatInput &b,
+                    const int components_num,
+                    float *dst)
+{
+  const bool a_single = a.span == nullptr;
+  const bool b_single = b.span == nullptr;
+  if (a_single && b_single) {
+    compute<Op, true, true>(mask, a, b, components_num, dst);
+  }
+  else if (a_single) {
+    compute<Op, true, false>(mask, a, b, components_num, dst);
+  }
+  else if (b_single) {
+    compute<Op, false, true>(mask, a, b, components_num, dst);
+  }
+  else {
+    compute<Op, false, false>(mask, a, b, components_num, dst);
+  }
+}
+
+static bool get_float_input(const GVArray &varray, const int components_num, FloatInput &r_input)
+{
+  if (varray.is_span()) {
+    r_input.span = static_cast<const float *>(varray.get_internal_span().data());
+    return true;
+  }
+  if (varray.is_single()) {
+    varray.get_internal_single(r_input.single);
+    for (int i = components_num; i < 3; i++) {
+      r_input.single[i] = r_input.single[0];
+    }
+    return true;
+  }
+  return false;
+}
+
+}  // namespace simd_math
+
+void SIMDMathFunction::call(const IndexMask &mask, Params params, Context context) const
+{
+  using namespace simd_math;
+
+  FloatInput a;
+  FloatInput b;
+  if (!get_float_input(params.readonly_single_input(0), components_num_, a) ||
+      !get_float_input(params.readonly_single_input(1), components_num_, b))
+  {
+    fallback_fn_.call(mask, params, context);
+    return;
+  }
+  float *dst = static_cast<float *>(params.uninitialized_single_output(2).data());
+
+  switch (operation_) {
+    case SIMDMathOperation::Add:
+      compute<AddOp>(mask, a, b, components_num_, dst);
+      break;
+    case SIMDMathOperation::Subtract:
+      compute<SubtractOp>(mask, a, b, components_num_, dst);
+      break;
+    case SIMDMathOperation::Multiply:
+      compute<MultiplyOp>(mask, a, b, components_num_, dst);
+      break;
+    case SIMDMathOperation::SafeDivide:
+      compute<SafeDivideOp>(mask, a, b, components_num_, dst);
+      break;
+    case SIMDMathOperation::Minimum:
+      compute<MinimumOp>(mask, a, b, components_num_, dst);
+      break;
+    case SIMDMathOperation::Maximum:
+      compute<MaximumOp>(mask, a, b, components_num_, dst);
+      break;
+  }
+}
+
+}  // namespace blender::fn::multi_function
@@ -178,4 +178,87 @@ TEST(lazy_function, GraphWithCycle)
   EXPECT_EQ(result, 10 * 2 * 5);
 }
 
+class SchedulingStatsLogger : public GraphExecutor::Logger {
+ public:
+  mutable std::atomic<int64_t> logged_node_runs = 0;
+  mutable GraphExecutorSchedulingStats stats;
+
+  bool use_scheduling_stats() const override
+  {
+    return true;
+  }
+
+  void log_node_scheduling(const FunctionNode & /*node*/,
+                           const GraphExecutorNodeSchedulingInfo & /*info*/,
+                           const Context & /*context*/) const override
+  {
+    logged_node_runs++;
+  }
+
+  void log_scheduling_stats(const GraphExecutorSchedulingStats &stats,
+                            const Context & /*context*/) const override
+  {
+    this->stats = stats;
+  }
+};
+
+TEST(lazy_function, WorkStealingScheduling)
+{
+  BLI_task_scheduler_init();
+  const AddLazyFunction add_fn;
+
+  Graph graph;
+  DummyNode &input_node = graph.add_dummy({}, {&CPPType::get<int>()});
+  DummyNode &output_node = graph.add_dummy({&CPPType::get<int>()}, {});
+
+  /* Many independent chains of nodes that are summed up at the end. */
+  const int chains_num = 32;
+  const int chain_length = 20;
+  const int value_1 = 1;
+  Vector<OutputSocket *> sockets_to_sum;
+  for (int chain = 0; chain < chains_num; chain++) {
+    OutputSocket *previous_socket = &input_node.output(0);
+    for (int i = 0; i < chain_length; i++) {
+      FunctionNode &node = graph.add_function(add_fn);
+      graph.add_link(*previous_socket, node.input(0));
+      node.input(1).set_default_value(&value_1);
+      previous_socket = &node.output(0);
+    }
+    sockets_to_sum.append(previous_socket);
+  }
+  while (sockets_to_sum.size() > 1) {
+    Vector<OutputSocket *> sums;
+    for (int i = 0; i < sockets_to_sum.size(); i += 2) {
+      FunctionNode &node = graph.add_function(add_fn);
+      graph.add_link(*sockets_to_sum[i], node.input(0));
+      graph.add_link(*sockets_to_sum[i + 1], node.input(1));
+      sums.append(&node.output(0));
+    }
+    sockets_to_sum = std::move(sums);
+  }
+  graph.add_link(*sockets_to_sum[0], output_node.input(0));
+  graph.update_node_indices();
+
+  for (const GraphExecutor::Scheduling scheduling :
+       {GraphExecutor::Scheduling::TaskPool, GraphExecutor::Scheduling::WorkStealing})
+  {
+    SchedulingStatsLogger logger;
+    GraphExecutor executor_fn{graph,
+                              {&input_node.output(0)},
+                              {&output_node.input(0)},
+                              &logger,
+                              nullptr,
+                              scheduling};
+    int result = 0;
+    execute_lazy_function_eagerly(
+        executor_fn, nullptr, nullptr, std::make_tuple(3), std::make_tuple(&result));
+
+    EXPECT_EQ(result, chains_num * (3 + chain_length));
+    EXPECT_EQ(logger.stats.node_runs, logger.logged_node_runs.load());
+    EXPECT_EQ(logger.stats.node_executions, graph.nodes().size() - 2);
+    EXPECT_GE(logger.stats.node_runs, logger.stats.node_executions);
+    EXPECT_LE(logger.stats.stolen_nodes, logger.stats.node_runs);
+  }
+}
+
 }  // namespace blender::fn::lazy_function::tests
@@ -421,4 +421,90 @@ TEST(multi_function_procedure, OutputBufferReplaced)
   EXPECT_EQ(output[2], output_value);
 }
 
+TEST(multi_function_procedure, FusedExecution)
+{
+  /**
+   * procedure(int a, int b, int *c, int *d) {
+   *   int e = b + b;
+   *   int f = a * b;
+   *   c = f + e;
+   *   c += 10;
+   *   d = f * e;
+   * }
+   */
+
+  auto add_fn = build::SI2_SO<int, int, int>("add", [](int a, int b) { return a + b; });
+  auto mul_fn = build::SI2_SO<int, int, int>("mul", [](int a, int b) { return a * b; });
+  auto add_10_fn = build::SM<int>("add_10", [](int &a) { a += 10; });
+
+  Procedure procedure;
+  ProcedureBuilder builder{procedure};
+
+  Variable *var_a = &builder.add_single_input_parameter<int>();
+  Variable *var_b = &builder.add_single_input_parameter<int>();
+  auto [var_e] = builder.add_call<1>(add_fn, {var_b, var_b});
+  auto [var_f] = builder.add_call<1>(mul_fn, {var_a, var_b});
+  builder.add_destruct({var_a, var_b});
+  auto [var_c] = builder.add_call<1>(add_fn, {var_f, var_e});
+  builder.add_call(add_10_fn, {var_c});
+  auto [var_d] = builder.add_call<1>(mul_fn, {var_f, var_e});
+  builder.add_destruct({var_e, var_f});
+  builder.add_return();
+  builder.add_output_parameter(*var_c);
+  builder.add_output_parameter(*var_d);
+
+  EXPECT_TRUE(procedure.validate());
+
+  ProcedureExecutor interpreted_fn{procedure};
+  ProcedureExecutor fused_fn{procedure, true};
+  EXPECT_FALSE(interpreted_fn.is_fused());
+  EXPECT_TRUE(fused_fn.is_fused());
+
+  const int size = 5000;
+  Array<int> a_values(size);
+  Array<int> b_values(size);
+  for (const int i : IndexRange(size)) {
+    a_values[i] = i;
+    b_values[i] = i % 7;
+  }
+
+  IndexMaskMemory memory;
+  const IndexMask full_mask(size);
+  const IndexMask sparse_mask = IndexMask::from_predicate(
+      full_mask, GrainSize(512), memory, [](const int64_t i) { return i % 3 != 1; });
+
+  for (const IndexMask &mask : {full_mask, sparse_mask}) {
+    for (const bool single_b : {false, true}) {
+      const GVArray b_varray = single_b ? VArray<int>::ForSingle(3, size) :
+                                          VArray<int>::ForSpan(b_values);
+      Array<int> expected_c(size, -1);
+      Array<int> expected_d(size, -1);
+      Array<int> c(size, -1);
+      Array<int> d(size, -1);
+      {
+        ParamsBuilder params{interpreted_fn, &mask};
+        params.add_readonly_single_input(a_values.as_span());
+        params.add_readonly_single_input(b_varray);
+        params.add_uninitialized_single_output(expected_c.as_mutable_span());
+        params.add_uninitialized_single_output(expected_d.as_mutable_span());
+        ContextBuilder context;
+        interpreted_fn.call(mask, params, context);
+      }
+      {
+        ParamsBuilder params{fused_fn, &mask};
+        params.add_readonly_single_input(a_values.as_span());
+        params.add_readonly_single_input(b_varray);
+        params.add_uninitialized_single_output(c.as_mutable_span());
+        params.add_uninitialized_single_output(d.as_mutable_span());
+        ContextBuilder context;
+        fused_fn.call(mask, params, context);
+      }
+      EXPECT_EQ_ARRAY(expected_c.data(), c.data(), size);
+      EXPECT_EQ_ARRAY(expected_d.data(), d.data(), size);
+      const int b = single_b ? 3 : b_values[4998];
+      EXPECT_EQ(c[4998], 4998 * b + b + b + 10);
+    }
+  }
+}
+
 }  // namespace blender::fn::multi_function::tests
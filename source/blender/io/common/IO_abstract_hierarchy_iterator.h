@@ -230,6 +230,12 @@ class AbstractHierarchyIterator {
    * previous iteration. */
   void set_export_subset(ExportSubset export_subset);
 
+  /* Set the dependency graph to iterate over. Set this before calling iterate_and_write(), when
+   * frames are evaluated by different dependency graphs. The graphs have to be built for the same
+   * view layer, so that the writers created in previous iterations remain valid. */
+  void set_depsgraph(Depsgraph *depsgraph);
+  Depsgraph *get_depsgraph() const;
+
   /* Convert the given name to something that is valid for the exported file format.
    * This base implementation is a no-op; override in a concrete subclass. */
   virtual std::string make_valid_name(const std::string &name) const;
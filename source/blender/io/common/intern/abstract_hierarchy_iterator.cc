@@ -196,6 +196,16 @@ void AbstractHierarchyIterator::set_export_subset(ExportSubset export_subset)
   export_subset_ = export_subset;
 }
 
+void AbstractHierarchyIterator::set_depsgraph(Depsgraph *depsgraph)
+{
+  depsgraph_ = depsgraph;
+}
+
+Depsgraph *AbstractHierarchyIterator::get_depsgraph() const
+{
+  return depsgraph_;
+}
+
 std::string AbstractHierarchyIterator::make_valid_name(const std::string &name) const
 {
   return name;
@@ -512,12 +522,13 @@ void AbstractHierarchyIterator::determine_export_paths(const HierarchyContext *p
 
     if (context->duplicator == nullptr) {
       /* This is an original (i.e. non-instanced) object, so we should keep track of where it was
-       * exported to, just in case it gets instanced somewhere. */
-      ID *source_ob = &context->object->id;
+       * exported to, just in case it gets instanced somewhere. The original IDs are used as keys,
+       * so that they stay the same when frames are evaluated by different dependency graphs. */
+      ID *source_ob = DEG_get_original_id(&context->object->id);
       duplisource_export_path_[source_ob] = context->export_path;
 
       if (context->object->data != nullptr) {
-        ID *source_data = static_cast<ID *>(context->object->data);
+        ID *source_data = DEG_get_original_id(static_cast<ID *>(context->object->data));
         duplisource_export_path_[source_data] = get_object_data_path(context);
       }
     }
@@ -533,7 +544,7 @@ void AbstractHierarchyIterator::determine_duplication_references(
 
   for (HierarchyContext *context : children) {
     if (context->duplicator != nullptr) {
-      ID *source_id = &context->object->id;
+      ID *source_id = DEG_get_original_id(&context->object->id);
       const ExportPathMap::const_iterator &it = duplisource_export_path_.find(source_id);
 
       if (it == duplisource_export_path_.end()) {
@@ -546,7 +557,7 @@ void AbstractHierarchyIterator::determine_duplication_references(
       }
 
       if (context->object->data) {
-        ID *source_data_id = (ID *)context->object->data;
+        ID *source_data_id = DEG_get_original_id((ID *)context->object->data);
         const ExportPathMap::const_iterator &it = duplisource_export_path_.find(source_data_id);
 
         if (it == duplisource_export_path_.end()) {
@@ -631,7 +642,7 @@ void AbstractHierarchyIterator::make_writer_object_data(const HierarchyContext *
 
   HierarchyContext data_context = context_for_object_data(context);
   if (data_context.is_instance()) {
-    ID *object_data = static_cast<ID *>(context->object->data);
+    ID *object_data = DEG_get_original_id(static_cast<ID *>(context->object->data));
     data_context.original_export_path = duplisource_export_path_[object_data];
 
     /* If the object is marked as an instance, so should the object data. */
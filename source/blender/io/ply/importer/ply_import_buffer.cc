@@ -3,8 +3,15 @@
 #include "ply_import_buffer.hh"
 
 #include "BLI_fileops.h"
+#include "BLI_mmap.h"
 
+#include <fcntl.h>
 #include <string.h>
+#ifndef WIN32
+#  include <unistd.h>
+#else
+#  include <io.h>
+#endif
 
 static inline bool is_newline(char ch)
 {
@@ -13,14 +20,20 @@ static inline bool is_newline(char ch)
 
 namespace blender::io::ply {
 
-PlyReadBuffer::PlyReadBuffer(const char *file_path, size_t read_buffer_size)
-    : buffer_(read_buffer_size), read_buffer_size_(read_buffer_size)
+PlyReadBuffer::PlyReadBuffer(const char *file_path, size_t read_buffer_size, bool use_mmap)
+    : file_path_(file_path),
+      buffer_(read_buffer_size),
+      read_buffer_size_(read_buffer_size),
+      use_mmap_(use_mmap)
 {
   file_ = BLI_fopen(file_path, "rb");
 }
 
 PlyReadBuffer::~PlyReadBuffer()
 {
+  if (mapped_file_ != nullptr) {
+    BLI_mmap_free(mapped_file_);
+  }
   if (file_ != nullptr) {
     fclose(file_);
   }
@@ -29,6 +42,17 @@ PlyReadBuffer::~PlyReadBuffer()
 void PlyReadBuffer::after_header(bool is_binary)
 {
   is_binary_ = is_binary;
+  if (!is_binary || !use_mmap_ || file_ == nullptr) {
+    return;
+  }
+  const int file = BLI_open(file_path_.c_str(), O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return;
+  }
+  mapped_file_ = BLI_mmap_open(file);
+  close(file);
+  /* Continue reading from the mapping after the header. */
+  mapped_pos_ = buffer_file_offset_ + pos_;
 }
 
 Span<char> PlyReadBuffer::read_line()
@@ -54,6 +78,14 @@ Span<char> PlyReadBuffer::read_line()
 
 bool PlyReadBuffer::read_bytes(void *dst, size_t size)
 {
+  if (mapped_file_ != nullptr) {
+    if (mapped_pos_ + size > BLI_mmap_get_length(mapped_file_)) {
+      return false;
+    }
+    memcpy(dst, static_cast<const char *>(BLI_mmap_get_pointer(mapped_file_)) + mapped_pos_, size);
+    mapped_pos_ += size;
+    return true;
+  }
   while (size > 0) {
     if (pos_ + size > buf_used_) {
       if (!refill_buffer()) {
@@ -71,6 +103,36 @@ bool PlyReadBuffer::read_bytes(void *dst, size_t size)
   return true;
 }
 
+const uint8_t *PlyReadBuffer::read_mapped_bytes(size_t size)
+{
+  if (mapped_file_ == nullptr || mapped_pos_ + size > BLI_mmap_get_length(mapped_file_)) {
+    return nullptr;
+  }
+  const uint8_t *data = static_cast<const uint8_t *>(BLI_mmap_get_pointer(mapped_file_)) +
+                        mapped_pos_;
+  mapped_pos_ += size;
+  return data;
+}
+
+Span<uint8_t> PlyReadBuffer::peek_mapped_bytes() const
+{
+  if (mapped_file_ == nullptr) {
+    return {};
+  }
+  const size_t size = BLI_mmap_get_length(mapped_file_);
+  if (mapped_pos_ >= size) {
+    return {};
+  }
+  return Span<uint8_t>(static_cast<const uint8_t *>(BLI_mmap_get_pointer(mapped_file_)) +
+                           mapped_pos_,
+                       int64_t(size - mapped_pos_));
+}
+
+bool PlyReadBuffer::has_mapped_io_error() const
+{
+  return mapped_file_ != nullptr && BLI_mmap_any_io_error(mapped_file_);
+}
+
 bool PlyReadBuffer::refill_buffer()
 {
   BLI_assert(pos_ <= buf_used_);
@@ -82,6 +144,7 @@ bool PlyReadBuffer::refill_buffer()
   }
 
   /* Move any leftover to start of buffer. */
+  buffer_file_offset_ += pos_;
   int keep = buf_used_ - pos_;
   if (keep > 0) {
     memmove(buffer_.data(), buffer_.data() + pos_, keep);
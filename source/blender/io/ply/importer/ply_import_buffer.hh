@@ -9,18 +9,27 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#include <string>
+
 #include "BLI_array.hh"
 #include "BLI_span.hh"
 
+struct BLI_mmap_file;
+
 namespace blender::io::ply {
 
 /**
  * Reads underlying PLY file in large chunks, and provides interface for ascii/header
  * parsing to read individual lines, and for binary parsing to read chunks of bytes.
+ *
+ * When `use_mmap` is set, the binary part of the file is read from a memory mapping instead,
+ * which also allows decoding rows directly from the file contents with #read_mapped_bytes.
  */
 class PlyReadBuffer {
  public:
-  PlyReadBuffer(const char *file_path, size_t read_buffer_size = 64 * 1024);
+  PlyReadBuffer(const char *file_path,
+                size_t read_buffer_size = 64 * 1024,
+                bool use_mmap = false);
   ~PlyReadBuffer();
 
   /** After header is parsed, indicate whether the rest of reading will be ascii or binary. */
@@ -37,18 +46,45 @@ class PlyReadBuffer {
    */
   bool read_bytes(void *dst, size_t size);
 
+  /**
+   * In binary mode with a mapped file, returns a pointer to the next bytes in the mapping and
+   * skips them. Returns null when the file is not mapped or the bytes can not be read, then
+   * #read_bytes should be used instead. The data is valid as long as the buffer exists.
+   */
+  const uint8_t *read_mapped_bytes(size_t size);
+
+  /** True if the binary data is read from a mapped file. */
+  bool is_mapped() const
+  {
+    return mapped_file_ != nullptr;
+  }
+
+  /** The remaining data of the mapped file, without skipping it. */
+  Span<uint8_t> peek_mapped_bytes() const;
+
+  /** True if there was an error reading mapped file data. */
+  bool has_mapped_io_error() const;
+
  private:
   bool refill_buffer();
 
  private:
   FILE *file_ = nullptr;
+  std::string file_path_;
   Array<char> buffer_;
+  /** Offset of the first byte in the buffer within the file. */
+  size_t buffer_file_offset_ = 0;
   int pos_ = 0;
   int buf_used_ = 0;
   int last_newline_ = 0;
   size_t read_buffer_size_ = 0;
   bool at_eof_ = false;
   bool is_binary_ = false;
+
+  bool use_mmap_ = false;
+  BLI_mmap_file *mapped_file_ = nullptr;
+  /** Position of the next byte in the mapped file. */
+  size_t mapped_pos_ = 0;
 };
 
 }  // namespace blender::io::ply
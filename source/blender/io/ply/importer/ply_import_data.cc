@@ -8,11 +8,14 @@
 #include "ply_data.hh"
 #include "ply_import_buffer.hh"
 
+#include "BLI_array.hh"
 #include "BLI_endian_switch.h"
+#include "BLI_task.hh"
 
 #include "fast_float.h"
 
 #include <algorithm>
+#include <atomic>
 #include <charconv>
 
 static bool is_whitespace(char c)
@@ -185,22 +188,16 @@ template<typename T> static T get_binary_value(PlyDataTypes type, const uint8_t
   return val;
 }
 
-static const char *parse_row_binary(PlyReadBuffer &file,
-                                    const PlyHeader &header,
-                                    const PlyElement &element,
-                                    Vector<uint8_t> &r_scratch,
-                                    Vector<float> &r_values)
+/**
+ * Convert the values of a binary row with fixed size properties to floats.
+ * \param row: The row data, endianness is switched in place.
+ */
+static const char *decode_row_binary(const PlyHeader &header,
+                                     const PlyElement &element,
+                                     uint8_t *row,
+                                     MutableSpan<float> r_values)
 {
-  if (element.stride == 0) {
-    return "Vertex/Edge element contains list properties, this is not supported";
-  }
-  BLI_assert(r_scratch.size() == element.stride);
-  BLI_assert(r_values.size() == element.properties.size());
-  if (!file.read_bytes(r_scratch.data(), r_scratch.size())) {
-    return "Could not read row of binary property";
-  }
-
-  const uint8_t *ptr = r_scratch.data();
+  const uint8_t *ptr = row;
   if (header.type == PlyFormatType::BINARY_LE) {
     /* Little endian: just read/convert the values. */
     for (int i = 0, n = int(element.properties.size()); i != n; i++) {
@@ -224,6 +221,23 @@ static const char *parse_row_binary(PlyReadBuffer &file,
   return nullptr;
 }
 
+static const char *parse_row_binary(PlyReadBuffer &file,
+                                    const PlyHeader &header,
+                                    const PlyElement &element,
+                                    Vector<uint8_t> &r_scratch,
+                                    Vector<float> &r_values)
+{
+  if (element.stride == 0) {
+    return "Vertex/Edge element contains list properties, this is not supported";
+  }
+  BLI_assert(r_scratch.size() == element.stride);
+  BLI_assert(r_values.size() == element.properties.size());
+  if (!file.read_bytes(r_scratch.data(), r_scratch.size())) {
+    return "Could not read row of binary property";
+  }
+  return decode_row_binary(header, element, r_scratch.data(), r_values);
+}
+
 static const char *load_vertex_element(PlyReadBuffer &file,
                                        const PlyHeader &header,
                                        const PlyElement &element,
@@ -248,15 +262,15 @@ static const char *load_vertex_element(PlyReadBuffer &file,
     return "Vertex positions are not present in the file";
   }
 
-  data->vertices.reserve(element.count);
+  data->vertices.resize(element.count);
   if (has_color) {
-    data->vertex_colors.reserve(element.count);
+    data->vertex_colors.resize(element.count);
   }
   if (has_normal) {
-    data->vertex_normals.reserve(element.count);
+    data->vertex_normals.resize(element.count);
   }
   if (has_uv) {
-    data->uv_coordinates.reserve(element.count);
+    data->uv_coordinates.resize(element.count);
   }
 
   float4 color_norm = {1, 1, 1, 1};
@@ -269,31 +283,13 @@ static const char *load_vertex_element(PlyReadBuffer &file,
     color_norm.w = data_type_normalizer[element.properties[alpha_index].type];
   }
 
-  Vector<float> value_vec(element.properties.size());
-  Vector<uint8_t> scratch;
-  if (header.type != PlyFormatType::ASCII) {
-    scratch.resize(element.stride);
-  }
-
-  for (int i = 0; i < element.count; i++) {
-
-    const char *error = nullptr;
-    if (header.type == PlyFormatType::ASCII) {
-      error = parse_row_ascii(file, value_vec);
-    }
-    else {
-      error = parse_row_binary(file, header, element, scratch, value_vec);
-    }
-    if (error != nullptr) {
-      return error;
-    }
-
+  auto store_vertex = [&](const int i, const Span<float> value_vec) {
     /* Vertex coord */
     float3 vertex3;
     vertex3.x = value_vec[vertex_index.x];
     vertex3.y = value_vec[vertex_index.y];
     vertex3.z = value_vec[vertex_index.z];
-    data->vertices.append(vertex3);
+    data->vertices[i] = vertex3;
 
     /* Vertex color */
     if (has_color) {
@@ -307,7 +303,7 @@ static const char *load_vertex_element(PlyReadBuffer &file,
       else {
         colors4.w = 1.0f;
       }
-      data->vertex_colors.append(colors4);
+      data->vertex_colors[i] = colors4;
     }
 
     /* If normals */
@@ -316,7 +312,7 @@ static const char *load_vertex_element(PlyReadBuffer &file,
       normals3.x = value_vec[normal_index.x];
       normals3.y = value_vec[normal_index.y];
       normals3.z = value_vec[normal_index.z];
-      data->vertex_normals.append(normals3);
+      data->vertex_normals[i] = normals3;
     }
 
     /* If uv */
@@ -324,8 +320,52 @@ static const char *load_vertex_element(PlyReadBuffer &file,
       float2 uvmap;
       uvmap.x = value_vec[uv_index.x];
       uvmap.y = value_vec[uv_index.y];
-      data->uv_coordinates.append(uvmap);
+      data->uv_coordinates[i] = uvmap;
     }
+  };
+
+  /* Decode the rows directly from the mapped file on multiple threads. */
+  if (header.type != PlyFormatType::ASCII && element.stride != 0) {
+    if (const uint8_t *rows = file.read_mapped_bytes(size_t(element.stride) * element.count)) {
+      std::atomic<const char *> error = nullptr;
+      threading::parallel_for(IndexRange(element.count), 4096, [&](const IndexRange range) {
+        Array<float, 16> value_vec(element.properties.size());
+        Array<uint8_t, 64> row(element.stride);
+        for (const int i : range) {
+          row.as_mutable_span().copy_from(Span(rows + size_t(element.stride) * i, element.stride));
+          if (const char *row_error = decode_row_binary(header, element, row.data(), value_vec)) {
+            error = row_error;
+            return;
+          }
+          store_vertex(i, value_vec);
+        }
+      });
+      if (file.has_mapped_io_error()) {
+        return "Could not read vertex data from the file";
+      }
+      return error.load();
+    }
+  }
+
+  Vector<float> value_vec(element.properties.size());
+  Vector<uint8_t> scratch;
+  if (header.type != PlyFormatType::ASCII) {
+    scratch.resize(element.stride);
+  }
+
+  for (int i = 0; i < element.count; i++) {
+
+    const char *error = nullptr;
+    if (header.type == PlyFormatType::ASCII) {
+      error = parse_row_ascii(file, value_vec);
+    }
+    else {
+      error = parse_row_binary(file, header, element, scratch, value_vec);
+    }
+    if (error != nullptr) {
+      return error;
+    }
+    store_vertex(i, value_vec);
   }
   return nullptr;
 }
@@ -360,6 +400,109 @@ static void skip_property(PlyReadBuffer &file,
   }
 }
 
+/**
+ * Load the vertex indices of all faces from a mapped binary file. The rows of the element have
+ * different sizes, so they are located first, then the indices are decoded on multiple threads.
+ */
+static const char *load_face_element_mapped(PlyReadBuffer &file,
+                                            const PlyHeader &header,
+                                            const PlyElement &element,
+                                            const int prop_index,
+                                            PlyData *data)
+{
+  const PlyProperty &prop = element.properties[prop_index];
+  const bool big_endian = header.type == PlyFormatType::BINARY_BE;
+  const Span<uint8_t> bytes = file.peek_mapped_bytes();
+  const char *read_error = "Could not read row of binary property";
+
+  size_t pos = 0;
+  auto read_count = [&](const PlyProperty &list_prop, uint32_t &r_count) {
+    const int size = data_type_size[list_prop.count_type];
+    if (pos + size > bytes.size()) {
+      return false;
+    }
+    alignas(8) uint8_t value[8];
+    memcpy(value, bytes.data() + pos, size);
+    if (big_endian) {
+      endian_switch(value, size);
+    }
+    const uint8_t *ptr = value;
+    r_count = get_binary_value<uint32_t>(list_prop.count_type, ptr);
+    pos += size;
+    return true;
+  };
+  auto skip_property = [&](const PlyProperty &other_prop) {
+    uint32_t count = 1;
+    if (other_prop.count_type != PlyDataTypes::NONE && !read_count(other_prop, count)) {
+      return false;
+    }
+    pos += size_t(count) * data_type_size[other_prop.type];
+    return pos <= bytes.size();
+  };
+
+  Array<size_t> index_offsets(element.count);
+  data->face_sizes.resize(element.count);
+  for (int i = 0; i < element.count; i++) {
+    /* Skip any properties before vertex indices. */
+    for (int j = 0; j < prop_index; j++) {
+      if (!skip_property(element.properties[j])) {
+        return read_error;
+      }
+    }
+    uint32_t count;
+    if (!read_count(prop, count)) {
+      return read_error;
+    }
+    if (count < 1 || count > 255) {
+      return "Invalid face size, must be between 1 and 255";
+    }
+    data->face_sizes[i] = count;
+    index_offsets[i] = pos;
+    pos += size_t(count) * data_type_size[prop.type];
+    if (pos > bytes.size()) {
+      return read_error;
+    }
+    /* Skip any properties after vertex indices. */
+    for (int j = prop_index + 1; j < element.properties.size(); j++) {
+      if (!skip_property(element.properties[j])) {
+        return read_error;
+      }
+    }
+  }
+  file.read_mapped_bytes(pos);
+
+  Array<int64_t> face_offsets(element.count + 1);
+  int64_t offset = 0;
+  for (int i = 0; i < element.count; i++) {
+    face_offsets[i] = offset;
+    offset += data->face_sizes[i];
+  }
+  face_offsets.last() = offset;
+  data->face_vertices.resize(offset);
+
+  const int type_size = data_type_size[prop.type];
+  threading::parallel_for(IndexRange(element.count), 4096, [&](const IndexRange range) {
+    alignas(8) uint8_t indices_data[255 * 8];
+    for (const int i : range) {
+      const uint32_t count = data->face_sizes[i];
+      memcpy(indices_data, bytes.data() + index_offsets[i], count * type_size);
+      if (big_endian) {
+        endian_switch_array(indices_data, type_size, count);
+      }
+      const uint8_t *ptr = indices_data;
+      MutableSpan<uint32_t> face_vertices = data->face_vertices.as_mutable_span().slice(
+          face_offsets[i], count);
+      for (const int j : IndexRange(count)) {
+        face_vertices[j] = get_binary_value<uint32_t>(prop.type, ptr);
+      }
+    }
+  });
+  if (file.has_mapped_io_error()) {
+    return "Could not read face data from the file";
+  }
+  return nullptr;
+}
+
 static const char *load_face_element(PlyReadBuffer &file,
                                      const PlyHeader &header,
                                      const PlyElement &element,
@@ -380,6 +523,10 @@ static const char *load_face_element(PlyReadBuffer &file,
     return "Face element vertex indices property must be a list";
   }
 
+  if (file.is_mapped()) {
+    return load_face_element_mapped(file, header, element, prop_index, data);
+  }
+
   data->face_vertices.reserve(element.count * 3);
   data->face_sizes.reserve(element.count);
 
@@ -22,13 +22,22 @@ struct Expectation {
 
 class ply_import_test : public testing::Test {
  public:
+  /** Import the file both with a read buffer and from a memory mapped file. */
   void import_and_check(const char *path, const Expectation &exp)
+  {
+    for (const bool use_mmap : {false, true}) {
+      SCOPED_TRACE(use_mmap ? "mapped" : "buffered");
+      import_and_check(path, exp, use_mmap);
+    }
+  }
+
+  void import_and_check(const char *path, const Expectation &exp, const bool use_mmap)
   {
     std::string ply_path = blender::tests::flags_test_asset_dir() +
                            SEP_STR "io_tests" SEP_STR "ply" SEP_STR + path;
 
     /* Use a small read buffer size for better coverage of buffer refilling behavior. */
-    PlyReadBuffer infile(ply_path.c_str(), 128);
+    PlyReadBuffer infile(ply_path.c_str(), 128, use_mmap);
     PlyHeader header;
     const char *header_err = read_header(infile, header);
     if (header_err != nullptr) {
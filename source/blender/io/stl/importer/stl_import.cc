@@ -78,9 +78,16 @@ void importer_main(Main *bmain,
   STRNCPY(ob_name, BLI_path_basename(import_params.filepath));
   BLI_path_extension_strip(ob_name);
 
-  Mesh *mesh = is_ascii_stl ?
-                   read_stl_ascii(import_params.filepath, import_params.use_facet_normal) :
-                   read_stl_binary(file, import_params.use_facet_normal);
+  Mesh *mesh = nullptr;
+  if (is_ascii_stl) {
+    mesh = read_stl_ascii(import_params.filepath, import_params.use_facet_normal);
+  }
+  else {
+    mesh = read_stl_binary_mapped(import_params.filepath, import_params.use_facet_normal);
+    if (mesh == nullptr) {
+      mesh = read_stl_binary(file, import_params.use_facet_normal);
+    }
+  }
 
   if (mesh == nullptr) {
     fprintf(stderr, "STL Importer: Failed to import mesh '%s'\n", import_params.filepath);
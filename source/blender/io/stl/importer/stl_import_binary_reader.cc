@@ -4,14 +4,26 @@
  * \ingroup stl
  */
 
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#ifndef WIN32
+#  include <unistd.h>
+#else
+#  include <io.h>
+#endif
 
 #include "BKE_main.h"
 #include "BKE_mesh.hh"
 
 #include "BLI_array.hh"
+#include "BLI_fileops.h"
+#include "BLI_math_vector_types.hh"
 #include "BLI_memory_utils.hh"
+#include "BLI_mmap.h"
+#include "BLI_task.hh"
 
 #include "DNA_mesh_types.h"
 
@@ -28,6 +40,7 @@ struct STLBinaryTriangle {
   uint16_t attribute_byte_count;
 };
 #pragma pack(pop)
+BLI_STATIC_ASSERT(sizeof(STLBinaryTriangle) == BINARY_STRIDE, "Unexpected STL triangle size")
 
 Mesh *read_stl_binary(FILE *file, const bool use_custom_normals)
 {
@@ -60,4 +73,51 @@ Mesh *read_stl_binary(FILE *file, const bool use_custom_normals)
   return stl_mesh.to_mesh();
 }
 
+Mesh *read_stl_binary_mapped(const char *filepath, const bool use_custom_normals)
+{
+  const int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return nullptr;
+  }
+  BLI_mmap_file *mapped_file = BLI_mmap_open(file);
+  close(file);
+  if (mapped_file == nullptr) {
+    return nullptr;
+  }
+  BLI_SCOPED_DEFER([&]() { BLI_mmap_free(mapped_file); });
+
+  const size_t size = BLI_mmap_get_length(mapped_file);
+  if (size < BINARY_HEADER_SIZE + sizeof(uint32_t)) {
+    return nullptr;
+  }
+  const char *data = static_cast<const char *>(BLI_mmap_get_pointer(mapped_file));
+  uint32_t num_tris;
+  memcpy(&num_tris, data + BINARY_HEADER_SIZE, sizeof(uint32_t));
+  if (size < BINARY_HEADER_SIZE + sizeof(uint32_t) + BINARY_STRIDE * size_t(num_tris)) {
+    return nullptr;
+  }
+  if (num_tris == 0) {
+    return BKE_mesh_new_nomain(0, 0, 0, 0);
+  }
+  const char *tris_data = data + BINARY_HEADER_SIZE + sizeof(uint32_t);
+
+  /* Triangles in the file are not aligned, copy their values out. */
+  Array<float3> corner_positions(int64_t(num_tris) * 3);
+  Array<float3> facet_normals(use_custom_normals ? num_tris : 0);
+  threading::parallel_for(IndexRange(num_tris), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      const char *tri = tris_data + BINARY_STRIDE * i;
+      memcpy(&corner_positions[i * 3], tri + offsetof(STLBinaryTriangle, v1), sizeof(float3) * 3);
+      if (use_custom_normals) {
+        memcpy(&facet_normals[i], tri + offsetof(STLBinaryTriangle, normal), sizeof(float3));
+      }
+    }
+  });
+  if (BLI_mmap_any_io_error(mapped_file)) {
+    return nullptr;
+  }
+
+  return stl_mesh_from_triangles(corner_positions, facet_normals);
+}
+
 }  // namespace blender::io::stl
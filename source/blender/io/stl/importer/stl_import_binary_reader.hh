@@ -27,5 +27,11 @@ const size_t BINARY_HEADER_SIZE = 80;
 const size_t BINARY_STRIDE = 12 * 4 + 2;
 
 Mesh *read_stl_binary(FILE *file, bool use_custom_normals);
+/**
+ * Read a binary STL file by mapping it into memory, the triangles are decoded directly from the
+ * mapping on multiple threads.
+ * \return Null when the file can't be mapped, then #read_stl_binary can be used instead.
+ */
+Mesh *read_stl_binary_mapped(const char *filepath, bool use_custom_normals);
 
 }  // namespace blender::io::stl
@@ -10,7 +10,9 @@
 #include "BKE_mesh.hh"
 
 #include "BLI_array.hh"
-#include "BLI_array_utils.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_map.hh"
+#include "BLI_math_base.h"
 #include "BLI_math_vector.h"
 #include "BLI_math_vector.hh"
 #include "BLI_task.hh"
@@ -25,30 +27,17 @@ namespace blender::io::stl {
 STLMeshHelper::STLMeshHelper(int tris_num, bool use_custom_normals)
     : use_custom_normals_(use_custom_normals)
 {
-  degenerate_tris_num_ = 0;
-  duplicate_tris_num_ = 0;
-  tris_.reserve(tris_num);
-  /* Upper bound (all vertices are unique). */
-  verts_.reserve(tris_num * 3);
+  corner_positions_.reserve(tris_num * 3);
   if (use_custom_normals) {
-    loop_normals_.reserve(tris_num * 3);
+    facet_normals_.reserve(tris_num);
   }
 }
 
-bool STLMeshHelper::add_triangle(const float3 &a, const float3 &b, const float3 &c)
+void STLMeshHelper::add_triangle(const float3 &a, const float3 &b, const float3 &c)
 {
-  int v1_id = verts_.index_of_or_add(a);
-  int v2_id = verts_.index_of_or_add(b);
-  int v3_id = verts_.index_of_or_add(c);
-  if ((v1_id == v2_id) || (v1_id == v3_id) || (v2_id == v3_id)) {
-    degenerate_tris_num_++;
-    return false;
-  }
-  if (!tris_.add({v1_id, v2_id, v3_id})) {
-    duplicate_tris_num_++;
-    return false;
-  }
-  return true;
+  corner_positions_.append(a);
+  corner_positions_.append(b);
+  corner_positions_.append(c);
 }
 
 void STLMeshHelper::add_triangle(const float3 &a,
@@ -56,25 +45,151 @@ void STLMeshHelper::add_triangle(const float3 &a,
                                  const float3 &c,
                                  const float3 &custom_normal)
 {
-  if (add_triangle(a, b, c)) {
-    loop_normals_.append_n_times(custom_normal, 3);
-  }
+  add_triangle(a, b, c);
+  facet_normals_.append(custom_normal);
 }
 
-Mesh *STLMeshHelper::to_mesh()
+static void report_removed_triangles(const int64_t degenerate_tris_num,
+                                     const int64_t duplicate_tris_num)
 {
-  if (degenerate_tris_num_ > 0) {
-    std::cout << "STL Importer: " << degenerate_tris_num_ << " degenerate triangles were removed"
+  if (degenerate_tris_num > 0) {
+    std::cout << "STL Importer: " << degenerate_tris_num << " degenerate triangles were removed"
               << std::endl;
   }
-  if (duplicate_tris_num_ > 0) {
-    std::cout << "STL Importer: " << duplicate_tris_num_ << " duplicate triangles were removed"
+  if (duplicate_tris_num > 0) {
+    std::cout << "STL Importer: " << duplicate_tris_num << " duplicate triangles were removed"
               << std::endl;
   }
+}
+
+/**
+ * For every value, find the index of the first value that is equal to it.
+ *
+ * The values are distributed over shards by their hash, keeping their order within each shard.
+ * The shards are deduplicated independently on multiple threads, which gives the same result as
+ * adding all values to a #VectorSet one after another.
+ */
+template<typename T> static Array<int> calc_first_occurrences(const Span<T> values)
+{
+  constexpr int shard_bits = 6;
+  constexpr int shards_num = 1 << shard_bits;
+  constexpr int64_t chunk_size = 1 << 16;
+
+  auto get_shard = [](const T &value) {
+    /* Use the high bits of a mixed hash, the hash table in every shard uses the low bits. */
+    const uint64_t hash = get_default_hash(value) * uint64_t(0x9E3779B97F4A7C15);
+    return int(hash >> (64 - shard_bits));
+  };
+
+  const int64_t chunks_num = divide_ceil_ul(values.size(), chunk_size);
+  auto chunk_range = [&](const int64_t chunk) {
+    return IndexRange(chunk * chunk_size,
+                      std::min(chunk_size, values.size() - chunk * chunk_size));
+  };
+
+  /* Count the values of every shard in every chunk. */
+  Array<uint8_t> shards(values.size());
+  Array<int, 0> chunk_shard_offsets(chunks_num * shards_num, 0);
+  threading::parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange range) {
+    for (const int64_t chunk : range) {
+      MutableSpan<int> counts = chunk_shard_offsets.as_mutable_span().slice(chunk * shards_num,
+                                                                            shards_num);
+      for (const int64_t i : chunk_range(chunk)) {
+        shards[i] = uint8_t(get_shard(values[i]));
+        counts[shards[i]]++;
+      }
+    }
+  });
+
+  /* Values of a shard are stored contiguously, in the order of the chunks. */
+  Array<int> shard_offsets(shards_num + 1);
+  int offset = 0;
+  for (const int shard : IndexRange(shards_num)) {
+    shard_offsets[shard] = offset;
+    for (const int64_t chunk : IndexRange(chunks_num)) {
+      const int count = chunk_shard_offsets[chunk * shards_num + shard];
+      chunk_shard_offsets[chunk * shards_num + shard] = offset;
+      offset += count;
+    }
+  }
+  shard_offsets.last() = offset;
+
+  Array<int> shard_indices(values.size());
+  threading::parallel_for(IndexRange(chunks_num), 1, [&](const IndexRange range) {
+    for (const int64_t chunk : range) {
+      MutableSpan<int> offsets = chunk_shard_offsets.as_mutable_span().slice(chunk * shards_num,
+                                                                             shards_num);
+      for (const int64_t i : chunk_range(chunk)) {
+        shard_indices[offsets[shards[i]]++] = int(i);
+      }
+    }
+  });
 
-  Mesh *mesh = BKE_mesh_new_nomain(verts_.size(), 0, tris_.size(), tris_.size() * 3);
+  Array<int> first_occurrences(values.size());
+  threading::parallel_for(IndexRange(shards_num), 1, [&](const IndexRange range) {
+    for (const int shard : range) {
+      const Span<int> indices = shard_indices.as_span().slice(
+          shard_offsets[shard], shard_offsets[shard + 1] - shard_offsets[shard]);
+      Map<T, int> first_index_by_value;
+      first_index_by_value.reserve(indices.size());
+      for (const int i : indices) {
+        first_occurrences[i] = first_index_by_value.lookup_or_add(values[i], i);
+      }
+    }
+  });
+  return first_occurrences;
+}
+
+Mesh *stl_mesh_from_triangles(const Span<float3> corner_positions,
+                              const Span<float3> facet_normals)
+{
+  BLI_assert(corner_positions.size() % 3 == 0);
+  const int64_t tris_num = corner_positions.size() / 3;
+
+  /* Merge vertices, numbering them in order of their first occurrence. */
+  const Array<int> first_corners = calc_first_occurrences(corner_positions);
+  IndexMaskMemory memory;
+  const IndexMask unique_corners = IndexMask::from_predicate(
+      corner_positions.index_range(), GrainSize(4096), memory, [&](const int64_t i) {
+        return first_corners[i] == i;
+      });
+  Array<int> vert_by_corner(corner_positions.size());
+  unique_corners.foreach_index(GrainSize(4096), [&](const int64_t i, const int64_t pos) {
+    vert_by_corner[i] = int(pos);
+  });
 
-  mesh->vert_positions_for_write().copy_from(verts_);
+  Array<Triangle> tris(tris_num);
+  threading::parallel_for(tris.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      tris[i] = {vert_by_corner[first_corners[i * 3 + 0]],
+                 vert_by_corner[first_corners[i * 3 + 1]],
+                 vert_by_corner[first_corners[i * 3 + 2]]};
+    }
+  });
+
+  /* Degenerate triangles are only equal to other degenerate triangles, so they don't affect
+   * which of the other triangles are duplicates. */
+  const Array<int> first_tris = calc_first_occurrences(tris.as_span());
+  const IndexMask degenerate_tris = IndexMask::from_predicate(
+      tris.index_range(), GrainSize(4096), memory, [&](const int64_t i) {
+        const Triangle &tri = tris[i];
+        return tri.v1 == tri.v2 || tri.v1 == tri.v3 || tri.v2 == tri.v3;
+      });
+  const IndexMask unique_tris = IndexMask::from_predicate(
+      tris.index_range(), GrainSize(4096), memory, [&](const int64_t i) {
+        const Triangle &tri = tris[i];
+        return first_tris[i] == i && tri.v1 != tri.v2 && tri.v1 != tri.v3 && tri.v2 != tri.v3;
+      });
+  report_removed_triangles(degenerate_tris.size(),
+                           tris_num - degenerate_tris.size() - unique_tris.size());
+
+  Mesh *mesh = BKE_mesh_new_nomain(
+      unique_corners.size(), 0, unique_tris.size(), unique_tris.size() * 3);
+
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  unique_corners.foreach_index(GrainSize(4096), [&](const int64_t i, const int64_t pos) {
+    positions[pos] = corner_positions[i];
+  });
 
   MutableSpan<int> poly_offsets = mesh->poly_offsets_for_write();
   threading::parallel_for(poly_offsets.index_range(), 4096, [&](const IndexRange range) {
@@ -83,17 +198,31 @@ Mesh *STLMeshHelper::to_mesh()
     }
   });
 
-  array_utils::copy(tris_.as_span().cast<int>(), mesh->corner_verts_for_write());
+  MutableSpan<int> corner_verts = mesh->corner_verts_for_write();
+  const Span<int> tri_verts = tris.as_span().cast<int>();
+  unique_tris.foreach_index(GrainSize(4096), [&](const int64_t i, const int64_t pos) {
+    corner_verts.slice(pos * 3, 3).copy_from(tri_verts.slice(i * 3, 3));
+  });
 
   /* NOTE: edges must be calculated first before setting custom normals. */
   BKE_mesh_calc_edges(mesh, false, false);
 
-  if (use_custom_normals_ && loop_normals_.size() == mesh->totloop) {
-    BKE_mesh_set_custom_normals(mesh, reinterpret_cast<float(*)[3]>(loop_normals_.data()));
+  if (!facet_normals.is_empty()) {
+    Array<float3> loop_normals(mesh->totloop);
+    unique_tris.foreach_index(GrainSize(4096), [&](const int64_t i, const int64_t pos) {
+      loop_normals.as_mutable_span().slice(pos * 3, 3).fill(facet_normals[i]);
+    });
+    BKE_mesh_set_custom_normals(mesh, reinterpret_cast<float(*)[3]>(loop_normals.data()));
     mesh->flag |= ME_AUTOSMOOTH;
   }
 
   return mesh;
 }
 
+Mesh *STLMeshHelper::to_mesh()
+{
+  return stl_mesh_from_triangles(corner_positions_,
+                                 use_custom_normals_ ? facet_normals_.as_span() : Span<float3>());
+}
+
 }  // namespace blender::io::stl
@@ -9,9 +9,8 @@
 #include <cstdint>
 
 #include "BLI_math_vector_types.hh"
-#include "BLI_set.hh"
+#include "BLI_span.hh"
 #include "BLI_vector.hh"
-#include "BLI_vector_set.hh"
 
 #include "DNA_mesh_types.h"
 
@@ -47,20 +46,17 @@ class Triangle {
 
 class STLMeshHelper {
  private:
-  VectorSet<float3> verts_;
-  VectorSet<Triangle> tris_;
-  Vector<float3> loop_normals_;
-  int degenerate_tris_num_;
-  int duplicate_tris_num_;
+  Vector<float3> corner_positions_;
+  Vector<float3> facet_normals_;
   const bool use_custom_normals_;
 
  public:
   STLMeshHelper(int tris_num, bool use_custom_normals);
 
-  /* Creates a new triangle from specified vertex locations,
-   * duplicate vertices and triangles are merged.
+  /* Adds a new triangle from specified vertex locations,
+   * duplicate vertices and triangles are merged in #to_mesh.
    */
-  bool add_triangle(const float3 &a, const float3 &b, const float3 &c);
+  void add_triangle(const float3 &a, const float3 &b, const float3 &c);
   void add_triangle(const float3 &a,
                     const float3 &b,
                     const float3 &c,
@@ -68,4 +64,12 @@ class STLMeshHelper {
   Mesh *to_mesh();
 };
 
+/**
+ * Create a mesh from triangles given by the positions of their corners. Duplicate vertices,
+ * degenerate and duplicate triangles are removed on multiple threads. Vertices and triangles keep
+ * the order of their first occurrence, so the result does not depend on the number of threads.
+ * \param facet_normals: The custom normal of every triangle, or empty to not use custom normals.
+ */
+Mesh *stl_mesh_from_triangles(Span<float3> corner_positions, Span<float3> facet_normals);
+
 }  // namespace blender::io::stl
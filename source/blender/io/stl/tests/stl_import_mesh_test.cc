@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.hh"
+
+#include "BLI_rand.hh"
+#include "BLI_timeit.hh"
+#include "BLI_vector_set.hh"
+
+#include "DNA_mesh_types.h"
+
+#include "stl_import_mesh.hh"
+
+namespace blender::io::stl::tests {
+
+class stl_import_mesh_test : public testing::Test {
+ public:
+  static void SetUpTestSuite()
+  {
+    BKE_idtype_init();
+  }
+};
+
+/**
+ * Triangles of a grid, with every corner position stored separately like in an STL file. Some
+ * degenerate and duplicate triangles are added and the order of the triangles is shuffled.
+ */
+static Vector<float3> grid_triangle_positions(const int size, const uint32_t seed)
+{
+  auto position = [&](const int x, const int y) { return float3(x * 0.5f, y * 0.25f, x * y); };
+
+  Vector<std::array<float3, 3>> tris;
+  for (const int y : IndexRange(size - 1)) {
+    for (const int x : IndexRange(size - 1)) {
+      tris.append({position(x, y), position(x + 1, y), position(x + 1, y + 1)});
+      tris.append({position(x, y), position(x + 1, y + 1), position(x, y + 1)});
+    }
+  }
+  const int64_t grid_tris_num = tris.size();
+  RandomNumberGenerator rng(seed);
+  for (int i = 0; i < grid_tris_num / 50; i++) {
+    const std::array<float3, 3> &tri = tris[rng.get_int32(grid_tris_num)];
+    /* Same triangle with different corner order. */
+    tris.append({tri[1], tri[2], tri[0]});
+    /* Triangle with two equal corners. */
+    tris.append({tri[0], tri[0], tri[2]});
+  }
+  rng.shuffle(tris.as_mutable_span());
+
+  Vector<float3> positions;
+  for (const std::array<float3, 3> &tri : tris) {
+    positions.extend({tri[0], tri[1], tri[2]});
+  }
+  return positions;
+}
+
+/**
+ * The previous implementation of #STLMeshHelper, that merged vertices and triangles one after
+ * another. Used to check the result and to compare performance.
+ */
+static void weld_triangles_serial(const Span<float3> corner_positions,
+                                  VectorSet<float3> &r_verts,
+                                  VectorSet<Triangle> &r_tris)
+{
+  r_verts.reserve(corner_positions.size());
+  r_tris.reserve(corner_positions.size() / 3);
+  for (int64_t i = 0; i < corner_positions.size(); i += 3) {
+    const int v1 = r_verts.index_of_or_add(corner_positions[i]);
+    const int v2 = r_verts.index_of_or_add(corner_positions[i + 1]);
+    const int v3 = r_verts.index_of_or_add(corner_positions[i + 2]);
+    if ((v1 == v2) || (v1 == v3) || (v2 == v3)) {
+      continue;
+    }
+    r_tris.add({v1, v2, v3});
+  }
+}
+
+TEST_F(stl_import_mesh_test, weld_same_as_serial)
+{
+  const Vector<float3> corner_positions = grid_triangle_positions(100, 0);
+
+  VectorSet<float3> verts;
+  VectorSet<Triangle> tris;
+  weld_triangles_serial(corner_positions, verts, tris);
+
+  Mesh *mesh = stl_mesh_from_triangles(corner_positions, {});
+  ASSERT_EQ(mesh->totvert, 100 * 100);
+  ASSERT_EQ(mesh->totvert, verts.size());
+  ASSERT_EQ(mesh->totpoly, tris.size());
+  EXPECT_EQ(mesh->vert_positions(), verts.as_span());
+  EXPECT_EQ(mesh->corner_verts(), tris.as_span().cast<int>());
+  BKE_id_free(nullptr, mesh);
+}
+
+TEST_F(stl_import_mesh_test, custom_normals)
+{
+  const Vector<float3> positions = {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, /* Duplicate. */
+                                    {1, 1, 0}, {0, 0, 0}, {1, 0, 0}, /* Degenerate. */
+                                    {0, 0, 0}, {0, 0, 0}, {1, 1, 0}, /* Second triangle. */
+                                    {0, 0, 0}, {1, 1, 0}, {0, 1, 0}};
+  const Vector<float3> facet_normals = {{0, 0, 1}, {0, 0, 1}, {0, 0, 1}, {0, 0, -1}};
+
+  Mesh *mesh = stl_mesh_from_triangles(positions, facet_normals);
+  EXPECT_EQ(mesh->totvert, 4);
+  EXPECT_EQ(mesh->totpoly, 2);
+  EXPECT_EQ(mesh->corner_verts(), Span<int>({0, 1, 2, 0, 2, 3}));
+  EXPECT_TRUE(mesh->flag & ME_AUTOSMOOTH);
+  BKE_id_free(nullptr, mesh);
+}
+
+/**
+ * Set this to 1 to activate the benchmark. It is disabled by default, because it takes long.
+ */
+#if 0
+TEST_F(stl_import_mesh_test, weld_benchmark)
+{
+  const Vector<float3> corner_positions = grid_triangle_positions(2000, 0);
+  printf("Welding %lld triangles:\n", (long long)corner_positions.size() / 3);
+  for ([[maybe_unused]] const int i : IndexRange(3)) {
+    {
+      SCOPED_TIMER("serial");
+      VectorSet<float3> verts;
+      VectorSet<Triangle> tris;
+      weld_triangles_serial(corner_positions, verts, tris);
+    }
+    {
+      SCOPED_TIMER("parallel");
+      Mesh *mesh = stl_mesh_from_triangles(corner_positions, {});
+      BKE_id_free(nullptr, mesh);
+    }
+  }
+}
+#endif /* Benchmark */
+
+}  // namespace blender::io::stl::tests
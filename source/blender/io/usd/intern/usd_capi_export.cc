@@ -31,6 +31,7 @@
 #include "BLI_fileops.h"
 #include "BLI_path_util.h"
 #include "BLI_string.h"
+#include "BLI_threads.h"
 #include "BLI_timeit.hh"
 
 #include "WM_api.h"
@@ -196,6 +197,30 @@ static bool perform_usdz_conversion(const ExportJobData *data)
   return true;
 }
 
+struct ExportFramesData {
+  USDHierarchyIterator *iter;
+  bool *stop;
+  bool *do_update;
+  float *progress;
+  float progress_per_frame;
+};
+
+static bool export_evaluated_frame(Depsgraph *depsgraph, const float frame, void *user_data)
+{
+  ExportFramesData *data = static_cast<ExportFramesData *>(user_data);
+  if (G.is_break || (data->stop != nullptr && *data->stop)) {
+    return false;
+  }
+
+  data->iter->set_depsgraph(depsgraph);
+  data->iter->set_export_frame(frame);
+  data->iter->iterate_and_write();
+
+  *data->progress += data->progress_per_frame;
+  *data->do_update = true;
+  return true;
+}
+
 static void export_startjob(void *customdata,
                             /* Cannot be const, this function implements wm_jobs_start_callback.
                              * NOLINTNEXTLINE: readability-non-const-parameter. */
@@ -255,8 +280,31 @@ static void export_startjob(void *customdata,
   ensure_root_prim(usd_stage, data->params);
 
   USDHierarchyIterator iter(data->bmain, data->depsgraph, usd_stage, data->params);
+  DEGFrameParallelEvaluator *frame_evaluator = nullptr;
 
-  if (data->params.export_animation) {
+  if (data->params.export_animation && data->params.use_parallel_frames &&
+      data->params.visible_objects_only)
+  {
+    /* Writing the animated frames is not 100% of the work, but it's our best guess. */
+    ExportFramesData frames_data = {&iter, stop, do_update, progress, 0.0f};
+    frames_data.progress_per_frame = 1.0f / std::max(1, (scene->r.efra - scene->r.sfra + 1));
+
+    /* The input scene stays at the current frame, every frame is evaluated by its own copy of
+     * the scene in one of the dependency graphs. */
+    frame_evaluator = DEG_frame_parallel_evaluator_new(data->bmain,
+                                                       scene,
+                                                       DEG_get_input_view_layer(data->depsgraph),
+                                                       data->params.evaluation_mode,
+                                                       BLI_system_thread_count());
+    DEG_frame_parallel_evaluate(frame_evaluator,
+                                float(scene->r.sfra),
+                                float(scene->r.efra),
+                                1.0f,
+                                export_evaluated_frame,
+                                &frames_data);
+    iter.set_depsgraph(data->depsgraph);
+  }
+  else if (data->params.export_animation) {
     /* Writing the animated frames is not 100% of the work, but it's our best guess. */
     float progress_per_frame = 1.0f / std::max(1, (scene->r.efra - scene->r.sfra + 1));
 
@@ -283,6 +331,9 @@ static void export_startjob(void *customdata,
   }
 
   iter.release_writers();
+  if (frame_evaluator != nullptr) {
+    DEG_frame_parallel_evaluator_free(frame_evaluator);
+  }
 
   /* Set the default prim if it doesn't exist */
   if (!usd_stage->GetDefaultPrim()) {
@@ -7,7 +7,6 @@
 #include <pxr/usd/sdf/path.h>
 #include <pxr/usd/usd/common.h>
 
-struct Depsgraph;
 struct Main;
 
 namespace blender::io::usd {
@@ -16,9 +15,10 @@ class USDHierarchyIterator;
 
 struct USDExporterContext {
   Main *bmain;
-  Depsgraph *depsgraph;
   const pxr::UsdStageRefPtr stage;
   const pxr::SdfPath usd_path;
+  /** The dependency graph of the exported frame is accessed through the iterator, as it changes
+   * when frames are evaluated in parallel. */
   const USDHierarchyIterator *hierarchy_iterator;
   const USDExportParams &export_params;
 };
@@ -87,7 +87,7 @@ USDExporterContext USDHierarchyIterator::create_usd_export_context(const Hierarc
     path = pxr::SdfPath(context->export_path);
   }
 
-  return USDExporterContext{bmain_, depsgraph_, stage_, path, this, params_};
+  return USDExporterContext{bmain_, stage_, path, this, params_};
 }
 
 AbstractHierarchyWriter *USDHierarchyIterator::create_transform_writer(
@@ -24,7 +24,8 @@ USDMetaballWriter::USDMetaballWriter(const USDExporterContext &ctx) : USDGeneric
 
 bool USDMetaballWriter::is_supported(const HierarchyContext *context) const
 {
-  Scene *scene = DEG_get_input_scene(usd_export_context_.depsgraph);
+  Depsgraph *depsgraph = usd_export_context_.hierarchy_iterator->get_depsgraph();
+  Scene *scene = DEG_get_input_scene(depsgraph);
   return is_basis_ball(scene, context->object) && USDGenericMeshWriter::is_supported(context);
 }
 
@@ -44,7 +45,8 @@ Mesh *USDMetaballWriter::get_export_mesh(Object *object_eval, bool &r_needsfree)
     return mesh_eval;
   }
   r_needsfree = true;
-  return BKE_mesh_new_from_object(usd_export_context_.depsgraph, object_eval, false, false);
+  Depsgraph *depsgraph = usd_export_context_.hierarchy_iterator->get_depsgraph();
+  return BKE_mesh_new_from_object(depsgraph, object_eval, false, false);
 }
 
 void USDMetaballWriter::free_export_mesh(Mesh *mesh)
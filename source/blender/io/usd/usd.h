@@ -45,6 +45,7 @@ struct USDExportParams {
   bool selected_objects_only;
   bool visible_objects_only;
   bool use_instancing;
+  bool use_parallel_frames;
   enum eEvaluationMode evaluation_mode;
   bool generate_preview_surface;
   bool export_textures;
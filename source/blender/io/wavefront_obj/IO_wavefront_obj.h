@@ -58,6 +58,9 @@ struct OBJExportParams {
   bool export_smooth_groups;
   /* Create bitflags instead of the default "0"/"1" group IDs. */
   bool smooth_groups_bitflags;
+
+  /* Write the file while objects are being formatted, with bounded memory usage. */
+  bool use_streaming;
 };
 
 struct OBJImportParams {
@@ -74,6 +77,8 @@ struct OBJImportParams {
   bool validate_meshes;
   bool relative_paths;
   bool clear_selection;
+  /** Parse vertices and faces on multiple threads. */
+  bool use_multithreading;
 };
 
 /**
@@ -203,6 +203,9 @@ void OBJWriter::write_object_name(FormatHandler &fh, const OBJMesh &obj_mesh_dat
 /* Split up large meshes into multi-threaded jobs; each job processes
  * this amount of items. */
 static const int chunk_size = 32768;
+/* When the output is streamed, only this many chunks are formatted at the same time,
+ * to not keep the whole text of a large mesh in memory. */
+static const int streaming_chunks_window = 8;
 static int calc_chunk_count(int count)
 {
   return (count + chunk_size - 1) / chunk_size;
@@ -231,20 +234,24 @@ void obj_parallel_chunked_output(FormatHandler &fh, int tot_count, const Functio
     return;
   }
   /* Give each chunk its own temporary output buffer, and process them in parallel. */
-  std::vector<FormatHandler> buffers(chunk_count);
-  blender::threading::parallel_for(IndexRange(chunk_count), 1, [&](IndexRange range) {
-    for (const int r : range) {
-      int i_start = r * chunk_size;
-      int i_end = std::min(i_start + chunk_size, tot_count);
-      auto &buf = buffers[r];
-      for (int i = i_start; i < i_end; i++) {
-        function(buf, i);
+  const int window = fh.has_block_consumer() ? streaming_chunks_window : chunk_count;
+  for (int window_start = 0; window_start < chunk_count; window_start += window) {
+    const int window_size = std::min(window, chunk_count - window_start);
+    std::vector<FormatHandler> buffers(window_size);
+    blender::threading::parallel_for(IndexRange(window_size), 1, [&](IndexRange range) {
+      for (const int r : range) {
+        int i_start = (window_start + r) * chunk_size;
+        int i_end = std::min(i_start + chunk_size, tot_count);
+        auto &buf = buffers[r];
+        for (int i = i_start; i < i_end; i++) {
+          function(buf, i);
+        }
       }
+    });
+    /* Emit all temporary output buffers into the destination buffer. */
+    for (auto &buf : buffers) {
+      fh.append_from(buf);
     }
-  });
-  /* Emit all temporary output buffers into the destination buffer. */
-  for (auto &buf : buffers) {
-    fh.append_from(buf);
   }
 }
 
@@ -11,6 +11,7 @@
 
 #include "BLI_compiler_attrs.h"
 #include "BLI_fileops.h"
+#include "BLI_function_ref.hh"
 #include "BLI_string_ref.hh"
 #include "BLI_utility_mixins.hh"
 #include "BLI_vector.hh"
@@ -27,15 +28,33 @@ namespace blender::io::obj {
  * (list of default 64 kilobyte blocks).
  * Call write_fo_file once in a while to write the memory buffer(s)
  * into the given file.
+ * When a block consumer is set, full blocks are passed on to it
+ * instead of being kept in memory.
  */
 class FormatHandler : NonCopyable, NonMovable {
  private:
   using VectorChar = Vector<char>;
   Vector<VectorChar> blocks_;
   size_t buffer_chunk_size_;
+  FunctionRef<void(VectorChar block)> block_consumer_;
 
  public:
   FormatHandler(size_t buffer_chunk_size = 64 * 1024) : buffer_chunk_size_(buffer_chunk_size) {}
+  FormatHandler(FunctionRef<void(VectorChar block)> block_consumer,
+                size_t buffer_chunk_size = 64 * 1024)
+      : buffer_chunk_size_(buffer_chunk_size), block_consumer_(block_consumer)
+  {
+  }
+
+  /* Pass all blocks to the block consumer, including the one that is not full yet. */
+  void flush_blocks()
+  {
+    BLI_assert(block_consumer_);
+    for (VectorChar &b : blocks_) {
+      block_consumer_(std::move(b));
+    }
+    blocks_.clear();
+  }
 
   /* Write contents to the buffer(s) into a file, and clear the buffers. */
   void write_to_file(FILE *f)
@@ -57,8 +76,21 @@ class FormatHandler : NonCopyable, NonMovable {
     return blocks_.size();
   }
 
+  bool has_block_consumer() const
+  {
+    return bool(block_consumer_);
+  }
+
   void append_from(FormatHandler &v)
   {
+    if (block_consumer_) {
+      this->flush_blocks();
+      for (VectorChar &b : v.blocks_) {
+        block_consumer_(std::move(b));
+      }
+      v.blocks_.clear();
+      return;
+    }
     blocks_.insert(blocks_.end(),
                    std::make_move_iterator(v.blocks_.begin()),
                    std::make_move_iterator(v.blocks_.end()));
@@ -199,6 +231,9 @@ class FormatHandler : NonCopyable, NonMovable {
   void ensure_space(size_t at_least)
   {
     if (blocks_.is_empty() || (blocks_.last().capacity() - blocks_.last().size() < at_least)) {
+      if (block_consumer_) {
+        this->flush_blocks();
+      }
       blocks_.append(VectorChar());
       blocks_.last().reserve(std::max(at_least, buffer_chunk_size_));
     }
@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup obj
+ */
+
+#include "PIL_time.h"
+
+#include "obj_export_stream.hh"
+
+namespace blender::io::obj {
+
+OBJExportStream::OBJExportStream(FILE *outfile,
+                                 const int64_t objects_num,
+                                 const int64_t max_queued_blocks_per_object,
+                                 const int64_t max_objects_ahead)
+    : outfile_(outfile),
+      max_queued_blocks_per_object_(std::max<int64_t>(max_queued_blocks_per_object, 1)),
+      max_objects_ahead_(std::max<int64_t>(max_objects_ahead, 1)),
+      queues_(objects_num)
+{
+  start_time_ = PIL_check_seconds_timer();
+  writer_thread_ = std::thread([this]() { this->write_blocks(); });
+}
+
+OBJExportStream::~OBJExportStream()
+{
+  if (writer_thread_.joinable()) {
+    this->finish();
+  }
+}
+
+void OBJExportStream::push_block(const int64_t object_index, Vector<char> block)
+{
+  if (block.is_empty()) {
+    return;
+  }
+  std::unique_lock lock{mutex_};
+  ObjectQueue &queue = queues_[object_index];
+  BLI_assert(!queue.is_finished);
+  block_popped_.wait(lock, [&]() {
+    return int64_t(queue.blocks.size()) < max_queued_blocks_per_object_ &&
+           object_index < writing_object_ + max_objects_ahead_;
+  });
+  queue.blocks.push_back(std::move(block));
+  blocks_queued_++;
+  stats_.max_blocks_queued = std::max(stats_.max_blocks_queued, blocks_queued_);
+  block_pushed_.notify_one();
+}
+
+void OBJExportStream::finish_object(const int64_t object_index)
+{
+  std::lock_guard lock{mutex_};
+  queues_[object_index].is_finished = true;
+  block_pushed_.notify_one();
+}
+
+OBJExportStream::Stats OBJExportStream::finish()
+{
+  writer_thread_.join();
+  stats_.total_seconds = PIL_check_seconds_timer() - start_time_;
+  return stats_;
+}
+
+void OBJExportStream::write_blocks()
+{
+  for (const int64_t object_index : queues_.index_range()) {
+    ObjectQueue &queue = queues_[object_index];
+    {
+      std::lock_guard lock{mutex_};
+      writing_object_ = object_index;
+    }
+    block_popped_.notify_all();
+    while (true) {
+      Vector<char> block;
+      {
+        std::unique_lock lock{mutex_};
+        if (queue.blocks.empty() && !queue.is_finished) {
+          const double wait_start = PIL_check_seconds_timer();
+          block_pushed_.wait(lock, [&]() { return !queue.blocks.empty() || queue.is_finished; });
+          stats_.writer_wait_seconds += PIL_check_seconds_timer() - wait_start;
+        }
+        if (queue.blocks.empty()) {
+          break;
+        }
+        block = std::move(queue.blocks.front());
+        queue.blocks.pop_front();
+        blocks_queued_--;
+      }
+      /* Multiple threads may wait for space in their own queue. */
+      block_popped_.notify_all();
+
+      fwrite(block.data(), 1, block.size(), outfile_);
+      stats_.bytes_written += block.size();
+      stats_.blocks_written++;
+    }
+  }
+}
+
+}  // namespace blender::io::obj
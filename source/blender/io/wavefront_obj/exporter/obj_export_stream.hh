@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup obj
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "BLI_array.hh"
+#include "BLI_utility_mixins.hh"
+#include "BLI_vector.hh"
+
+namespace blender::io::obj {
+
+/**
+ * Writes the text of multiple objects into a file while they are being formatted.
+ *
+ * Every object is a separate stream of text blocks, formatting threads push full blocks of
+ * their object into a bounded queue. A dedicated writer thread writes the blocks of the first
+ * unfinished object to the file, so the output has the same order as the objects. Formatting
+ * threads have to start objects in increasing order, then the object that is written next is
+ * always being formatted. Only objects close to the one that is being written can queue blocks,
+ * so memory usage does not depend on the size of the scene.
+ */
+class OBJExportStream : NonCopyable, NonMovable {
+ public:
+  struct Stats {
+    int64_t bytes_written = 0;
+    int64_t blocks_written = 0;
+    /** Largest number of blocks waiting to be written at the same time. */
+    int64_t max_blocks_queued = 0;
+    /** Time the writer thread waited for blocks to be formatted. */
+    double writer_wait_seconds = 0.0;
+    double total_seconds = 0.0;
+  };
+
+ private:
+  struct ObjectQueue {
+    std::deque<Vector<char>> blocks;
+    bool is_finished = false;
+  };
+
+  FILE *outfile_;
+  int64_t max_queued_blocks_per_object_;
+  int64_t max_objects_ahead_;
+  Array<ObjectQueue> queues_;
+
+  std::mutex mutex_;
+  /** Notified when a block is pushed or an object is finished. */
+  std::condition_variable block_pushed_;
+  /** Notified when the writer took a block from a queue or started writing the next object. */
+  std::condition_variable block_popped_;
+  int64_t blocks_queued_ = 0;
+  /** Index of the object that is currently being written. */
+  int64_t writing_object_ = 0;
+
+  Stats stats_;
+  double start_time_;
+  std::thread writer_thread_;
+
+ public:
+  /**
+   * Start the writer thread.
+   * \param max_queued_blocks_per_object: Formatting threads wait when their object has that many
+   * blocks that have not been written yet.
+   * \param max_objects_ahead: Formatting threads wait when their object is that many objects
+   * after the object that is being written.
+   */
+  OBJExportStream(FILE *outfile,
+                  int64_t objects_num,
+                  int64_t max_queued_blocks_per_object,
+                  int64_t max_objects_ahead);
+  ~OBJExportStream();
+
+  /**
+   * Add a block of text at the end of the object. Waits while the queue of the object is full or
+   * the object is too far ahead of the writer.
+   */
+  void push_block(int64_t object_index, Vector<char> block);
+  /**
+   * No more blocks will be added to the object.
+   */
+  void finish_object(int64_t object_index);
+  /**
+   * Wait until the text of all objects is written. All objects have to be finished.
+   */
+  Stats finish();
+
+ private:
+  void write_blocks();
+};
+
+}  // namespace blender::io::obj
@@ -4,14 +4,17 @@
  * \ingroup obj
  */
 
+#include <atomic>
 #include <cstdio>
 #include <exception>
 #include <memory>
+#include <thread>
 
 #include "BKE_scene.h"
 
 #include "BLI_path_util.h"
 #include "BLI_task.hh"
+#include "BLI_threads.h"
 #include "BLI_vector.hh"
 
 #include "DEG_depsgraph_query.h"
@@ -25,6 +28,7 @@
 #include "obj_exporter.hh"
 
 #include "obj_export_file_writer.hh"
+#include "obj_export_stream.hh"
 
 namespace blender::io::obj {
 
@@ -135,16 +139,66 @@ filter_supported_objects(Depsgraph *depsgraph, const OBJExportParams &export_par
   return {std::move(r_exportable_meshes), std::move(r_exportable_nurbs)};
 }
 
+/**
+ * Format the objects on multiple threads while a separate thread writes the finished parts of
+ * the text to the file, see #OBJExportStream. Unlike formatting all objects into memory first,
+ * memory usage does not depend on the size of the exported scene.
+ */
+static void write_mesh_objects_streaming(
+    const int64_t objects_num,
+    FILE *outfile,
+    const FunctionRef<void(int object_index, FormatHandler &fh)> write_object)
+{
+  /* Allow formatting to run a bit ahead of writing, without keeping much text in memory. */
+  const int64_t max_queued_blocks_per_object = 16;
+  const int threads_num = std::max<int>(std::min<int64_t>(BLI_system_thread_count(), objects_num),
+                                        1);
+
+  OBJExportStream stream(outfile, objects_num, max_queued_blocks_per_object, threads_num * 2);
+
+  /* Objects are started in order, so that the object that is written next is always formatted by
+   * some thread. Dedicated threads are used because formatting waits for the writer, which may
+   * not be done in tasks of the shared thread pool. */
+  std::atomic<int64_t> next_object_index = 0;
+  auto format_objects = [&]() {
+    while (true) {
+      const int64_t i = next_object_index.fetch_add(1);
+      if (i >= objects_num) {
+        break;
+      }
+      FormatHandler fh{[&](Vector<char> block) { stream.push_block(i, std::move(block)); }};
+      write_object(i, fh);
+      fh.flush_blocks();
+      stream.finish_object(i);
+    }
+  };
+  Vector<std::thread> threads;
+  for ([[maybe_unused]] const int thread_i : IndexRange(threads_num)) {
+    threads.append(std::thread(format_objects));
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  const OBJExportStream::Stats stats = stream.finish();
+  const double mib = double(stats.bytes_written) / (1024.0 * 1024.0);
+  fprintf(stderr,
+          "OBJ export: wrote %.2f MiB in %.3f s (%.2f MiB/s) using %d threads, "
+          "writer waited %.3f s, at most %lld blocks queued\n",
+          mib,
+          stats.total_seconds,
+          stats.total_seconds > 0.0 ? mib / stats.total_seconds : 0.0,
+          threads_num,
+          stats.writer_wait_seconds,
+          (long long)stats.max_blocks_queued);
+}
+
 static void write_mesh_objects(Vector<std::unique_ptr<OBJMesh>> exportable_as_mesh,
                                OBJWriter &obj_writer,
                                MTLWriter *mtl_writer,
                                const OBJExportParams &export_params)
 {
-  /* Parallelization is over meshes/objects, which means
-   * we have to have the output text buffer for each object,
-   * and write them all into the file at the end. */
   size_t count = exportable_as_mesh.size();
-  std::vector<FormatHandler> buffers(count);
 
   /* Serial: gather material indices, ensure normals & edges. */
   Vector<Vector<int>> mtlindices;
@@ -188,49 +242,62 @@ static void write_mesh_objects(Vector<std::unique_ptr<OBJMesh>> exportable_as_me
     offsets.normal_offset += obj.tot_normal_indices();
   }
 
-  /* Parallel over meshes: main result writing. */
-  blender::threading::parallel_for(IndexRange(count), 1, [&](IndexRange range) {
-    for (const int i : range) {
-      OBJMesh &obj = *exportable_as_mesh[i];
-      auto &fh = buffers[i];
+  auto write_object = [&](const int i, FormatHandler &fh) {
+    OBJMesh &obj = *exportable_as_mesh[i];
 
-      obj_writer.write_object_name(fh, obj);
-      obj_writer.write_vertex_coords(fh, obj, export_params.export_colors);
+    obj_writer.write_object_name(fh, obj);
+    obj_writer.write_vertex_coords(fh, obj, export_params.export_colors);
 
-      if (obj.tot_polygons() > 0) {
-        if (export_params.export_smooth_groups) {
-          obj.calc_smooth_groups(export_params.smooth_groups_bitflags);
-        }
-        if (export_params.export_materials) {
-          obj.calc_poly_order();
-        }
-        if (export_params.export_normals) {
-          obj_writer.write_poly_normals(fh, obj);
-        }
-        if (export_params.export_uv) {
-          obj_writer.write_uv_coords(fh, obj);
-        }
-        /* This function takes a 0-indexed slot index for the obj_mesh object and
-         * returns the material name that we are using in the .obj file for it. */
-        const auto *obj_mtlindices = mtlindices.is_empty() ? nullptr : &mtlindices[i];
-        std::function<const char *(int)> matname_fn = [&](int s) -> const char * {
-          if (!obj_mtlindices || s < 0 || s >= obj_mtlindices->size()) {
-            return nullptr;
-          }
-          return mtl_writer->mtlmaterial_name((*obj_mtlindices)[s]);
-        };
-        obj_writer.write_poly_elements(fh, index_offsets[i], obj, matname_fn);
+    if (obj.tot_polygons() > 0) {
+      if (export_params.export_smooth_groups) {
+        obj.calc_smooth_groups(export_params.smooth_groups_bitflags);
+      }
+      if (export_params.export_materials) {
+        obj.calc_poly_order();
+      }
+      if (export_params.export_normals) {
+        obj_writer.write_poly_normals(fh, obj);
+      }
+      if (export_params.export_uv) {
+        obj_writer.write_uv_coords(fh, obj);
       }
-      obj_writer.write_edges_indices(fh, index_offsets[i], obj);
+      /* This function takes a 0-indexed slot index for the obj_mesh object and
+       * returns the material name that we are using in the .obj file for it. */
+      const auto *obj_mtlindices = mtlindices.is_empty() ? nullptr : &mtlindices[i];
+      std::function<const char *(int)> matname_fn = [&](int s) -> const char * {
+        if (!obj_mtlindices || s < 0 || s >= obj_mtlindices->size()) {
+          return nullptr;
+        }
+        return mtl_writer->mtlmaterial_name((*obj_mtlindices)[s]);
+      };
+      obj_writer.write_poly_elements(fh, index_offsets[i], obj, matname_fn);
+    }
+    obj_writer.write_edges_indices(fh, index_offsets[i], obj);
+
+    /* Nothing will need this object's data after this point, release
+     * various arrays here. */
+    obj.clear();
+  };
+
+  FILE *f = obj_writer.get_outfile();
+  if (export_params.use_streaming) {
+    write_mesh_objects_streaming(count, f, write_object);
+    return;
+  }
 
-      /* Nothing will need this object's data after this point, release
-       * various arrays here. */
-      obj.clear();
+  /* Parallelization is over meshes/objects, which means
+   * we have to have the output text buffer for each object,
+   * and write them all into the file at the end. */
+  std::vector<FormatHandler> buffers(count);
+
+  /* Parallel over meshes: main result writing. */
+  blender::threading::parallel_for(IndexRange(count), 1, [&](IndexRange range) {
+    for (const int i : range) {
+      write_object(i, buffers[i]);
     }
   });
 
   /* Write all the object text buffers into the output file. */
-  FILE *f = obj_writer.get_outfile();
   for (auto &b : buffers) {
     b.write_to_file(f);
   }
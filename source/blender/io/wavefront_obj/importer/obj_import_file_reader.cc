@@ -8,6 +8,7 @@
 #include "BLI_math_color.h"
 #include "BLI_math_vector.h"
 #include "BLI_string_ref.hh"
+#include "BLI_task.hh"
 #include "BLI_vector.hh"
 
 #include "obj_export_mtl.hh"
@@ -217,47 +218,77 @@ static void geom_add_polyline(Geometry *geom,
   }
 }
 
-static void geom_add_polygon(Geometry *geom,
-                             const char *p,
-                             const char *end,
-                             const GlobalVertices &global_vertices,
-                             const int material_index,
-                             const int group_index,
-                             const bool shaded_smooth)
+/**
+ * Parse the corners of a face without resolving the indices, which requires knowing how many
+ * vertices have been read before. Parsing stops at the first corner with an invalid vertex
+ * index, which is still added so that it can be reported later.
+ */
+static void parse_polygon_corners(const char *p, const char *end, Vector<PolyCorner> &r_corners)
 {
-  PolyElem curr_face;
-  curr_face.shaded_smooth = shaded_smooth;
-  curr_face.material_index = material_index;
-  if (group_index >= 0) {
-    curr_face.vertex_group_index = group_index;
-    geom->has_vertex_groups_ = true;
-  }
-
-  const int orig_corners_size = geom->face_corners_.size();
-  curr_face.start_index_ = orig_corners_size;
-
-  bool face_valid = true;
   p = drop_whitespace(p, end);
-  while (p < end && face_valid) {
+  while (p < end) {
     PolyCorner corner;
-    bool got_uv = false, got_normal = false;
+    /* Missing indices are marked like indices that failed to parse. */
+    corner.uv_vert_index = INT32_MAX;
+    corner.vertex_normal_index = INT32_MAX;
     /* Parse vertex index. */
     p = parse_int(p, end, INT32_MAX, corner.vert_index, false);
-    face_valid &= corner.vert_index != INT32_MAX;
     if (p < end && *p == '/') {
       /* Parse UV index. */
       ++p;
       if (p < end && *p != '/') {
         p = parse_int(p, end, INT32_MAX, corner.uv_vert_index, false);
-        got_uv = corner.uv_vert_index != INT32_MAX;
       }
       /* Parse normal index. */
       if (p < end && *p == '/') {
         ++p;
         p = parse_int(p, end, INT32_MAX, corner.vertex_normal_index, false);
-        got_normal = corner.vertex_normal_index != INT32_MAX;
       }
     }
+    r_corners.append(corner);
+    if (corner.vert_index == INT32_MAX) {
+      break;
+    }
+
+    /* Some files contain extra stuff per face (e.g. 4 indices); skip any remainder (#103441). */
+    p = drop_non_whitespace(p, end);
+    /* Skip whitespace to get to the next face corner. */
+    p = drop_whitespace(p, end);
+  }
+}
+
+/**
+ * Add a face from the corners that have been appended to the geometry's face corners starting
+ * at `corners_start` by #parse_polygon_corners. The indices are transformed to be non-negative
+ * and zero-based. If any index is invalid, the corners are removed again.
+ */
+static void geom_add_polygon_corners(Geometry *geom,
+                                     const int corners_start,
+                                     const GlobalVertices &global_vertices,
+                                     const int material_index,
+                                     const int group_index,
+                                     const bool shaded_smooth)
+{
+  PolyElem curr_face;
+  curr_face.shaded_smooth = shaded_smooth;
+  curr_face.material_index = material_index;
+  if (group_index >= 0) {
+    curr_face.vertex_group_index = group_index;
+    geom->has_vertex_groups_ = true;
+  }
+  curr_face.start_index_ = corners_start;
+
+  bool face_valid = true;
+  for (const int corner_i : geom->face_corners_.index_range().drop_front(corners_start)) {
+    PolyCorner &corner = geom->face_corners_[corner_i];
+    const bool got_uv = corner.uv_vert_index != INT32_MAX;
+    const bool got_normal = corner.vertex_normal_index != INT32_MAX;
+    if (!got_uv) {
+      corner.uv_vert_index = -1;
+    }
+    if (!got_normal) {
+      corner.vertex_normal_index = -1;
+    }
     /* Always keep stored indices non-negative and zero-based. */
     corner.vert_index += corner.vert_index < 0 ? global_vertices.vertices.size() : -1;
     if (corner.vert_index < 0 || corner.vert_index >= global_vertices.vertices.size()) {
@@ -298,13 +329,10 @@ static void geom_add_polygon(Geometry *geom,
         face_valid = false;
       }
     }
-    geom->face_corners_.append(corner);
     curr_face.corner_count_++;
-
-    /* Some files contain extra stuff per face (e.g. 4 indices); skip any remainder (#103441). */
-    p = drop_non_whitespace(p, end);
-    /* Skip whitespace to get to the next face corner. */
-    p = drop_whitespace(p, end);
+    if (!face_valid) {
+      break;
+    }
   }
 
   if (face_valid) {
@@ -313,11 +341,25 @@ static void geom_add_polygon(Geometry *geom,
   }
   else {
     /* Remove just-added corners for the invalid face. */
-    geom->face_corners_.resize(orig_corners_size);
+    geom->face_corners_.resize(corners_start);
     geom->has_invalid_polys_ = true;
   }
 }
 
+static void geom_add_polygon(Geometry *geom,
+                             const char *p,
+                             const char *end,
+                             const GlobalVertices &global_vertices,
+                             const int material_index,
+                             const int group_index,
+                             const bool shaded_smooth)
+{
+  const int corners_start = geom->face_corners_.size();
+  parse_polygon_corners(p, end, geom->face_corners_);
+  geom_add_polygon_corners(
+      geom, corners_start, global_vertices, material_index, group_index, shaded_smooth);
+}
+
 static Geometry *geom_set_curve_type(Geometry *geom,
                                      const char *p,
                                      const char *end,
@@ -483,6 +525,368 @@ static void use_all_vertices_if_no_faces(Geometry *geom,
   }
 }
 
+/**
+ * State variables: once set, they remain the same for the remaining
+ * elements in the object.
+ */
+struct OBJParseState {
+  Geometry *curr_geom = nullptr;
+  bool shaded_smooth = false;
+  string group_name;
+  int group_index = -1;
+  string material_name;
+  int material_index = -1;
+};
+
+/**
+ * If we don't have a material index assigned yet, get one.
+ * It means "usemtl" state came from the previous object.
+ */
+static void ensure_face_material_index(OBJParseState &state)
+{
+  if (state.material_index == -1 && !state.material_name.empty() &&
+      state.curr_geom->material_indices_.is_empty())
+  {
+    state.curr_geom->material_indices_.add_new(state.material_name, 0);
+    state.curr_geom->material_order_.append(state.material_name);
+    state.material_index = 0;
+  }
+}
+
+void OBJParser::parse_line(const char *p,
+                           const char *end,
+                           OBJParseState &state,
+                           Vector<std::unique_ptr<Geometry>> &r_all_geometries,
+                           GlobalVertices &r_global_vertices)
+{
+  /* Most common things that start with 'v': vertices, normals, UVs. */
+  if (*p == 'v') {
+    if (parse_keyword(p, end, "v")) {
+      geom_add_vertex(p, end, r_global_vertices);
+    }
+    else if (parse_keyword(p, end, "vn")) {
+      geom_add_vertex_normal(p, end, r_global_vertices);
+    }
+    else if (parse_keyword(p, end, "vt")) {
+      geom_add_uv_vertex(p, end, r_global_vertices);
+    }
+  }
+  /* Faces. */
+  else if (parse_keyword(p, end, "f")) {
+    ensure_face_material_index(state);
+    geom_add_polygon(state.curr_geom,
+                     p,
+                     end,
+                     r_global_vertices,
+                     state.material_index,
+                     state.group_index,
+                     state.shaded_smooth);
+  }
+  /* Faces. */
+  else if (parse_keyword(p, end, "l")) {
+    geom_add_polyline(state.curr_geom, p, end, r_global_vertices);
+  }
+  /* Objects. */
+  else if (parse_keyword(p, end, "o")) {
+    if (import_params_.use_split_objects) {
+      geom_new_object(p,
+                      end,
+                      state.shaded_smooth,
+                      state.group_name,
+                      state.material_index,
+                      state.curr_geom,
+                      r_all_geometries);
+    }
+  }
+  /* Groups. */
+  else if (parse_keyword(p, end, "g")) {
+    if (import_params_.use_split_groups) {
+      geom_new_object(p,
+                      end,
+                      state.shaded_smooth,
+                      state.group_name,
+                      state.material_index,
+                      state.curr_geom,
+                      r_all_geometries);
+    }
+    else {
+      geom_update_group(StringRef(p, end).trim(), state.group_name);
+      int new_index = state.curr_geom->group_indices_.size();
+      state.group_index = state.curr_geom->group_indices_.lookup_or_add(state.group_name,
+                                                                        new_index);
+      if (new_index == state.group_index) {
+        state.curr_geom->group_order_.append(state.group_name);
+      }
+    }
+  }
+  /* Smoothing groups. */
+  else if (parse_keyword(p, end, "s")) {
+    geom_update_smooth_group(p, end, state.shaded_smooth);
+  }
+  /* Materials and their libraries. */
+  else if (parse_keyword(p, end, "usemtl")) {
+    state.material_name = StringRef(p, end).trim();
+    int new_mat_index = state.curr_geom->material_indices_.size();
+    state.material_index = state.curr_geom->material_indices_.lookup_or_add(state.material_name,
+                                                                            new_mat_index);
+    if (new_mat_index == state.material_index) {
+      state.curr_geom->material_order_.append(state.material_name);
+    }
+  }
+  else if (parse_keyword(p, end, "mtllib")) {
+    add_mtl_library(StringRef(p, end).trim());
+  }
+  else if (parse_keyword(p, end, "#MRGB")) {
+    geom_add_mrgb_colors(p, end, r_global_vertices);
+  }
+  /* Comments. */
+  else if (*p == '#') {
+    /* Nothing to do. */
+  }
+  /* Curve related things. */
+  else if (parse_keyword(p, end, "cstype")) {
+    state.curr_geom = geom_set_curve_type(
+        state.curr_geom, p, end, state.group_name, r_all_geometries);
+  }
+  else if (parse_keyword(p, end, "deg")) {
+    geom_set_curve_degree(state.curr_geom, p, end);
+  }
+  else if (parse_keyword(p, end, "curv")) {
+    geom_add_curve_vertex_indices(state.curr_geom, p, end, r_global_vertices);
+  }
+  else if (parse_keyword(p, end, "parm")) {
+    geom_add_curve_parameters(state.curr_geom, p, end);
+  }
+  else if (StringRef(p, end).startswith("end")) {
+    /* End of curve definition, nothing else to do. */
+  }
+  else {
+    std::cout << "OBJ element not recognized: '" << std::string(p, end) << "'" << std::endl;
+  }
+}
+
+void OBJParser::parse_lines(StringRef buffer,
+                            OBJParseState &state,
+                            Vector<std::unique_ptr<Geometry>> &r_all_geometries,
+                            GlobalVertices &r_global_vertices,
+                            size_t &r_line_number)
+{
+  while (!buffer.is_empty()) {
+    StringRef line = read_next_line(buffer);
+    const char *p = line.begin(), *end = line.end();
+    p = drop_whitespace(p, end);
+    ++r_line_number;
+    if (p == end) {
+      continue;
+    }
+    parse_line(p, end, state, r_all_geometries, r_global_vertices);
+  }
+}
+
+/**
+ * Result of parsing a part of the file on a separate thread. Vertex data and faces are parsed
+ * independently of the rest of the file. All other lines depend on or change the parser state,
+ * so they are only stored to be parsed afterwards in file order.
+ */
+struct OBJParsedChunk {
+  /** Vertex data, vertex color blocks start at indices relative to the chunk. */
+  GlobalVertices vertices;
+  /** Corners of all faces in the chunk, see #parse_polygon_corners. */
+  Vector<PolyCorner> face_corners;
+
+  struct Line {
+    /** Text of the line when it is not a face. */
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    /** Range in #face_corners for faces. */
+    IndexRange face_corners;
+    bool is_face = false;
+    /** Number of vertex elements of the chunk that come before this line. */
+    int vertices_num = 0;
+    int uv_vertices_num = 0;
+    int vert_normals_num = 0;
+  };
+  /** Lines that have to be parsed in file order, including all faces. */
+  Vector<Line> lines;
+  size_t lines_num = 0;
+};
+
+static void parse_chunk(StringRef buffer, OBJParsedChunk &r_chunk)
+{
+  GlobalVertices &vertices = r_chunk.vertices;
+  while (!buffer.is_empty()) {
+    StringRef line = read_next_line(buffer);
+    const char *p = line.begin(), *end = line.end();
+    p = drop_whitespace(p, end);
+    ++r_chunk.lines_num;
+    if (p == end) {
+      continue;
+    }
+    if (*p == 'v') {
+      if (parse_keyword(p, end, "v")) {
+        geom_add_vertex(p, end, vertices);
+      }
+      else if (parse_keyword(p, end, "vn")) {
+        geom_add_vertex_normal(p, end, vertices);
+      }
+      else if (parse_keyword(p, end, "vt")) {
+        geom_add_uv_vertex(p, end, vertices);
+      }
+      continue;
+    }
+    if (*p == '#') {
+      const char *comment = p;
+      if (!parse_keyword(comment, end, "#MRGB")) {
+        continue;
+      }
+    }
+    OBJParsedChunk::Line chunk_line;
+    chunk_line.vertices_num = vertices.vertices.size();
+    chunk_line.uv_vertices_num = vertices.uv_vertices.size();
+    chunk_line.vert_normals_num = vertices.vert_normals.size();
+    if (parse_keyword(p, end, "f")) {
+      const int corners_start = r_chunk.face_corners.size();
+      parse_polygon_corners(p, end, r_chunk.face_corners);
+      chunk_line.face_corners = r_chunk.face_corners.index_range().drop_front(corners_start);
+      chunk_line.is_face = true;
+    }
+    else {
+      chunk_line.begin = p;
+      chunk_line.end = end;
+    }
+    r_chunk.lines.append(chunk_line);
+  }
+}
+
+/**
+ * Append vertex colors for consecutive vertices, extending the last block if possible.
+ */
+static void append_vertex_colors(const int start_vertex_index,
+                                 const Span<float3> colors,
+                                 GlobalVertices &r_global_vertices)
+{
+  auto &blocks = r_global_vertices.vertex_colors;
+  if (blocks.is_empty() ||
+      (blocks.last().start_vertex_index + blocks.last().colors.size() != start_vertex_index))
+  {
+    GlobalVertices::VertexColorsBlock block;
+    block.start_vertex_index = start_vertex_index;
+    blocks.append(block);
+  }
+  blocks.last().colors.extend(colors);
+}
+
+/** Keeps track of how much of a parsed chunk's vertex data has been added already. */
+struct OBJChunkVerticesCursor {
+  int vertices_num = 0;
+  int uv_vertices_num = 0;
+  int vert_normals_num = 0;
+  int color_block = 0;
+  int colors_num_in_block = 0;
+};
+
+/**
+ * Add the vertex data of the chunk up to the given counts to the global vertices, so that
+ * following lines see the same vertex data as when the file is parsed line by line.
+ */
+static void append_chunk_vertices(const GlobalVertices &chunk_vertices,
+                                  const int vertices_num,
+                                  const int uv_vertices_num,
+                                  const int vert_normals_num,
+                                  OBJChunkVerticesCursor &cursor,
+                                  GlobalVertices &r_global_vertices)
+{
+  const int vertex_offset = r_global_vertices.vertices.size() - cursor.vertices_num;
+  r_global_vertices.vertices.extend(chunk_vertices.vertices.as_span().slice(
+      cursor.vertices_num, vertices_num - cursor.vertices_num));
+  r_global_vertices.uv_vertices.extend(chunk_vertices.uv_vertices.as_span().slice(
+      cursor.uv_vertices_num, uv_vertices_num - cursor.uv_vertices_num));
+  r_global_vertices.vert_normals.extend(chunk_vertices.vert_normals.as_span().slice(
+      cursor.vert_normals_num, vert_normals_num - cursor.vert_normals_num));
+  cursor.vertices_num = vertices_num;
+  cursor.uv_vertices_num = uv_vertices_num;
+  cursor.vert_normals_num = vert_normals_num;
+
+  while (cursor.color_block < chunk_vertices.vertex_colors.size()) {
+    const GlobalVertices::VertexColorsBlock &block =
+        chunk_vertices.vertex_colors[cursor.color_block];
+    const int start_vertex = block.start_vertex_index + cursor.colors_num_in_block;
+    if (start_vertex >= vertices_num) {
+      break;
+    }
+    const int colors_num = std::min<int>(block.colors.size() - cursor.colors_num_in_block,
+                                         vertices_num - start_vertex);
+    append_vertex_colors(vertex_offset + start_vertex,
+                         block.colors.as_span().slice(cursor.colors_num_in_block, colors_num),
+                         r_global_vertices);
+    cursor.colors_num_in_block += colors_num;
+    if (cursor.colors_num_in_block == block.colors.size()) {
+      cursor.color_block++;
+      cursor.colors_num_in_block = 0;
+    }
+  }
+}
+
+void OBJParser::parse_lines_multithreaded(StringRef buffer,
+                                          OBJParseState &state,
+                                          Vector<std::unique_ptr<Geometry>> &r_all_geometries,
+                                          GlobalVertices &r_global_vertices,
+                                          size_t &r_line_number)
+{
+  /* Split the buffer into chunks that end with a newline. */
+  Vector<StringRef> chunk_buffers;
+  while (!buffer.is_empty()) {
+    const int64_t min_size = std::min<int64_t>(read_buffer_size_, buffer.size());
+    const int64_t last_nl = buffer.find('\n', min_size - 1);
+    const int64_t chunk_size = last_nl == StringRef::not_found ? buffer.size() : last_nl + 1;
+    chunk_buffers.append(buffer.substr(0, chunk_size));
+    buffer = buffer.drop_prefix(chunk_size);
+  }
+
+  Array<OBJParsedChunk> chunks(chunk_buffers.size());
+  threading::parallel_for(chunks.index_range(), 1, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      parse_chunk(chunk_buffers[i], chunks[i]);
+    }
+  });
+
+  /* Add the parsed data in file order. Everything that depends on the parser state or on the
+   * number of elements read so far is handled here. */
+  for (const OBJParsedChunk &chunk : chunks) {
+    OBJChunkVerticesCursor cursor;
+    for (const OBJParsedChunk::Line &line : chunk.lines) {
+      append_chunk_vertices(chunk.vertices,
+                            line.vertices_num,
+                            line.uv_vertices_num,
+                            line.vert_normals_num,
+                            cursor,
+                            r_global_vertices);
+      if (line.is_face) {
+        ensure_face_material_index(state);
+        Geometry *geom = state.curr_geom;
+        const int corners_start = geom->face_corners_.size();
+        geom->face_corners_.extend(chunk.face_corners.as_span().slice(line.face_corners));
+        geom_add_polygon_corners(geom,
+                                 corners_start,
+                                 r_global_vertices,
+                                 state.material_index,
+                                 state.group_index,
+                                 state.shaded_smooth);
+      }
+      else {
+        parse_line(line.begin, line.end, state, r_all_geometries, r_global_vertices);
+      }
+    }
+    append_chunk_vertices(chunk.vertices,
+                          chunk.vertices.vertices.size(),
+                          chunk.vertices.uv_vertices.size(),
+                          chunk.vertices.vert_normals.size(),
+                          cursor,
+                          r_global_vertices);
+    r_line_number += chunk.lines_num;
+  }
+}
+
 void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
                       GlobalVertices &r_global_vertices)
 {
@@ -495,25 +899,24 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
   STRNCPY(ob_name, BLI_path_basename(import_params_.filepath));
   BLI_path_extension_strip(ob_name);
 
-  Geometry *curr_geom = create_geometry(nullptr, GEOM_MESH, ob_name, r_all_geometries);
+  OBJParseState state;
+  state.curr_geom = create_geometry(nullptr, GEOM_MESH, ob_name, r_all_geometries);
 
-  /* State variables: once set, they remain the same for the remaining
-   * elements in the object. */
-  bool state_shaded_smooth = false;
-  string state_group_name;
-  int state_group_index = -1;
-  string state_material_name;
-  int state_material_index = -1;
+  /* When parsing on multiple threads, every read is split into chunks of the read buffer size
+   * that are parsed in parallel. */
+  const bool use_multithreading = import_params_.use_multithreading;
+  const size_t read_size = use_multithreading ? read_buffer_size_ * multithreaded_chunks_per_read :
+                                                read_buffer_size_;
 
   /* Read the input file in chunks. We need up to twice the possible chunk size,
    * to possibly store remainder of the previous input line that got broken mid-chunk. */
-  Array<char> buffer(read_buffer_size_ * 2);
+  Array<char> buffer(read_size * 2);
 
   size_t buffer_offset = 0;
   size_t line_number = 0;
   while (true) {
     /* Read a chunk of input from the file. */
-    size_t bytes_read = fread(buffer.data() + buffer_offset, 1, read_buffer_size_, obj_file_);
+    size_t bytes_read = fread(buffer.data() + buffer_offset, 1, read_size, obj_file_);
     if (bytes_read == 0 && buffer_offset == 0) {
       break; /* No more data to read. */
     }
@@ -524,7 +927,7 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
                              buffer.data() + buffer_offset + bytes_read);
 
     /* Ensure buffer ends in a newline. */
-    if (bytes_read < read_buffer_size_) {
+    if (bytes_read < read_size) {
       if (bytes_read == 0 || buffer[buffer_offset + bytes_read - 1] != '\n') {
         buffer[buffer_offset + bytes_read] = '\n';
         bytes_read++;
@@ -549,133 +952,19 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
       fprintf(stderr,
               "OBJ file contains a line #%zu that is too long (max. length %zu)\n",
               line_number,
-              read_buffer_size_);
+              read_size);
       break;
     }
     ++last_nl;
 
-    /* Parse the buffer (until last newline) that we have so far,
-     * line by line. */
+    /* Parse the buffer (until last newline) that we have so far. */
     StringRef buffer_str{buffer.data(), int64_t(last_nl)};
-    while (!buffer_str.is_empty()) {
-      StringRef line = read_next_line(buffer_str);
-      const char *p = line.begin(), *end = line.end();
-      p = drop_whitespace(p, end);
-      ++line_number;
-      if (p == end) {
-        continue;
-      }
-      /* Most common things that start with 'v': vertices, normals, UVs. */
-      if (*p == 'v') {
-        if (parse_keyword(p, end, "v")) {
-          geom_add_vertex(p, end, r_global_vertices);
-        }
-        else if (parse_keyword(p, end, "vn")) {
-          geom_add_vertex_normal(p, end, r_global_vertices);
-        }
-        else if (parse_keyword(p, end, "vt")) {
-          geom_add_uv_vertex(p, end, r_global_vertices);
-        }
-      }
-      /* Faces. */
-      else if (parse_keyword(p, end, "f")) {
-        /* If we don't have a material index assigned yet, get one.
-         * It means "usemtl" state came from the previous object. */
-        if (state_material_index == -1 && !state_material_name.empty() &&
-            curr_geom->material_indices_.is_empty())
-        {
-          curr_geom->material_indices_.add_new(state_material_name, 0);
-          curr_geom->material_order_.append(state_material_name);
-          state_material_index = 0;
-        }
-
-        geom_add_polygon(curr_geom,
-                         p,
-                         end,
-                         r_global_vertices,
-                         state_material_index,
-                         state_group_index,
-                         state_shaded_smooth);
-      }
-      /* Faces. */
-      else if (parse_keyword(p, end, "l")) {
-        geom_add_polyline(curr_geom, p, end, r_global_vertices);
-      }
-      /* Objects. */
-      else if (parse_keyword(p, end, "o")) {
-        if (import_params_.use_split_objects) {
-          geom_new_object(p,
-                          end,
-                          state_shaded_smooth,
-                          state_group_name,
-                          state_material_index,
-                          curr_geom,
-                          r_all_geometries);
-        }
-      }
-      /* Groups. */
-      else if (parse_keyword(p, end, "g")) {
-        if (import_params_.use_split_groups) {
-          geom_new_object(p,
-                          end,
-                          state_shaded_smooth,
-                          state_group_name,
-                          state_material_index,
-                          curr_geom,
-                          r_all_geometries);
-        }
-        else {
-          geom_update_group(StringRef(p, end).trim(), state_group_name);
-          int new_index = curr_geom->group_indices_.size();
-          state_group_index = curr_geom->group_indices_.lookup_or_add(state_group_name, new_index);
-          if (new_index == state_group_index) {
-            curr_geom->group_order_.append(state_group_name);
-          }
-        }
-      }
-      /* Smoothing groups. */
-      else if (parse_keyword(p, end, "s")) {
-        geom_update_smooth_group(p, end, state_shaded_smooth);
-      }
-      /* Materials and their libraries. */
-      else if (parse_keyword(p, end, "usemtl")) {
-        state_material_name = StringRef(p, end).trim();
-        int new_mat_index = curr_geom->material_indices_.size();
-        state_material_index = curr_geom->material_indices_.lookup_or_add(state_material_name,
-                                                                          new_mat_index);
-        if (new_mat_index == state_material_index) {
-          curr_geom->material_order_.append(state_material_name);
-        }
-      }
-      else if (parse_keyword(p, end, "mtllib")) {
-        add_mtl_library(StringRef(p, end).trim());
-      }
-      else if (parse_keyword(p, end, "#MRGB")) {
-        geom_add_mrgb_colors(p, end, r_global_vertices);
-      }
-      /* Comments. */
-      else if (*p == '#') {
-        /* Nothing to do. */
-      }
-      /* Curve related things. */
-      else if (parse_keyword(p, end, "cstype")) {
-        curr_geom = geom_set_curve_type(curr_geom, p, end, state_group_name, r_all_geometries);
-      }
-      else if (parse_keyword(p, end, "deg")) {
-        geom_set_curve_degree(curr_geom, p, end);
-      }
-      else if (parse_keyword(p, end, "curv")) {
-        geom_add_curve_vertex_indices(curr_geom, p, end, r_global_vertices);
-      }
-      else if (parse_keyword(p, end, "parm")) {
-        geom_add_curve_parameters(curr_geom, p, end);
-      }
-      else if (StringRef(p, end).startswith("end")) {
-        /* End of curve definition, nothing else to do. */
-      }
-      else {
-        std::cout << "OBJ element not recognized: '" << std::string(p, end) << "'" << std::endl;
-      }
+    if (use_multithreading) {
+      parse_lines_multithreaded(
+          buffer_str, state, r_all_geometries, r_global_vertices, line_number);
+    }
+    else {
+      parse_lines(buffer_str, state, r_all_geometries, r_global_vertices, line_number);
     }
 
     /* We might have a line that was cut in the middle by the previous buffer;
@@ -685,7 +974,7 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
     buffer_offset = left_size;
   }
 
-  use_all_vertices_if_no_faces(curr_geom, r_all_geometries, r_global_vertices);
+  use_all_vertices_if_no_faces(state.curr_geom, r_all_geometries, r_global_vertices);
   add_default_mtl_library();
 }
 
@@ -13,6 +13,8 @@
 
 namespace blender::io::obj {
 
+struct OBJParseState;
+
 /* NOTE: the OBJ parser implementation is planned to get fairly large changes "soon",
  * so don't read too much into current implementation... */
 class OBJParser {
@@ -22,6 +24,12 @@ class OBJParser {
   Vector<std::string> mtl_libraries_;
   size_t read_buffer_size_;
 
+  /**
+   * When parsing on multiple threads, this many chunks of the read buffer size are read at once
+   * and parsed in parallel.
+   */
+  static constexpr size_t multithreaded_chunks_per_read = 256;
+
  public:
   /**
    * Open OBJ file at the path given in import parameters.
@@ -43,6 +51,34 @@ class OBJParser {
  private:
   void add_mtl_library(StringRef path);
   void add_default_mtl_library();
+
+  /**
+   * Parse a single line, starting after leading white-space.
+   */
+  void parse_line(const char *p,
+                  const char *end,
+                  OBJParseState &state,
+                  Vector<std::unique_ptr<Geometry>> &r_all_geometries,
+                  GlobalVertices &r_global_vertices);
+  /**
+   * Parse all lines in the buffer one after another.
+   */
+  void parse_lines(StringRef buffer,
+                   OBJParseState &state,
+                   Vector<std::unique_ptr<Geometry>> &r_all_geometries,
+                   GlobalVertices &r_global_vertices,
+                   size_t &r_line_number);
+  /**
+   * Parse all lines in the buffer with the same result as #parse_lines. The buffer is split into
+   * chunks of whole lines. Vertices and faces are parsed in parallel per chunk, then the chunks
+   * are merged in order, resolving element indices and handling all lines that depend on the
+   * parser state.
+   */
+  void parse_lines_multithreaded(StringRef buffer,
+                                 OBJParseState &state,
+                                 Vector<std::unique_ptr<Geometry>> &r_all_geometries,
+                                 GlobalVertices &r_global_vertices,
+                                 size_t &r_line_number);
 };
 
 class MTLParser {
@@ -1,10 +1,12 @@
 /* SPDX-License-Identifier: Apache-2.0 */
 
+#include <atomic>
 #include <gtest/gtest.h>
 #include <ios>
 #include <memory>
 #include <string>
 #include <system_error>
+#include <thread>
 
 #include "testing/testing.h"
 #include "tests/blendfile_loading_base_test.h"
@@ -25,6 +27,7 @@
 #include "obj_export_file_writer.hh"
 #include "obj_export_mesh.hh"
 #include "obj_export_nurbs.hh"
+#include "obj_export_stream.hh"
 #include "obj_exporter.hh"
 
 #include "obj_exporter_tests.hh"
@@ -229,6 +232,49 @@ parm u 0.0
   ASSERT_EQ(got_string, expected);
 }
 
+TEST_F(ObjExporterWriterTest, export_stream_order)
+{
+  const std::string out_file_path = get_temp_obj_filename();
+  FILE *file = BLI_fopen(out_file_path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+
+  /* Push many small blocks from multiple threads, with a tiny queue size, so that threads have to
+   * wait for the writer. Objects are started in order, like the exporter does. */
+  const int objects_num = 20;
+  const int blocks_per_object = 50;
+  {
+    OBJExportStream stream(file, objects_num, 2, 3);
+    std::atomic<int> next_object = 0;
+    auto push_objects = [&]() {
+      for (int object = next_object++; object < objects_num; object = next_object++) {
+        for (const int block_i : IndexRange(blocks_per_object)) {
+          const std::string text = fmt::format("o {} {}\n", object, block_i);
+          Vector<char> block;
+          block.extend(Span<char>(text.data(), text.size()));
+          stream.push_block(object, std::move(block));
+        }
+        stream.finish_object(object);
+      }
+    };
+    std::thread thread_a(push_objects);
+    std::thread thread_b(push_objects);
+    thread_a.join();
+    thread_b.join();
+    const OBJExportStream::Stats stats = stream.finish();
+    EXPECT_EQ(stats.blocks_written, objects_num * blocks_per_object);
+    EXPECT_LE(stats.max_blocks_queued, 2 * 3);
+  }
+  fclose(file);
+
+  std::string expected;
+  for (const int object : IndexRange(objects_num)) {
+    for (const int block_i : IndexRange(blocks_per_object)) {
+      expected += fmt::format("o {} {}\n", object, block_i);
+    }
+  }
+  EXPECT_EQ(read_temp_file_in_string(out_file_path), expected);
+}
+
 /* Return true if string #a and string #b are equal after their first newline. */
 static bool strings_equal_after_first_lines(const std::string &a, const std::string &b)
 {
@@ -281,17 +327,23 @@ class obj_exporter_regression_test : public obj_exporter_test {
     std::string golden_file_path = blender::tests::flags_test_asset_dir() + SEP_STR + golden_obj;
     BLI_path_split_dir_part(
         golden_file_path.c_str(), params.file_base_for_tests, sizeof(params.file_base_for_tests));
-    export_frame(depsgraph, params, out_file_path.c_str());
-    std::string output_str = read_temp_file_in_string(out_file_path);
-
     std::string golden_str = read_temp_file_in_string(golden_file_path);
-    bool are_equal = strings_equal_after_first_lines(output_str, golden_str);
-    if (save_failing_test_output && !are_equal) {
-      printf("failing test output in %s\n", out_file_path.c_str());
-    }
-    ASSERT_TRUE(are_equal);
-    if (!save_failing_test_output || are_equal) {
-      BLI_delete(out_file_path.c_str(), false, false);
+    bool are_equal = false;
+    /* Streaming the output has to give the same result. */
+    for (const bool use_streaming : {false, true}) {
+      SCOPED_TRACE(use_streaming ? "streaming" : "not streaming");
+      params.use_streaming = use_streaming;
+      export_frame(depsgraph, params, out_file_path.c_str());
+      std::string output_str = read_temp_file_in_string(out_file_path);
+
+      are_equal = strings_equal_after_first_lines(output_str, golden_str);
+      if (save_failing_test_output && !are_equal) {
+        printf("failing test output in %s\n", out_file_path.c_str());
+      }
+      ASSERT_TRUE(are_equal);
+      if (!save_failing_test_output || are_equal) {
+        BLI_delete(out_file_path.c_str(), false, false);
+      }
     }
     if (!golden_mtl.empty()) {
       std::string out_mtl_file_path = tempdir + BLI_path_basename(golden_mtl.c_str());
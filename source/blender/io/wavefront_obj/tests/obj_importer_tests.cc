@@ -61,12 +61,33 @@ class obj_importer_test : public BlendfileLoadingBaseTest {
     params.import_vertex_groups = false;
     params.relative_paths = true;
     params.clear_selection = true;
+    params.use_multithreading = false;
   }
+
+  /**
+   * Import the file with both the single and multi-threaded parser, the results have to be the
+   * same.
+   */
   void import_and_check(const char *path,
                         const Expectation *expect,
                         size_t expect_count,
                         int expect_mat_count,
                         int expect_image_count = 0)
+  {
+    for (const bool use_multithreading : {false, true}) {
+      SCOPED_TRACE(use_multithreading ? "multithreaded" : "single threaded");
+      params.use_multithreading = use_multithreading;
+      import_and_check_once(path, expect, expect_count, expect_mat_count, expect_image_count);
+      depsgraph_free();
+      blendfile_free();
+    }
+  }
+
+  void import_and_check_once(const char *path,
+                             const Expectation *expect,
+                             size_t expect_count,
+                             int expect_mat_count,
+                             int expect_image_count)
   {
     if (!blendfile_load("io_tests" SEP_STR "blend_geometry" SEP_STR "all_quads.blend")) {
       ADD_FAILURE();
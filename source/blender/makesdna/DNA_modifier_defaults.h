@@ -560,7 +560,11 @@
   }
 
 #define _DNA_DEFAULT_NodesModifierData \
-  { 0 }
+  { \
+    .flag = 0, \
+    .eval_cache_memory_budget = 256, \
+    .eval_cache_min_execution_time = 0.5f, \
+  }
 
 #define _DNA_DEFAULT_SkinModifierData \
   { \
@@ -2329,7 +2329,19 @@ typedef struct NodesModifierData {
    * Directory where baked simulation states are stored. This may be relative to the .blend file.
    */
   char *simulation_bake_directory;
-  void *_pad;
+
+  /** #NodesModifierFlag. */
+  int flag;
+  /** Maximum memory in MiB used by the outputs kept in the evaluation cache. */
+  int eval_cache_memory_budget;
+  /** Nodes that took less time than this (in milliseconds) to evaluate are not cached. */
+  float eval_cache_min_execution_time;
+  char _pad[4];
+
+  /**
+   * Outputs of expensive nodes from previous evaluations. Only allocated on the original modifier.
+   */
+  void *runtime_eval_cache;
 
   /**
    * Contains logged information from the last evaluation.
@@ -2340,6 +2352,12 @@ typedef struct NodesModifierData {
   ModifierSimulationCacheHandle *simulation_cache;
 } NodesModifierData;
 
+/** #NodesModifierData.flag */
+typedef enum NodesModifierFlag {
+  /** Reuse the outputs of expensive nodes from previous evaluations. */
+  NODES_MODIFIER_USE_EVAL_CACHE = (1 << 0),
+} NodesModifierFlag;
+
 typedef struct MeshToVolumeModifierData {
   ModifierData modifier;
 
@@ -679,7 +679,10 @@ typedef struct UserDef_Experimental {
   char enable_overlay_next;
   char enable_workbench_next;
   char use_new_volume_nodes;
-  char _pad[4];
+  char use_threaded_blend_write;
+  char use_threaded_blend_read;
+  char use_lazy_blend_data;
+  char _pad[1];
   /** `makesdna` does not allow empty structs. */
 } UserDef_Experimental;
 
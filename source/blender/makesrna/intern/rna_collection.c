@@ -382,7 +382,7 @@ static void rna_Collection_flag_update(Main *bmain, Scene *scene, PointerRNA *pt
   BKE_main_collection_sync(bmain);
 
   DEG_id_tag_update(&collection->id, ID_RECALC_COPY_ON_WRITE);
-  DEG_relations_tag_update(bmain);
+  DEG_collection_tag_relations_update(bmain, collection);
   WM_main_add_notifier(NC_SCENE | ND_OB_SELECT, scene);
 }
 
@@ -340,7 +340,7 @@ static void rna_LayerCollection_exclude_update(Main *bmain, Scene *UNUSED(scene)
     FOREACH_OBJECT_END;
   }
 
-  DEG_relations_tag_update(bmain);
+  DEG_collection_tag_relations_update(bmain, lc->collection);
   WM_main_add_notifier(NC_SCENE | ND_LAYER_CONTENT, NULL);
   if (exclude) {
     ED_object_base_active_refresh(bmain, scene, view_layer);
@@ -1691,6 +1691,44 @@ static void rna_NodesModifier_node_group_update(Main *bmain, Scene *scene, Point
   MOD_nodes_update_interface(object, nmd);
 }
 
+static void rna_NodesModifier_use_eval_cache_update(Main *bmain, Scene *scene, PointerRNA *ptr)
+{
+  NodesModifierData *nmd = ptr->data;
+  if ((nmd->flag & NODES_MODIFIER_USE_EVAL_CACHE) == 0) {
+    /* Don't keep the cached geometry around when it won't be used anymore. */
+    MOD_nodes_eval_cache_free(nmd);
+  }
+  rna_Modifier_update(bmain, scene, ptr);
+}
+
+static int rna_NodesModifier_eval_cache_hits_get(PointerRNA *ptr)
+{
+  NodesModifierEvalCacheStats stats;
+  MOD_nodes_eval_cache_stats_get(ptr->data, &stats);
+  return stats.hits;
+}
+
+static int rna_NodesModifier_eval_cache_misses_get(PointerRNA *ptr)
+{
+  NodesModifierEvalCacheStats stats;
+  MOD_nodes_eval_cache_stats_get(ptr->data, &stats);
+  return stats.misses;
+}
+
+static int rna_NodesModifier_eval_cache_evictions_get(PointerRNA *ptr)
+{
+  NodesModifierEvalCacheStats stats;
+  MOD_nodes_eval_cache_stats_get(ptr->data, &stats);
+  return stats.evictions;
+}
+
+static float rna_NodesModifier_eval_cache_memory_usage_get(PointerRNA *ptr)
+{
+  NodesModifierEvalCacheStats stats;
+  MOD_nodes_eval_cache_stats_get(ptr->data, &stats);
+  return stats.memory_usage;
+}
+
 static IDProperty **rna_NodesModifier_properties(PointerRNA *ptr)
 {
   NodesModifierData *nmd = ptr->data;
@@ -7052,7 +7090,60 @@ static void rna_def_modifier_nodes(BlenderRNA *brna)
       prop, "Simulation Bake Directory", "Location on disk where the bake data is stored");
   RNA_def_property_update(prop, 0, NULL);
 
+  prop = RNA_def_property(srna, "use_eval_cache", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", NODES_MODIFIER_USE_EVAL_CACHE);
+  RNA_def_property_ui_text(prop,
+                           "Evaluation Cache",
+                           "Reuse the outputs of expensive nodes from previous evaluations when "
+                           "their inputs did not change");
+  RNA_def_property_update(prop, 0, "rna_NodesModifier_use_eval_cache_update");
+
+  prop = RNA_def_property(srna, "eval_cache_memory_budget", PROP_INT, PROP_NONE);
+  RNA_def_property_range(prop, 1, INT_MAX);
+  RNA_def_property_ui_range(prop, 16, 16384, 16, -1);
+  RNA_def_property_ui_text(prop,
+                           "Memory Budget",
+                           "Maximum memory in MiB used by the evaluation cache, least recently "
+                           "used outputs are removed when it is exceeded");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "eval_cache_min_execution_time", PROP_FLOAT, PROP_NONE);
+  RNA_def_property_range(prop, 0.0f, FLT_MAX);
+  RNA_def_property_ui_range(prop, 0.0f, 1000.0f, 10, 2);
+  RNA_def_property_ui_text(prop,
+                           "Minimum Execution Time",
+                           "Only cache the outputs of nodes that took longer than this to "
+                           "evaluate, in milliseconds");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
   RNA_define_lib_overridable(false);
+
+  prop = RNA_def_property(srna, "eval_cache_hits", PROP_INT, PROP_NONE);
+  RNA_def_property_int_funcs(prop, "rna_NodesModifier_eval_cache_hits_get", NULL, NULL);
+  RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+  RNA_def_property_ui_text(
+      prop, "Evaluation Cache Hits", "Number of node evaluations that reused cached outputs");
+
+  prop = RNA_def_property(srna, "eval_cache_misses", PROP_INT, PROP_NONE);
+  RNA_def_property_int_funcs(prop, "rna_NodesModifier_eval_cache_misses_get", NULL, NULL);
+  RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+  RNA_def_property_ui_text(prop,
+                           "Evaluation Cache Misses",
+                           "Number of evaluations of expensive nodes that had no cached outputs");
+
+  prop = RNA_def_property(srna, "eval_cache_evictions", PROP_INT, PROP_NONE);
+  RNA_def_property_int_funcs(prop, "rna_NodesModifier_eval_cache_evictions_get", NULL, NULL);
+  RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+  RNA_def_property_ui_text(prop,
+                           "Evaluation Cache Evictions",
+                           "Number of cached outputs that were removed to stay within the "
+                           "memory budget");
+
+  prop = RNA_def_property(srna, "eval_cache_memory_usage", PROP_FLOAT, PROP_NONE);
+  RNA_def_property_float_funcs(prop, "rna_NodesModifier_eval_cache_memory_usage_get", NULL, NULL);
+  RNA_def_property_clear_flag(prop, PROP_EDITABLE);
+  RNA_def_property_ui_text(
+      prop, "Evaluation Cache Memory", "Estimated memory used by the evaluation cache in MiB");
 }
 
 static void rna_def_modifier_mesh_to_volume(BlenderRNA *brna)
@@ -368,7 +368,7 @@ static void rna_Object_hide_update(Main *bmain, Scene *UNUSED(scene), PointerRNA
   Object *ob = (Object *)ptr->owner_id;
   BKE_main_collection_sync_remap(bmain);
   DEG_id_tag_update(&ob->id, ID_RECALC_COPY_ON_WRITE);
-  DEG_relations_tag_update(bmain);
+  DEG_id_tag_relations_update(bmain, &ob->id);
   WM_main_add_notifier(NC_OBJECT | ND_DRAW, &ob->id);
 }
 
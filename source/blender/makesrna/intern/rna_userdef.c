@@ -6715,6 +6715,25 @@ static void rna_def_userdef_experimental(BlenderRNA *brna)
   prop = RNA_def_property(srna, "use_new_volume_nodes", PROP_BOOLEAN, PROP_NONE);
   RNA_def_property_ui_text(
       prop, "New Volume Nodes", "Enables visibility of the new Volume nodes in the UI");
+
+  prop = RNA_def_property(srna, "use_threaded_blend_write", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_ui_text(prop,
+                           "Multi-Threaded File Writing",
+                           "Serialize geometry data-blocks on multiple threads when saving "
+                           ".blend files");
+
+  prop = RNA_def_property(srna, "use_threaded_blend_read", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_ui_text(prop,
+                           "Multi-Threaded File Reading",
+                           "Read geometry data-blocks on multiple threads when loading .blend "
+                           "files");
+
+  prop = RNA_def_property(srna, "use_lazy_blend_data", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_ui_text(prop,
+                           "Lazy File Data Loading",
+                           "Reference large mesh attribute arrays in uncompressed .blend files "
+                           "instead of reading them, so that they are only loaded from disk when "
+                           "accessed");
 }
 
 static void rna_def_userdef_addon_collection(BlenderRNA *brna, PropertyRNA *cprop)
@@ -16,6 +16,24 @@ extern "C" {
  */
 void MOD_nodes_update_interface(struct Object *object, struct NodesModifierData *nmd);
 
+typedef struct NodesModifierEvalCacheStats {
+  int hits;
+  int misses;
+  int evictions;
+  int entries_num;
+  /** Estimated memory used by the cached values in MiB. */
+  float memory_usage;
+} NodesModifierEvalCacheStats;
+
+/**
+ * Statistics of the evaluation cache of the original modifier, all zero when the cache has not
+ * been used yet. See #NODES_MODIFIER_USE_EVAL_CACHE.
+ */
+void MOD_nodes_eval_cache_stats_get(const struct NodesModifierData *nmd,
+                                    NodesModifierEvalCacheStats *r_stats);
+/** Free the evaluation cache of the original modifier, e.g. when it has been disabled. */
+void MOD_nodes_eval_cache_free(struct NodesModifierData *nmd);
+
 #ifdef __cplusplus
 }
 #endif
@@ -87,6 +87,7 @@
 #include "ED_viewer_path.hh"
 
 #include "NOD_geometry.h"
+#include "NOD_geometry_nodes_eval_cache.hh"
 #include "NOD_geometry_nodes_lazy_function.hh"
 #include "NOD_node_declaration.hh"
 
@@ -770,6 +771,30 @@ void MOD_nodes_update_interface(Object *object, NodesModifierData *nmd)
   DEG_id_tag_update(&object->id, ID_RECALC_GEOMETRY);
 }
 
+void MOD_nodes_eval_cache_stats_get(const NodesModifierData *nmd,
+                                    NodesModifierEvalCacheStats *r_stats)
+{
+  using namespace blender;
+  *r_stats = {};
+  if (nmd->runtime_eval_cache == nullptr) {
+    return;
+  }
+  const nodes::GeometryNodesEvalCacheStats stats =
+      static_cast<const nodes::GeometryNodesEvalCache *>(nmd->runtime_eval_cache)->stats();
+  r_stats->hits = int(std::min<int64_t>(stats.hits, INT_MAX));
+  r_stats->misses = int(std::min<int64_t>(stats.misses, INT_MAX));
+  r_stats->evictions = int(std::min<int64_t>(stats.evictions, INT_MAX));
+  r_stats->entries_num = int(stats.entries_num);
+  r_stats->memory_usage = float(double(stats.memory_usage) / (1024 * 1024));
+}
+
+void MOD_nodes_eval_cache_free(NodesModifierData *nmd)
+{
+  using namespace blender;
+  MEM_delete(static_cast<nodes::GeometryNodesEvalCache *>(nmd->runtime_eval_cache));
+  nmd->runtime_eval_cache = nullptr;
+}
+
 namespace blender {
 
 static void initialize_group_input(const bNodeTree &tree,
@@ -1272,8 +1297,12 @@ static GeometrySet compute_geometry(const bNodeTree &btree,
   nodes::GeometryNodesLazyFunctionLogger lf_logger(lf_graph_info);
   nodes::GeometryNodesLazyFunctionSideEffectProvider lf_side_effect_provider;
 
-  lf::GraphExecutor graph_executor{
-      lf_graph_info.graph, graph_inputs, graph_outputs, &lf_logger, &lf_side_effect_provider};
+  lf::GraphExecutor graph_executor{lf_graph_info.graph,
+                                   graph_inputs,
+                                   graph_outputs,
+                                   &lf_logger,
+                                   &lf_side_effect_provider,
+                                   nodes::lazy_function_graph_scheduling(lf_graph_info)};
 
   nodes::GeoNodesModifierData geo_nodes_modifier_data;
   geo_nodes_modifier_data.depsgraph = ctx->depsgraph;
@@ -1292,6 +1321,18 @@ static GeometrySet compute_geometry(const bNodeTree &btree,
   MultiValueMap<ComputeContextHash, const lf::FunctionNode *> r_side_effect_nodes;
   find_side_effect_nodes(*nmd, *ctx, r_side_effect_nodes);
   geo_nodes_modifier_data.side_effect_nodes = &r_side_effect_nodes;
+  /* Other depsgraphs, e.g. for rendering, usually don't evaluate the same tree repeatedly. */
+  if ((nmd->flag & NODES_MODIFIER_USE_EVAL_CACHE) && DEG_is_active(ctx->depsgraph)) {
+    if (nmd_orig->runtime_eval_cache == nullptr) {
+      nmd_orig->runtime_eval_cache = MEM_new<nodes::GeometryNodesEvalCache>(__func__);
+    }
+    nodes::GeometryNodesEvalCache &eval_cache = *static_cast<nodes::GeometryNodesEvalCache *>(
+        nmd_orig->runtime_eval_cache);
+    eval_cache.set_memory_budget(int64_t(nmd->eval_cache_memory_budget) * 1024 * 1024);
+    eval_cache.set_min_execution_time(std::chrono::duration_cast<timeit::Nanoseconds>(
+        std::chrono::duration<float, std::milli>(nmd->eval_cache_min_execution_time)));
+    geo_nodes_modifier_data.eval_cache = &eval_cache;
+  }
   nodes::GeoNodesLFUserData user_data;
   user_data.modifier_data = &geo_nodes_modifier_data;
   bke::ModifierComputeContext modifier_compute_context{nullptr, nmd->modifier.name};
@@ -1988,6 +2029,43 @@ static void internal_dependencies_panel_draw(const bContext * /*C*/, Panel *pane
   }
 }
 
+static void eval_cache_panel_header_draw(const bContext * /*C*/, Panel *panel)
+{
+  uiLayout *layout = panel->layout;
+
+  PointerRNA *ptr = modifier_panel_get_property_pointers(panel, nullptr);
+
+  uiItemR(layout, ptr, "use_eval_cache", 0, IFACE_("Evaluation Cache"), ICON_NONE);
+}
+
+static void eval_cache_panel_draw(const bContext * /*C*/, Panel *panel)
+{
+  uiLayout *layout = panel->layout;
+
+  PointerRNA *ptr = modifier_panel_get_property_pointers(panel, nullptr);
+  NodesModifierData *nmd = static_cast<NodesModifierData *>(ptr->data);
+
+  uiLayoutSetPropSep(layout, true);
+  uiLayoutSetActive(layout, RNA_boolean_get(ptr, "use_eval_cache"));
+  uiItemR(layout, ptr, "eval_cache_memory_budget", 0, nullptr, ICON_NONE);
+  uiItemR(layout, ptr, "eval_cache_min_execution_time", 0, nullptr, ICON_NONE);
+
+  if (nmd->runtime_eval_cache == nullptr) {
+    return;
+  }
+  NodesModifierEvalCacheStats stats;
+  MOD_nodes_eval_cache_stats_get(nmd, &stats);
+  char text[256];
+  SNPRINTF(text,
+           TIP_("%d hits, %d misses, %d evictions"),
+           stats.hits,
+           stats.misses,
+           stats.evictions);
+  uiItemL(layout, text, ICON_NONE);
+  SNPRINTF(text, TIP_("%d entries, %.1f MiB"), stats.entries_num, stats.memory_usage);
+  uiItemL(layout, text, ICON_NONE);
+}
+
 static void panelRegister(ARegionType *region_type)
 {
   using namespace blender;
@@ -2004,6 +2082,12 @@ static void panelRegister(ARegionType *region_type)
                              nullptr,
                              internal_dependencies_panel_draw,
                              panel_type);
+  modifier_subpanel_register(region_type,
+                             "eval_cache",
+                             "",
+                             eval_cache_panel_header_draw,
+                             eval_cache_panel_draw,
+                             panel_type);
 }
 
 static void blendWrite(BlendWriter *writer, const ID * /*id_owner*/, const ModifierData *md)
@@ -2061,6 +2145,7 @@ static void blendRead(BlendDataReader *reader, ModifierData *md)
     IDP_BlendDataRead(reader, &nmd->settings.properties);
   }
   nmd->runtime_eval_log = nullptr;
+  nmd->runtime_eval_cache = nullptr;
   nmd->simulation_cache = nullptr;
 }
 
@@ -2072,6 +2157,7 @@ static void copyData(const ModifierData *md, ModifierData *target, const int fla
   BKE_modifier_copydata_generic(md, target, flag);
 
   tnmd->runtime_eval_log = nullptr;
+  tnmd->runtime_eval_cache = nullptr;
   tnmd->simulation_cache = nullptr;
   tnmd->simulation_bake_directory = nmd->simulation_bake_directory ?
                                         BLI_strdup(nmd->simulation_bake_directory) :
@@ -2091,6 +2177,7 @@ static void freeData(ModifierData *md)
   }
 
   MEM_delete(nmd->simulation_cache);
+  MEM_delete(static_cast<nodes::GeometryNodesEvalCache *>(nmd->runtime_eval_cache));
   MEM_SAFE_FREE(nmd->simulation_bake_directory);
 
   clear_runtime_data(nmd);
@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#pragma once
+
+/** \file
+ * \ingroup nodes
+ *
+ * The evaluation cache keeps the outputs of expensive geometry nodes from previous evaluations of
+ * a modifier. When the same node is evaluated again with the same inputs, e.g. because only a
+ * later part of the node tree or an unrelated input changed, the outputs are reused instead of
+ * being computed again.
+ *
+ * Only nodes that took a while to compute in a previous evaluation take part in caching. Keeping
+ * references to the inputs of a node makes them shared, so nodes can't modify them in-place
+ * anymore, which would make cheap nodes slower.
+ *
+ * Entries are keyed on the compute context of the node, the node itself and a hash of its inputs.
+ * To avoid expensive comparisons of geometry data, inputs are compared by identity where possible:
+ * geometries by their implicitly shared components and fields by their field nodes. Entries keep
+ * references to the compared data, so it can't be freed or modified while the entry exists.
+ */
+
+#include <mutex>
+
+#include "BLI_compute_context.hh"
+#include "BLI_generic_pointer.hh"
+#include "BLI_map.hh"
+#include "BLI_timeit.hh"
+
+#include "FN_lazy_function.hh"
+
+struct bNode;
+
+namespace blender::nodes {
+
+namespace lf = fn::lazy_function;
+
+struct GeometryNodesEvalCacheStats {
+  /** Number of node evaluations that reused outputs from the cache. */
+  int64_t hits = 0;
+  /** Number of node evaluations that could be cached but had no matching entry. */
+  int64_t misses = 0;
+  /** Number of entries that have been added or evicted because of the memory budget. */
+  int64_t stores = 0;
+  int64_t evictions = 0;
+  /** Current number of entries and their estimated memory usage in bytes. */
+  int64_t entries_num = 0;
+  int64_t memory_usage = 0;
+};
+
+class GeometryNodesEvalCache : NonCopyable, NonMovable {
+ public:
+  static constexpr int64_t default_memory_budget = 256 * 1024 * 1024;
+  static constexpr timeit::Nanoseconds default_min_execution_time = std::chrono::microseconds(500);
+  /**
+   * Compute contexts change when node groups are edited, so execution times of nodes that are not
+   * evaluated anymore have to be removed at some point.
+   */
+  static constexpr int64_t max_execution_times_num = 16 * 1024;
+
+  struct Key {
+    ComputeContextHash context_hash;
+    int32_t node_id = 0;
+    uint64_t inputs_hash = 0;
+
+    uint64_t hash() const;
+    friend bool operator==(const Key &a, const Key &b);
+  };
+
+  struct Entry;
+
+ private:
+  mutable std::mutex mutex_;
+  Map<Key, std::unique_ptr<Entry>> entries_;
+  /**
+   * Execution time of the last evaluation of expensive nodes, used to decide which nodes to cache.
+   * Nodes that were faster than #min_execution_time_ are not stored.
+   */
+  Map<std::pair<ComputeContextHash, int32_t>, timeit::Nanoseconds> last_execution_times_;
+  int64_t memory_budget_ = default_memory_budget;
+  timeit::Nanoseconds min_execution_time_ = default_min_execution_time;
+  /** Used to find the least recently used entries when the memory budget is exceeded. */
+  uint64_t use_counter_ = 0;
+  GeometryNodesEvalCacheStats stats_;
+
+  friend class CachedNodeEvaluation;
+
+ public:
+  GeometryNodesEvalCache();
+  ~GeometryNodesEvalCache();
+
+  /**
+   * Maximum estimated memory used by all entries. Least recently used entries are removed when
+   * it is exceeded.
+   */
+  void set_memory_budget(int64_t bytes);
+  /** Nodes that are faster to compute than this are not stored in the cache. */
+  void set_min_execution_time(timeit::Nanoseconds duration);
+
+  GeometryNodesEvalCacheStats stats() const;
+  void clear();
+
+  /**
+   * False for nodes whose outputs do not only depend on their inputs and settings, e.g. because
+   * they access other objects or the current frame.
+   */
+  static bool is_node_supported(const bNode &node);
+
+ private:
+  bool is_expensive(const ComputeContextHash &context_hash, const bNode &node) const;
+  void add_entry(const Key &key, std::unique_ptr<Entry> entry);
+  void remove_least_recently_used();
+};
+
+/**
+ * Wraps a single evaluation of a node with the cache. All inputs of the node have to be available
+ * already. They are copied before the node is executed, because the node may move them.
+ */
+class CachedNodeEvaluation : NonCopyable, NonMovable {
+ private:
+  class RecordingParams;
+
+  GeometryNodesEvalCache &cache_;
+  const bNode &node_;
+  lf::Params &params_;
+  GeometryNodesEvalCache::Key key_;
+  bool is_cacheable_ = true;
+  Vector<uint8_t> settings_;
+  Vector<GMutablePointer> inputs_;
+  std::unique_ptr<RecordingParams> recording_params_;
+
+ public:
+  CachedNodeEvaluation(GeometryNodesEvalCache &cache,
+                       const ComputeContextHash &context_hash,
+                       const bNode &node,
+                       lf::Params &params);
+  ~CachedNodeEvaluation();
+
+  /**
+   * False when the node was not expensive before or when the inputs can't be compared to previous
+   * inputs. The node is executed normally then.
+   */
+  bool is_cacheable() const;
+
+  /**
+   * Set all outputs that have not been set yet from a matching cache entry. Returns false when
+   * there is no entry for the current inputs.
+   */
+  bool try_output_cached();
+
+  /**
+   * The node has to use these params when it is executed, so that the outputs can be stored.
+   */
+  lf::Params &params_for_execution();
+
+  /**
+   * Has to be called after the node has been executed. The recorded outputs are added to the cache
+   * if computing them took long enough.
+   */
+  void finish(timeit::Nanoseconds execution_time);
+
+ private:
+  bool entry_matches(const GeometryNodesEvalCache::Entry &entry, Span<int> output_indices) const;
+};
+
+}  // namespace blender::nodes
@@ -36,6 +36,8 @@ namespace blender::nodes {
 using lf::LazyFunction;
 using mf::MultiFunction;
 
+class GeometryNodesEvalCache;
+
 /**
  * Data that is passed into geometry nodes evaluation from the modifier.
  */
@@ -69,6 +71,10 @@ struct GeoNodesModifierData {
    * If this is null, all socket values will be logged.
    */
   const Set<ComputeContextHash> *socket_log_contexts = nullptr;
+  /**
+   * Optional cache that allows reusing the outputs of expensive nodes from previous evaluations.
+   */
+  GeometryNodesEvalCache *eval_cache = nullptr;
 };
 
 /**
@@ -301,4 +307,12 @@ class GeometryNodesLazyFunctionSideEffectProvider
 const GeometryNodesLazyFunctionGraphInfo *ensure_geometry_nodes_lazy_function_graph(
     const bNodeTree &btree);
 
+/**
+ * Decides how the nodes of the lazy-function graph are distributed over threads. Large graphs
+ * usually contain many cheap nodes that can be evaluated independently, which benefits from work
+ * stealing.
+ */
+lf::GraphExecutor::Scheduling lazy_function_graph_scheduling(
+    const GeometryNodesLazyFunctionGraphInfo &lf_graph_info);
+
 }  // namespace blender::nodes
@@ -28,6 +28,15 @@ const FloatMathOperationInfo *get_float_math_operation_info(int operation);
 const FloatMathOperationInfo *get_float3_math_operation_info(int operation);
 const FloatMathOperationInfo *get_float_compare_operation_info(int operation);
 
+/**
+ * Returns a multi-function that computes the same as `fn` but uses explicit SIMD instructions,
+ * if that is supported for the operation. Otherwise `fn` itself is returned. `fn` is used as
+ * fallback and has to be the same for every call with the same operation.
+ */
+const mf::MultiFunction &get_simd_float_math_function(int operation, const mf::MultiFunction &fn);
+const mf::MultiFunction &get_simd_float3_math_function(int operation,
+                                                       const mf::MultiFunction &fn);
+
 /**
  * This calls the `callback` with two arguments:
  * 1. The math function that takes a float as input and outputs a new float.
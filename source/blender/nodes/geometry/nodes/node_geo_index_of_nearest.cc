@@ -23,25 +23,37 @@ static KDTree_3d *build_kdtree(const Span<float3> positions, const IndexMask &ma
   KDTree_3d *tree = BLI_kdtree_3d_new(mask.size());
   mask.foreach_index(
       [&](const int index) { BLI_kdtree_3d_insert(tree, index, positions[index]); });
-  BLI_kdtree_3d_balance(tree);
+  BLI_kdtree_3d_balance_ex(tree, true);
   return tree;
 }
 
-static int find_nearest_non_self(const KDTree_3d &tree, const float3 &position, const int index)
-{
-  return BLI_kdtree_3d_find_nearest_cb_cpp(
-      &tree, position, 0, [index](const int other, const float * /*co*/, const float /*dist_sq*/) {
-        return index == other ? 0 : 1;
-      });
-}
-
 static void find_neighbors(const KDTree_3d &tree,
                            const Span<float3> positions,
                            const IndexMask &mask,
                            MutableSpan<int> r_indices)
 {
-  mask.foreach_index(GrainSize(1024), [&](const int index) {
-    r_indices[index] = find_nearest_non_self(tree, positions[index], index);
+  if (mask.is_empty()) {
+    return;
+  }
+
+  Array<float3> query_positions(mask.size());
+  mask.foreach_index(GrainSize(4096), [&](const int index, const int pos) {
+    query_positions[pos] = positions[index];
+  });
+
+  /* Every point is in the tree itself, so find two points and skip the one with the same index.
+   * Other points at the same position may come first, which are nearest as well. */
+  Array<KDTreeNearest_3d> nearest(mask.size() * 2);
+  BLI_kdtree_3d_find_nearest_n_batch(&tree,
+                                     reinterpret_cast<const float(*)[3]>(query_positions.data()),
+                                     int(mask.size()),
+                                     nearest.data(),
+                                     2,
+                                     nullptr);
+
+  mask.foreach_index(GrainSize(4096), [&](const int index, const int pos) {
+    const int nearest_index = nearest[pos * 2].index;
+    r_indices[index] = (nearest_index == index) ? nearest[pos * 2 + 1].index : nearest_index;
   });
 }
 
@@ -135,22 +135,29 @@ static void raycast_to_mesh(const IndexMask &mask,
   /* We shouldn't be rebuilding the BVH tree when calling this function in parallel. */
   BLI_assert(tree_data.cached);
 
-  mask.foreach_index([&](const int i) {
-    const float ray_length = ray_lengths[i];
-    const float3 ray_origin = ray_origins[i];
-    const float3 ray_direction = ray_directions[i];
-
-    BVHTreeRayHit hit;
-    hit.index = -1;
-    hit.dist = ray_length;
-    if (BLI_bvhtree_ray_cast(tree_data.tree,
-                             ray_origin,
-                             ray_direction,
-                             0.0f,
-                             &hit,
-                             tree_data.raycast_callback,
-                             &tree_data) != -1)
-    {
+  /* Cast all rays at once, so that they are traversed in coherent packets. */
+  Array<float3> origins(mask.size());
+  Array<float3> directions(mask.size());
+  Array<BVHTreeRayHit> hits(mask.size());
+  ray_origins.materialize_compressed_to_uninitialized(mask, origins.as_mutable_span());
+  ray_directions.materialize_compressed_to_uninitialized(mask, directions.as_mutable_span());
+  mask.foreach_index([&](const int i, const int pos) {
+    hits[pos].index = -1;
+    hits[pos].dist = ray_lengths[i];
+  });
+
+  BLI_bvhtree_ray_cast_batch_cpp(*tree_data.tree,
+                                 origins,
+                                 directions,
+                                 0.0f,
+                                 hits,
+                                 tree_data.raycast_callback,
+                                 tree_data.raycast_packet_callback,
+                                 &tree_data);
+
+  mask.foreach_index([&](const int i, const int pos) {
+    const BVHTreeRayHit &hit = hits[pos];
+    if (hit.index != -1) {
       if (!r_hit.is_empty()) {
         r_hit[i] = hit.index >= 0;
       }
@@ -182,7 +189,7 @@ static void raycast_to_mesh(const IndexMask &mask,
         r_hit_normals[i] = float3(0.0f, 0.0f, 0.0f);
       }
       if (!r_hit_distances.is_empty()) {
-        r_hit_distances[i] = ray_length;
+        r_hit_distances[i] = ray_lengths[i];
       }
     }
   });
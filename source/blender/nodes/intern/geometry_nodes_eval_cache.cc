@@ -0,0 +1,600 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_hash.hh"
+
+#include "DNA_node_types.h"
+
+#include "BKE_anonymous_attribute_id.hh"
+#include "BKE_customdata.h"
+#include "BKE_geometry_set.hh"
+#include "BKE_instances.hh"
+#include "BKE_node.h"
+#include "BKE_node_runtime.hh"
+
+#include "FN_field_cpp_type.hh"
+
+#include "NOD_geometry_nodes_eval_cache.hh"
+
+namespace blender::nodes {
+
+using fn::ValueOrFieldCPPType;
+
+struct GeometryNodesEvalCache::Entry {
+  /** Copied node settings that were used to compute the outputs. */
+  Vector<uint8_t> settings;
+  /** Copies of the inputs that were used to compute the outputs. */
+  Vector<GMutablePointer> inputs;
+  /** Computed outputs, the data pointer is null when an output was not computed. */
+  Array<GMutablePointer> outputs;
+  int64_t memory_usage = 0;
+  uint64_t last_use = 0;
+
+  ~Entry()
+  {
+    for (GMutablePointer value : inputs) {
+      value.destruct();
+      MEM_freeN(value.get());
+    }
+    for (GMutablePointer value : outputs) {
+      if (value.get() != nullptr) {
+        value.destruct();
+        MEM_freeN(value.get());
+      }
+    }
+  }
+};
+
+uint64_t GeometryNodesEvalCache::Key::hash() const
+{
+  return get_default_hash_3(context_hash.hash(), node_id, inputs_hash);
+}
+
+bool operator==(const GeometryNodesEvalCache::Key &a, const GeometryNodesEvalCache::Key &b)
+{
+  return a.context_hash == b.context_hash && a.node_id == b.node_id &&
+         a.inputs_hash == b.inputs_hash;
+}
+
+GeometryNodesEvalCache::GeometryNodesEvalCache() = default;
+
+GeometryNodesEvalCache::~GeometryNodesEvalCache() = default;
+
+void GeometryNodesEvalCache::set_memory_budget(const int64_t bytes)
+{
+  std::lock_guard lock{mutex_};
+  memory_budget_ = bytes;
+  while (stats_.memory_usage > memory_budget_ && !entries_.is_empty()) {
+    this->remove_least_recently_used();
+  }
+}
+
+void GeometryNodesEvalCache::set_min_execution_time(const timeit::Nanoseconds duration)
+{
+  std::lock_guard lock{mutex_};
+  min_execution_time_ = duration;
+}
+
+GeometryNodesEvalCacheStats GeometryNodesEvalCache::stats() const
+{
+  std::lock_guard lock{mutex_};
+  return stats_;
+}
+
+void GeometryNodesEvalCache::clear()
+{
+  std::lock_guard lock{mutex_};
+  entries_.clear();
+  last_execution_times_.clear();
+  stats_.entries_num = 0;
+  stats_.memory_usage = 0;
+}
+
+bool GeometryNodesEvalCache::is_node_supported(const bNode &node)
+{
+  if (ELEM(node.type,
+           GEO_NODE_OBJECT_INFO,
+           GEO_NODE_COLLECTION_INFO,
+           GEO_NODE_SELF_OBJECT,
+           GEO_NODE_INPUT_SCENE_TIME,
+           GEO_NODE_IS_VIEWPORT,
+           GEO_NODE_DEFORM_CURVES_ON_SURFACE,
+           GEO_NODE_IMAGE,
+           GEO_NODE_IMAGE_INFO,
+           GEO_NODE_IMAGE_TEXTURE,
+           GEO_NODE_SIMULATION_INPUT,
+           GEO_NODE_SIMULATION_OUTPUT,
+           GEO_NODE_VIEWER))
+  {
+    return false;
+  }
+  if (node.id != nullptr) {
+    return false;
+  }
+  for (const bNodeSocket *socket : node.input_sockets()) {
+    if (ELEM(socket->type,
+             SOCK_OBJECT,
+             SOCK_COLLECTION,
+             SOCK_TEXTURE,
+             SOCK_IMAGE,
+             SOCK_MATERIAL))
+    {
+      /* The referenced data-blocks may change without changing the pointer. */
+      return false;
+    }
+  }
+  return true;
+}
+
+bool GeometryNodesEvalCache::is_expensive(const ComputeContextHash &context_hash,
+                                          const bNode &node) const
+{
+  std::lock_guard lock{mutex_};
+  const timeit::Nanoseconds *last_time = last_execution_times_.lookup_ptr(
+      {context_hash, node.identifier});
+  return last_time != nullptr && *last_time >= min_execution_time_;
+}
+
+void GeometryNodesEvalCache::add_entry(const Key &key, std::unique_ptr<Entry> entry)
+{
+  if (entry->memory_usage > memory_budget_) {
+    return;
+  }
+  entry->last_use = use_counter_++;
+  stats_.memory_usage += entry->memory_usage;
+  stats_.stores++;
+  entries_.add_or_modify(
+      key,
+      [&](std::unique_ptr<Entry> *value) {
+        new (value) std::unique_ptr<Entry>(std::move(entry));
+        stats_.entries_num++;
+      },
+      [&](std::unique_ptr<Entry> *value) {
+        /* The inputs of a node changed in a way that does not change the hash. */
+        stats_.memory_usage -= (*value)->memory_usage;
+        *value = std::move(entry);
+      });
+  while (stats_.memory_usage > memory_budget_) {
+    this->remove_least_recently_used();
+  }
+}
+
+void GeometryNodesEvalCache::remove_least_recently_used()
+{
+  std::optional<Key> oldest_key;
+  uint64_t oldest_use = UINT64_MAX;
+  for (const auto item : entries_.items()) {
+    if (item.value->last_use < oldest_use) {
+      oldest_use = item.value->last_use;
+      oldest_key = item.key;
+    }
+  }
+  BLI_assert(oldest_key.has_value());
+  std::unique_ptr<Entry> entry = entries_.pop(*oldest_key);
+  /* The node has to be found to be expensive again before it is cached again. */
+  last_execution_times_.remove({oldest_key->context_hash, oldest_key->node_id});
+  stats_.memory_usage -= entry->memory_usage;
+  stats_.entries_num--;
+  stats_.evictions++;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Comparing Values
+ *
+ * Geometries are compared by the identity of their components. Components are implicitly shared
+ * and can't be modified while they are referenced by a cache entry, so comparing the pointers is
+ * enough.
+ * \{ */
+
+/**
+ * Object and collection instances reference data that can change without changing the geometry
+ * itself.
+ */
+static bool geometry_is_self_contained(const GeometrySet &geometry)
+{
+  if (!geometry.owns_direct_data()) {
+    return false;
+  }
+  if (const bke::Instances *instances = geometry.get_instances_for_read()) {
+    for (const bke::InstanceReference &reference : instances->references()) {
+      switch (reference.type()) {
+        case bke::InstanceReference::Type::None:
+          break;
+        case bke::InstanceReference::Type::Object:
+        case bke::InstanceReference::Type::Collection:
+          return false;
+        case bke::InstanceReference::Type::GeometrySet:
+          if (!geometry_is_self_contained(reference.geometry_set())) {
+            return false;
+          }
+          break;
+      }
+    }
+  }
+  return true;
+}
+
+static bool value_is_cacheable(const CPPType &type, const void *value)
+{
+  if (type.is<GeometrySet>()) {
+    return geometry_is_self_contained(*static_cast<const GeometrySet *>(value));
+  }
+  if (type.is<bke::AnonymousAttributeSet>()) {
+    return true;
+  }
+  if (const ValueOrFieldCPPType *value_or_field_type = ValueOrFieldCPPType::get_from_self(type)) {
+    return value_or_field_type->is_field(value) ||
+           value_or_field_type->value.is_equality_comparable();
+  }
+  return type.is_equality_comparable();
+}
+
+static uint64_t hash_value(const CPPType &type, const void *value)
+{
+  if (type.is<GeometrySet>()) {
+    uint64_t hash = 0;
+    for (const GeometryComponent *component :
+         static_cast<const GeometrySet *>(value)->get_components_for_read())
+    {
+      hash = hash * 33 ^ get_default_hash(component);
+    }
+    return hash;
+  }
+  if (type.is<bke::AnonymousAttributeSet>()) {
+    const auto &set = *static_cast<const bke::AnonymousAttributeSet *>(value);
+    if (!set.names) {
+      return 0;
+    }
+    /* The order of the names is arbitrary. */
+    uint64_t hash = 0;
+    for (const std::string &name : *set.names) {
+      hash += get_default_hash(name);
+    }
+    return hash;
+  }
+  if (const ValueOrFieldCPPType *value_or_field_type = ValueOrFieldCPPType::get_from_self(type)) {
+    if (value_or_field_type->is_field(value)) {
+      return value_or_field_type->get_field_ptr(value)->hash();
+    }
+    return value_or_field_type->value.hash_or_fallback(value_or_field_type->get_value_ptr(value),
+                                                       0);
+  }
+  return type.hash_or_fallback(value, 0);
+}
+
+static bool values_equal(const CPPType &type, const void *a, const void *b)
+{
+  if (type.is<GeometrySet>()) {
+    return static_cast<const GeometrySet *>(a)->get_components_for_read() ==
+           static_cast<const GeometrySet *>(b)->get_components_for_read();
+  }
+  if (type.is<bke::AnonymousAttributeSet>()) {
+    const bke::AnonymousAttributeSet &set_a = *static_cast<const bke::AnonymousAttributeSet *>(a);
+    const bke::AnonymousAttributeSet &set_b = *static_cast<const bke::AnonymousAttributeSet *>(b);
+    if (!set_a.names || !set_b.names) {
+      return !set_a.names && !set_b.names;
+    }
+    return *set_a.names == *set_b.names;
+  }
+  if (const ValueOrFieldCPPType *value_or_field_type = ValueOrFieldCPPType::get_from_self(type)) {
+    const bool is_field_a = value_or_field_type->is_field(a);
+    const bool is_field_b = value_or_field_type->is_field(b);
+    if (is_field_a || is_field_b) {
+      return is_field_a && is_field_b &&
+             *value_or_field_type->get_field_ptr(a) == *value_or_field_type->get_field_ptr(b);
+    }
+    return value_or_field_type->value.is_equal_or_false(value_or_field_type->get_value_ptr(a),
+                                                        value_or_field_type->get_value_ptr(b));
+  }
+  return type.is_equal_or_false(a, b);
+}
+
+static GMutablePointer copy_value(const CPPType &type, const void *value)
+{
+  void *buffer = MEM_mallocN_aligned(type.size(), type.alignment(), __func__);
+  type.copy_construct(value, buffer);
+  return {type, buffer};
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Memory Usage
+ * \{ */
+
+static int64_t estimate_geometry_memory(const GeometrySet &geometry)
+{
+  int64_t size = 0;
+  for (const GeometryComponent *component : geometry.get_components_for_read()) {
+    if (const std::optional<bke::AttributeAccessor> attributes = component->attributes()) {
+      attributes->for_all(
+          [&](const bke::AttributeIDRef & /*id*/, const bke::AttributeMetaData &meta_data) {
+            const CPPType *type = bke::custom_data_type_to_cpp_type(meta_data.data_type);
+            if (type != nullptr) {
+              size += int64_t(attributes->domain_size(meta_data.domain)) * type->size();
+            }
+            return true;
+          });
+    }
+  }
+  if (const bke::Instances *instances = geometry.get_instances_for_read()) {
+    for (const bke::InstanceReference &reference : instances->references()) {
+      if (reference.type() == bke::InstanceReference::Type::GeometrySet) {
+        size += estimate_geometry_memory(reference.geometry_set());
+      }
+    }
+  }
+  return size;
+}
+
+static int64_t estimate_memory_usage(const GMutablePointer value)
+{
+  if (value.type()->is<GeometrySet>()) {
+    return estimate_geometry_memory(*value.get<GeometrySet>());
+  }
+  return value.type()->size();
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Cached Node Evaluation
+ * \{ */
+
+/**
+ * Forwards everything to the params of the node, but keeps a copy of every output before it is
+ * passed on.
+ */
+class CachedNodeEvaluation::RecordingParams : public lf::Params {
+ private:
+  lf::Params &params_;
+
+ public:
+  /** The data pointer is null for outputs that have not been set. */
+  Array<GMutablePointer> outputs;
+
+  RecordingParams(lf::Params &params)
+      : lf::Params(params.fn_, false), params_(params), outputs(params.fn_.outputs().size())
+  {
+  }
+
+  ~RecordingParams()
+  {
+    for (GMutablePointer value : outputs) {
+      if (value.get() != nullptr) {
+        value.destruct();
+        MEM_freeN(value.get());
+      }
+    }
+  }
+
+ private:
+  void *try_get_input_data_ptr_impl(const int index) const override
+  {
+    return params_.try_get_input_data_ptr(index);
+  }
+
+  void *try_get_input_data_ptr_or_request_impl(const int index) override
+  {
+    return params_.try_get_input_data_ptr_or_request(index);
+  }
+
+  void *get_output_data_ptr_impl(const int index) override
+  {
+    return params_.get_output_data_ptr(index);
+  }
+
+  void output_set_impl(const int index) override
+  {
+    /* The value is passed on to other nodes immediately, so it has to be copied before. */
+    const CPPType &type = *fn_.outputs()[index].type;
+    outputs[index] = copy_value(type, params_.get_output_data_ptr(index));
+    params_.output_set(index);
+  }
+
+  bool output_was_set_impl(const int index) const override
+  {
+    return params_.output_was_set(index);
+  }
+
+  lf::ValueUsage get_output_usage_impl(const int index) const override
+  {
+    return params_.get_output_usage(index);
+  }
+
+  void set_input_unused_impl(const int index) override
+  {
+    params_.set_input_unused(index);
+  }
+
+  bool try_enable_multi_threading_impl() override
+  {
+    return params_.try_enable_multi_threading();
+  }
+};
+
+static void append_bytes(Vector<uint8_t> &bytes, const void *data, const int64_t size)
+{
+  bytes.extend(Span(static_cast<const uint8_t *>(data), size));
+}
+
+CachedNodeEvaluation::CachedNodeEvaluation(GeometryNodesEvalCache &cache,
+                                           const ComputeContextHash &context_hash,
+                                           const bNode &node,
+                                           lf::Params &params)
+    : cache_(cache), node_(node), params_(params)
+{
+  key_.context_hash = context_hash;
+  key_.node_id = node.identifier;
+
+  if (!cache.is_expensive(context_hash, node)) {
+    is_cacheable_ = false;
+    return;
+  }
+
+  const Span<lf::Input> fn_inputs = params.fn_.inputs();
+  for (const int i : fn_inputs.index_range()) {
+    const CPPType &type = *fn_inputs[i].type;
+    const void *value = params.try_get_input_data_ptr(i);
+    BLI_assert(value != nullptr);
+    if (!value_is_cacheable(type, value)) {
+      is_cacheable_ = false;
+      return;
+    }
+  }
+
+  /* Settings that are not exposed as sockets. They are compared byte-wise, which may result in
+   * false cache misses but never in wrong results. */
+  append_bytes(settings_, &node.typeinfo, sizeof(node.typeinfo));
+  append_bytes(settings_, &node.custom1, sizeof(node.custom1));
+  append_bytes(settings_, &node.custom2, sizeof(node.custom2));
+  append_bytes(settings_, &node.custom3, sizeof(node.custom3));
+  append_bytes(settings_, &node.custom4, sizeof(node.custom4));
+  if (node.storage != nullptr) {
+    append_bytes(settings_, node.storage, int64_t(MEM_allocN_len(node.storage)));
+  }
+
+  uint64_t inputs_hash = get_default_hash(settings_.size());
+  for (const uint8_t byte : settings_) {
+    inputs_hash = inputs_hash * 33 ^ byte;
+  }
+  inputs_.reserve(fn_inputs.size());
+  for (const int i : fn_inputs.index_range()) {
+    const CPPType &type = *fn_inputs[i].type;
+    const void *value = params.try_get_input_data_ptr(i);
+    inputs_hash = get_default_hash_2(inputs_hash, hash_value(type, value));
+    inputs_.append(copy_value(type, value));
+  }
+  key_.inputs_hash = inputs_hash;
+}
+
+CachedNodeEvaluation::~CachedNodeEvaluation()
+{
+  for (GMutablePointer value : inputs_) {
+    value.destruct();
+    MEM_freeN(value.get());
+  }
+}
+
+bool CachedNodeEvaluation::is_cacheable() const
+{
+  return is_cacheable_;
+}
+
+bool CachedNodeEvaluation::try_output_cached()
+{
+  BLI_assert(is_cacheable_);
+  const Span<lf::Output> fn_outputs = params_.fn_.outputs();
+  Vector<int> output_indices;
+  for (const int i : fn_outputs.index_range()) {
+    if (params_.get_output_usage(i) != lf::ValueUsage::Unused && !params_.output_was_set(i)) {
+      output_indices.append(i);
+    }
+  }
+
+  {
+    std::lock_guard lock{cache_.mutex_};
+    const std::unique_ptr<GeometryNodesEvalCache::Entry> *entry_ptr = cache_.entries_.lookup_ptr(
+        key_);
+    if (entry_ptr == nullptr || !this->entry_matches(**entry_ptr, output_indices)) {
+      cache_.stats_.misses++;
+      return false;
+    }
+    const GeometryNodesEvalCache::Entry &entry = **entry_ptr;
+    for (const int i : output_indices) {
+      entry.outputs[i].type()->copy_construct(entry.outputs[i].get(),
+                                              params_.get_output_data_ptr(i));
+    }
+    (*entry_ptr)->last_use = cache_.use_counter_++;
+    cache_.stats_.hits++;
+  }
+  /* Set the outputs without holding the lock, because that may start the evaluation of other
+   * nodes. */
+  for (const int i : output_indices) {
+    params_.output_set(i);
+  }
+  return true;
+}
+
+bool CachedNodeEvaluation::entry_matches(const GeometryNodesEvalCache::Entry &entry,
+                                         const Span<int> output_indices) const
+{
+  /* The node may have different sockets than when the entry was created. */
+  if (entry.inputs.size() != inputs_.size() ||
+      entry.outputs.size() != params_.fn_.outputs().size())
+  {
+    return false;
+  }
+  if (entry.settings.as_span() != settings_.as_span()) {
+    return false;
+  }
+  for (const int i : inputs_.index_range()) {
+    const CPPType &type = *inputs_[i].type();
+    if (entry.inputs[i].type() != &type) {
+      return false;
+    }
+    if (!values_equal(type, inputs_[i].get(), entry.inputs[i].get())) {
+      return false;
+    }
+  }
+  for (const int i : output_indices) {
+    if (entry.outputs[i].get() == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
+lf::Params &CachedNodeEvaluation::params_for_execution()
+{
+  if (!is_cacheable_) {
+    return params_;
+  }
+  recording_params_ = std::make_unique<RecordingParams>(params_);
+  return *recording_params_;
+}
+
+void CachedNodeEvaluation::finish(const timeit::Nanoseconds execution_time)
+{
+  bool is_expensive;
+  {
+    std::lock_guard lock{cache_.mutex_};
+    const std::pair<ComputeContextHash, int32_t> time_key{key_.context_hash, key_.node_id};
+    is_expensive = execution_time >= cache_.min_execution_time_;
+    if (is_expensive) {
+      if (cache_.last_execution_times_.size() >= GeometryNodesEvalCache::max_execution_times_num) {
+        cache_.last_execution_times_.clear();
+      }
+      cache_.last_execution_times_.add_overwrite(time_key, execution_time);
+    }
+    else {
+      /* Nodes without a recorded time are not expensive either. */
+      cache_.last_execution_times_.remove(time_key);
+    }
+  }
+  if (!recording_params_ || !is_expensive) {
+    return;
+  }
+
+  auto entry = std::make_unique<GeometryNodesEvalCache::Entry>();
+  entry->settings = std::move(settings_);
+  entry->inputs = std::move(inputs_);
+  entry->outputs = std::move(recording_params_->outputs);
+  recording_params_.reset();
+  for (const GMutablePointer value : entry->inputs) {
+    entry->memory_usage += estimate_memory_usage(value);
+  }
+  for (const GMutablePointer value : entry->outputs) {
+    if (value.get() != nullptr) {
+      entry->memory_usage += estimate_memory_usage(value);
+    }
+  }
+
+  std::lock_guard lock{cache_.mutex_};
+  cache_.add_entry(key_, std::move(entry));
+}
+
+/** \} */
+
+}  // namespace blender::nodes
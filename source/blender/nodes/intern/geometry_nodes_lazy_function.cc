@@ -14,6 +14,7 @@
  */
 
 #include "NOD_geometry_exec.hh"
+#include "NOD_geometry_nodes_eval_cache.hh"
 #include "NOD_geometry_nodes_lazy_function.hh"
 #include "NOD_multi_function.hh"
 #include "NOD_node_declaration.hh"
@@ -146,6 +147,8 @@ class LazyFunctionForGeometryNode : public LazyFunction {
    * does not have to execute.
    */
   Vector<bool> is_attribute_output_bsocket_;
+  /** True when the outputs of the node may be reused from a #GeometryNodesEvalCache. */
+  bool is_cacheable_;
 
   struct OutputAttributeID {
     int bsocket_index;
@@ -161,7 +164,8 @@ class LazyFunctionForGeometryNode : public LazyFunction {
                               GeometryNodesLazyFunctionGraphInfo &own_lf_graph_info)
       : node_(node),
         own_lf_graph_info_(own_lf_graph_info),
-        is_attribute_output_bsocket_(node.output_sockets().size(), false)
+        is_attribute_output_bsocket_(node.output_sockets().size(), false),
+        is_cacheable_(GeometryNodesEvalCache::is_node_supported(node))
   {
     BLI_assert(node.typeinfo->geometry_node_execute != nullptr);
     debug_name_ = node.name;
@@ -288,9 +292,20 @@ class LazyFunctionForGeometryNode : public LazyFunction {
       return;
     }
 
+    std::optional<CachedNodeEvaluation> cached_evaluation;
+    if (is_cacheable_ && user_data->modifier_data->eval_cache != nullptr) {
+      cached_evaluation.emplace(*user_data->modifier_data->eval_cache,
+                                user_data->compute_context->hash(),
+                                node_,
+                                params);
+      if (cached_evaluation->is_cacheable() && cached_evaluation->try_output_cached()) {
+        return;
+      }
+    }
+
     GeoNodeExecParams geo_params{
         node_,
-        params,
+        cached_evaluation ? cached_evaluation->params_for_execution() : params,
         context,
         own_lf_graph_info_.mapping.lf_input_index_for_output_bsocket_usage,
         own_lf_graph_info_.mapping.lf_input_index_for_attribute_propagation_to_output,
@@ -300,6 +315,11 @@ class LazyFunctionForGeometryNode : public LazyFunction {
     node_.typeinfo->geometry_node_execute(geo_params);
     geo_eval_log::TimePoint end_time = geo_eval_log::Clock::now();
 
+    if (cached_evaluation) {
+      cached_evaluation->finish(
+          std::chrono::duration_cast<timeit::Nanoseconds>(end_time - start_time));
+    }
+
     if (local_user_data.tree_logger) {
       local_user_data.tree_logger->node_execution_times.append(
           {node_.identifier, start_time, end_time});
@@ -943,7 +963,8 @@ class LazyFunctionForGroupNode : public LazyFunction {
                             std::move(graph_inputs),
                             std::move(graph_outputs),
                             &*lf_logger_,
-                            &*lf_side_effect_provider_);
+                            &*lf_side_effect_provider_,
+                            lazy_function_graph_scheduling(group_lf_graph_info));
   }
 
   void execute_impl(lf::Params &params, const lf::Context &context) const override
@@ -3183,6 +3204,16 @@ const GeometryNodesLazyFunctionGraphInfo *ensure_geometry_nodes_lazy_function_gr
   return lf_graph_info_ptr.get();
 }
 
+lf::GraphExecutor::Scheduling lazy_function_graph_scheduling(
+    const GeometryNodesLazyFunctionGraphInfo &lf_graph_info)
+{
+  /* In smaller graphs, enabling multi-threading eagerly often costs more than it gains. */
+  if (lf_graph_info.graph.nodes().size() > 1000) {
+    return lf::GraphExecutor::Scheduling::WorkStealing;
+  }
+  return lf::GraphExecutor::Scheduling::TaskPool;
+}
+
 GeometryNodesLazyFunctionLogger::GeometryNodesLazyFunctionLogger(
     const GeometryNodesLazyFunctionGraphInfo &lf_graph_info)
     : lf_graph_info_(lf_graph_info)
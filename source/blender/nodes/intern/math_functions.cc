@@ -2,6 +2,8 @@
 
 #include "NOD_math_functions.hh"
 
+#include "FN_multi_function_simd_math.hh"
+
 namespace blender::nodes {
 
 const FloatMathOperationInfo *get_float_math_operation_info(const int operation)
@@ -204,4 +206,51 @@ const FloatMathOperationInfo *get_float3_math_operation_info(const int operation
   return nullptr;
 }
 
+const mf::MultiFunction &get_simd_float_math_function(const int operation,
+                                                      const mf::MultiFunction &fn)
+{
+#define RETURN_SIMD_FUNCTION(simd_operation) \
+  { \
+    static const mf::SIMDMathFunction simd_fn{simd_operation, fn}; \
+    return simd_fn; \
+  } \
+  ((void)0)
+
+  switch (operation) {
+    case NODE_MATH_ADD:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Add);
+    case NODE_MATH_SUBTRACT:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Subtract);
+    case NODE_MATH_MULTIPLY:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Multiply);
+    case NODE_MATH_DIVIDE:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::SafeDivide);
+    case NODE_MATH_MINIMUM:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Minimum);
+    case NODE_MATH_MAXIMUM:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Maximum);
+  }
+  return fn;
+}
+
+const mf::MultiFunction &get_simd_float3_math_function(const int operation,
+                                                       const mf::MultiFunction &fn)
+{
+  /* Minimum and maximum are not supported, because #math::min and #math::max handle NaN and
+   * signed zero differently than `std::min` and `std::max`. */
+  switch (operation) {
+    case NODE_VECTOR_MATH_ADD:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Add);
+    case NODE_VECTOR_MATH_SUBTRACT:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Subtract);
+    case NODE_VECTOR_MATH_MULTIPLY:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::Multiply);
+    case NODE_VECTOR_MATH_DIVIDE:
+      RETURN_SIMD_FUNCTION(mf::SIMDMathOperation::SafeDivide);
+  }
+  return fn;
+
+#undef RETURN_SIMD_FUNCTION
+}
+
 }  // namespace blender::nodes
@@ -119,7 +119,7 @@ static const mf::MultiFunction *get_base_multi_function(const bNode &node)
         base_fn = &fn;
       });
   if (base_fn != nullptr) {
-    return base_fn;
+    return &get_simd_float_math_function(mode, *base_fn);
   }
 
   try_dispatch_float_math_fl_fl_fl_to_fl(
@@ -241,7 +241,7 @@ static const mf::MultiFunction *get_multi_function(const bNode &node)
         multi_fn = &fn;
       });
   if (multi_fn != nullptr) {
-    return multi_fn;
+    return &get_simd_float3_math_function(operation, *multi_fn);
   }
 
   try_dispatch_float_math_fl3_fl3_fl3_to_fl3(
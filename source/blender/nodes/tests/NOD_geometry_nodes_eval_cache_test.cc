@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "DNA_node_types.h"
+
+#include "FN_lazy_function_execute.hh"
+
+#include "NOD_geometry_nodes_eval_cache.hh"
+
+namespace blender::nodes::tests {
+
+using namespace std::chrono_literals;
+
+class AddOneFunction : public lf::LazyFunction {
+ public:
+  mutable int executions_num = 0;
+
+  AddOneFunction()
+  {
+    debug_name_ = "Add One";
+    inputs_.append({"Value", CPPType::get<int>()});
+    outputs_.append({"Result", CPPType::get<int>()});
+  }
+
+  void execute_impl(lf::Params &params, const lf::Context & /*context*/) const override
+  {
+    executions_num++;
+    params.set_output(0, params.get_input<int>(0) + 1);
+  }
+};
+
+/**
+ * Evaluates the function the same way #LazyFunctionForGeometryNode does, but with a fake execution
+ * time, so that the tests don't depend on how long the function actually takes.
+ */
+static int evaluate(GeometryNodesEvalCache &cache,
+                    const AddOneFunction &fn,
+                    const bNode &node,
+                    int input,
+                    const timeit::Nanoseconds execution_time)
+{
+  int output = 0;
+  std::array<GMutablePointer, 1> inputs = {GMutablePointer(&input)};
+  std::array<GMutablePointer, 1> outputs = {GMutablePointer(&output)};
+  std::array<std::optional<lf::ValueUsage>, 1> input_usages;
+  std::array<lf::ValueUsage, 1> output_usages = {lf::ValueUsage::Used};
+  std::array<bool, 1> set_outputs = {false};
+  lf::BasicParams params{fn, inputs, outputs, input_usages, output_usages, set_outputs};
+
+  CachedNodeEvaluation evaluation{cache, ComputeContextHash{}, node, params};
+  if (evaluation.is_cacheable() && evaluation.try_output_cached()) {
+    EXPECT_TRUE(set_outputs[0]);
+    return output;
+  }
+  lf::Context context{nullptr, nullptr, nullptr};
+  fn.execute(evaluation.params_for_execution(), context);
+  evaluation.finish(execution_time);
+  EXPECT_TRUE(set_outputs[0]);
+  return output;
+}
+
+TEST(geometry_nodes_eval_cache, HitsAndMisses)
+{
+  GeometryNodesEvalCache cache;
+  const AddOneFunction fn;
+  bNode node{};
+  node.identifier = 1;
+
+  /* The node is not known to be expensive yet. */
+  EXPECT_EQ(evaluate(cache, fn, node, 5, 10ms), 6);
+  EXPECT_EQ(cache.stats().misses, 0);
+  EXPECT_EQ(cache.stats().stores, 0);
+
+  EXPECT_EQ(evaluate(cache, fn, node, 5, 10ms), 6);
+  EXPECT_EQ(cache.stats().misses, 1);
+  EXPECT_EQ(cache.stats().stores, 1);
+  EXPECT_EQ(fn.executions_num, 2);
+
+  EXPECT_EQ(evaluate(cache, fn, node, 5, 10ms), 6);
+  EXPECT_EQ(cache.stats().hits, 1);
+  EXPECT_EQ(fn.executions_num, 2);
+
+  /* Different inputs don't match the existing entry. */
+  EXPECT_EQ(evaluate(cache, fn, node, 7, 10ms), 8);
+  EXPECT_EQ(cache.stats().hits, 1);
+  EXPECT_EQ(cache.stats().misses, 2);
+  EXPECT_EQ(fn.executions_num, 3);
+
+  EXPECT_EQ(evaluate(cache, fn, node, 7, 10ms), 8);
+  EXPECT_EQ(evaluate(cache, fn, node, 5, 10ms), 6);
+  EXPECT_EQ(cache.stats().hits, 3);
+  EXPECT_EQ(cache.stats().entries_num, 2);
+  EXPECT_EQ(fn.executions_num, 3);
+
+  /* Changed node settings don't match either. */
+  node.custom1 = 1;
+  EXPECT_EQ(evaluate(cache, fn, node, 5, 10ms), 6);
+  EXPECT_EQ(cache.stats().misses, 3);
+  EXPECT_EQ(fn.executions_num, 4);
+}
+
+TEST(geometry_nodes_eval_cache, CheapNodesAreNotCached)
+{
+  GeometryNodesEvalCache cache;
+  cache.set_min_execution_time(1ms);
+  const AddOneFunction fn;
+  bNode node{};
+  node.identifier = 1;
+
+  for ([[maybe_unused]] const int i : IndexRange(3)) {
+    EXPECT_EQ(evaluate(cache, fn, node, 5, 100us), 6);
+  }
+  EXPECT_EQ(fn.executions_num, 3);
+  EXPECT_EQ(cache.stats().hits, 0);
+  EXPECT_EQ(cache.stats().misses, 0);
+  EXPECT_EQ(cache.stats().entries_num, 0);
+}
+
+TEST(geometry_nodes_eval_cache, BudgetEviction)
+{
+  GeometryNodesEvalCache cache;
+  const AddOneFunction fn;
+  bNode node_a{};
+  node_a.identifier = 1;
+  bNode node_b{};
+  node_b.identifier = 2;
+
+  for ([[maybe_unused]] const int i : IndexRange(2)) {
+    evaluate(cache, fn, node_a, 1, 10ms);
+    evaluate(cache, fn, node_b, 2, 10ms);
+  }
+  EXPECT_EQ(cache.stats().entries_num, 2);
+  const int64_t entry_size = cache.stats().memory_usage / 2;
+  EXPECT_GT(entry_size, 0);
+
+  /* Use the entry of the first node, so that the second one is evicted. */
+  EXPECT_EQ(evaluate(cache, fn, node_a, 1, 10ms), 2);
+  EXPECT_EQ(cache.stats().hits, 1);
+  cache.set_memory_budget(entry_size);
+  EXPECT_EQ(cache.stats().evictions, 1);
+  EXPECT_EQ(cache.stats().entries_num, 1);
+  EXPECT_EQ(cache.stats().memory_usage, entry_size);
+
+  EXPECT_EQ(evaluate(cache, fn, node_a, 1, 10ms), 2);
+  EXPECT_EQ(cache.stats().hits, 2);
+  const int executions_num = fn.executions_num;
+
+  /* The evicted node has to be found to be expensive again before it is cached again, which
+   * evicts the entry of the other node. */
+  EXPECT_EQ(evaluate(cache, fn, node_b, 2, 10ms), 3);
+  EXPECT_EQ(cache.stats().entries_num, 1);
+  EXPECT_EQ(evaluate(cache, fn, node_b, 2, 10ms), 3);
+  EXPECT_EQ(cache.stats().evictions, 2);
+  EXPECT_EQ(cache.stats().entries_num, 1);
+  EXPECT_EQ(evaluate(cache, fn, node_b, 2, 10ms), 3);
+  EXPECT_EQ(fn.executions_num, executions_num + 2);
+}
+
+}  // namespace blender::nodes::tests
@@ -658,9 +658,12 @@ static void print_help(bArgs *ba, bool all)
   BLI_args_print_arg_doc(ba, "--debug-depsgraph-build");
   BLI_args_print_arg_doc(ba, "--debug-depsgraph-tag");
   BLI_args_print_arg_doc(ba, "--debug-depsgraph-no-threads");
+  BLI_args_print_arg_doc(ba, "--debug-depsgraph-critical-path");
+  BLI_args_print_arg_doc(ba, "--debug-depsgraph-validate-incremental");
   BLI_args_print_arg_doc(ba, "--debug-depsgraph-time");
   BLI_args_print_arg_doc(ba, "--debug-depsgraph-pretty");
   BLI_args_print_arg_doc(ba, "--debug-depsgraph-uuid");
+  BLI_args_print_arg_doc(ba, "--debug-depsgraph-trace");
   BLI_args_print_arg_doc(ba, "--debug-ghost");
   BLI_args_print_arg_doc(ba, "--debug-wintab");
   BLI_args_print_arg_doc(ba, "--debug-gpu");
@@ -1122,6 +1125,14 @@ static const char arg_handle_debug_mode_generic_set_doc_depsgraph_eval[] =
 static const char arg_handle_debug_mode_generic_set_doc_depsgraph_no_threads[] =
     "\n\t"
     "Switch dependency graph to a single threaded evaluation.";
+static const char arg_handle_debug_mode_generic_set_doc_depsgraph_critical_path[] =
+    "\n\t"
+    "Evaluate dependency graph operations on the longest chain of dependent operations first,\n\t"
+    "based on the evaluation times measured in previous updates.";
+static const char arg_handle_debug_mode_generic_set_doc_depsgraph_validate_incremental[] =
+    "\n\t"
+    "Compare the result of every incremental dependency graph relations update against a full\n\t"
+    "rebuild, and print the differences.";
 static const char arg_handle_debug_mode_generic_set_doc_depsgraph_pretty[] =
     "\n\t"
     "Enable colors for dependency graph debug messages.";
@@ -1143,6 +1154,21 @@ static int arg_handle_debug_mode_generic_set(int UNUSED(argc),
   return 0;
 }
 
+static const char arg_handle_debug_depsgraph_trace_doc[] =
+    "<filepath>\n"
+    "\tRecord the timeline of dependency graph evaluations and write it to the file on exit,\n"
+    "\tin the trace event format which can be opened in 'chrome://tracing' or Perfetto.";
+static int arg_handle_debug_depsgraph_trace(int argc, const char **argv, void *UNUSED(data))
+{
+  const char *arg_id = "--debug-depsgraph-trace";
+  if (argc > 1) {
+    DEG_debug_trace_global_begin(argv[1]);
+    return 1;
+  }
+  fprintf(stderr, "\nError: '%s' no args given.\n", arg_id);
+  return 0;
+}
+
 static const char arg_handle_debug_mode_io_doc[] =
     "\n\t"
     "Enable debug messages for I/O (Collada, ...).";
@@ -2498,6 +2524,16 @@ void main_args_setup(bContext *C, bArgs *ba, bool all)
                "--debug-depsgraph-no-threads",
                CB_EX(arg_handle_debug_mode_generic_set, depsgraph_no_threads),
                (void *)G_DEBUG_DEPSGRAPH_NO_THREADS);
+  BLI_args_add(ba,
+               NULL,
+               "--debug-depsgraph-critical-path",
+               CB_EX(arg_handle_debug_mode_generic_set, depsgraph_critical_path),
+               (void *)G_DEBUG_DEPSGRAPH_CRITICAL_PATH);
+  BLI_args_add(ba,
+               NULL,
+               "--debug-depsgraph-validate-incremental",
+               CB_EX(arg_handle_debug_mode_generic_set, depsgraph_validate_incremental),
+               (void *)G_DEBUG_DEPSGRAPH_VALIDATE_INCREMENTAL);
   BLI_args_add(ba,
                NULL,
                "--debug-depsgraph-pretty",
@@ -2508,6 +2544,7 @@ void main_args_setup(bContext *C, bArgs *ba, bool all)
                "--debug-depsgraph-uuid",
                CB_EX(arg_handle_debug_mode_generic_set, depsgraph_uuid),
                (void *)G_DEBUG_DEPSGRAPH_UUID);
+  BLI_args_add(ba, NULL, "--debug-depsgraph-trace", CB(arg_handle_debug_depsgraph_trace), NULL);
   BLI_args_add(ba,
                NULL,
                "--debug-gpu-force-workarounds",
@@ -27,10 +27,14 @@ def _run(args):
 
 
 class AnimationTest(api.Test):
-    def __init__(self, filepath):
+    def __init__(self, filepath, critical_path=False):
         self.filepath = filepath
+        # Use the depsgraph scheduling which prioritizes the longest chain of operations.
+        self.critical_path = critical_path
 
     def name(self):
+        if self.critical_path:
+            return self.filepath.stem + "_critical_path"
         return self.filepath.stem
 
     def category(self):
@@ -38,10 +42,13 @@ class AnimationTest(api.Test):
 
     def run(self, env, device_id):
         args = {}
-        result, _ = env.run_in_blender(_run, args, [self.filepath])
+        blender_args = ['--debug-depsgraph-critical-path'] if self.critical_path else []
+        result, _ = env.run_in_blender(_run, args, blender_args + [self.filepath])
         return result
 
 
 def generate(env):
     filepaths = env.find_blend_files('animation/*')
-    return [AnimationTest(filepath) for filepath in filepaths]
+    return [AnimationTest(filepath, critical_path)
+            for filepath in filepaths
+            for critical_path in (False, True)]